@@ -0,0 +1,233 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Compares the two storages of IQTensor blocks on the tensors
+// made by the DMRG steps of a sweep: the wavefunction of each bond
+// and every intermediate of applying the Hamiltonian to it.
+// IQTensor keeps its blocks in an IQTDat (a deque of ITensors,
+// each with its own storage); IQTFlat keeps all of them in one
+// Vector with a table of offsets. Timed are the uses made of the
+// blocks, copying the tensors (as done when a shared IQTDat is
+// written to), finding blocks by key and iterating over them, and
+// the vector operations of the Davidson algorithm on tensors with
+// the same blocks.
+//
+// Usage: blockdat_bench [N] [maxm] [nrep]
+//
+#include "core.h"
+#include "model/spinone.h"
+#include "hams/heisenberg.h"
+#include "cputime.h"
+
+using namespace std;
+using boost::format;
+
+struct Timings
+    {
+    Real copy, lookup, iterate, axpy, dot, norm;
+    Timings() : copy(0), lookup(0), iterate(0), axpy(0), dot(0), norm(0) { }
+
+    Real
+    total() const { return copy+lookup+iterate+axpy+dot+norm; }
+    };
+
+//Deep copy, as made when a shared IQTensor is written to
+void
+copyOf(const IQTensor& T, IQTensor& res)
+    {
+    res = T;
+    res.assignFrom(T);
+    }
+
+void
+copyOf(const IQTFlat& T, IQTFlat& res)
+    {
+    res = T;
+    }
+
+Real
+lookupAll(const IQTensor& T, const vector<IndexKey>& keys)
+    {
+    Real s = 0;
+    Foreach(IndexKey k, keys)
+        s += T.blocks().get(k).vecSize();
+    return s;
+    }
+
+Real
+lookupAll(const IQTFlat& T, const vector<IndexKey>& keys)
+    {
+    Real s = 0;
+    Foreach(IndexKey k, keys)
+        s += T.blockData(T.find(k)).Length();
+    return s;
+    }
+
+Real
+iterateAll(const IQTensor& T)
+    {
+    Real s = 0;
+    for(IQTensor::const_iten_it it = T.const_iten_begin(); it != T.const_iten_end(); ++it)
+        s += it->sumels();
+    return s;
+    }
+
+Real
+iterateAll(const IQTFlat& T)
+    {
+    return T.data().sumels();
+    }
+
+//
+// Times each kind of use on pairs x,y of tensors
+// with the same blocks
+//
+template <class Tensor>
+Real
+timeUses(const vector<Tensor>& x, const vector<Tensor>& y,
+         const vector<vector<IndexKey> >& keys, int nrep, Timings& T)
+    {
+    Real check = 0;
+    for(int n = 0; n < nrep; ++n)
+        {
+        vector<Tensor> c(x.size());
+        cpu_time cpu;
+        for(size_t j = 0; j < x.size(); ++j)
+            copyOf(y[j],c[j]);
+        T.copy += cpu.sincemark().time;
+
+        cpu.mark();
+        for(size_t j = 0; j < x.size(); ++j)
+            check += lookupAll(x[j],keys[j]);
+        T.lookup += cpu.sincemark().time;
+
+        cpu.mark();
+        for(size_t j = 0; j < x.size(); ++j)
+            check += iterateAll(x[j]);
+        T.iterate += cpu.sincemark().time;
+
+        cpu.mark();
+        for(size_t j = 0; j < x.size(); ++j)
+            c[j] += x[j];
+        T.axpy += cpu.sincemark().time;
+
+        cpu.mark();
+        for(size_t j = 0; j < x.size(); ++j)
+            check += Dot(x[j],c[j]);
+        T.dot += cpu.sincemark().time;
+
+        cpu.mark();
+        for(size_t j = 0; j < x.size(); ++j)
+            check += c[j].norm();
+        T.norm += cpu.sincemark().time;
+        }
+    return check;
+    }
+
+void
+multInto(IQTensor& L, const IQTensor& A)
+    {
+    if(L.isNull()) L = A;
+    else L *= A;
+    }
+
+void
+printRow(const string& name, Real per, Real told, Real tnew)
+    {
+    cout << format("%10s %12.1f %12.1f %8.2f\n")
+            % name % (per*told) % (per*tnew) % (told/max(tnew,1E-9));
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int N = (argc > 1 ? atoi(argv[1]) : 20),
+              maxm = (argc > 2 ? atoi(argv[2]) : 100),
+              nrep = (argc > 3 ? atoi(argv[3]) : 20);
+
+    SpinOne model(N);
+    IQMPO H = Heisenberg(model);
+    InitState initState(N);
+    for(int i = 1; i <= N; ++i)
+        initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+    IQMPS psi(model,initState);
+
+    Sweeps sweeps(4);
+    sweeps.maxm() = maxm/4,maxm/2,maxm;
+    sweeps.cutoff() = 1E-10;
+    dmrg(psi,H,sweeps,Quiet());
+    psi.position(1);
+
+    //Environments of the Hamiltonian
+    vector<IQTensor> Lenv(N+2), Renv(N+2);
+    for(int i = 1; i <= N; ++i)
+        {
+        Lenv[i] = Lenv[i-1];
+        multInto(Lenv[i],psi.AA(i));
+        Lenv[i] *= H.AA(i);
+        Lenv[i] *= conj(primed(psi.AA(i)));
+        }
+    for(int i = N; i >= 1; --i)
+        {
+        Renv[i] = Renv[i+1];
+        multInto(Renv[i],psi.AA(i));
+        Renv[i] *= H.AA(i);
+        Renv[i] *= conj(primed(psi.AA(i)));
+        }
+
+    //DMRG steps of a sweep: apply H to the
+    //wavefunction of each bond, keeping
+    //the tensors made along the way
+    vector<IQTensor> made;
+    for(int b = 1; b < N; ++b)
+        {
+        made.push_back(psi.AA(b) * psi.AA(b+1));
+        IQTensor Hphi = Lenv[b-1];
+        multInto(Hphi,made.back());     made.push_back(Hphi);
+        Hphi *= H.AA(b);                made.push_back(Hphi);
+        Hphi *= H.AA(b+1);              made.push_back(Hphi);
+        if(b+2 <= N)
+            { Hphi *= Renv[b+2];        made.push_back(Hphi); }
+        }
+
+    //Pairs of tensors with the same blocks
+    vector<IQTensor> x(made), y(made.size());
+    vector<IQTFlat> fx, fy;
+    vector<vector<IndexKey> > keys(made.size());
+    int nblock = 0;
+    for(size_t j = 0; j < made.size(); ++j)
+        {
+        y[j] = x[j];
+        y[j].Randomize();
+        fx.push_back(IQTFlat(x[j]));
+        fy.push_back(IQTFlat(y[j]));
+        for(IQTensor::const_iten_it it = x[j].const_iten_begin(); it != x[j].const_iten_end(); ++it)
+            keys[j].push_back(it->uniqueId());
+        nblock += x[j].iten_size();
+        }
+
+    Timings told, tnew;
+    const Real cold = timeUses(x,y,keys,nrep,told),
+               cnew = timeUses(fx,fy,keys,nrep,tnew);
+    if(fabs(cold-cnew) > 1E-8*fabs(cold))
+        {
+        cout << "Storages differ" << endl;
+        return 1;
+        }
+
+    cout << format("N = %d, maxm = %d: %d tensors with %.1f blocks on average per sweep\n\n")
+            % N % maxm % made.size() % (Real(nblock)/made.size());
+
+    const Real per = 1E6/(nrep*(N-1));
+    cout << format("%10s %12s %12s %8s\n") % "per step" % "IQTDat us" % "IQTFlat us" % "gain";
+    printRow("copy",per,told.copy,tnew.copy);
+    printRow("lookup",per,told.lookup,tnew.lookup);
+    printRow("iterate",per,told.iterate,tnew.iterate);
+    printRow("axpy",per,told.axpy,tnew.axpy);
+    printRow("dot",per,told.dot,tnew.dot);
+    printRow("norm",per,told.norm,tnew.norm);
+    printRow("total",per,told.total(),tnew.total());
+
+    return 0;
+    }
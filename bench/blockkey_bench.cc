@@ -0,0 +1,263 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Times the block bookkeeping of IQTensor::operator*= for
+// tensors with many small blocks: grouping the blocks by the
+// key of their contracted indices and finding the block of the
+// result each pair adds into. The integer keys and hash tables
+// now used are compared with the Real keys (uniqueReal) and
+// ApproxReal trees they replaced, which are reproduced below
+// (with the keys of each Index computed ahead of time, as
+// they were stored in the IndexDat).
+//
+// Usage: blockkey_bench [nsector] [nrep]
+//
+#include "iqtensor.h"
+#include "cputime.h"
+#include <set>
+
+using namespace std;
+using boost::format;
+
+//
+// Previous Index::uniqueReal: a sin of the weighted
+// uuid digits, scaled by the prime level
+//
+Real
+oldUniqueReal(const Index& I)
+    {
+    static const int plist[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31,
+                                 37, 41, 43, 47, 53, 59, 61, 67, 71, 73 };
+    const boost::uuids::uuid& ind = I.Ind();
+    Real arg = 0;
+    int pn = 1;
+    for(int i = int(ind.size())-1; i >= 0; --i)
+        { arg += ind.data[i]*sqrt(1.0/plist[++pn]); }
+    arg *= sqrt(1.0/plist[++pn]);
+    arg += ((int)I.type() - (int)Site) * sqrt(1.0/plist[++pn]);
+    return sin(arg)*(1+0.00398406*I.primeLevel());
+    }
+
+struct ApproxReal
+    {
+    Real r;
+    ApproxReal() : r(0) {}
+    ApproxReal(Real _r) : r(_r) {}
+
+    bool friend inline
+    operator<(const ApproxReal &a,const ApproxReal &b)
+        { return b.r-a.r > 1E-14; }
+    };
+
+typedef list<ITensor>::const_iterator
+block_it;
+
+//
+// Block with its index keys as they were stored before:
+// computed once per Index, and summed for the block
+//
+struct OldBlock
+    {
+    block_it it;
+    vector<Real> ur;
+    Real total;
+
+    OldBlock(block_it it_)
+        : it(it_), total(0)
+        {
+        for(int a = 1; a <= it->r(); ++a)
+            {
+            ur.push_back(oldUniqueReal(it->index(a)));
+            total += ur.back();
+            }
+        }
+    };
+
+//
+// Previous grouping: multimaps and sets keyed
+// by sums of Real keys compared through ApproxReal
+//
+int
+oldPlan(const vector<OldBlock>& L, const vector<OldBlock>& R,
+        const vector<Real>& common)
+    {
+    set<ApproxReal> common_inds;
+    Foreach(Real ur, common)
+        common_inds.insert(ApproxReal(ur));
+
+    typedef vector<OldBlock>::const_iterator
+    oblock_it;
+
+    set<ApproxReal> keys;
+    multimap<ApproxReal,oblock_it> com_this, com_other;
+    for(oblock_it tt = L.begin(); tt != L.end(); ++tt)
+        {
+        Real r = 0;
+        Foreach(Real ur, tt->ur)
+            if(common_inds.count(ApproxReal(ur))) r += ur;
+        com_this.insert(make_pair(ApproxReal(r),tt));
+        keys.insert(ApproxReal(r));
+        }
+    for(oblock_it ot = R.begin(); ot != R.end(); ++ot)
+        {
+        Real r = 0;
+        Foreach(Real ur, ot->ur)
+            if(common_inds.count(ApproxReal(ur))) r += ur;
+        com_other.insert(make_pair(ApproxReal(r),ot));
+        keys.insert(ApproxReal(r));
+        }
+
+    typedef multimap<ApproxReal,oblock_it>::iterator mit;
+    map<ApproxReal,int> blockOf;
+    int npair = 0;
+    for(set<ApproxReal>::iterator k = keys.begin(); k != keys.end(); ++k)
+        {
+        pair<mit,mit> lrange = com_this.equal_range(*k),
+                      rrange = com_other.equal_range(*k);
+        for(mit ll = lrange.first; ll != lrange.second; ++ll)
+        for(mit rr = rrange.first; rr != rrange.second; ++rr)
+            {
+            const ApproxReal res_ur(ll->second->total + rr->second->total - 2*k->r);
+            if(blockOf.find(res_ur) == blockOf.end())
+                blockOf.insert(make_pair(res_ur,int(blockOf.size())));
+            ++npair;
+            }
+        }
+    return npair;
+    }
+
+//
+// Current grouping, as in IQTensor::operator*=
+//
+int
+newPlan(const list<ITensor>& L, const list<ITensor>& R,
+        const vector<IQIndex>& common)
+    {
+    boost::unordered_set<IndexKey> common_inds;
+    Foreach(const IQIndex& I, common)
+        {
+        for(size_t n = 0; n < I.iq().size(); ++n)
+            common_inds.insert(I.iq()[n].index.uniqueId());
+        common_inds.insert(I.uniqueId());
+        }
+
+    BlockGroups<block_it,block_it> groups(common_inds);
+    for(block_it tt = L.begin(); tt != L.end(); ++tt) groups.addLeft(tt);
+    for(block_it ot = R.begin(); ot != R.end(); ++ot) groups.addRight(ot);
+
+    boost::unordered_map<IndexKey,int> blockOf;
+    int npair = 0;
+    for(int g = 0; g < groups.size(); ++g)
+        {
+        const vector<block_it> &Lg = groups.left(g),
+                               &Rg = groups.right(g);
+        for(size_t l = 0; l < Lg.size(); ++l)
+        for(size_t r = 0; r < Rg.size(); ++r)
+            {
+            const IndexKey res_key = Lg[l]->uniqueId() + Rg[r]->uniqueId() - 2*groups.key(g);
+            if(blockOf.find(res_key) == blockOf.end())
+                blockOf.insert(make_pair(res_key,int(blockOf.size())));
+            ++npair;
+            }
+        }
+    return npair;
+    }
+
+//Link IQIndex with sectors Sz = -nsector..nsector, each of dimension m
+IQIndex
+makeLink(const string& name, int nsector, int m)
+    {
+    vector<inqn> iq;
+    for(int q = -nsector; q <= nsector; ++q)
+        iq.push_back(inqn(Index(str(format("%s%+d")%name%q),m),QN(q)));
+    return IQIndex(name,iq,Out);
+    }
+
+//Tensor with indices conj(l), s, r keeping all blocks
+//allowed by conservation of Sz
+IQTensor
+makeMPSTensor(const IQIndex& l, const IQIndex& s, const IQIndex& r)
+    {
+    IQTensor A(conj(l),s,r);
+    for(int i = 1; i <= l.nindex(); ++i)
+    for(int j = 1; j <= s.nindex(); ++j)
+    for(int k = 1; k <= r.nindex(); ++k)
+        {
+        if(l.qn(i) + s.qn(j) != r.qn(k)) continue;
+        ITensor t(l.index(i),s.index(j),r.index(k));
+        t.Randomize();
+        A += t;
+        }
+    return A;
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int nsector = (argc > 1 ? atoi(argv[1]) : 40),
+              nrep = (argc > 2 ? atoi(argv[2]) : 200);
+
+    //Spin 1/2 sites (Sz = +-1 in units of 1/2)
+    //so that each link sector couples to two others
+    Index su("su",1,Site), sd("sd",1,Site),
+          tu("tu",1,Site), td("td",1,Site);
+    IQIndex S("S",su,QN(+1),sd,QN(-1),Out),
+            T("T",tu,QN(+1),td,QN(-1),Out);
+
+    cout << format("%8s %8s %8s %12s %12s %8s %14s\n")
+            % "sectors" % "blocks" % "pairs" % "old us" % "new us"
+            % "gain" % "product us";
+
+    for(int ns = nsector/4; ns <= nsector; ns *= 2)
+        {
+        const IQIndex L = makeLink("L",2*ns,2),
+                      M = makeLink("M",2*ns,2),
+                      R = makeLink("R",2*ns,2);
+
+        const IQTensor A = makeMPSTensor(L,S,M),
+                       B = makeMPSTensor(M,T,R);
+
+        const list<ITensor> Ablocks(A.blocks().begin(),A.blocks().end()),
+                            Bblocks(B.blocks().begin(),B.blocks().end());
+        const vector<IQIndex> common(1,M);
+
+        vector<OldBlock> Aold, Bold;
+        for(block_it it = Ablocks.begin(); it != Ablocks.end(); ++it) Aold.push_back(OldBlock(it));
+        for(block_it it = Bblocks.begin(); it != Bblocks.end(); ++it) Bold.push_back(OldBlock(it));
+        vector<Real> cold(1,oldUniqueReal(M));
+        for(int n = 1; n <= M.nindex(); ++n) cold.push_back(oldUniqueReal(M.index(n)));
+
+        const int npair = newPlan(Ablocks,Bblocks,common);
+        if(oldPlan(Aold,Bold,cold) != npair)
+            {
+            cout << "Number of block pairs differ" << endl;
+            return 1;
+            }
+
+        cpu_time cpu;
+        for(int n = 0; n < nrep; ++n)
+            oldPlan(Aold,Bold,cold);
+        const Real told = cpu.sincemark().time;
+
+        cpu.mark();
+        for(int n = 0; n < nrep; ++n)
+            newPlan(Ablocks,Bblocks,common);
+        const Real tnew = cpu.sincemark().time;
+
+        cpu.mark();
+        for(int n = 0; n < nrep; ++n)
+            {
+            IQTensor AB(A);
+            AB *= B;
+            }
+        const Real tprod = cpu.sincemark().time;
+
+        cout << format("%8d %8d %8d %12.1f %12.1f %8.2f %14.1f\n")
+                % L.nindex() % (A.iten_size()+B.iten_size()) % npair
+                % (1E6*told/nrep) % (1E6*tnew/nrep)
+                % (told/max(tnew,1E-9)) % (1E6*tprod/nrep);
+        }
+
+    return 0;
+    }
@@ -0,0 +1,141 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Times saving and loading a chain of MPS-like IQTensors
+// with IQTensor::write/read on one std::fstream, and with
+// CheckpointWriter/CheckpointReader.
+// Also times loading only the last tensor of the chain.
+// (Both read from the page cache after the first pass.)
+//
+// Usage: checkpoint_bench [N] [nsector] [m per sector] [dir]
+//
+#include "checkpoint.h"
+#include <sys/time.h>
+#include <cstdio>
+
+using namespace std;
+using boost::format;
+
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+//Link IQIndex with sectors Sz = -nsector..nsector, each of dimension m
+IQIndex
+makeLink(const string& name, int nsector, int m)
+    {
+    vector<inqn> iq;
+    for(int q = -nsector; q <= nsector; ++q)
+        iq.push_back(inqn(Index(str(format("%s%+d")%name%q),m),QN(q)));
+    return IQIndex(name,iq,Out);
+    }
+
+IQTensor
+makeMPSTensor(const IQIndex& l, const IQIndex& s, const IQIndex& r)
+    {
+    IQTensor A(conj(l),s,r);
+    for(int i = 1; i <= l.nindex(); ++i)
+    for(int j = 1; j <= s.nindex(); ++j)
+    for(int k = 1; k <= r.nindex(); ++k)
+        {
+        if(l.qn(i) + s.qn(j) != r.qn(k)) continue;
+        ITensor t(l.index(i),s.index(j),r.index(k));
+        t.Randomize();
+        A += t;
+        }
+    return A;
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int N = (argc > 1 ? atoi(argv[1]) : 20),
+              nsector = (argc > 2 ? atoi(argv[2]) : 20),
+              m = (argc > 3 ? atoi(argv[3]) : 50);
+    const string dir = (argc > 4 ? argv[4] : "."),
+                 fstream_name = dir + "/bench_stream",
+                 ckpt_name = dir + "/bench_ckpt";
+
+    vector<IQIndex> link(N+1);
+    for(int j = 0; j <= N; ++j)
+        link[j] = makeLink(str(format("L%d")%j),nsector,m);
+    vector<IQTensor> A(N+1);
+    Real bytes = 0;
+    for(int j = 1; j <= N; ++j)
+        {
+        Index su(str(format("su%d")%j),1,Site), sd(str(format("sd%d")%j),1,Site);
+        IQIndex S(str(format("S%d")%j),su,QN(+1),sd,QN(-1),Out);
+        A[j] = makeMPSTensor(link[j-1],S,link[j]);
+        Foreach(const ITensor& t, A[j].blocks()) bytes += sizeof(Real)*t.vecSize();
+        }
+
+    cout << format("%d tensors, link m = %d, %.1f MB\n\n") % N % link[0].m() % (bytes/1E6);
+    cout << format("%12s %10s %10s %10s\n") % "" % "write s" % "read s" % "last s";
+
+    Real t0 = wallTime();
+    {
+    ofstream s(fstream_name.c_str(),ios::binary);
+    for(int j = 1; j <= N; ++j) A[j].write(s);
+    }
+    const Real twold = wallTime()-t0;
+
+    t0 = wallTime();
+    vector<IQTensor> B(N+1);
+    {
+    ifstream s(fstream_name.c_str(),ios::binary);
+    for(int j = 1; j <= N; ++j) B[j].read(s);
+    }
+    const Real trold = wallTime()-t0;
+
+    //Only the last tensor: the stream has to be read up to it
+    t0 = wallTime();
+    {
+    ifstream s(fstream_name.c_str(),ios::binary);
+    IQTensor T;
+    for(int j = 1; j <= N; ++j) T.read(s);
+    }
+    const Real tlold = wallTime()-t0;
+
+    t0 = wallTime();
+    {
+    CheckpointWriter w(ckpt_name);
+    for(int j = 1; j <= N; ++j) w.write(str(format("A%03d")%j),A[j]);
+    }
+    const Real twnew = wallTime()-t0;
+
+    t0 = wallTime();
+    vector<IQTensor> C(N+1);
+    {
+    CheckpointReader r(ckpt_name);
+    for(int j = 1; j <= N; ++j) r.read(str(format("A%03d")%j),C[j]);
+    }
+    const Real trnew = wallTime()-t0;
+
+    t0 = wallTime();
+    {
+    CheckpointReader r(ckpt_name);
+    IQTensor T;
+    r.read(str(format("A%03d")%N),T);
+    }
+    const Real tlnew = wallTime()-t0;
+
+    cout << format("%12s %10.3f %10.3f %10.3f\n") % "fstream" % twold % trold % tlold;
+    cout << format("%12s %10.3f %10.3f %10.3f\n") % "checkpoint" % twnew % trnew % tlnew;
+
+    Real diff = 0;
+    for(int j = 1; j <= N; ++j) diff += (C[j]-B[j]).norm();
+    if(diff > 1E-10)
+        {
+        cout << "Tensors read differ" << endl;
+        return 1;
+        }
+
+    std::remove(fstream_name.c_str());
+    std::remove(ckpt_name.c_str());
+    return 0;
+    }
@@ -0,0 +1,110 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Counts, for each sweep of an IQTensor DMRG run on the
+// Heisenberg chain, the bytes of data that Combiners shared
+// instead of permuting (ITensor::groupIndices finding the
+// combined indices already in order, but not last) and the
+// bytes which were still permuted (ITensor::reshapeDat, from
+// all callers).
+//
+// Usage: combiner_bench [N] [nsweep] [maxm]
+//
+#include "core.h"
+#include "model/spinhalf.h"
+#include "hams/heisenberg.h"
+#include <sys/time.h>
+
+using namespace std;
+using boost::format;
+
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+const Profiler::Site*
+findSite(const vector<Profiler::Site>& sites, const string& name)
+    {
+    Foreach(const Profiler::Site& s, sites)
+        {
+        if(s.name == name) return &s;
+        }
+    return 0;
+    }
+
+int
+maxLinkM(const IQMPS& psi)
+    {
+    int m = 1;
+    for(int b = 1; b < psi.NN(); ++b)
+        m = max(m,psi.LinkInd(b).m());
+    return m;
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int N = (argc > 1 ? atoi(argv[1]) : 50),
+              nsweep = (argc > 2 ? atoi(argv[2]) : 5),
+              maxm = (argc > 3 ? atoi(argv[3]) : 100);
+
+    SpinHalf model(N);
+    IQMPO H = Heisenberg(model);
+    InitState initState(N);
+    for(int i = 1; i <= N; ++i)
+        initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+    IQMPS psi(model,initState);
+
+    Profiler::maxEvents(0);
+    Profiler::enable();
+
+    cout << format("N = %d, maxm = %d\n\n") % N % maxm;
+    cout << format("%6s %6s %10s %12s %10s %12s %8s\n")
+            % "sweep" % "m" % "shared" % "shared MB"
+            % "permuted" % "permuted MB" % "time s";
+
+    Real total_shared = 0, total_permuted = 0;
+    for(int sw = 1; sw <= nsweep; ++sw)
+        {
+        Sweeps sweeps(1);
+        sweeps.maxm() = min(maxm,10*(1 << sw));
+        sweeps.cutoff() = 1E-10;
+
+        Profiler::reset();
+        const Real t0 = wallTime();
+            {
+            //Swallow the sweep summary
+            ostringstream out;
+            streambuf* orig = cout.rdbuf(out.rdbuf());
+            dmrg(psi,H,sweeps,Quiet());
+            cout.rdbuf(orig);
+            }
+        const Real t = wallTime()-t0;
+
+        const vector<Profiler::Site> sites = Profiler::sites();
+        const Profiler::Site *shared = findSite(sites,"ITensor::groupIndices (shared)"),
+                             *permuted = findSite(sites,"ITensor::reshapeDat");
+        const long nshared = (shared ? shared->count : 0),
+                   npermuted = (permuted ? permuted->count : 0);
+        //Site bytes count both the read and the write
+        const Real bshared = (shared ? shared->bytes/2 : 0),
+                   bpermuted = (permuted ? permuted->bytes/2 : 0);
+        total_shared += bshared;
+        total_permuted += bpermuted;
+
+        cout << format("%6d %6d %10d %12.2f %10d %12.2f %8.2f\n")
+                % sw % maxLinkM(psi) % nshared % (bshared/1E6)
+                % npermuted % (bpermuted/1E6) % t;
+        }
+
+    cout << format("\nShared %.2f MB, permuted %.2f MB (%.0f%% of the data combined or permuted was shared)\n")
+            % (total_shared/1E6) % (total_permuted/1E6)
+            % (100*total_shared/max(total_shared+total_permuted,1.));
+
+    return 0;
+    }
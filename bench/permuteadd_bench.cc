@@ -0,0 +1,165 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Times adding a scaled, permuted dense tensor to another
+// (ITensor::operator+= with a different index order) for every
+// permutation of rank 3 through 6 using the permuteAdd kernel
+// and the counter loop it replaced, reproduced below.
+//
+// Usage: permuteadd_bench [nrep]
+//
+#include "permute.h"
+#include "cputime.h"
+#include <algorithm>
+
+using namespace std;
+using boost::format;
+
+typedef boost::array<int,NMAX+1>
+int9;
+
+//
+// Previous operator+= loop: a counter over the
+// source, with ind[k] the (1-based) destination
+// of index k.
+//
+struct OldCounter
+    {
+    int9 n, i;
+    int ind, rn_;
+
+    OldCounter(const int9& dims, int rn)
+        : ind(1), rn_(rn)
+        {
+        for(int k = 1; k <= NMAX; ++k) { n[k] = (k <= rn ? dims[k] : 1); i[k] = 1; }
+        i[0] = n[0] = 0;
+        }
+
+    bool
+    notDone() const { return i[1] != 0; }
+
+    OldCounter&
+    operator++()
+        {
+        ++ind;
+        ++i[1];
+        if(i[1] > n[1])
+        for(int k = 2; k <= rn_+1; ++k)
+            {
+            i[k-1] = 1;
+            ++i[k];
+            if(i[k] <= n[k]) break;
+            }
+        if(i[rn_+1] > 1 || rn_ == 0) i[1] = 0;
+        return *this;
+        }
+    };
+
+void
+oldAdd(int rn, const int9& dims, const int9& ind, Real scalefac,
+       const Vector& othrdat, Vector& thisdat)
+    {
+    OldCounter c(dims,rn);
+    int *j[NMAX+1];
+    for(int k = 1; k <= NMAX; ++k) j[ind[k]] = &(c.i[k]);
+    int n[NMAX+1];
+    for(int k = 1; k <= NMAX; ++k) n[ind[k]] = c.n[k];
+
+    for(; c.notDone(); ++c)
+        {
+        thisdat((((((((*j[8]-1)*n[7]+*j[7]-1)*n[6]
+        +*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]
+        +*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
+        += scalefac * othrdat(c.ind);
+        }
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int nrep = (argc > 1 ? atoi(argv[1]) : 3);
+    const Real scalefac = 0.5;
+
+    //About 10^6 elements for each rank
+    int9 dims3, dims4, dims5, dims6;
+    dims3[1] = 100; dims3[2] = 120; dims3[3] = 90;
+    dims4[1] = 30; dims4[2] = 34; dims4[3] = 32; dims4[4] = 30;
+    dims5[1] = 16; dims5[2] = 15; dims5[3] = 17; dims5[4] = 16; dims5[5] = 16;
+    dims6[1] = 10; dims6[2] = 9; dims6[3] = 10; dims6[4] = 11; dims6[5] = 10; dims6[6] = 10;
+    const int9* alldims[] = { &dims3, &dims4, &dims5, &dims6 };
+
+    cout << format("%4s %6s %10s %10s %10s %10s %14s\n")
+            % "rank" % "nperm" % "old GB/s" % "new GB/s"
+            % "min gain" % "total gain" % "worst perm";
+
+    for(int r = 3; r <= 6; ++r)
+        {
+        const int9& dims = *alldims[r-3];
+        int size = 1;
+        for(int k = 1; k <= r; ++k) size *= dims[k];
+
+        Vector src(size), rold(size), rnew(size);
+        src.Randomize();
+
+        std::vector<int> order(r);
+        for(int k = 0; k < r; ++k) order[k] = k+1;
+
+        int nperm = 0, nwrong = 0;
+        Real told = 0, tnew = 0,
+             mingain = 1E10;
+        std::string worst;
+        do  {
+            int9 ind;
+            for(int k = 1; k <= NMAX; ++k) ind[k] = k;
+            for(int k = 1; k <= r; ++k) ind[k] = order[k-1];
+
+            int cdims[NMAX], cdest[NMAX];
+            for(int k = 1; k <= r; ++k)
+                {
+                cdims[k-1] = dims[k];
+                cdest[k-1] = ind[k]-1;
+                }
+
+            rold = 0;
+            rnew = 0;
+
+            cpu_time cpu;
+            for(int n = 0; n < nrep; ++n)
+                oldAdd(r,dims,ind,scalefac,src,rold);
+            const Real to = cpu.sincemark().time;
+
+            cpu.mark();
+            for(int n = 0; n < nrep; ++n)
+                permuteAdd(r,cdims,cdest,scalefac,src.Store(),rnew.Store());
+            const Real tn = cpu.sincemark().time;
+
+            if(Norm(rold-rnew) > 1E-12*Norm(rold)) ++nwrong;
+
+            const Real gain = to/max(tn,1E-9);
+            if(gain < mingain)
+                {
+                mingain = gain;
+                worst.clear();
+                for(int k = 1; k <= r; ++k) worst += char('0'+ind[k]);
+                }
+            told += to;
+            tnew += tn;
+            ++nperm;
+            }
+        while(std::next_permutation(order.begin(),order.end()));
+
+        //Bytes read (both arrays) plus bytes written
+        const Real gb = 3.*sizeof(Real)*size*nrep*nperm*1E-9;
+        cout << format("%4d %6d %10.2f %10.2f %10.2f %10.2f %14s\n")
+                % r % nperm % (gb/told) % (gb/tnew)
+                % mingain % (told/max(tnew,1E-9)) % worst;
+        if(nwrong != 0)
+            {
+            cout << "Results differ for " << nwrong << " permutations" << endl;
+            return 1;
+            }
+        }
+
+    return 0;
+    }
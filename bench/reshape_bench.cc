@@ -0,0 +1,234 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Times every permutation of dense tensors of rank 3 through 6
+// using the permuteCopy kernel (used by ITensor::reshapeDat) and
+// the reshapeDat loops it replaced, which are reproduced below.
+//
+// Usage: reshape_bench [nrep]
+//
+#include "permute.h"
+#include "cputime.h"
+#include <algorithm>
+
+using namespace std;
+using boost::format;
+
+typedef boost::array<int,NMAX+1>
+int9;
+
+//
+// Previous reshapeDat: a counter over the source
+// with hand-written loops for some permutations.
+// ind[k] is the (1-based) destination of index k.
+//
+struct OldCounter
+    {
+    int9 n, i;
+    int ind, rn_;
+
+    OldCounter(const int9& dims, int rn)
+        : ind(1), rn_(rn)
+        {
+        for(int k = 1; k <= NMAX; ++k) { n[k] = (k <= rn ? dims[k] : 1); i[k] = 1; }
+        i[0] = n[0] = 0;
+        }
+
+    bool
+    notDone() const { return i[1] != 0; }
+
+    OldCounter&
+    operator++()
+        {
+        ++ind;
+        ++i[1];
+        if(i[1] > n[1])
+        for(int k = 2; k <= rn_+1; ++k)
+            {
+            i[k-1] = 1;
+            ++i[k];
+            if(i[k] <= n[k]) break;
+            }
+        if(i[rn_+1] > 1 || rn_ == 0) i[1] = 0;
+        return *this;
+        }
+    };
+
+void
+oldReshape(int rn, const int9& dims, const int9& ind,
+           const Vector& thisdat, Vector& rdat)
+    {
+    OldCounter c(dims,rn);
+    int9 n;
+    for(int j = 1; j <= NMAX; ++j) n[j] = 1;
+    for(int j = 1; j <= rn; ++j) n[ind[j]] = c.n[j];
+
+#define Loop6(q,z,w,k,y,s) {for(int i1 = 1; i1 <= n[1]; ++i1) for(int i2 = 1; i2 <= n[2]; ++i2)\
+	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4) for(int i5 = 1; i5 <= n[5]; ++i5)\
+    for(int i6 = 1; i6 <= n[6]; ++i6)\
+    rdat( (((((i6-1)*n[5]+i5-1)*n[4]+i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) =\
+    thisdat( (((((s-1)*c.n[5]+y-1)*c.n[4]+k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
+
+#define Loop5(q,z,w,k,y) {for(int i1 = 1; i1 <= n[1]; ++i1) for(int i2 = 1; i2 <= n[2]; ++i2)\
+	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4) for(int i5 = 1; i5 <= n[5]; ++i5)\
+    rdat( ((((i5-1)*n[4]+i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( ((((y-1)*c.n[4]+k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
+
+#define Loop4(q,z,w,k) {for(int i1 = 1; i1 <= n[1]; ++i1)  for(int i2 = 1; i2 <= n[2]; ++i2)\
+	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4)\
+	rdat( (((i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( (((k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
+
+#define Loop3(q,z,w) {for(int i1 = 1; i1 <= n[1]; ++i1)  for(int i2 = 1; i2 <= n[2]; ++i2)\
+	for(int i3 = 1; i3 <= n[3]; ++i3) rdat( ((i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( ((w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
+
+#define Bif3(a,b,c) if(ind[1] == a && ind[2] == b && ind[3] == c)
+#define Bif4(a,b,c,d) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4] == d)
+#define Bif5(a,b,c,d,e) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e)
+#define Bif6(a,b,c,d,e,g) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e && ind[6] == g)
+
+    if(rn == 3)
+        {
+        Bif3(2,1,3) Loop3(i2,i1,i3)
+        Bif3(2,3,1) Loop3(i2,i3,i1)
+        Bif3(3,1,2) Loop3(i3,i1,i2)
+        }
+    else if(rn == 4)
+        {
+        Bif4(1,2,4,3) Loop4(i1,i2,i4,i3)
+        Bif4(1,3,2,4) Loop4(i1,i3,i2,i4)
+        Bif4(2,3,1,4) Loop4(i2,i3,i1,i4)
+        Bif4(2,3,4,1) Loop4(i2,i3,i4,i1)
+        Bif4(1,4,2,3) Loop4(i1,i4,i2,i3)
+        Bif4(2,1,3,4) Loop4(i2,i1,i3,i4)
+        Bif4(2,1,4,3) Loop4(i2,i1,i4,i3)
+        Bif4(3,4,1,2) Loop4(i3,i4,i1,i2)
+        }
+    else if(rn == 5)
+        {
+        Bif5(3,1,4,5,2) Loop5(i3,i1,i4,i5,i2)
+        Bif5(1,4,2,5,3) Loop5(i1,i4,i2,i5,i3)
+        Bif5(1,4,2,3,5) Loop5(i1,i4,i2,i3,i5)
+        Bif5(3,1,4,2,5) Loop5(i3,i1,i4,i2,i5)
+        Bif5(2,4,1,3,5) Loop5(i2,i4,i1,i3,i5)
+        Bif5(2,4,3,5,1) Loop5(i2,i4,i3,i5,i1)
+        Bif5(3,4,1,2,5) Loop5(i3,i4,i1,i2,i5)
+        Bif5(2,1,3,4,5) Loop5(i2,i1,i3,i4,i5)
+        Bif5(2,3,4,5,1) Loop5(i2,i3,i4,i5,i1)
+        Bif5(2,3,4,1,5) Loop5(i2,i3,i4,i1,i5)
+        Bif5(2,3,1,4,5) Loop5(i2,i3,i1,i4,i5)
+        Bif5(3,4,1,5,2) Loop5(i3,i4,i1,i5,i2)
+        Bif5(5,1,4,2,3) Loop5(i5,i1,i4,i2,i3)
+        }
+    else if(rn == 6)
+        {
+        Bif6(2,4,1,3,5,6) Loop6(i2,i4,i1,i3,i5,i6)
+        Bif6(1,4,2,3,5,6) Loop6(i1,i4,i2,i3,i5,i6)
+        Bif6(2,4,1,5,3,6) Loop6(i2,i4,i1,i5,i3,i6)
+        Bif6(1,2,4,5,3,6) Loop6(i1,i2,i4,i5,i3,i6)
+        Bif6(3,4,1,5,6,2) Loop6(i3,i4,i1,i5,i6,i2)
+        }
+
+    boost::array<int*,NMAX+1> j;
+    for(int k = 1; k <= NMAX; ++k) { j[ind[k]] = &(c.i[k]); }
+
+    for(; c.notDone(); ++c)
+        {
+        rdat((((((((*j[8]-1)*n[7]+*j[7]-1)*n[6]+*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
+            = thisdat(c.ind);
+        }
+
+#undef Loop6
+#undef Loop5
+#undef Loop4
+#undef Loop3
+#undef Bif3
+#undef Bif4
+#undef Bif5
+#undef Bif6
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    const int nrep = (argc > 1 ? atoi(argv[1]) : 3);
+
+    //About 10^6 elements for each rank
+    int9 dims3, dims4, dims5, dims6;
+    dims3[1] = 100; dims3[2] = 120; dims3[3] = 90;
+    dims4[1] = 30; dims4[2] = 34; dims4[3] = 32; dims4[4] = 30;
+    dims5[1] = 16; dims5[2] = 15; dims5[3] = 17; dims5[4] = 16; dims5[5] = 16;
+    dims6[1] = 10; dims6[2] = 9; dims6[3] = 10; dims6[4] = 11; dims6[5] = 10; dims6[6] = 10;
+    const int9* alldims[] = { &dims3, &dims4, &dims5, &dims6 };
+
+    cout << format("%4s %6s %10s %10s %10s %10s %14s\n")
+            % "rank" % "nperm" % "old GB/s" % "new GB/s"
+            % "min gain" % "mean gain" % "worst perm";
+
+    for(int r = 3; r <= 6; ++r)
+        {
+        const int9& dims = *alldims[r-3];
+        int size = 1;
+        for(int k = 1; k <= r; ++k) size *= dims[k];
+
+        Vector src(size), rold(size), rnew(size);
+        src.Randomize();
+
+        std::vector<int> order(r);
+        for(int k = 0; k < r; ++k) order[k] = k+1;
+
+        int nperm = 0, nwrong = 0;
+        Real told = 0, tnew = 0,
+             mingain = 1E10, sumgain = 0;
+        std::string worst;
+        do  {
+            int9 ind;
+            for(int k = 1; k <= NMAX; ++k) ind[k] = k;
+            for(int k = 1; k <= r; ++k) ind[k] = order[k-1];
+
+            int cdims[NMAX], cdest[NMAX];
+            for(int k = 1; k <= r; ++k)
+                {
+                cdims[k-1] = dims[k];
+                cdest[k-1] = ind[k]-1;
+                }
+
+            cpu_time cpu;
+            for(int n = 0; n < nrep; ++n)
+                oldReshape(r,dims,ind,src,rold);
+            const Real to = cpu.sincemark().time;
+
+            cpu.mark();
+            for(int n = 0; n < nrep; ++n)
+                permuteCopy(r,cdims,cdest,src.Store(),rnew.Store());
+            const Real tn = cpu.sincemark().time;
+
+            if(Norm(rold-rnew) != 0) ++nwrong;
+
+            const Real gain = to/max(tn,1E-9);
+            if(gain < mingain)
+                {
+                mingain = gain;
+                worst.clear();
+                for(int k = 1; k <= r; ++k) worst += char('0'+ind[k]);
+                }
+            sumgain += gain;
+            told += to;
+            tnew += tn;
+            ++nperm;
+            }
+        while(std::next_permutation(order.begin(),order.end()));
+
+        //Bytes read plus bytes written
+        const Real gb = 2.*sizeof(Real)*size*nrep*nperm*1E-9;
+        cout << format("%4d %6d %10.2f %10.2f %10.2f %10.2f %14s\n")
+                % r % nperm % (gb/told) % (gb/tnew)
+                % mingain % (sumgain/nperm) % worst;
+        if(nwrong != 0)
+            {
+            cout << "Results differ for " << nwrong << " permutations" << endl;
+            return 1;
+            }
+        }
+
+    return 0;
+    }
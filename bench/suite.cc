@@ -0,0 +1,490 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+// Standing benchmark suite (run by "make bench").
+//
+// Times ITensor products for each rank and permutation class,
+// IQTensor products of the tensors of a DMRG step, SVDWorker::svd
+// and denmatDecomp (diag_denmat), Eigensolver::davidson, and full
+// dmrg() runs on the Heisenberg, Hubbard and J1J2 Hamiltonians.
+// Each case is run nrep times after one untimed warm up; the best
+// and median wall times are written to a JSON file. Cases faster
+// than minTime are repeated within each timing and the time of one
+// call is reported.
+//
+// Usage: bench_suite [-o out.json] [-r nrep] [-f filter]
+//        bench_suite --compare base.json new.json [-t threshold]
+//
+// -f runs only the cases whose name contains filter.
+// --compare lists the cases whose best time in new.json is more
+// than (1+threshold) times that in base.json (default threshold
+// 0.1) and exits with status 1 if there are any.
+//
+#include "core.h"
+#include "model/spinhalf.h"
+#include "model/spinone.h"
+#include "model/hubbard.h"
+#include "hams/heisenberg.h"
+#include "hams/ExtendedHubbard.h"
+#include "hams/J1J2Chain.h"
+#include <sys/time.h>
+#include <sys/utsname.h>
+#include <algorithm>
+
+using namespace std;
+using boost::format;
+
+Real ran1(int newseed);
+
+//Shortest time measured for one sample
+static const Real
+minTime = 0.05;
+
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+struct Result
+    {
+    string name;
+    int nrep,
+        ninner; //calls per timed sample
+    Real best,
+         median,
+         check; //A number computed by the case, e.g. an energy
+    Result() : nrep(0), ninner(1), best(0), median(0), check(0) { }
+    };
+
+class Suite
+    {
+    public:
+
+    Suite(int nrep, const string& filter)
+        : nrep_(nrep), filter_(filter) { }
+
+    //Runs f(), which returns its check value, unless
+    //the name doesn't match the filter
+    template <class Case>
+    void
+    run(const string& name, const Case& f);
+
+    bool
+    wants(const string& name) const
+        { return name.find(filter_) != string::npos; }
+
+    const vector<Result>&
+    results() const { return results_; }
+
+    void
+    writeJSON(ostream& s) const;
+
+    private:
+
+    int nrep_;
+    string filter_;
+    vector<Result> results_;
+    };
+
+//Swallows what the cases print (e.g. dmrg's sweep summaries)
+class QuietCout
+    {
+    public:
+    QuietCout() : old_(cout.rdbuf(null_.rdbuf())) { }
+    ~QuietCout() { cout.rdbuf(old_); }
+    private:
+    ostringstream null_;
+    streambuf* old_;
+    };
+
+template <class Case>
+void Suite::
+run(const string& name, const Case& f)
+    {
+    if(!wants(name)) return;
+    Result r;
+    r.name = name;
+    r.nrep = nrep_;
+    vector<Real> t(nrep_);
+        {
+        QuietCout q;
+        const Real t0 = wallTime();
+        r.check = f();
+        const Real tw = wallTime()-t0;
+        if(tw < minTime) r.ninner = int(minTime/max(tw,1E-6))+1;
+        for(int n = 0; n < nrep_; ++n)
+            {
+            const Real t0 = wallTime();
+            for(int i = 0; i < r.ninner; ++i) r.check = f();
+            t[n] = (wallTime()-t0)/r.ninner;
+            }
+        }
+    sort(t.begin(),t.end());
+    r.best = t.front();
+    r.median = t[nrep_/2];
+    results_.push_back(r);
+    cout << format("%-34s %10.4f %10.4f %16.10g\n") % name % r.best % r.median % r.check;
+    }
+
+void Suite::
+writeJSON(ostream& s) const
+    {
+    utsname u;
+    uname(&u);
+    s << "{\n";
+    s << "  \"suite\": \"itensor\",\n";
+    s << "  \"version\": 1,\n";
+    s << format("  \"host\": \"%s %s %s\",\n") % u.nodename % u.sysname % u.machine;
+    s << format("  \"time\": %d,\n") % time(0);
+    s << "  \"results\": [\n";
+    for(size_t j = 0; j < results_.size(); ++j)
+        {
+        const Result& r = results_[j];
+        s << format("    {\"name\": \"%s\", \"nrep\": %d, \"ninner\": %d, \"best\": %.6e, \"median\": %.6e, \"check\": %.12e}%s\n")
+             % r.name % r.nrep % r.ninner % r.best % r.median % r.check % (j+1 < results_.size() ? "," : "");
+        }
+    s << "  ]\n";
+    s << "}\n";
+    }
+
+//
+// Reads back the results written by writeJSON
+// (one result object per line)
+//
+bool
+jsonField(const string& line, const string& key, string& val)
+    {
+    const string k = "\"" + key + "\":";
+    size_t p = line.find(k);
+    if(p == string::npos) return false;
+    p = line.find_first_not_of(" ",p+k.size());
+    if(p == string::npos) return false;
+    if(line[p] == '"')
+        {
+        const size_t e = line.find('"',p+1);
+        if(e == string::npos) return false;
+        val = line.substr(p+1,e-p-1);
+        }
+    else
+        {
+        const size_t e = line.find_first_of(",}",p);
+        val = line.substr(p,e-p);
+        }
+    return true;
+    }
+
+vector<Result>
+readJSON(const string& fname)
+    {
+    ifstream s(fname.c_str());
+    if(!s) Error("Could not open benchmark results " + fname);
+    vector<Result> res;
+    string line;
+    while(getline(s,line))
+        {
+        Result r;
+        string val;
+        if(!jsonField(line,"name",r.name)) continue;
+        if(jsonField(line,"nrep",val)) r.nrep = atoi(val.c_str());
+        if(jsonField(line,"ninner",val)) r.ninner = atoi(val.c_str());
+        if(jsonField(line,"best",val)) r.best = atof(val.c_str());
+        if(jsonField(line,"median",val)) r.median = atof(val.c_str());
+        if(jsonField(line,"check",val)) r.check = atof(val.c_str());
+        res.push_back(r);
+        }
+    return res;
+    }
+
+int
+compare(const string& basefile, const string& newfile, Real threshold)
+    {
+    const vector<Result> base = readJSON(basefile),
+                         curr = readJSON(newfile);
+    map<string,Result> bmap;
+    Foreach(const Result& r, base) bmap[r.name] = r;
+
+    cout << format("%-34s %10s %10s %8s\n") % "case" % "base s" % "new s" % "ratio";
+    int nworse = 0;
+    Foreach(const Result& r, curr)
+        {
+        map<string,Result>::const_iterator b = bmap.find(r.name);
+        if(b == bmap.end())
+            {
+            cout << format("%-34s %10s %10.4f %8s\n") % r.name % "-" % r.best % "new";
+            continue;
+            }
+        const Real ratio = r.best/max(b->second.best,1E-9);
+        const bool worse = ratio > 1+threshold;
+        if(worse) ++nworse;
+        const Real dcheck = fabs(r.check-b->second.check);
+        cout << format("%-34s %10.4f %10.4f %8.2f%s%s\n")
+                % r.name % b->second.best % r.best % ratio
+                % (worse ? "  REGRESSION" : "")
+                % (dcheck > 1E-8*max(1.,fabs(r.check)) ? "  (check differs)" : "");
+        bmap.erase(r.name);
+        }
+    for(map<string,Result>::const_iterator b = bmap.begin(); b != bmap.end(); ++b)
+        cout << format("%-34s %10.4f %10s %8s\n") % b->first % b->second.best % "-" % "missing";
+
+    cout << format("\n%d regression%s beyond %.0f%%\n") % nworse % (nworse == 1 ? "" : "s") % (100*threshold);
+    return (nworse == 0 ? 0 : 1);
+    }
+
+//
+// Cases
+//
+
+struct ProductCase
+    {
+    ITensor A, B;
+    ProductCase(const ITensor& A_, const ITensor& B_) : A(A_), B(B_) { }
+    Real operator()() const { return (A*B).norm(); }
+    };
+
+struct IQProductCase
+    {
+    IQTensor A, B;
+    IQProductCase(const IQTensor& A_, const IQTensor& B_) : A(A_), B(B_) { }
+    Real operator()() const { return (A*B).norm(); }
+    };
+
+struct SVDCase
+    {
+    IQTensor A, B; //Site tensors whose indices split phi
+    IQTensor phi;
+    int maxm;
+    SVDCase(const IQTensor& A_, const IQTensor& B_, int maxm_)
+        : A(A_), B(B_), phi(A_*B_), maxm(maxm_) { }
+    Real operator()() const
+        {
+        SVDWorker svd(2);
+        svd.maxm(maxm);
+        svd.cutoff(1E-12);
+        IQTensor U(A), V(B);
+        IQTSparse D;
+        svd.svd(1,phi,U,D,V);
+        return svd.truncerr(1);
+        }
+    };
+
+struct DenmatCase
+    {
+    IQTensor A, B; //Site tensors whose indices split phi
+    IQTensor phi;
+    int maxm;
+    DenmatCase(const IQTensor& A_, const IQTensor& B_, int maxm_)
+        : A(A_), B(B_), phi(A_*B_), maxm(maxm_) { }
+    Real operator()() const
+        {
+        SVDWorker svd(2);
+        svd.maxm(maxm);
+        svd.cutoff(1E-12);
+        IQTensor U(A), V(B);
+        svd.denmatDecomp(1,phi,U,V,Fromleft);
+        return svd.truncerr(1);
+        }
+    };
+
+struct DavidsonCase
+    {
+    const LocalMPO<IQTensor>& PH;
+    IQTensor phi;
+    DavidsonCase(const LocalMPO<IQTensor>& PH_, const IQTensor& phi_) : PH(PH_), phi(phi_) { }
+    Real operator()() const
+        {
+        Eigensolver solver(2,1E-4);
+        IQTensor x(phi);
+        return solver.davidson(PH,x);
+        }
+    };
+
+struct DMRGCase
+    {
+    IQMPS psi0;
+    IQMPO H;
+    Sweeps sweeps;
+    DMRGCase(const IQMPS& psi0_, const IQMPO& H_, const Sweeps& sweeps_)
+        : psi0(psi0_), H(H_), sweeps(sweeps_) { }
+    Real operator()() const
+        {
+        IQMPS psi(psi0);
+        return dmrg(psi,H,sweeps,Quiet());
+        }
+    };
+
+//Uses ran1 rather than Randomize (seeded from
+//an address) so every run sees the same elements
+ITensor
+randomTensor(const Index& i1, const Index& i2, const Index& i3 = Index::Null(),
+             const Index& i4 = Index::Null())
+    {
+    vector<Index> inds;
+    inds.push_back(i1);
+    inds.push_back(i2);
+    if(i3.isNotNull()) inds.push_back(i3);
+    if(i4.isNotNull()) inds.push_back(i4);
+    int size = 1;
+    Foreach(const Index& I, inds) size *= I.m();
+    Vector V(size);
+    for(int j = 1; j <= size; ++j) V(j) = ran1();
+    return ITensor(inds,V);
+    }
+
+void
+itensorProducts(Suite& S)
+    {
+    //Rank 2: a plain matrix product
+    Index i("i",800), j("j",800), k("k",800);
+    S.run("itensor/rank2/matrix",ProductCase(randomTensor(i,k),randomTensor(k,j)));
+    //The result's indices transposed relative to the matrix product
+    S.run("itensor/rank2/transposed",ProductCase(randomTensor(k,i),randomTensor(j,k)));
+
+    //Rank 3: MPS-like tensors sharing one bond
+    Index a("a",300), b("b",300), c("c",300), s("s",4), t("t",4);
+    S.run("itensor/rank3/bond",ProductCase(randomTensor(a,s,b),randomTensor(b,t,c)));
+    //Contracted index in the middle of both
+    S.run("itensor/rank3/middle",ProductCase(randomTensor(a,b,s),randomTensor(t,b,c)));
+
+    //Rank 4: two indices contracted
+    Index p("p",40), q("q",40), r("r",40), u("u",40), v("v",40), w("w",40);
+    S.run("itensor/rank4/adjacent",ProductCase(randomTensor(p,q,r,u),randomTensor(r,u,v,w)));
+    //Contracted indices interleaved with the others
+    S.run("itensor/rank4/interleaved",ProductCase(randomTensor(p,r,q,u),randomTensor(v,r,w,u)));
+    //Rank 4 times rank 2 (an environment times a site tensor)
+    Index x("x",100);
+    S.run("itensor/rank4/rank2",ProductCase(randomTensor(p,q,r,u),randomTensor(q,x)));
+    }
+
+void
+dmrgStep(Suite& S)
+    {
+    if(!(S.wants("iqtensor") || S.wants("svd") || S.wants("davidson"))) return;
+
+    //A converged SpinOne chain; the tensors of the middle bond
+    const int N = 20, b = N/2, maxm = 200;
+    SpinOne model(N);
+    IQMPO H = Heisenberg(model);
+    InitState initState(N);
+    for(int i = 1; i <= N; ++i)
+        initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+    IQMPS psi(model,initState);
+    Sweeps sweeps(4);
+    sweeps.maxm() = maxm/4,maxm/2,maxm;
+    sweeps.cutoff() = 1E-10;
+        {
+        QuietCout q;
+        dmrg(psi,H,sweeps,Quiet());
+        }
+
+    psi.position(b);
+    LocalMPO<IQTensor> PH(H);
+    PH.position(b,psi);
+
+    const IQTensor phi = psi.AA(b)*psi.AA(b+1);
+    S.run("iqtensor/site*site",IQProductCase(psi.AA(b),psi.AA(b+1)));
+    S.run("iqtensor/L*phi",IQProductCase(PH.L(),phi));
+    IQTensor Lphi = PH.L()*phi;
+    S.run("iqtensor/Lphi*W",IQProductCase(Lphi,H.AA(b)));
+    IQTensor LphiWW = Lphi*H.AA(b)*H.AA(b+1);
+    S.run("iqtensor/LphiWW*R",IQProductCase(LphiWW,PH.R()));
+
+    S.run("svd/svd",SVDCase(psi.AA(b),psi.AA(b+1),maxm));
+    S.run("svd/denmat",DenmatCase(psi.AA(b),psi.AA(b+1),maxm));
+    S.run("davidson/bond",DavidsonCase(PH,phi));
+    }
+
+void
+dmrgRuns(Suite& S)
+    {
+    Sweeps sweeps(5);
+    sweeps.maxm() = 10,20,40,80,100;
+    sweeps.cutoff() = 1E-10;
+
+    if(S.wants("dmrg/heisenberg"))
+        {
+        const int N = 40;
+        SpinHalf model(N);
+        InitState initState(N);
+        for(int i = 1; i <= N; ++i)
+            initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+        S.run("dmrg/heisenberg",DMRGCase(IQMPS(model,initState),Heisenberg(model),sweeps));
+        }
+
+    if(S.wants("dmrg/hubbard"))
+        {
+        //Four states per site: fewer sites and states kept
+        Sweeps hsweeps(4);
+        hsweeps.maxm() = 10,20,40;
+        hsweeps.cutoff() = 1E-10;
+        const int N = 10;
+        Hubbard model(N);
+        InitState initState(N);
+        for(int i = 1; i <= N; ++i)
+            initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+        S.run("dmrg/hubbard",DMRGCase(IQMPS(model,initState),ExtendedHubbard(model,1,4,0),hsweeps));
+        }
+
+    if(S.wants("dmrg/j1j2"))
+        {
+        const int N = 40;
+        SpinHalf model(N);
+        InitState initState(N);
+        for(int i = 1; i <= N; ++i)
+            initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+        S.run("dmrg/j1j2",DMRGCase(IQMPS(model,initState),J1J2Chain(model,0.5),sweeps));
+        }
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    string out = "bench_results.json",
+           filter;
+    int nrep = 3;
+    Real threshold = 0.1;
+    vector<string> cmp;
+    for(int n = 1; n < argc; ++n)
+        {
+        const string a = argv[n];
+        if(a == "-o" && n+1 < argc) out = argv[++n];
+        else if(a == "-r" && n+1 < argc) nrep = atoi(argv[++n]);
+        else if(a == "-f" && n+1 < argc) filter = argv[++n];
+        else if(a == "-t" && n+1 < argc) threshold = atof(argv[++n]);
+        else if(a == "--compare" && n+2 < argc)
+            {
+            cmp.push_back(argv[++n]);
+            cmp.push_back(argv[++n]);
+            }
+        else
+            {
+            cerr << "Usage: " << argv[0] << " [-o out.json] [-r nrep] [-f filter]\n"
+                 << "       " << argv[0] << " --compare base.json new.json [-t threshold]\n";
+            return 2;
+            }
+        }
+
+    if(!cmp.empty())
+        {
+        try { return compare(cmp[0],cmp[1],threshold); }
+        catch(const ITError& e) { return 2; }
+        }
+
+    if(nrep < 1) nrep = 1;
+    //Same random tensors on every run
+    ran1(1237);
+
+    cout << format("%-34s %10s %10s %16s\n") % "case" % "best s" % "median s" % "check";
+    Suite S(nrep,filter);
+    itensorProducts(S);
+    dmrgStep(S);
+    dmrgRuns(S);
+
+    ofstream f(out.c_str());
+    S.writeJSON(f);
+    cout << "\nWrote " << out << endl;
+    return 0;
+    }
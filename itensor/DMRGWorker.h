@@ -10,6 +10,7 @@
 #include "localmposet.h"
 #include "localmpo_mps.h"
 #include "eigensolver.h"
+#include "costmodel.h"
 
 //
 // DMRGWorker
@@ -55,6 +56,9 @@ class DMRGWorker : public BaseDMRGWorker<MPSType>
 
     Real energy_;
     bool quiet_;
+    bool verbose_;
+    bool use_arena_;
+    bool dry_run_;
     Real weight_;
 
     //
@@ -171,6 +175,9 @@ DMRGWorker(const Sweeps& sweeps,
     Parent(sweeps), 
     energy_(0),
     quiet_(false),
+    verbose_(false),
+    use_arena_(true),
+    dry_run_(false),
     weight_(1)
     { 
     parseOptions(opt1,opt2);
@@ -184,6 +191,9 @@ DMRGWorker(const Sweeps& sweeps, Observer& obs,
     Parent(sweeps, obs), 
     energy_(0),
     quiet_(false),
+    verbose_(false),
+    use_arena_(true),
+    dry_run_(false),
     weight_(1)
     { 
     parseOptions(opt1,opt2);
@@ -195,6 +205,9 @@ parseOptions(const Option& opt1, const Option& opt2)
     {
     OptionSet oset(opt1,opt2);
     quiet_ = oset.boolOrDefault("Quiet",false);
+    verbose_ = oset.boolOrDefault("Verbose",false);
+    use_arena_ = oset.boolOrDefault("UseArena",true);
+    dry_run_ = oset.boolOrDefault("DryRun",false);
     weight_ = oset.realOrDefault("Weight",1);
     }
 
@@ -206,6 +219,13 @@ runInternal(const MPOType& H, MPSType& psi)
     typedef typename MPOType::TensorT 
     MPOTensor;
 
+    if(dry_run_)
+        {
+        //Only estimate the time and memory of the run
+        std::cout << DMRGCost(psi,H,sweeps()) << std::endl;
+        return 0;
+        }
+
     const Real orig_cutoff = psi.cutoff(),
                orig_noise  = psi.noise();
     const int orig_minm = psi.minm(), 
@@ -216,6 +236,8 @@ runInternal(const MPOType& H, MPSType& psi)
     energy_ = 0;
 
     psi.position(1);
+
+    StorePool::resetStats();
     
     LocalMPO<MPOTensor> PH(H);
 
@@ -223,6 +245,9 @@ runInternal(const MPOType& H, MPSType& psi)
     solver.debugLevel(debuglevel);
 
     const Option doNorm = DoNormalize(true);
+
+    //Time spent waiting for the disk, if writing to disk
+    Real last_stall = 0;
     
     for(int sw = 1; sw <= sweeps().nsweep(); ++sw)
         {
@@ -247,6 +272,9 @@ runInternal(const MPOType& H, MPSType& psi)
 
         for(int b = 1, ha = 1; ha != 3; sweepnext(b,ha,N))
             {
+            //Storage freed during this bond update is kept for reuse
+            StorePool::Arena arena(use_arena_);
+
             if(!quiet_)
                 {
                 std::cout << 
@@ -273,6 +301,16 @@ runInternal(const MPOType& H, MPSType& psi)
             observer().measure(sw,ha,b,psi.svd(),energy_);
 
             } //for loop over b
+
+        if(verbose_)
+            std::cout << "    Storage: " << StorePool::stats() << std::endl;
+
+        if(!quiet_ && PH.doWrite())
+            {
+            const Real stall = psi.ioStallTime() + PH.ioStallTime();
+            std::cout << boost::format("    I/O stall: %.2f s") % (stall-last_stall) << std::endl;
+            last_stall = stall;
+            }
         
         if(observer().checkDone(sw,psi.svd(),energy_)) break;
     
@@ -290,6 +328,9 @@ template <class MPSType> inline
 Real DMRGWorker<MPSType>::
 runInternal(const std::vector<MPOType>& H, MPSType& psi)
     {
+    if(dry_run_) 
+        Error("DryRun is only supported for DMRG with a single MPO");
+
     typedef typename MPOType::TensorT 
     MPOTensor;
 
@@ -303,6 +344,8 @@ runInternal(const std::vector<MPOType>& H, MPSType& psi)
     energy_ = 0;
 
     psi.position(1);
+
+    StorePool::resetStats();
     
     LocalMPOSet<MPOTensor> PH(H);
 
@@ -321,6 +364,9 @@ runInternal(const std::vector<MPOType>& H, MPSType& psi)
 
         for(int b = 1, ha = 1; ha != 3; sweepnext(b,ha,N))
             {
+            //Storage freed during this bond update is kept for reuse
+            StorePool::Arena arena(use_arena_);
+
             if(!quiet_)
                 {
                 std::cout << 
@@ -347,6 +393,9 @@ runInternal(const std::vector<MPOType>& H, MPSType& psi)
             observer().measure(sw,ha,b,psi.svd(),energy_);
 
             } //for loop over b
+
+        if(verbose_)
+            std::cout << "    Storage: " << StorePool::stats() << std::endl;
         
         if(observer().checkDone(sw,psi.svd(),energy_)) break;
     
@@ -364,6 +413,9 @@ template <class MPSType> inline
 Real DMRGWorker<MPSType>::
 runInternal(const MPOType& H, const std::vector<MPSType> psis, MPSType& psi)
     {
+    if(dry_run_) 
+        Error("DryRun is only supported for DMRG with a single MPO");
+
     typedef typename MPOType::TensorT 
     MPOTensor;
 
@@ -377,6 +429,8 @@ runInternal(const MPOType& H, const std::vector<MPSType> psis, MPSType& psi)
     energy_ = 0;
 
     psi.position(1);
+
+    StorePool::resetStats();
     
     LocalMPO_MPS<MPOTensor> PH(H,psis);
     PH.weight(this->weight_);
@@ -385,6 +439,9 @@ runInternal(const MPOType& H, const std::vector<MPSType> psis, MPSType& psi)
     solver.debugLevel(debuglevel);
 
     const Option doNorm = DoNormalize(true);
+
+    //Time spent waiting for the disk, if writing to disk
+    Real last_stall = 0;
     
     for(int sw = 1; sw <= sweeps().nsweep(); ++sw)
         {
@@ -409,6 +466,9 @@ runInternal(const MPOType& H, const std::vector<MPSType> psis, MPSType& psi)
 
         for(int b = 1, ha = 1; ha != 3; sweepnext(b,ha,N))
             {
+            //Storage freed during this bond update is kept for reuse
+            StorePool::Arena arena(use_arena_);
+
             if(!quiet_)
                 {
                 std::cout << 
@@ -435,6 +495,16 @@ runInternal(const MPOType& H, const std::vector<MPSType> psis, MPSType& psi)
             observer().measure(sw,ha,b,psi.svd(),energy_);
 
             } //for loop over b
+
+        if(verbose_)
+            std::cout << "    Storage: " << StorePool::stats() << std::endl;
+
+        if(!quiet_ && PH.doWrite())
+            {
+            const Real stall = psi.ioStallTime() + PH.ioStallTime();
+            std::cout << boost::format("    I/O stall: %.2f s") % (stall-last_stall) << std::endl;
+            last_stall = stall;
+            }
         
         if(observer().checkDone(sw,psi.svd(),energy_)) break;
     
@@ -4,7 +4,13 @@
 //
 #ifndef __ITENSOR_ALLOCATOR_H
 #define __ITENSOR_ALLOCATOR_H
+#include "boost/thread/mutex.hpp"
 
+//
+// Free list of fixed-size blocks.
+// Shared by all threads, so alloc and
+// dealloc are guarded by a mutex.
+//
 template <class T>
 class DatAllocator
     {
@@ -20,6 +26,7 @@ class DatAllocator
 
     void* pf_[stackSize];
     size_t nf_;
+    boost::mutex mutex_;
 
 
     DatAllocator() 
@@ -39,7 +46,10 @@ class DatAllocator
     void* 
     alloc()
         {
-        if(nf_ != 0) { return pf_[--nf_]; }
+            {
+            boost::mutex::scoped_lock lock(mutex_);
+            if(nf_ != 0) { return pf_[--nf_]; }
+            }
         void* p = malloc(allocSize);
         if(p == 0) throw std::bad_alloc();
         return p;
@@ -48,6 +58,7 @@ class DatAllocator
     void 
     dealloc(void* p) throw()
         {
+        boost::mutex::scoped_lock lock(mutex_);
         if(nf_ == stackSize) free(p);
         else pf_[nf_++] = p;
 
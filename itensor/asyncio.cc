@@ -0,0 +1,331 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "asyncio.h"
+#include "profiler.h"
+#include "boost/bind.hpp"
+#include <sys/time.h>
+
+using namespace std;
+
+namespace {
+
+//Wall clock time in seconds
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+}
+
+AsyncIO::
+AsyncIO(int window)
+    :
+    window_(max(window,1)),
+    thread_(0),
+    quit_(false),
+    stall_(0)
+    { }
+
+AsyncIO::
+~AsyncIO()
+    {
+    try {
+        flush();
+        }
+    catch(const ITError& e)
+        {
+        cerr << "AsyncIO: " << e.what() << endl;
+        }
+    if(thread_ == 0) return;
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        quit_ = true;
+        }
+    work_.notify_all();
+    thread_->join();
+    delete thread_;
+    }
+
+void AsyncIO::
+window(int val)
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    window_ = max(val,1);
+    trim();
+    }
+
+Real AsyncIO::
+stallTime() const
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    return stall_;
+    }
+
+void AsyncIO::
+putData(const string& fname, const Data& data)
+    {
+    startThread();
+    boost::mutex::scoped_lock lock(mutex_);
+    checkError();
+
+    entry_it it = entries_.find(fname);
+    if(it != entries_.end() && it->second.state == Entry::Write)
+        {
+        //Not started yet, just replace the data
+        it->second.data = data;
+        return;
+        }
+
+    if(numPendingWrites() >= window_)
+        {
+        const Real t0 = wallTime();
+        while(numPendingWrites() >= window_) done_.wait(lock);
+        stall_ += wallTime()-t0;
+        checkError();
+        }
+
+    //A read in progress will see the new state and discard
+    //its result; a write in progress is followed by this one
+    Entry& e = entries_[fname];
+    e.state = Entry::Write;
+    e.data = data;
+    e.prefetched = false;
+    queue_.push_back(fname);
+    trim();
+    work_.notify_one();
+    }
+
+AsyncIO::Data AsyncIO::
+getData(const string& fname)
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    checkError();
+
+    const Real t0 = wallTime();
+    entry_it it = entries_.find(fname);
+    while(it != entries_.end() && it->second.state == Entry::Reading)
+        {
+        done_.wait(lock);
+        it = entries_.find(fname);
+        }
+
+    if(it == entries_.end() || it->second.state == Entry::Read)
+        {
+        //Not in memory: read it here
+        //(a queued read is skipped once its entry is gone)
+        if(it != entries_.end()) entries_.erase(it);
+        lock.unlock();
+        string* d = new string;
+        Data res(d);
+        string msg;
+        const bool ok = readFile(fname,*d,msg);
+        lock.lock();
+        stall_ += wallTime()-t0;
+        if(!ok) Error(msg);
+        return res;
+        }
+
+    stall_ += wallTime()-t0;
+
+    Entry& e = it->second;
+    if(e.state == Entry::Failed)
+        {
+        const string msg = e.error;
+        entries_.erase(it);
+        Error(msg);
+        }
+
+    Data res = e.data;
+    //The caller now holds the object; pending
+    //writes still have to go to disk though
+    if(e.state == Entry::Cached) entries_.erase(it);
+    return res;
+    }
+
+void AsyncIO::
+prefetch(const string& fname)
+    {
+    startThread();
+    boost::mutex::scoped_lock lock(mutex_);
+    if(entries_.count(fname) != 0) return;
+    trim();
+    if(int(entries_.size()) >= window_) return;
+
+    Entry& e = entries_[fname];
+    e.state = Entry::Read;
+    e.prefetched = true;
+    queue_.push_back(fname);
+    work_.notify_one();
+    }
+
+void AsyncIO::
+flush()
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    if(numPendingWrites() > 0)
+        {
+        const Real t0 = wallTime();
+        while(numPendingWrites() > 0) done_.wait(lock);
+        stall_ += wallTime()-t0;
+        }
+    checkError();
+    }
+
+void AsyncIO::
+startThread()
+    {
+    if(thread_ == 0)
+        thread_ = new boost::thread(boost::bind(&AsyncIO::workLoop,this));
+    }
+
+void AsyncIO::
+workLoop()
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    while(true)
+        {
+        while(queue_.empty() && !quit_) work_.wait(lock);
+        if(queue_.empty()) return;
+
+        const string fname = queue_.front();
+        queue_.pop_front();
+
+        entry_it it = entries_.find(fname);
+        if(it == entries_.end()) continue;
+
+        if(it->second.state == Entry::Write)
+            {
+            it->second.state = Entry::Writing;
+            const Data d = it->second.data;
+            lock.unlock();
+            string msg;
+            const bool ok = writeFile(fname,*d,msg);
+            lock.lock();
+            if(!ok && error_.empty()) error_ = msg;
+
+            it = entries_.find(fname);
+            if(it != entries_.end() && it->second.state == Entry::Writing)
+                {
+                it->second.state = Entry::Cached;
+                trim();
+                }
+            }
+        else
+        if(it->second.state == Entry::Read)
+            {
+            it->second.state = Entry::Reading;
+            lock.unlock();
+            string* d = new string;
+            Data res(d);
+            string msg;
+            const bool ok = readFile(fname,*d,msg);
+            lock.lock();
+
+            it = entries_.find(fname);
+            if(it != entries_.end() && it->second.state == Entry::Reading)
+                {
+                if(ok)
+                    {
+                    it->second.state = Entry::Cached;
+                    it->second.data = res;
+                    }
+                else
+                    {
+                    it->second.state = Entry::Failed;
+                    it->second.error = msg;
+                    }
+                }
+            }
+
+        done_.notify_all();
+        }
+    }
+
+//Drop cached files until the window is respected,
+//those that were just written before those read ahead
+void AsyncIO::
+trim()
+    {
+    int size = 0;
+    for(entry_it it = entries_.begin(); it != entries_.end(); ++it)
+        if(it->second.state != Entry::Failed) ++size;
+
+    for(int pass = 1; pass <= 2 && size > window_; ++pass)
+        {
+        const bool prefetched = (pass == 2);
+        entry_it it = entries_.begin();
+        while(it != entries_.end() && size > window_)
+            {
+            const Entry& e = it->second;
+            if(e.state == Entry::Cached && e.prefetched == prefetched)
+                {
+                entries_.erase(it++);
+                --size;
+                }
+            else
+                ++it;
+            }
+        }
+    }
+
+int AsyncIO::
+numPendingWrites() const
+    {
+    int n = 0;
+    for(map<string,Entry>::const_iterator it = entries_.begin();
+        it != entries_.end(); ++it)
+        {
+        if(it->second.state == Entry::Write || it->second.state == Entry::Writing) ++n;
+        }
+    return n;
+    }
+
+void AsyncIO::
+checkError()
+    {
+    if(error_.empty()) return;
+    const string msg = error_;
+    error_.clear();
+    Error(msg);
+    }
+
+bool AsyncIO::
+readFile(const string& fname, string& data, string& msg)
+    {
+    ProfileScope ps("AsyncIO::readFile",Profiler::DiskIO);
+    ifstream s(fname.c_str(),ios::binary);
+    if(!s.good())
+        {
+        msg = "Couldn't open file \"" + fname + "\" for reading";
+        return false;
+        }
+    ostringstream os;
+    os << s.rdbuf();
+    data = os.str();
+    ps.addBytes(data.size());
+    return true;
+    }
+
+bool AsyncIO::
+writeFile(const string& fname, const string& data, string& msg)
+    {
+    ProfileScope ps("AsyncIO::writeFile",Profiler::DiskIO,0,data.size());
+    ofstream s(fname.c_str(),ios::binary);
+    if(!s.good())
+        {
+        msg = "Couldn't open file \"" + fname + "\" for writing";
+        return false;
+        }
+    s.write(data.data(),data.size());
+    if(!s.good())
+        {
+        msg = "Error writing file \"" + fname + "\"";
+        return false;
+        }
+    return true;
+    }
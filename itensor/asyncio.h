@@ -0,0 +1,169 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_ASYNCIO_H
+#define __ITENSOR_ASYNCIO_H
+#include "global.h"
+#include <map>
+#include <deque>
+#include <sstream>
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+//
+// AsyncIO writes objects to files and reads them
+// back using a background thread, so that a sweep
+// can keep computing while the tensors it has left
+// are written out and the ones it will need next
+// are read in (see prefetch).
+//
+// Objects are converted to and from bytes by the
+// calling thread (using their write and read methods);
+// the background thread only does the file I/O,
+// so it never touches a tensor.
+//
+// At most window() files are held in memory: those
+// waiting to be written, read ahead, or kept after
+// being written in case they are asked for again.
+// put waits if the window is full of pending writes.
+// The time the calling thread spends waiting for
+// the disk (in put, get or flush, including reads
+// which were not prefetched) is given by stallTime().
+//
+
+class AsyncIO
+    {
+    public:
+
+    explicit
+    AsyncIO(int window = 4);
+
+    //Finishes all writes first
+    ~AsyncIO();
+
+    //Write t to file fname in the background
+    template <class T>
+    void
+    put(const std::string& fname, const T& t);
+
+    //Read t from fname, or from memory if fname
+    //is pending or was read ahead.
+    //Waits for the read if it is in progress.
+    template <class T>
+    void
+    get(const std::string& fname, T& t);
+
+    //Start reading fname in the background, unless
+    //it is already in memory or the window is full
+    void
+    prefetch(const std::string& fname);
+
+    //Wait for all pending writes
+    void
+    flush();
+
+    int
+    window() const { return window_; }
+    void
+    window(int val);
+
+    //Seconds spent waiting for the disk
+    Real
+    stallTime() const;
+
+    private:
+
+    typedef boost::shared_ptr<const std::string>
+    Data;
+
+    struct Entry
+        {
+        enum State { Write, Writing, Read, Reading, Cached, Failed };
+
+        State state;
+        Data data;
+        std::string error;
+        bool prefetched;
+
+        Entry() : state(Failed), prefetched(false) { }
+        };
+
+    typedef std::map<std::string,Entry>::iterator
+    entry_it;
+
+    void
+    putData(const std::string& fname, const Data& data);
+
+    Data
+    getData(const std::string& fname);
+
+    void
+    startThread();
+
+    void
+    workLoop();
+
+    void
+    trim();
+
+    int
+    numPendingWrites() const;
+
+    void
+    checkError();
+
+    static bool
+    readFile(const std::string& fname, std::string& data, std::string& msg);
+
+    static bool
+    writeFile(const std::string& fname, const std::string& data, std::string& msg);
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    int window_;
+    std::map<std::string,Entry> entries_;
+    std::deque<std::string> queue_;
+
+    boost::thread* thread_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable work_,
+                              done_;
+    bool quit_;
+
+    std::string error_;
+    Real stall_;
+
+    //
+    /////////////////
+
+    //Not copyable
+    AsyncIO(const AsyncIO&);
+    void operator=(const AsyncIO&);
+
+    };
+
+template <class T>
+void AsyncIO::
+put(const std::string& fname, const T& t)
+    {
+    std::ostringstream s;
+    t.write(s);
+    putData(fname,Data(new std::string(s.str())));
+    }
+
+template <class T>
+void AsyncIO::
+get(const std::string& fname, T& t)
+    {
+    Data d = getData(fname);
+    std::istringstream s(*d);
+    t.read(s);
+    }
+
+#endif
@@ -0,0 +1,456 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "checkpoint.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using boost::uint64_t;
+using boost::uint32_t;
+using boost::int64_t;
+using boost::int32_t;
+
+namespace {
+
+const char magic[8] = { 'I','T','C','H','K','P','T','\0' };
+
+const uint32_t version_number = 1,
+               byte_order_mark = 0x01020304;
+
+const uint64_t header_size = 64,
+               data_align = 64;
+
+enum EntryKind { IntKind = 1, RealKind, BytesKind, ITensorKind, IQTensorKind };
+
+template <typename T>
+void
+put(ostream& s, const T& x) { s.write((const char*) &x,sizeof(x)); }
+
+//Reads an x from p, moving p past it
+template <typename T>
+T
+get(const char*& p)
+    {
+    T x;
+    memcpy(&x,p,sizeof(x));
+    p += sizeof(x);
+    return x;
+    }
+
+template <typename T>
+T
+get(istream& s)
+    {
+    T x;
+    s.read((char*) &x,sizeof(x));
+    return x;
+    }
+
+//Lets the read methods of Index, QN, etc.
+//read straight from the mapped file
+class MemBuf : public streambuf
+    {
+    public:
+    MemBuf(const char* b, uint64_t n)
+        {
+        char* p = const_cast<char*>(b);
+        setg(p,p,p+n);
+        }
+    };
+
+}
+
+//
+// CheckpointWriter
+//
+
+CheckpointWriter::
+CheckpointWriter(const string& fname)
+    :
+    file_(fname.c_str(),ios::out | ios::binary | ios::trunc),
+    fname_(fname),
+    dsize_(0),
+    closed_(false)
+    {
+    if(!file_.good())
+        Error("Could not open checkpoint file " + fname);
+    const char zero[header_size] = { 0 };
+    file_.write(zero,header_size);
+    }
+
+CheckpointWriter::
+~CheckpointWriter()
+    {
+    try {
+        close();
+        }
+    catch(const ITError& e)
+        {
+        cerr << "CheckpointWriter: " << e.what() << endl;
+        }
+    }
+
+void CheckpointWriter::
+addEntry(const string& name, int kind, const string& rec)
+    {
+    if(closed_)
+        Error("Checkpoint " + fname_ + " already closed");
+    if(!names_.insert(name).second)
+        Error("Checkpoint already has an entry named " + name);
+    put(entries_,uint64_t(name.size()));
+    entries_.write(name.data(),name.size());
+    put(entries_,uint32_t(kind));
+    put(entries_,uint64_t(rec.size()));
+    entries_.write(rec.data(),rec.size());
+    }
+
+uint64_t CheckpointWriter::
+indexNum(const Index& I)
+    {
+    boost::unordered_map<IndexKey,int>::const_iterator it = indexnum_.find(I.uniqueId());
+    if(it != indexnum_.end()) return it->second;
+    const int n = indexnum_.size();
+    indexnum_[I.uniqueId()] = n;
+    I.write(indices_);
+    return n;
+    }
+
+uint64_t CheckpointWriter::
+iqindexNum(const IQIndex& I)
+    {
+    boost::unordered_map<IndexKey,int>::const_iterator it = iqindexnum_.find(I.uniqueId());
+    if(it != iqindexnum_.end()) return it->second;
+    const int n = iqindexnum_.size();
+    iqindexnum_[I.uniqueId()] = n;
+    put(iqindices_,indexNum(Index(I)));
+    put(iqindices_,uint64_t(I.nindex()));
+    for(int j = 1; j <= I.nindex(); ++j)
+        {
+        put(iqindices_,indexNum(I.index(j)));
+        I.qn(j).write(iqindices_);
+        }
+    return n;
+    }
+
+void CheckpointWriter::
+writeBlock(ostream& rec, const ITensor& t)
+    {
+    put(rec,uint32_t(t.r()));
+    for(int j = 1; j <= t.r(); ++j)
+        put(rec,indexNum(t.index(j)));
+    put(rec,t.scale_.logNum());
+    put(rec,int32_t(t.scale_.sign()));
+
+    const Vector& v = t.p->v;
+    const uint64_t length = v.Length();
+    put(rec,dsize_);
+    put(rec,length);
+
+    ProfileScope ps("CheckpointWriter::writeBlock",Profiler::DiskIO,0,sizeof(Real)*length);
+
+    file_.write((const char*) v.Store(),sizeof(Real)*length);
+    dsize_ += sizeof(Real)*length;
+    const uint64_t pad = (data_align - dsize_%data_align)%data_align;
+    if(pad > 0)
+        {
+        const char zero[data_align] = { 0 };
+        file_.write(zero,pad);
+        dsize_ += pad;
+        }
+    if(!file_.good())
+        Error("Error writing checkpoint file " + fname_);
+    }
+
+void CheckpointWriter::
+write(const string& name, const ITensor& t)
+    {
+    ostringstream rec;
+    put(rec,uint32_t(t.isNull()));
+    if(t.isNotNull()) writeBlock(rec,t);
+    addEntry(name,ITensorKind,rec.str());
+    }
+
+void CheckpointWriter::
+write(const string& name, const IQTensor& T)
+    {
+    ostringstream rec;
+    put(rec,uint32_t(T.isNull()));
+    if(T.isNotNull())
+        {
+        put(rec,uint32_t(T.r()));
+        for(int j = 1; j <= T.r(); ++j)
+            {
+            put(rec,iqindexNum(T.index(j)));
+            put(rec,int32_t(T.index(j).dir()));
+            }
+        put(rec,uint64_t(T.iten_size()));
+        Foreach(const ITensor& t, T.blocks())
+            writeBlock(rec,t);
+        }
+    addEntry(name,IQTensorKind,rec.str());
+    }
+
+void CheckpointWriter::
+writeInt(const string& name, long val)
+    {
+    ostringstream rec;
+    put(rec,int64_t(val));
+    addEntry(name,IntKind,rec.str());
+    }
+
+void CheckpointWriter::
+writeReal(const string& name, Real val)
+    {
+    ostringstream rec;
+    put(rec,val);
+    addEntry(name,RealKind,rec.str());
+    }
+
+void CheckpointWriter::
+writeBytes(const string& name, const string& bytes)
+    {
+    addEntry(name,BytesKind,bytes);
+    }
+
+void CheckpointWriter::
+close()
+    {
+    if(closed_) return;
+    closed_ = true;
+
+    const string ind = indices_.str(),
+                 iqind = iqindices_.str(),
+                 ent = entries_.str();
+    put(file_,uint64_t(indexnum_.size()));
+    put(file_,uint64_t(ind.size()));
+    file_.write(ind.data(),ind.size());
+    put(file_,uint64_t(iqindexnum_.size()));
+    put(file_,uint64_t(iqind.size()));
+    file_.write(iqind.data(),iqind.size());
+    put(file_,uint64_t(names_.size()));
+    put(file_,uint64_t(ent.size()));
+    file_.write(ent.data(),ent.size());
+    const uint64_t tsize = 6*sizeof(uint64_t) + ind.size() + iqind.size() + ent.size();
+
+    file_.seekp(0);
+    file_.write(magic,sizeof(magic));
+    put(file_,version_number);
+    put(file_,byte_order_mark);
+    put(file_,header_size);
+    put(file_,dsize_);
+    put(file_,header_size+dsize_);
+    put(file_,tsize);
+
+    file_.close();
+    if(file_.fail())
+        Error("Error writing checkpoint file " + fname_);
+    }
+
+//
+// CheckpointReader
+//
+
+CheckpointReader::
+CheckpointReader(const string& fname)
+    :
+    fname_(fname),
+    base_(0),
+    size_(0),
+    version_(0),
+    data_(0)
+    {
+    const int fd = open(fname.c_str(),O_RDONLY);
+    if(fd < 0)
+        Error("Could not open checkpoint file " + fname);
+    struct stat st;
+    if(fstat(fd,&st) != 0 || st.st_size < off_t(header_size))
+        {
+        ::close(fd);
+        Error("Not a checkpoint file: " + fname);
+        }
+    size_ = st.st_size;
+    void* m = mmap(0,size_,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if(m == MAP_FAILED)
+        Error("Could not map checkpoint file " + fname);
+    base_ = (char*) m;
+
+    try {
+        const char* p = base_;
+        if(memcmp(p,magic,sizeof(magic)) != 0)
+            Error("Not a checkpoint file: " + fname);
+        p += sizeof(magic);
+        version_ = get<uint32_t>(p);
+        if(version_ > int(version_number))
+            Error("Checkpoint file " + fname + " has a newer version");
+        if(get<uint32_t>(p) != byte_order_mark)
+            Error("Checkpoint file " + fname + " has a different byte order");
+        const uint64_t doffset = get<uint64_t>(p),
+                       dsize = get<uint64_t>(p),
+                       toffset = get<uint64_t>(p),
+                       tsize = get<uint64_t>(p);
+        if(doffset+dsize > size_ || toffset+tsize > size_)
+            Error("Checkpoint file " + fname + " is truncated");
+        data_ = base_ + doffset;
+
+        //Make each Index and IQIndex once
+        p = base_ + toffset;
+        const uint64_t nindex = get<uint64_t>(p),
+                       isize = get<uint64_t>(p);
+        {
+        MemBuf buf(p,isize);
+        istream s(&buf);
+        indices_.resize(nindex);
+        for(uint64_t n = 0; n < nindex; ++n)
+            indices_[n].read(s);
+        }
+        p += isize;
+
+        const uint64_t niqindex = get<uint64_t>(p),
+                       iqsize = get<uint64_t>(p);
+        {
+        MemBuf buf(p,iqsize);
+        istream s(&buf);
+        iqindices_.reserve(niqindex);
+        for(uint64_t n = 0; n < niqindex; ++n)
+            {
+            const Index& I = indices_.at(get<uint64_t>(s));
+            vector<inqn> iq(get<uint64_t>(s));
+            for(size_t j = 0; j < iq.size(); ++j)
+                {
+                iq[j].index = indices_.at(get<uint64_t>(s));
+                iq[j].qn.read(s);
+                }
+            iqindices_.push_back(IQIndex(I,iq,Out));
+            }
+        }
+        p += iqsize;
+
+        //Find the records of the entries
+        const uint64_t nentry = get<uint64_t>(p);
+        get<uint64_t>(p);
+        order_.reserve(nentry);
+        for(uint64_t n = 0; n < nentry; ++n)
+            {
+            const uint64_t len = get<uint64_t>(p);
+            order_.push_back(string(p,len));
+            p += len;
+            Entry& e = entries_[order_.back()];
+            e.kind = get<uint32_t>(p);
+            const uint64_t rlen = get<uint64_t>(p);
+            e.rec = p;
+            p += rlen;
+            }
+        }
+    catch(...)
+        {
+        munmap(base_,size_);
+        throw;
+        }
+    }
+
+CheckpointReader::
+~CheckpointReader()
+    {
+    munmap(base_,size_);
+    }
+
+bool CheckpointReader::
+has(const string& name) const
+    {
+    return entries_.count(name) == 1;
+    }
+
+vector<string> CheckpointReader::
+names() const
+    {
+    return order_;
+    }
+
+const CheckpointReader::Entry& CheckpointReader::
+entry(const string& name, int kind) const
+    {
+    map<string,Entry>::const_iterator it = entries_.find(name);
+    if(it == entries_.end())
+        Error("No entry named " + name + " in checkpoint " + fname_);
+    if(it->second.kind != kind)
+        Error("Entry " + name + " in checkpoint " + fname_ + " has a different type");
+    return it->second;
+    }
+
+ITensor CheckpointReader::
+readBlock(const char*& rec) const
+    {
+    vector<Index> inds(get<uint32_t>(rec));
+    for(size_t j = 0; j < inds.size(); ++j)
+        inds[j] = indices_.at(get<uint64_t>(rec));
+    const Real lognum = get<Real>(rec);
+    const int sign = get<int32_t>(rec);
+    const uint64_t offset = get<uint64_t>(rec),
+                   length = get<uint64_t>(rec);
+
+    //Copies the elements out of the mapped file
+    ProfileScope ps("CheckpointReader::readBlock",Profiler::DiskIO,0,sizeof(Real)*length);
+    ITensor t(inds,VectorRef(StoreLink(),(Real*)(data_+offset),length));
+    t *= LogNumber(lognum,sign);
+    return t;
+    }
+
+void CheckpointReader::
+read(const string& name, ITensor& t) const
+    {
+    const char* rec = entry(name,ITensorKind).rec;
+    if(get<uint32_t>(rec))
+        t = ITensor();
+    else
+        t = readBlock(rec);
+    }
+
+void CheckpointReader::
+read(const string& name, IQTensor& T) const
+    {
+    const char* rec = entry(name,IQTensorKind).rec;
+    if(get<uint32_t>(rec))
+        {
+        T = IQTensor();
+        return;
+        }
+    vector<IQIndex> inds(get<uint32_t>(rec));
+    for(size_t j = 0; j < inds.size(); ++j)
+        {
+        inds[j] = iqindices_.at(get<uint64_t>(rec));
+        if(get<int32_t>(rec) != Out) inds[j].conj();
+        }
+    T = IQTensor(inds);
+    const uint64_t nblock = get<uint64_t>(rec);
+    for(uint64_t n = 0; n < nblock; ++n)
+        T.insert(readBlock(rec));
+    }
+
+long CheckpointReader::
+intVal(const string& name) const
+    {
+    const char* rec = entry(name,IntKind).rec;
+    return get<int64_t>(rec);
+    }
+
+Real CheckpointReader::
+realVal(const string& name) const
+    {
+    const char* rec = entry(name,RealKind).rec;
+    return get<Real>(rec);
+    }
+
+string CheckpointReader::
+bytes(const string& name) const
+    {
+    const char* rec = entry(name,BytesKind).rec;
+    //Record length precedes the record
+    const char* l = rec - sizeof(uint64_t);
+    return string(rec,get<uint64_t>(l));
+    }
@@ -0,0 +1,359 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_CHECKPOINT_H
+#define __ITENSOR_CHECKPOINT_H
+#include "localmpo.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+
+//
+// Checkpoint files hold named ITensors, IQTensors,
+// MPS, MPOs, LocalMPO environments and numbers.
+//
+// Layout (version 1, all sizes 64 bit):
+//
+//   header    64 bytes: magic, version, byte order mark,
+//             offset and size of the data and table sections
+//   data      the elements of every tensor (or IQTensor block),
+//             each starting at a multiple of 64 bytes
+//   tables    each Index and IQIndex, written once; then
+//             for each named entry its kind and, for tensors,
+//             the table numbers of its indices and the offset
+//             of its elements in the data section
+//
+// The data is written as it is added, the tables when
+// the writer is closed (or destroyed).
+//
+// CheckpointReader maps the file into memory. The Index's
+// and IQIndex's are made once when it is opened and shared
+// by all the tensors read; the elements of a tensor are
+// copied straight from the mapped file into its storage
+// when it is read, so only the tensors asked for are loaded.
+//
+
+class CheckpointWriter
+    {
+    public:
+
+    explicit
+    CheckpointWriter(const std::string& fname);
+
+    //Closes the file if close() has not been called
+    ~CheckpointWriter();
+
+    void
+    write(const std::string& name, const ITensor& t);
+
+    void
+    write(const std::string& name, const IQTensor& T);
+
+    //Site tensors as name.A001, name.A002, ...
+    //orthogonality limits as name.llim, name.rlim
+    //and the SVDWorker as name.svd
+    template <class Tensor>
+    void
+    write(const std::string& name, const MPSt<Tensor>& psi);
+
+    template <class Tensor>
+    void
+    write(const std::string& name, const MPOt<Tensor>& H);
+
+    //Environments held (in memory or on disk)
+    //as name.PH001, ... and their limits
+    template <class Tensor>
+    void
+    write(const std::string& name, const LocalMPO<Tensor>& PH);
+
+    void
+    writeInt(const std::string& name, long val);
+
+    void
+    writeReal(const std::string& name, Real val);
+
+    //Bytes from another write method (e.g. SVDWorker::write)
+    void
+    writeBytes(const std::string& name, const std::string& bytes);
+
+    //Writes the tables and header
+    void
+    close();
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+
+    std::ofstream file_;
+
+    std::string fname_;
+
+    //Bytes of data written so far
+    boost::uint64_t dsize_;
+
+    boost::unordered_map<IndexKey,int>
+    indexnum_;
+    std::ostringstream indices_;
+
+    boost::unordered_map<IndexKey,int>
+    iqindexnum_;
+    std::ostringstream iqindices_;
+
+    std::set<std::string>
+    names_;
+    std::ostringstream entries_;
+
+    bool closed_;
+
+    //
+    /////////////////
+
+    void
+    addEntry(const std::string& name, int kind, const std::string& rec);
+
+    boost::uint64_t
+    indexNum(const Index& I);
+
+    boost::uint64_t
+    iqindexNum(const IQIndex& I);
+
+    void
+    writeBlock(std::ostream& rec, const ITensor& t);
+
+    //Not copyable
+    CheckpointWriter(const CheckpointWriter&);
+    void operator=(const CheckpointWriter&);
+
+    };
+
+class CheckpointReader
+    {
+    public:
+
+    explicit
+    CheckpointReader(const std::string& fname);
+
+    ~CheckpointReader();
+
+    bool
+    has(const std::string& name) const;
+
+    //Names of all entries, in the order written
+    std::vector<std::string>
+    names() const;
+
+    void
+    read(const std::string& name, ITensor& t) const;
+
+    void
+    read(const std::string& name, IQTensor& T) const;
+
+    //psi must be constructed with the Model it was
+    //written with (as for MPSt::read)
+    template <class Tensor>
+    void
+    read(const std::string& name, MPSt<Tensor>& psi) const;
+
+    template <class Tensor>
+    void
+    read(const std::string& name, MPOt<Tensor>& H) const;
+
+    //PH must be constructed from the same MPO
+    //(or MPS) as the one written
+    template <class Tensor>
+    void
+    read(const std::string& name, LocalMPO<Tensor>& PH) const;
+
+    long
+    intVal(const std::string& name) const;
+
+    Real
+    realVal(const std::string& name) const;
+
+    std::string
+    bytes(const std::string& name) const;
+
+    int
+    version() const { return version_; }
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+
+    std::string fname_;
+
+    //The mapped file
+    char* base_;
+    size_t size_;
+
+    int version_;
+
+    const char* data_;
+
+    std::vector<Index> 
+    indices_;
+
+    std::vector<IQIndex> 
+    iqindices_;
+
+    struct Entry
+        {
+        int kind;
+        const char* rec; //Start of its record in the tables
+        };
+    std::map<std::string,Entry>
+    entries_;
+    std::vector<std::string>
+    order_;
+
+    //
+    /////////////////
+
+    const Entry&
+    entry(const std::string& name, int kind) const;
+
+    ITensor
+    readBlock(const char*& rec) const;
+
+    //Not copyable
+    CheckpointReader(const CheckpointReader&);
+    void operator=(const CheckpointReader&);
+
+    };
+
+namespace detail {
+
+inline std::string
+siteName(const std::string& name, const char* what, int j)
+    {
+    return (boost::format("%s.%s%03d")%name%what%j).str();
+    }
+
+}
+
+template <class Tensor>
+void CheckpointWriter::
+write(const std::string& name, const MPSt<Tensor>& psi)
+    {
+    writeInt(name+".N",psi.NN());
+    for(int j = 1; j <= psi.NN(); ++j)
+        write(detail::siteName(name,"A",j),psi.AA(j));
+    writeInt(name+".llim",psi.leftLim());
+    writeInt(name+".rlim",psi.rightLim());
+    writeInt(name+".ortho",psi.isOrtho());
+    std::ostringstream svd;
+    psi.svd().write(svd);
+    writeBytes(name+".svd",svd.str());
+    }
+
+template <class Tensor>
+void CheckpointWriter::
+write(const std::string& name, const MPOt<Tensor>& H)
+    {
+    writeInt(name+".N",H.NN());
+    for(int j = 1; j <= H.NN(); ++j)
+        write(detail::siteName(name,"A",j),H.AA(j));
+    writeInt(name+".llim",H.leftLim());
+    writeInt(name+".rlim",H.rightLim());
+    }
+
+template <class Tensor>
+void CheckpointWriter::
+write(const std::string& name, const LocalMPO<Tensor>& PH)
+    {
+    const int N = int(PH.PH_.size())-2;
+    writeInt(name+".N",N);
+    writeInt(name+".llim",PH.LHlim_);
+    writeInt(name+".rlim",PH.RHlim_);
+    for(int j = 1; j <= N; ++j)
+        {
+        if(j > PH.LHlim_ && j < PH.RHlim_) continue;
+        if(PH.PH_.at(j).isNotNull())
+            {
+            write(detail::siteName(name,"PH",j),PH.PH_.at(j));
+            }
+        else
+        if(PH.do_write_)
+            {
+            Tensor t;
+            PH.io_->get(PH.PHFName(j),t);
+            if(t.isNotNull()) write(detail::siteName(name,"PH",j),t);
+            }
+        }
+    }
+
+template <class Tensor>
+void CheckpointReader::
+read(const std::string& name, MPSt<Tensor>& psi) const
+    {
+    if(psi.isNull())
+        Error("Can't read to default constructed MPS");
+    if(intVal(name+".N") != psi.NN())
+        Error("Number of sites in checkpoint does not match MPS");
+    for(int j = 1; j <= psi.NN(); ++j)
+        read(detail::siteName(name,"A",j),psi.AAnc(j));
+    psi.leftLim(intVal(name+".llim"));
+    psi.rightLim(intVal(name+".rlim"));
+    psi.isOrtho(intVal(name+".ortho") != 0);
+    std::istringstream svd(bytes(name+".svd"));
+    psi.svd().read(svd);
+    }
+
+template <class Tensor>
+void CheckpointReader::
+read(const std::string& name, MPOt<Tensor>& H) const
+    {
+    if(H.isNull())
+        Error("Can't read to default constructed MPO");
+    if(intVal(name+".N") != H.NN())
+        Error("Number of sites in checkpoint does not match MPO");
+    for(int j = 1; j <= H.NN(); ++j)
+        read(detail::siteName(name,"A",j),H.AAnc(j));
+    H.leftLim(intVal(name+".llim"));
+    H.rightLim(intVal(name+".rlim"));
+    }
+
+template <class Tensor>
+void CheckpointReader::
+read(const std::string& name, LocalMPO<Tensor>& PH) const
+    {
+    if(PH.isNull())
+        Error("Can't read to null LocalMPO");
+    const int N = int(PH.PH_.size())-2;
+    if(intVal(name+".N") != N)
+        Error("Number of sites in checkpoint does not match LocalMPO");
+
+    PH.LHlim_ = intVal(name+".llim");
+    PH.RHlim_ = intVal(name+".rlim");
+    for(int j = 0; j <= N+1; ++j)
+        {
+        Tensor t;
+        const std::string tname = detail::siteName(name,"PH",j);
+        if(has(tname)) read(tname,t);
+        //When environments are kept on disk, only
+        //the current two are held in memory
+        if(PH.do_write_ && j != PH.LHlim_ && j != PH.RHlim_)
+            {
+            PH.PH_.at(j) = Tensor();
+            if(t.isNotNull()) PH.io_->put(PH.PHFName(j),t);
+            }
+        else
+            {
+            PH.PH_.at(j) = t;
+            }
+        }
+
+    if(PH.Op_ != 0 && PH.RHlim_-PH.LHlim_ == PH.nc_+1)
+        {
+        const int b = PH.LHlim_+1;
+        PH.lop_.update(PH.Op_->AA(b),PH.Op_->AA(b+1),PH.L(),PH.R());
+        }
+    }
+
+#endif
@@ -20,7 +20,7 @@ class Combiner
     {
     public:
 
-    typedef boost::array<Index,NMAX+1>::const_iterator 
+    typedef IndexArray::const_iterator 
     left_it;
 
     //Accessor Methods ----------------------------------------------
@@ -96,8 +96,8 @@ class Combiner
 
     //Other Methods -------------------------------------------------
 
-    Real
-    uniqueReal() const;
+    IndexKey
+    uniqueId() const;
 
     operator ITensor() const;
 
@@ -116,7 +116,7 @@ class Combiner
 
 private:
 
-    boost::array<Index,NMAX+1> left_; // max dim is 8
+    IndexArray left_;
     mutable Index right_;
     int rl_; //Number of m>1 'left' indices (indices to be combined into one)
     mutable bool initted;
@@ -157,8 +157,7 @@ void inline Combiner::
 addleft(const Index& l)// Include another left index
     { 
     initted = false;
-    if(rl_ == NMAX) 
-        Error("Combiner: already reached max number of left indices.");
+    left_.grow(rl_+2);
     left_[++rl_] = l; 
     }
 
@@ -166,8 +165,7 @@ void inline Combiner::
 addleft(const std::vector<Index>& ls)
     { 
     initted = false;
-    if(rl_+int(ls.size()) > NMAX) 
-        Error("Combiner: too many left indices.");
+    left_.grow(rl_+int(ls.size())+2);
     for(size_t j = 0; j < ls.size(); ++j)
         left_[++rl_] = ls[j]; 
     }
@@ -264,13 +262,13 @@ product(const ITensor& t, ITensor& res) const
     t.groupIndices(left_,rl_,right_,res);
     }
 
-Real inline Combiner::
-uniqueReal() const
+IndexKey inline Combiner::
+uniqueId() const
     {
-    Real ur = 0;
+    IndexKey key = 0;
     for(int j = 1; j <= rl_; ++j)
-        ur += left_[j].uniqueReal();
-    return ur;
+        key += left_[j].uniqueId();
+    return key;
     }
 
 inline 
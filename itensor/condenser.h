@@ -52,6 +52,16 @@ class Condenser
 
 private:
 
+    //One sector for each Index of bigind_: the Index of
+    //smallind_ it is condensed into and the position it
+    //starts at
+    struct Sector
+        {
+        Index big, 
+              small;
+        int start;
+        };
+
     ///////////////
     //
     // Data Members
@@ -60,20 +70,20 @@ private:
     IQIndex bigind_,   //uncondensed
             smallind_; //condensed
 
-    mutable std::map<Index, std::pair<Index,int> > 
-    big_to_small;
+    //Sectors of the same small Index are
+    //consecutive and in order of start
+    std::vector<Sector> sector_;
 
-    mutable std::map<std::pair<Index,int>,Index > 
-    small_to_big;
+    //Position in sector_ of each big Index, and of the
+    //first sector of each small Index, by their keys
+    boost::unordered_map<IndexKey,int> bigpos_, 
+                                       smallpos_;
 
     //
     //////////////
 
-    typedef std::map<Index, std::pair<Index,int> >::const_iterator
-    bts_const_it;
-
-    typedef std::map<std::pair<Index,int>,Index >::const_iterator
-    stb_const_it;
+    void
+    setPositions();
 
     void 
     init(const std::string& smallind_name);
@@ -85,26 +95,26 @@ doprime(PrimeType pt, int inc)
     {
     bigind_.doprime(pt,inc);
     smallind_.doprime(pt,inc);
-
-    small_to_big.clear();
-
-    std::map<Index,std::pair<Index,int> >
-    new_bts;
-    for(bts_const_it it = big_to_small.begin();
-        it != big_to_small.end(); ++it)
+    Foreach(Sector& S, sector_)
         {
-        Index pindex = it->first;
-        pindex.doprime(pt,inc);
-
-        std::pair<Index,int> newpair = it->second;
-        newpair.first.doprime(pt,inc);
-
-        new_bts[pindex] = newpair;
-        small_to_big[newpair] = pindex;
+        S.big.doprime(pt,inc);
+        S.small.doprime(pt,inc);
         }
-    big_to_small.swap(new_bts);
+    setPositions();
     }
 
+void inline Condenser::
+setPositions()
+    {
+    bigpos_.clear();
+    smallpos_.clear();
+    for(size_t n = 0; n < sector_.size(); ++n)
+        {
+        const Sector& S = sector_[n];
+        bigpos_[S.big.uniqueId()] = n;
+        if(S.start == 0) smallpos_[S.small.uniqueId()] = n;
+        }
+    }
 
 inline Condenser::
 Condenser(const IQIndex& bigindex, IQIndex& smallindex)
@@ -136,8 +146,8 @@ init(const std::string& smallind_name)
         Error("Arrow dirs not the same in Condenser.");
     }
     */
-    static std::vector<QN> qns(1000);
-    qns.resize(0);
+    std::vector<QN> qns;
+    qns.reserve(bigind_.iq().size());
     Foreach(const inqn& x, bigind_.iq()) 
         qns.push_back(x.qn);
 
@@ -159,13 +169,16 @@ init(const std::string& smallind_name)
         Foreach(const inqn& x, bigind_.iq())
             if(x.qn == q)
                 {
-                const Index &xi = x.index;
-                small_to_big[std::make_pair(small_qind,start)] = xi;
-                big_to_small[xi] = std::make_pair(small_qind,start);
-                start += xi.m();
+                Sector S;
+                S.big = x.index;
+                S.small = small_qind;
+                S.start = start;
+                sector_.push_back(S);
+                start += x.index.m();
                 }
         iq.push_back(inqn(small_qind,q));
         }
+    setPositions();
 
     smallind_ = IQIndex(smallind_name,iq,bigind_.dir(),bigind_.primeLevel());
 
@@ -213,25 +226,36 @@ product(const IQTensor& t, IQTensor& res) const
 
         res = IQTensor(iqinds);
 
-        for(IQTensor::const_iten_it i = t.const_iten_begin(); i != t.const_iten_end(); ++i)
+        //Each block is split into the blocks of its sectors
+        //by copying the ranges of its small Index
+        const int nsector = sector_.size();
+        Foreach(const ITensor& tt, t.blocks())
             {
-            int k;
-            for(k = 1; k <= i->r(); ++k)
-                if(smallind_.hasindex(i->index(k))) break;
-
-            Index sind = i->index(k);
-            for(int start = 0; start < sind.m(); )
+            int k = 1, 
+                s = -1;
+            for(; k <= tt.r(); ++k)
                 {
-                Index bind = small_to_big[std::make_pair(sind,start)];
-                Matrix C(sind.m(),bind.m()); C = 0;
-                for(int kk = 1; kk <= bind.m(); ++kk) 
+                boost::unordered_map<IndexKey,int>::const_iterator
+                it = smallpos_.find(tt.index(k).uniqueId());
+                if(it != smallpos_.end()) 
                     { 
-                    C(start+kk,kk) = 1; 
+                    s = it->second; 
+                    break; 
                     }
-                ITensor converter(sind,bind,C);
-                converter *= (*i);
-                res += converter;
-                start += bind.m();
+                }
+            if(s < 0)
+                {
+                Print(*this);
+                Print(tt);
+                Error("Condenser::product: Can't find common Index");
+                }
+
+            const Index& sind = tt.index(k);
+            for(; s < nsector && sector_[s].small == sind; ++s)
+                {
+                ITensor part(tt);
+                part.sliceIndex(sind,sector_[s].big,sector_[s].start);
+                res += part;
                 }
             }
         }
@@ -252,14 +276,18 @@ product(const IQTensor& t, IQTensor& res) const
             bool gotit = false;
 
             for(int k = 1; k <= tt.r(); ++k)
-                if(bigind_.hasindex(tt.index(k)))
+                {
+                boost::unordered_map<IndexKey,int>::const_iterator
+                it = bigpos_.find(tt.index(k).uniqueId());
+                if(it != bigpos_.end())
                     {
-                    std::pair<Index,int> Ii = big_to_small[tt.index(k)];
-                    tt.expandIndex(tt.index(k),Ii.first,Ii.second);
+                    const Sector& S = sector_[it->second];
+                    tt.expandIndex(S.big,S.small,S.start);
                     res += tt;
                     gotit = true;
                     break;
                     }
+                }
 
             if(!gotit)
                 {
@@ -277,14 +305,9 @@ operator<<(std::ostream & s, const Condenser & c)
     {
     s << "bigind_ is " << c.bigind_ << "\n";
     s << "smallind_ is " << c.smallind_ << "\n";
-    s << "big_to_small is " << "\n";
-    for(std::map<Index, std::pair<Index,int> >::const_iterator kk = c.big_to_small.begin();
-        kk != c.big_to_small.end(); ++kk)
-        { s << kk->first SP kk->second.first SP kk->second.second << "\n"; }
-    s << "small_to_big is " << std::endl;
-    for(std::map<std::pair<Index,int>,Index>::const_iterator kk = c.small_to_big.begin();
-        kk != c.small_to_big.end(); ++kk)
-        { s << kk->first.first SP kk->first.second SP kk->second << "\n"; }
+    s << "sectors (big, small, start) are" << "\n";
+    Foreach(const Condenser::Sector& S, c.sector_)
+        { s << S.big SP S.small SP S.start << "\n"; }
     return s << std::endl;
     }
 
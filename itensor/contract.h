@@ -0,0 +1,439 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_CONTRACT_H
+#define __ITENSOR_CONTRACT_H
+#include "iqtensor.h"
+
+//
+// Contraction collects the operands of a product
+// of several tensors, such as phi * L * Op1 * Op2 * R,
+// and contracts them pairwise in the order which
+// needs the fewest multiply-adds, estimated from
+// the dimensions of their indices.
+//
+// Usage:
+//
+//   Contraction<ITensor> C;
+//   C.add(phi,"phi").add(L,"L").add(Op1,"Op1");
+//   ITensor res = C.result();
+//   cout << C.order() << " " << C.flops() << endl;
+//
+// As with operator*, indices shared by two
+// operands are summed over.
+// All orders are searched for up to maxExhaustive()
+// operands; for more, the cheapest pair is
+// contracted first at each step.
+// Null operands are ignored.
+//
+// For products repeated on new tensors of the same
+// structure, contract(res,plans) keeps a ProductPlan
+// for each pairwise IQTensor product in plans.
+//
+
+template <class Tensor>
+class Contraction
+    {
+    public:
+
+    typedef typename Tensor::IndexT
+    IndexT;
+
+    Contraction() : planned_(false), flops_(0) { }
+
+    //Operands are copied, which for ITensor and
+    //IQTensor only copies a reference to their data
+    Contraction&
+    add(const Tensor& t, const std::string& name = "");
+
+    int
+    size() const { return ops_.size(); }
+
+    void
+    contract(Tensor& res) const;
+
+    //Reuses the plans of the pairwise products made by
+    //an earlier call (see ProductPlan), or makes them
+    void
+    contract(Tensor& res, std::vector<ProductPlan>& plans) const;
+
+    Tensor
+    result() const
+        {
+        Tensor res;
+        contract(res);
+        return res;
+        }
+
+    //Estimated multiply-adds for the chosen order
+    Real
+    flops() const { plan(); return flops_; }
+
+    //Chosen order, e.g. ((phi*L)*Op1)*Op2
+    std::string
+    order() const { plan(); return orderString(root_); }
+
+    static int
+    maxExhaustive() { return 6; }
+
+    private:
+
+    typedef unsigned long
+    Set;
+
+    //Nodes 0 to size()-1 are the operands,
+    //the rest are pairwise contractions
+    struct Node
+        {
+        int left, right;
+        Set set;
+        };
+
+    void
+    plan() const;
+
+    void
+    planExhaustive() const;
+
+    void
+    planGreedy() const;
+
+    Real
+    dim(Set s) const;
+
+    Real
+    pairCost(Set s1, Set s2) const;
+
+    int
+    addNode(int left, int right) const;
+
+    void
+    eval(int n, Tensor& res, std::vector<ProductPlan>* plans) const;
+
+    void
+    multiply(int n, Tensor& res, const Tensor& other,
+             std::vector<ProductPlan>* plans) const;
+
+    std::string
+    orderString(int n) const;
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    std::vector<Tensor> ops_;
+    std::vector<std::string> names_;
+
+    //For each distinct index, its dimension and
+    //the set of operands having it
+    std::vector<IndexT> inds_;
+    std::vector<Real> m_;
+    std::vector<Set> has_;
+
+    mutable bool planned_;
+    mutable std::vector<Node> nodes_;
+    mutable int root_;
+    mutable Real flops_;
+
+    //
+    /////////////////
+
+    };
+
+template <class Tensor>
+Contraction<Tensor>& Contraction<Tensor>::
+add(const Tensor& t, const std::string& name)
+    {
+    if(t.isNull()) return *this;
+    const int n = ops_.size();
+    if(n >= int(8*sizeof(Set)))
+        Error("Contraction: too many operands");
+
+    ops_.push_back(t);
+    names_.push_back(name != "" ? name : (boost::format("T%d")%(n+1)).str());
+
+    //The ReIm index of complex tensors is
+    //not summed over, so it is left out
+    std::vector<IndexT> inds;
+    for(int j = 1; j <= t.r(); ++j)
+        {
+        const IndexT& I = t.index(j);
+        if(I == IndexT::IndReIm()) continue;
+        inds.push_back(I);
+        }
+
+    //Find index numbers of inds, adding new ones
+    Foreach(const IndexT& I, inds)
+        {
+        size_t k = 0;
+        while(k < inds_.size() && !(inds_[k] == I)) ++k;
+        if(k == inds_.size())
+            {
+            inds_.push_back(I);
+            m_.push_back(I.m());
+            has_.push_back(0);
+            }
+        has_[k] |= (Set(1) << n);
+        }
+
+    planned_ = false;
+    return *this;
+    }
+
+//Product of the dimensions of the indices
+//remaining after contracting the operands in s
+template <class Tensor>
+Real Contraction<Tensor>::
+dim(Set s) const
+    {
+    Real d = 1;
+    for(size_t k = 0; k < m_.size(); ++k)
+        {
+        //An index shared an odd number of
+        //times within s is not contracted away
+        Set in = has_[k] & s;
+        int count = 0;
+        for(; in != 0; in &= (in-1)) ++count;
+        if(count%2 == 1) d *= m_[k];
+        }
+    return d;
+    }
+
+//Multiply-adds for contracting the results of s1 and s2:
+//the product of the dimensions of all their indices
+template <class Tensor>
+Real Contraction<Tensor>::
+pairCost(Set s1, Set s2) const
+    {
+    Real c = 1;
+    for(size_t k = 0; k < m_.size(); ++k)
+        {
+        int c1 = 0, c2 = 0;
+        for(Set in = has_[k] & s1; in != 0; in &= (in-1)) ++c1;
+        for(Set in = has_[k] & s2; in != 0; in &= (in-1)) ++c2;
+        if(c1%2 == 1 || c2%2 == 1) c *= m_[k];
+        }
+    return c;
+    }
+
+template <class Tensor>
+int Contraction<Tensor>::
+addNode(int left, int right) const
+    {
+    Node nd;
+    nd.left = left;
+    nd.right = right;
+    nd.set = (nodes_.at(left).set | nodes_.at(right).set);
+    nodes_.push_back(nd);
+    return nodes_.size()-1;
+    }
+
+template <class Tensor>
+void Contraction<Tensor>::
+plan() const
+    {
+    if(planned_) return;
+    if(ops_.empty()) Error("Contraction: no operands");
+
+    nodes_.clear();
+    for(size_t j = 0; j < ops_.size(); ++j)
+        {
+        Node nd;
+        nd.left = nd.right = -1;
+        nd.set = (Set(1) << j);
+        nodes_.push_back(nd);
+        }
+    flops_ = 0;
+    root_ = 0;
+
+    if(size() <= maxExhaustive())
+        planExhaustive();
+    else
+        planGreedy();
+
+    planned_ = true;
+    }
+
+//Best split of every subset of the operands,
+//from the smallest subsets up
+template <class Tensor>
+void Contraction<Tensor>::
+planExhaustive() const
+    {
+    const int n = size();
+    const Set all = (Set(1) << n) - 1;
+    std::vector<Real> cost(all+1,0);
+    std::vector<Set> split(all+1,0);
+
+    for(Set s = 1; s <= all; ++s)
+        {
+        if((s & (s-1)) == 0) continue; //single operand
+
+        //Splits s = s1 + s2, with s1 holding the
+        //lowest operand of s so that operands
+        //keep their relative order. Subsets s1 are
+        //visited in increasing order so that ties go
+        //to the order in which operands were added.
+        const Set low = (s & (~s+1));
+        bool first = true;
+        for(Set s1 = low; s1 != s; s1 = (s1-s) & s)
+            {
+            if((s1 & low) == 0) continue;
+            const Set s2 = s & ~s1;
+            const Real c = cost[s1] + cost[s2] + pairCost(s1,s2);
+            if(first || c < cost[s])
+                {
+                cost[s] = c;
+                split[s] = s1;
+                first = false;
+                }
+            }
+        }
+
+    //Build the tree of the best order
+    std::vector<int> node_of(all+1,-1);
+    for(int j = 0; j < n; ++j) node_of[Set(1) << j] = j;
+
+    std::vector<Set> stack(1,all), post;
+    while(!stack.empty())
+        {
+        const Set s = stack.back();
+        stack.pop_back();
+        if(node_of[s] >= 0) continue;
+        post.push_back(s);
+        stack.push_back(split[s]);
+        stack.push_back(s & ~split[s]);
+        }
+    for(int k = int(post.size())-1; k >= 0; --k)
+        {
+        const Set s = post[k];
+        node_of[s] = addNode(node_of[split[s]],node_of[s & ~split[s]]);
+        }
+
+    root_ = node_of[all];
+    flops_ = cost[all];
+    }
+
+//Repeatedly contract the cheapest pair,
+//avoiding outer products where possible
+template <class Tensor>
+void Contraction<Tensor>::
+planGreedy() const
+    {
+    std::vector<int> active;
+    for(int j = 0; j < size(); ++j) active.push_back(j);
+
+    while(active.size() > 1)
+        {
+        int ba = 0, bb = 1;
+        Real best = -1;
+        bool best_shares = false;
+        for(size_t a = 0; a < active.size(); ++a)
+        for(size_t b = a+1; b < active.size(); ++b)
+            {
+            const Set sa = nodes_[active[a]].set,
+                      sb = nodes_[active[b]].set;
+            const Real c = pairCost(sa,sb);
+            //Shares an index if the pair costs less
+            //than the product of their dimensions
+            const bool shares = (c < dim(sa)*dim(sb));
+            if(best < 0 || (shares && !best_shares)
+               || (shares == best_shares && c < best))
+                {
+                best = c;
+                best_shares = shares;
+                ba = a;
+                bb = b;
+                }
+            }
+        flops_ += best;
+        active[ba] = addNode(active[ba],active[bb]);
+        active.erase(active.begin()+bb);
+        }
+
+    root_ = active.front();
+    }
+
+//Products done by Contraction can reuse a
+//ProductPlan, which only IQTensor's have
+inline void
+multiplyPlanned(ITensor& t, const ITensor& other, ProductPlan& plan)
+    { t *= other; }
+
+inline void
+multiplyPlanned(IQTensor& t, const IQTensor& other, ProductPlan& plan)
+    { t.multiply(other,plan); }
+
+//res *= other for node n
+template <class Tensor>
+void Contraction<Tensor>::
+multiply(int n, Tensor& res, const Tensor& other,
+         std::vector<ProductPlan>* plans) const
+    {
+    if(plans == 0)
+        {
+        res *= other;
+        return;
+        }
+    //Pairwise products are the nodes after the operands
+    const size_t k = n - size();
+    if(plans->size() < nodes_.size()-size()) 
+        plans->resize(nodes_.size()-size());
+    multiplyPlanned(res,other,plans->at(k));
+    }
+
+template <class Tensor>
+void Contraction<Tensor>::
+eval(int n, Tensor& res, std::vector<ProductPlan>* plans) const
+    {
+    const Node& nd = nodes_.at(n);
+    if(nd.left < 0)
+        {
+        res = ops_.at(n);
+        return;
+        }
+    eval(nd.left,res,plans);
+    if(nodes_.at(nd.right).left < 0)
+        {
+        multiply(n,res,ops_.at(nd.right),plans);
+        }
+    else
+        {
+        Tensor r;
+        eval(nd.right,r,plans);
+        multiply(n,res,r,plans);
+        }
+    }
+
+template <class Tensor>
+void Contraction<Tensor>::
+contract(Tensor& res) const
+    {
+    plan();
+    eval(root_,res,0);
+    }
+
+template <class Tensor>
+void Contraction<Tensor>::
+contract(Tensor& res, std::vector<ProductPlan>& plans) const
+    {
+    plan();
+    eval(root_,res,&plans);
+    }
+
+template <class Tensor>
+std::string Contraction<Tensor>::
+orderString(int n) const
+    {
+    const Node& nd = nodes_.at(n);
+    if(nd.left < 0) return names_.at(n);
+    std::string l = orderString(nd.left),
+                r = orderString(nd.right);
+    if(nodes_.at(nd.left).left >= 0) l = "(" + l + ")";
+    if(nodes_.at(nd.right).left >= 0) r = "(" + r + ")";
+    return l + "*" + r;
+    }
+
+#endif
@@ -9,5 +9,7 @@
 #include "DMRGWorker.h"
 #include "option.h"
 #include "dmrg.h"
+#include "checkpoint.h"
+#include "iqtflat.h"
 
 #endif
@@ -0,0 +1,870 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "costmodel.h"
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+using boost::format;
+
+namespace {
+
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+//Same count as used by the profiler for an m x n SVD
+Real
+svdFlops(Real m, Real n)
+    {
+    const Real a = max(m,n), b = min(m,n);
+    return 4*a*a*b + 8*a*b*b + 9*b*b*b;
+    }
+
+struct QNLess
+    {
+    bool
+    operator()(const QN& a, const QN& b) const
+        {
+        if(a.sz() != b.sz()) return a.sz() < b.sz();
+        if(a.Nf() != b.Nf()) return a.Nf() < b.Nf();
+        return a.Nfp() < b.Nfp();
+        }
+    };
+
+typedef DMRGCost::Sectors
+Sectors;
+
+typedef map<QN,Real,QNLess>
+QNReal;
+
+struct LargerRemainder
+    {
+    bool
+    operator()(const pair<Real,QN>& a, const pair<Real,QN>& b) const
+        { return a.first > b.first; }
+    };
+
+//
+// One index of a block sparse tensor: its sectors, and the
+// sign with which their quantum numbers enter the
+// conservation rule of the tensor's blocks,
+//   sum over indices of sign*qn == div.
+// Indices with the same id are contracted.
+//
+struct Leg
+    {
+    int id,
+        sign;
+    vector<QN> q;
+    vector<Real> d;
+    map<QN,int,QNLess> pos;
+
+    Leg(int id_, int sign_, const Sectors& s)
+        : id(id_), sign(sign_)
+        {
+        for(size_t n = 0; n < s.size(); ++n)
+            {
+            q.push_back(s[n].first);
+            d.push_back(s[n].second);
+            pos[s[n].first] = int(n);
+            }
+        }
+    };
+
+struct Block
+    {
+    vector<int> sec;
+    Real size;
+    };
+
+struct Shape
+    {
+    vector<Leg> legs;
+    QN div;
+
+    Shape&
+    add(int id, int sign, const Sectors& s)
+        {
+        legs.push_back(Leg(id,sign,s));
+        return *this;
+        }
+
+    void
+    blocks(vector<Block>& res) const
+        {
+        res.clear();
+        if(legs.empty()) return;
+        vector<int> sec(legs.size());
+        addBlocks(0,QN(),sec,1,res);
+        }
+
+    Real
+    size() const
+        {
+        vector<Block> b;
+        blocks(b);
+        Real res = 0;
+        Foreach(const Block& x, b) res += x.size;
+        return res;
+        }
+
+    private:
+
+    void
+    addBlocks(size_t k, const QN& acc, vector<int>& sec, Real size,
+              vector<Block>& res) const
+        {
+        const Leg& L = legs[k];
+        if(k+1 == legs.size())
+            {
+            //The last sector is fixed by the others
+            map<QN,int,QNLess>::const_iterator it = L.pos.find((div-acc)*L.sign);
+            if(it == L.pos.end()) return;
+            sec[k] = it->second;
+            Block b = { sec, size*L.d[it->second] };
+            res.push_back(b);
+            return;
+            }
+        for(size_t n = 0; n < L.q.size(); ++n)
+            {
+            sec[k] = int(n);
+            addBlocks(k+1,acc+L.q[n]*L.sign,sec,size*L.d[n],res);
+            }
+        }
+    };
+
+struct Counts
+    {
+    Real flops,
+         pairs,
+         bytes,
+         peak; //largest pair of input and output, in elements
+
+    Counts() : flops(0), pairs(0), bytes(0), peak(0) { }
+
+    Counts&
+    operator+=(const Counts& o)
+        {
+        flops += o.flops;
+        pairs += o.pairs;
+        bytes += o.bytes;
+        peak = max(peak,o.peak);
+        return *this;
+        }
+    };
+
+//
+// Counts the cost of A*B, done block by block: the blocks
+// of A and of B with the same sectors of the contracted
+// indices are multiplied pairwise.
+//
+Shape
+contract(const Shape& A, const Shape& B, Counts& c)
+    {
+    vector<int> ca, cb;
+    for(size_t i = 0; i < A.legs.size(); ++i)
+    for(size_t j = 0; j < B.legs.size(); ++j)
+        {
+        if(A.legs[i].id != B.legs[j].id) continue;
+        if(A.legs[i].sign != -B.legs[j].sign)
+            Error("DMRGCost: contracted indices must have opposite arrows");
+        ca.push_back(int(i));
+        cb.push_back(int(j));
+        }
+
+    typedef map<vector<int>,pair<Real,Real> > KeyMap;
+    KeyMap ka, kb;
+    vector<Block> blk;
+    Real sizeA = 0, sizeB = 0;
+
+    A.blocks(blk);
+    Foreach(const Block& b, blk)
+        {
+        vector<int> key(ca.size());
+        for(size_t n = 0; n < ca.size(); ++n) key[n] = b.sec[ca[n]];
+        pair<Real,Real>& x = ka[key];
+        x.first += b.size;
+        x.second += 1;
+        sizeA += b.size;
+        }
+
+    B.blocks(blk);
+    Foreach(const Block& b, blk)
+        {
+        vector<int> key(cb.size());
+        Real cdim = 1;
+        for(size_t n = 0; n < cb.size(); ++n)
+            {
+            key[n] = b.sec[cb[n]];
+            cdim *= B.legs[cb[n]].d[key[n]];
+            }
+        pair<Real,Real>& x = kb[key];
+        x.first += b.size/cdim;
+        x.second += 1;
+        sizeB += b.size;
+        }
+
+    for(KeyMap::const_iterator it = ka.begin(); it != ka.end(); ++it)
+        {
+        KeyMap::const_iterator jt = kb.find(it->first);
+        if(jt == kb.end()) continue;
+        c.flops += 2*it->second.first*jt->second.first;
+        c.pairs += it->second.second*jt->second.second;
+        }
+
+    Shape R;
+    R.div = A.div + B.div;
+    for(size_t i = 0; i < A.legs.size(); ++i)
+        if(find(ca.begin(),ca.end(),int(i)) == ca.end()) R.legs.push_back(A.legs[i]);
+    for(size_t j = 0; j < B.legs.size(); ++j)
+        if(find(cb.begin(),cb.end(),int(j)) == cb.end()) R.legs.push_back(B.legs[j]);
+
+    const Real sizeR = R.size();
+    c.bytes += sizeof(Real)*(sizeA+sizeB+sizeR);
+    c.peak = max(c.peak,sizeA+sizeB+sizeR);
+    return R;
+    }
+
+Real
+totalDim(const Sectors& s)
+    {
+    Real res = 0;
+    for(size_t n = 0; n < s.size(); ++n) res += s[n].second;
+    return res;
+    }
+
+Sectors
+merge(const QNReal& dim)
+    {
+    Sectors res;
+    for(QNReal::const_iterator it = dim.begin(); it != dim.end(); ++it)
+        res.push_back(make_pair(it->first,int(it->second)));
+    return res;
+    }
+
+//
+// Bond sectors keeping the given dimensions, scaled down
+// in proportion if they add up to more than maxm (rounding
+// so the total is maxm). Sectors left with no states are
+// dropped.
+//
+Sectors
+truncate(const QNReal& dim, int maxm)
+    {
+    Real tot = 0;
+    for(QNReal::const_iterator it = dim.begin(); it != dim.end(); ++it)
+        tot += it->second;
+    if(tot <= maxm) return merge(dim);
+    const Real scale = maxm/tot;
+
+    //Whole states first, then one more to the
+    //sectors with the largest remainders
+    vector<pair<Real,QN> > rem;
+    QNReal kept;
+    int nkept = 0;
+    for(QNReal::const_iterator it = dim.begin(); it != dim.end(); ++it)
+        {
+        const Real x = it->second*scale;
+        const int d = int(x);
+        kept[it->first] = d;
+        nkept += d;
+        rem.push_back(make_pair(x-d,it->first));
+        }
+    sort(rem.begin(),rem.end(),LargerRemainder());
+    for(size_t n = 0; n < rem.size() && nkept < maxm; ++n, ++nkept)
+        kept[rem[n].second] += 1;
+
+    Sectors res;
+    for(QNReal::const_iterator it = kept.begin(); it != kept.end(); ++it)
+        if(it->second > 0) res.push_back(make_pair(it->first,int(it->second)));
+    return res;
+    }
+
+//
+// Index ids of the tensors of a two-site DMRG step.
+// Bra indices are the primed copies of the ket indices.
+//
+enum LegKind { KetLink, BraLink, KetSite, BraSite, MPOLink, NumLegKinds };
+
+int
+legId(LegKind k, int j) { return NumLegKinds*j + k; }
+
+//
+// Quantum numbers are counted as flowing in from the left
+// end of the chain: a link sector is labeled by the total
+// quantum number of the sites to its left, and the MPO
+// link by the difference of that of the ket and the bra.
+//
+struct Chain
+    {
+    const vector<Sectors>& site;
+    const vector<Sectors>& link;
+    const vector<Sectors>& mpo;
+
+    Chain(const vector<Sectors>& site_, const vector<Sectors>& link_,
+          const vector<Sectors>& mpo_)
+        : site(site_), link(link_), mpo(mpo_) { }
+
+    //Two-site wavefunction of sites b, b+1
+    Shape
+    phi(int b) const
+        {
+        Shape S;
+        S.add(legId(KetLink,b-1),-1,link[b-1])
+         .add(legId(KetSite,b),-1,site[b])
+         .add(legId(KetSite,b+1),-1,site[b+1])
+         .add(legId(KetLink,b+1),+1,link[b+1]);
+        return S;
+        }
+
+    Shape
+    mps(int j) const
+        {
+        Shape S;
+        S.add(legId(KetLink,j-1),-1,link[j-1])
+         .add(legId(KetSite,j),-1,site[j])
+         .add(legId(KetLink,j),+1,link[j]);
+        return S;
+        }
+
+    Shape
+    mpsBra(int j) const
+        {
+        Shape S;
+        S.add(legId(BraLink,j-1),+1,link[j-1])
+         .add(legId(BraSite,j),+1,site[j])
+         .add(legId(BraLink,j),-1,link[j]);
+        return S;
+        }
+
+    Shape
+    op(int j) const
+        {
+        Shape S;
+        S.add(legId(MPOLink,j-1),+1,mpo[j-1])
+         .add(legId(KetSite,j),+1,site[j])
+         .add(legId(BraSite,j),-1,site[j])
+         .add(legId(MPOLink,j),-1,mpo[j]);
+        return S;
+        }
+
+    //Environment of sites 1,...,k
+    Shape
+    left(int k) const
+        {
+        Shape S;
+        S.add(legId(KetLink,k),+1,link[k])
+         .add(legId(MPOLink,k),-1,mpo[k])
+         .add(legId(BraLink,k),-1,link[k]);
+        return S;
+        }
+
+    //Environment of sites k+1,...,N
+    Shape
+    right(int k) const
+        {
+        Shape S;
+        S.add(legId(KetLink,k),-1,link[k])
+         .add(legId(MPOLink,k),+1,mpo[k])
+         .add(legId(BraLink,k),+1,link[k]);
+        return S;
+        }
+
+    //Cost of the environment of sites 1,...,j from that of 1,...,j-1
+    Real
+    growLeft(int j, Counts& c) const
+        {
+        Shape E = contract(left(j-1),mps(j),c);
+        E = contract(E,op(j),c);
+        E = contract(E,mpsBra(j),c);
+        return E.size();
+        }
+
+    //Cost of the environment of sites j,...,N from that of j+1,...,N
+    Real
+    growRight(int j, Counts& c) const
+        {
+        Shape E = contract(right(j),mps(j),c);
+        E = contract(E,op(j),c);
+        E = contract(E,mpsBra(j),c);
+        return E.size();
+        }
+    };
+
+string
+showBytes(Real b)
+    {
+    if(b < 1E3) return str(format("%.0f B")%b);
+    if(b < 1E6) return str(format("%.1f kB")%(b/1E3));
+    if(b < 1E9) return str(format("%.1f MB")%(b/1E6));
+    if(b < 1E12) return str(format("%.2f GB")%(b/1E9));
+    return str(format("%.2f TB")%(b/1E12));
+    }
+
+string
+showTime(Real t)
+    {
+    if(t < 120) return str(format("%.2f s")%t);
+    if(t < 7200) return str(format("%.1f min")%(t/60));
+    if(t < 2*86400) return str(format("%.1f h")%(t/3600));
+    return str(format("%.1f days")%(t/86400));
+    }
+
+//QN of the site Index i (of either prime level)
+QN
+siteQN(const IQIndex& s, const Index& i)
+    {
+    Foreach(const inqn& x, s.iq())
+        if(x.index.noprime_equals(i)) return x.qn;
+    Error("DMRGCost: site Index not found");
+    return QN();
+    }
+
+//
+// Given the left-flowing quantum numbers of the sectors of
+// the left link of A, finds those of its right link.
+// Unprimed site indices add their quantum number, primed
+// ones subtract it. If A has no right link, sets last.
+//
+void
+propagateFlux(const IQTensor& A, const IQIndex& s,
+              map<Index,QN>& flux, QN& last)
+    {
+    map<Index,QN> next;
+    Foreach(const ITensor& t, A.blocks())
+        {
+        QN f;
+        Index r;
+        for(int k = 1; k <= t.r(); ++k)
+            {
+            const Index& i = t.index(k);
+            if(i.type() == Site)
+                {
+                const QN q = siteQN(s,i);
+                f += (i.primeLevel() == 0 ? q : -q);
+                }
+            else if(flux.count(i) != 0)
+                {
+                f += flux[i];
+                }
+            else
+                {
+                r = i;
+                }
+            }
+        if(r.isNull()) last = f;
+        else if(next.count(r) == 0) next[r] = f;
+        }
+    flux.swap(next);
+    }
+
+Sectors
+linkSectors(const IQIndex& l, const map<Index,QN>& flux)
+    {
+    QNReal dim;
+    Foreach(const inqn& x, l.iq())
+        {
+        map<Index,QN>::const_iterator it = flux.find(x.index);
+        //Sectors with no blocks don't matter
+        if(it != flux.end()) dim[it->second] += x.index.m();
+        }
+    return merge(dim);
+    }
+
+Sectors
+oneSector(int m, const QN& q = QN())
+    {
+    return Sectors(1,make_pair(q,m));
+    }
+
+//Link with sectors Sz = -nsec,...,nsec, each of dimension m
+IQIndex
+blockLink(const string& name, int nsec, int m)
+    {
+    vector<inqn> iq;
+    for(int q = -nsec; q <= nsec; ++q)
+        iq.push_back(inqn(Index(str(format("%s%+d")%name%q),m),QN(q)));
+    return IQIndex(name,iq,Out);
+    }
+
+IQIndex
+blockSite(const string& name)
+    {
+    Index u(name+"u",1,Site), d(name+"d",1,Site);
+    return IQIndex(name,u,QN(+1),d,QN(-1),Out);
+    }
+
+//All blocks of A(l,s,r) allowed by l.qn + s.qn == r.qn
+IQTensor
+blockTensor(const IQIndex& l, const IQIndex& s, const IQIndex& r)
+    {
+    IQTensor A(conj(l),s,r);
+    for(int i = 1; i <= l.nindex(); ++i)
+    for(int j = 1; j <= s.nindex(); ++j)
+    for(int k = 1; k <= r.nindex(); ++k)
+        {
+        if(l.qn(i) + s.qn(j) != r.qn(k)) continue;
+        ITensor t(l.index(i),s.index(j),r.index(k));
+        t.Randomize();
+        A += t;
+        }
+    return A;
+    }
+
+//Whether a and b share an Index of r
+bool
+shareSector(const ITensor& a, const ITensor& b, const IQIndex& r)
+    {
+    Foreach(const inqn& x, r.iq())
+        if(a.hasindex(x.index) && b.hasindex(x.index)) return true;
+    return false;
+    }
+
+} //namespace
+
+SweepCost::
+SweepCost()
+    :
+    sweep(0), maxm(0), m(0),
+    matvec_flops(0), svd_flops(0), env_flops(0),
+    block_pairs(0), bytes_moved(0), time(0),
+    mem(0), disk_mem(0), disk_bytes(0),
+    write(false)
+    { }
+
+MachineRates MachineRates::
+measure()
+    {
+    MachineRates r;
+    const Real tmin = 0.15;
+
+    //Dense product
+        {
+        const int n = 300;
+        Index i("i",n), j("j",n), k("k",n);
+        ITensor A(i,j), B(j,k);
+        A.Randomize();
+        B.Randomize();
+        int reps = 0;
+        const Real t0 = wallTime();
+        Real t = 0;
+        do { ITensor C = A*B; ++reps; t = wallTime()-t0; } while(t < tmin);
+        r.gemm = reps*2.*n*n*n/t;
+        }
+
+    //Dense SVD
+        {
+        const int n = 150;
+        Matrix M(n,n), U, V;
+        Vector d;
+        M.Randomize();
+        int reps = 0;
+        const Real t0 = wallTime();
+        Real t = 0;
+        do { SVD(M,U,d,V); ++reps; t = wallTime()-t0; } while(t < tmin);
+        r.svd = reps*svdFlops(n,n)/t;
+        }
+
+    //Overhead per pair of blocks of an IQTensor product
+    //with many small blocks
+        {
+        const int nsec = 20, m = 2;
+        IQIndex l1 = blockLink("l1",nsec,m),
+                l2 = blockLink("l2",nsec,m),
+                l3 = blockLink("l3",nsec,m);
+        IQTensor A = blockTensor(l1,blockSite("s"),l2),
+                 B = blockTensor(l2,blockSite("t"),l3);
+        Real pairs = 0, flops = 0;
+        Foreach(const ITensor& a, A.blocks())
+        Foreach(const ITensor& b, B.blocks())
+            if(shareSector(a,b,l2))
+                {
+                pairs += 1;
+                flops += 2.*a.vecSize()*b.vecSize()/m;
+                }
+        int reps = 0;
+        const Real t0 = wallTime();
+        Real t = 0;
+        do { IQTensor C = A*B; ++reps; t = wallTime()-t0; } while(t < tmin);
+        r.block = max(t/reps - flops/r.gemm,0.)/pairs;
+        }
+
+    return r;
+    }
+
+const MachineRates& MachineRates::
+measured()
+    {
+    static const MachineRates r = measure();
+    return r;
+    }
+
+std::ostream&
+operator<<(std::ostream& s, const MachineRates& r)
+    {
+    return s << format("products %.2f GFlop/s, SVD %.2f GFlop/s, %.2f us per block pair")
+                % (1E-9*r.gemm) % (1E-9*r.svd) % (1E6*r.block);
+    }
+
+DMRGCost::
+DMRGCost(const MPS& psi, const MPO& H, const Sweeps& sweeps,
+         const MachineRates& rates, const Option& opt1, const Option& opt2)
+    :
+    N_(psi.NN()),
+    rates_(rates)
+    {
+    init(opt1,opt2);
+    if(H.NN() != N_) Error("DMRGCost: psi and H have different sizes");
+
+    //Dense tensors: every index has a single sector
+    vector<Sectors> site(N_+1), link(N_+1), mpo(N_+1);
+    for(int j = 1; j <= N_; ++j)
+        site[j] = oneSector(psi.si(j).m());
+    link[0] = link[N_] = mpo[0] = mpo[N_] = oneSector(1);
+    for(int b = 1; b < N_; ++b)
+        {
+        link[b] = oneSector(psi.LinkInd(b).m());
+        mpo[b] = oneSector(H.LinkInd(b).m());
+        }
+
+    run(sweeps,QN(),site,link,mpo);
+    }
+
+DMRGCost::
+DMRGCost(const IQMPS& psi, const IQMPO& H, const Sweeps& sweeps,
+         const MachineRates& rates, const Option& opt1, const Option& opt2)
+    :
+    N_(psi.NN()),
+    rates_(rates)
+    {
+    init(opt1,opt2);
+    if(H.NN() != N_) Error("DMRGCost: psi and H have different sizes");
+
+    vector<Sectors> site(N_+1), link(N_+1), mpo(N_+1);
+    for(int j = 1; j <= N_; ++j)
+        {
+        QNReal dim;
+        Foreach(const inqn& x, psi.si(j).iq()) dim[x.qn] += x.index.m();
+        site[j] = merge(dim);
+        }
+
+    //The quantum numbers of the link sectors are found from
+    //the blocks of psi and H, so they don't depend on the
+    //arrow conventions of the links
+    QN total;
+    map<Index,QN> flux, hflux;
+    for(int j = 1; j <= N_; ++j)
+        {
+        QN unused;
+        propagateFlux(psi.AA(j),psi.si(j),flux,total);
+        propagateFlux(H.AA(j),psi.si(j),hflux,unused);
+        if(j == N_) break;
+        link[j] = linkSectors(psi.RightLinkInd(j),flux);
+        mpo[j] = linkSectors(H.RightLinkInd(j),hflux);
+        }
+    link[0] = mpo[0] = mpo[N_] = oneSector(1);
+    link[N_] = oneSector(1,total);
+
+    run(sweeps,total,site,link,mpo);
+    }
+
+void DMRGCost::
+init(const Option& opt1, const Option& opt2)
+    {
+    if(N_ < 2) Error("DMRGCost: need at least two sites");
+    OptionSet oset(opt1,opt2);
+    const Real phys = Real(sysconf(_SC_PHYS_PAGES))*Real(sysconf(_SC_PAGE_SIZE));
+    mem_limit_ = oset.realOrDefault("MaxMemory",phys);
+    write_m_ = 0;
+    }
+
+void DMRGCost::
+run(const Sweeps& sweeps, const QN& total,
+    const vector<Sectors>& site,
+    vector<Sectors> link,
+    const vector<Sectors>& mpo)
+    {
+    const int N = N_;
+    const OptionSet& gopts = Global::options();
+    const int window = gopts.intOrDefault("IOWindow",4);
+    const Real bytes = sizeof(Real);
+
+    Chain C(site,link,mpo);
+
+    //Elements of the environments, stored as LocalMPO does:
+    //sites 1..k at k, sites k+1..N at k+1
+    vector<Real> env(N+2,0);
+    vector<Real> mps(N+1,0);
+    for(int j = 1; j <= N; ++j) mps[j] = C.mps(j).size();
+
+    //Environments made by the first PH.position(1,psi)
+    Counts setup;
+    for(int k = N-1; k >= 2; --k)
+        env[k+1] = C.growRight(k+1,setup);
+
+    bool write = false;
+    sweep_.clear();
+    for(int sw = 1; sw <= sweeps.nsweep(); ++sw)
+        {
+        SweepCost S;
+        S.sweep = sw;
+        S.maxm = sweeps.maxm(sw);
+        const int niter = sweeps.niter(sw);
+        if(gopts.defined("WriteM") && S.maxm >= gopts.intVal("WriteM"))
+            write = true;
+        S.write = write;
+
+        Counts mv, sv, en;
+        if(sw == 1) en += setup;
+
+        for(int b = 1, ha = 1; ha != 3; sweepnext(b,ha,N))
+            {
+            //Davidson: the diagonal and niter products,
+            //and orthogonalizing the vectors it keeps
+            Counts prod;
+            Shape X = contract(C.phi(b),C.left(b-1),prod);
+            X = contract(X,C.op(b),prod);
+            X = contract(X,C.op(b+1),prod);
+            X = contract(X,C.right(b+1),prod);
+            const Real phisize = C.phi(b).size();
+            mv.flops += (niter+1)*prod.flops + (2.*niter*(niter+1)+4*niter)*phisize;
+            mv.pairs += (niter+1)*prod.pairs;
+            mv.bytes += (niter+1)*prod.bytes;
+            mv.peak = max(mv.peak,prod.peak);
+            const Real davidson = (2*niter+2)*phisize + prod.peak;
+
+            //SVD of each block of phi
+            QNReal rows, cols;
+            Foreach(const Sectors::value_type& a, link[b-1])
+            Foreach(const Sectors::value_type& s, site[b])
+                rows[a.first+s.first] += Real(a.second)*s.second;
+            Foreach(const Sectors::value_type& c, link[b+1])
+            Foreach(const Sectors::value_type& s, site[b+1])
+                cols[c.first-s.first] += Real(c.second)*s.second;
+            QNReal rank;
+            Real svdwork = 0;
+            for(QNReal::const_iterator r = rows.begin(); r != rows.end(); ++r)
+                {
+                QNReal::const_iterator c = cols.find(r->first);
+                if(c == cols.end()) continue;
+                const Real k = min(r->second,c->second);
+                rank[r->first] = k;
+                sv.flops += svdFlops(r->second,c->second);
+                sv.pairs += 1;
+                sv.bytes += bytes*(r->second*c->second + k*(r->second+c->second));
+                svdwork += r->second*c->second + k*(r->second+c->second);
+                }
+            sv.peak = max(sv.peak,svdwork);
+            link[b] = truncate(rank,S.maxm);
+            S.m = max(S.m,int(totalDim(link[b])));
+            mps[b] = C.mps(b).size();
+            mps[b+1] = C.mps(b+1).size();
+
+            //Environment needed by the next step
+            if(ha == 1 && b < N-1)
+                env[b] = C.growLeft(b,en);
+            else if(ha == 2 && b > 1)
+                env[b+1] = C.growRight(b+1,en);
+
+            Real envtot = 0, envmax = 0, mpstot = 0, mpsmax = 0;
+            for(int k = 0; k <= N+1; ++k)
+                {
+                envtot += env[k];
+                envmax = max(envmax,env[k]);
+                }
+            for(int j = 1; j <= N; ++j)
+                {
+                mpstot += mps[j];
+                mpsmax = max(mpsmax,mps[j]);
+                }
+            const Real work = max(davidson,svdwork);
+
+            S.mem = max(S.mem,bytes*(envtot + mpstot + work));
+            S.disk_mem = max(S.disk_mem,
+                bytes*(env[b-1] + env[b+2] + window*envmax
+                       + mps[b] + mps[b+1] + window*mpsmax + work));
+            S.disk_bytes = max(S.disk_bytes,bytes*(envtot+mpstot));
+            }
+
+        S.matvec_flops = mv.flops;
+        S.svd_flops = sv.flops;
+        S.env_flops = en.flops;
+        S.block_pairs = mv.pairs + en.pairs;
+        S.bytes_moved = mv.bytes + sv.bytes + en.bytes;
+        S.time = (mv.flops+en.flops)/rates_.gemm + sv.flops/rates_.svd
+                 + S.block_pairs*rates_.block;
+
+        if(write_m_ == 0 && S.mem > mem_limit_) write_m_ = S.maxm;
+
+        sweep_.push_back(S);
+        }
+
+    final_m_.assign(N,0);
+    for(int b = 1; b < N; ++b) final_m_[b] = int(totalDim(link[b]));
+    }
+
+Real DMRGCost::
+time() const
+    {
+    Real res = 0;
+    Foreach(const SweepCost& S, sweep_) res += S.time;
+    return res;
+    }
+
+Real DMRGCost::
+flops() const
+    {
+    Real res = 0;
+    Foreach(const SweepCost& S, sweep_) res += S.flops();
+    return res;
+    }
+
+Real DMRGCost::
+peakMemory() const
+    {
+    Real res = 0;
+    Foreach(const SweepCost& S, sweep_) res = max(res,S.peakMemory());
+    return res;
+    }
+
+bool DMRGCost::
+exceedsMemory() const
+    {
+    Foreach(const SweepCost& S, sweep_)
+        if(S.disk_mem > mem_limit_) return true;
+    return false;
+    }
+
+std::ostream&
+operator<<(std::ostream& s, const DMRGCost& c)
+    {
+    s << format("\nDMRG cost estimate for N = %d, %d sweeps\n") % c.NN() % c.sweeps().size();
+    s << "Machine: " << c.rates() << "\n";
+    s << format("%5s %6s %6s %10s %10s %10s %10s %11s %11s\n")
+         % "sweep" % "maxm" % "m" % "GFlop" % "svd GFlop" % "time"
+         % "memory" % "w/ WriteM" % "on disk";
+    Foreach(const SweepCost& S, c.sweeps())
+        {
+        s << format("%5d %6d %6d %10.2f %10.2f %10s %10s %11s %11s%s\n")
+             % S.sweep % S.maxm % S.m % (1E-9*S.flops()) % (1E-9*S.svd_flops)
+             % showTime(S.time) % showBytes(S.mem) % showBytes(S.disk_mem)
+             % showBytes(S.disk_bytes) % (S.write ? "  (writes)" : "");
+        }
+    s << format("Total: %s, %.1f GFlop, peak memory %s (limit %s)\n")
+         % showTime(c.time()) % (1E-9*c.flops())
+         % showBytes(c.peakMemory()) % showBytes(c.memoryLimit());
+    if(c.writeM() == 0)
+        s << "Fits in memory without WriteM\n";
+    else
+        s << format("Needs WriteM(%d) or less to fit in memory\n") % c.writeM();
+    if(c.exceedsMemory())
+        s << "Does not fit in memory even with WriteM\n";
+    return s;
+    }
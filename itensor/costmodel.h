@@ -0,0 +1,192 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_COSTMODEL_H
+#define __ITENSOR_COSTMODEL_H
+#include "mpo.h"
+#include "Sweeps.h"
+
+//
+// DMRGCost predicts the time and memory a (two-site)
+// DMRG run would take, without doing any numerics.
+//
+// It follows the sweeps of the run using only the block
+// structure of the tensors: the quantum number sectors of
+// each link and their dimensions. The sectors of the MPS
+// and MPO links are taken from psi and H; after each bond
+// is optimized, each sector of the new link gets the rank
+// of its block of the wavefunction, and if these add up
+// to more than maxm they are scaled down in proportion.
+// (The cutoff is not used, so the bond dimensions and
+// costs are upper bounds when the cutoff truncates more.)
+//
+// For every contraction of the Davidson matrix-vector
+// products and of the environment updates, and for every
+// SVD, it counts the floating point operations, the pairs
+// of blocks multiplied and the bytes of the tensors. Times
+// are estimated with rates measured on this machine
+// (see MachineRates).
+//
+// Memory is estimated with all environments in memory,
+// and with the environments and MPS kept on disk as done
+// when the WriteM option is reached. The first sweep
+// whose peak memory exceeds the limit (by default the
+// physical memory, or the MaxMemory option in bytes)
+// gives the maxm from which WriteM is needed.
+//
+// Usage:
+//
+//    DMRGCost cost(psi,H,sweeps);
+//    cout << cost;
+//
+// or dmrg(psi,H,sweeps,DryRun()), which prints the
+// estimate and returns without changing psi.
+//
+
+//
+// Speeds of this machine for the operations of DMRG.
+//
+struct MachineRates
+    {
+    Real gemm,  //flop/s of tensor products with large blocks
+         svd,   //flop/s of dense SVDs
+         block; //seconds of overhead per pair of blocks multiplied
+
+    MachineRates(Real gemm_ = 1E9, Real svd_ = 1E9, Real block_ = 1E-6)
+        : gemm(gemm_), svd(svd_), block(block_) { }
+
+    //Times dense products and SVDs, and an IQTensor
+    //product of many small blocks (about half a second)
+    static MachineRates
+    measure();
+
+    //Measured the first time it is called
+    static const MachineRates&
+    measured();
+    };
+
+std::ostream&
+operator<<(std::ostream& s, const MachineRates& r);
+
+//
+// Estimates for one sweep.
+//
+struct SweepCost
+    {
+    int sweep,
+        maxm,
+        m;              //largest bond dimension reached
+    Real matvec_flops,  //Davidson, including its vector operations
+         svd_flops,
+         env_flops,     //updates of the environments
+         block_pairs,   //pairs of blocks multiplied
+         bytes_moved,   //read and written by the contractions
+         time,          //seconds
+         mem,           //peak bytes, environments in memory
+         disk_mem,      //peak bytes, environments and MPS on disk
+         disk_bytes;    //largest size on disk, if written
+    bool write;         //whether the sweep writes to disk
+
+    SweepCost();
+
+    Real
+    flops() const { return matvec_flops + svd_flops + env_flops; }
+
+    //Peak bytes for the mode the sweep runs in
+    Real
+    peakMemory() const { return (write ? disk_mem : mem); }
+    };
+
+class DMRGCost
+    {
+    public:
+
+    //Recognized options: MaxMemory (bytes), and
+    //WriteM and IOWindow in Global::options()
+    DMRGCost(const MPS& psi, const MPO& H, const Sweeps& sweeps,
+             const MachineRates& rates = MachineRates::measured(),
+             const Option& opt1 = Option(), const Option& opt2 = Option());
+
+    DMRGCost(const IQMPS& psi, const IQMPO& H, const Sweeps& sweeps,
+             const MachineRates& rates = MachineRates::measured(),
+             const Option& opt1 = Option(), const Option& opt2 = Option());
+
+    int
+    NN() const { return N_; }
+
+    const std::vector<SweepCost>&
+    sweeps() const { return sweep_; }
+
+    const SweepCost&
+    sweep(int sw) const { return sweep_.at(sw-1); }
+
+    const MachineRates&
+    rates() const { return rates_; }
+
+    //Estimated seconds for the whole run
+    Real
+    time() const;
+
+    Real
+    flops() const;
+
+    Real
+    peakMemory() const;
+
+    //Bytes available (MaxMemory, or the physical memory)
+    Real
+    memoryLimit() const { return mem_limit_; }
+
+    //The maxm of the first sweep which does not fit in
+    //memoryLimit() unless written to disk, or 0 if every
+    //sweep fits
+    int
+    writeM() const { return write_m_; }
+
+    //Whether some sweep does not fit even when written to disk
+    bool
+    exceedsMemory() const;
+
+    //Bond dimensions after the last sweep,
+    //m(b) for b = 1,...,N-1
+    int
+    m(int b) const { return final_m_.at(b); }
+
+    typedef std::vector<std::pair<QN,int> >
+    Sectors;
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+
+    int N_;
+    MachineRates rates_;
+    Real mem_limit_;
+    int write_m_;
+    std::vector<SweepCost> sweep_;
+    std::vector<int> final_m_;
+
+    //
+    /////////////////
+
+    void
+    init(const Option& opt1, const Option& opt2);
+
+    //Sectors (labeled by the quantum number flowing
+    //in from the left end) of each site, MPS link
+    //and MPO link; links 0 and N are the ends
+    void
+    run(const Sweeps& sweeps, const QN& total,
+        const std::vector<Sectors>& site,
+        std::vector<Sectors> link,
+        const std::vector<Sectors>& mpo_link);
+
+    };
+
+std::ostream&
+operator<<(std::ostream& s, const DMRGCost& c);
+
+#endif
@@ -5,6 +5,8 @@
 #ifndef __ITENSOR_EIGENSOLVER_H
 #define __ITENSOR_EIGENSOLVER_H
 #include "iqcombiner.h"
+#include <limits>
+#include "boost/shared_ptr.hpp"
 
 template<class Tensor>
 void
@@ -98,6 +100,15 @@ class Eigensolver
             Real theta_;
         };
 
+    //Function object which applies the mapping
+    // f(x) = 1
+    class Unit
+        {
+        public:
+            Real
+            operator()(Real val) const { return 1; }
+        };
+
     //Function object which applies the mapping
     // f(x,theta) = 1/(theta - 1)
     class LanczosPrecond
@@ -153,13 +164,219 @@ Eigensolver(int maxiter, Real errgoal, int numget)
       debug_level_(-1)
     { }
 
+//
+// Holds groups of tensors with the same indices, each group
+// as the rows of one Matrix, each row storing the elements
+// of a tensor in a common order. Sums and overlaps of the
+// tensors of a group can then be done with single BLAS
+// matrix-vector products on a contiguous block.
+//
+// Rows are allocated as they are used, the storage of a 
+// group doubling (up to maxrows) when it runs out of room.
+// Tensors are written straight into their row.
+//
+// (For IQTensors, storing a tensor having blocks not seen 
+// before appends them to the common order and widens 
+// the rows used so far.)
+//
+template <class Tensor>
+class PackedTensors
+    {
+    public:
+
+    PackedTensors(const Tensor& ref, int ngroup, int maxrows);
+
+    //Number of elements of each tensor
+    int
+    vecSize() const { return size_; }
+
+    //Rows first through last of group g 
+    //as a Matrix with one tensor per column
+    MatrixRef
+    cols(int g, int first, int last) const 
+        { return group_.at(g).rows->Rows(first,last).t(); }
+
+    VectorRef
+    vec(int g, int j) const { return group_.at(g).rows->Row(j); }
+
+    //Row j of group g, to be written directly. j can be at 
+    //most one past the last row used. If the rows are
+    //widened later, the new elements of this row are fill.
+    VectorRef
+    row(int g, int j, Real fill = 0);
+
+    //Stores t in row j of group g (see row), setting
+    //the elements of blocks t doesn't have to fill
+    void
+    store(int g, int j, const Tensor& t, Real fill = 0);
+
+    //Tensor with elements v, valid until 
+    //the next call to tensor or store
+    const Tensor&
+    tensor(const VectorRef& v) const;
+
+    private:
+
+    struct Group
+        {
+        boost::shared_ptr<Matrix> rows;
+        std::vector<Real> fill; //one for each row used
+        };
+
+    void
+    extend(const Tensor& t);
+
+    //Zero tensor defining the order of the elements
+    Tensor zero_;
+    //Storage reused by tensor(v)
+    mutable Tensor work_;
+    int size_,
+        maxrows_;
+    std::vector<Group> group_;
+
+    };
+
+//
+// Helpers for PackedTensors
+//
+
+//True if every block of t has a place in the order of ref
+inline bool
+hasAllBlocks(const ITensor& ref, const ITensor& t) { return true; }
+
+inline bool
+hasAllBlocks(const IQTensor& ref, const IQTensor& t)
+    {
+    Foreach(const ITensor& b, t.blocks())
+        {
+        if(!ref.blocks().has_itensor(b.uniqueId())) return false;
+        }
+    return true;
+    }
+
+//Writes the elements of t into v in the order of ref,
+//with fill for the blocks of ref that t doesn't have
+inline void
+packInto(const ITensor& t, const ITensor& ref, VectorRef v, Real fill)
+    { 
+    t.assignToVec(v,ref); 
+    }
+
+inline void
+packInto(const IQTensor& t, const IQTensor& ref, VectorRef v, Real fill)
+    {
+    int off = 1;
+    Foreach(const ITensor& rb, ref.blocks())
+        {
+        const int d = rb.vecSize();
+        VectorRef seg = v.SubVector(off,off+d-1);
+        if(t.blocks().has_itensor(rb.uniqueId()))
+            t.blocks().get(rb.uniqueId()).assignToVec(seg,rb);
+        else
+            seg = fill;
+        off += d;
+        }
+    }
+
+template <class Tensor>
+PackedTensors<Tensor>::
+PackedTensors(const Tensor& ref, int ngroup, int maxrows)
+    : zero_(ref),
+      size_(ref.vecSize()),
+      maxrows_(maxrows),
+      group_(ngroup)
+    {
+    Vector z(size_);
+    z = 0;
+    zero_.assignFromVec(z);
+    work_ = zero_;
+    }
+
+template <class Tensor>
+VectorRef PackedTensors<Tensor>::
+row(int g, int j, Real fill)
+    {
+    Group& G = group_.at(g);
+    const int nused = G.fill.size();
+    if(j < 1 || j > nused+1)
+        Error("PackedTensors: rows must be used in order");
+
+    if(j <= nused)
+        {
+        G.fill[j-1] = fill;
+        return G.rows->Row(j);
+        }
+
+    const int ncap = (G.rows ? G.rows->Nrows() : 0);
+    if(j > ncap)
+        {
+        const int newcap = std::min(maxrows_,std::max(j,2*ncap));
+        if(j > newcap) 
+            Error("PackedTensors: more than maxrows rows used");
+        boost::shared_ptr<Matrix> bigger(new Matrix(newcap,size_));
+        if(nused > 0) 
+            bigger->Rows(1,nused) = G.rows->Rows(1,nused);
+        G.rows = bigger;
+        }
+    G.fill.push_back(fill);
+    return G.rows->Row(j);
+    }
+
+template <class Tensor>
+void PackedTensors<Tensor>::
+store(int g, int j, const Tensor& t, Real fill)
+    {
+    if(!hasAllBlocks(zero_,t)) extend(t);
+    packInto(t,zero_,row(g,j,fill),fill);
+    }
+
+template <class Tensor>
+const Tensor& PackedTensors<Tensor>::
+tensor(const VectorRef& v) const
+    {
+    work_.assignFromVec(v);
+    return work_;
+    }
+
+template <class Tensor>
+void PackedTensors<Tensor>::
+extend(const Tensor& t)
+    {
+    //The new blocks of t can go anywhere in the
+    //order of zero_, so each row used is moved
+    //block by block into the new order
+    Tensor old(zero_),
+           x(zero_);
+    x.assignFrom(t);
+    Vector z(x.vecSize());
+    z = 0;
+    x.assignFromVec(z);
+    zero_ = x;
+    work_ = zero_;
+    size_ = zero_.vecSize();
+
+    Foreach(Group& G, group_)
+        {
+        const int nused = G.fill.size();
+        if(nused == 0)
+            {
+            G.rows.reset();
+            continue;
+            }
+        boost::shared_ptr<Matrix> wider(new Matrix(G.rows->Nrows(),size_));
+        for(int j = 1; j <= nused; ++j)
+            {
+            old.assignFromVec(G.rows->Row(j));
+            packInto(old,zero_,wider->Row(j),G.fill[j-1]);
+            }
+        G.rows = wider;
+        }
+    }
+
 template <class LocalT, class Tensor> 
 inline Real Eigensolver::
 davidson(const LocalT& A, Tensor& phi) const
     {
-    typedef typename Tensor::SparseT
-    SparseT;
-
     phi *= 1.0/phi.norm();
 
     const int maxsize = A.size();
@@ -168,8 +385,15 @@ davidson(const LocalT& A, Tensor& phi) const
          last_lambda = lambda,
          qnorm = 1E30;
 
-    std::vector<Tensor> V(actual_maxiter+2),
-                       AV(actual_maxiter+2);
+    //Groups of P: the Krylov vectors V, the products
+    //AV = A*V and the diagonal of A (used in the 
+    //preconditioner), which is NaN where A.diag
+    //leaves it undefined
+    const int basis = 0,
+              products = 1,
+              diagonal = 2;
+    const Real undefined = std::numeric_limits<Real>::quiet_NaN();
+    PackedTensors<Tensor> P(phi,3,actual_maxiter+1);
 
     //Storage for Matrix that gets diagonalized 
     Matrix M(actual_maxiter+2,actual_maxiter+2);
@@ -177,28 +401,36 @@ davidson(const LocalT& A, Tensor& phi) const
     MatrixRef Mref(M.SubMatrix(1, 1, 1, 1));
 
     //Get diagonal of A to use later
+    {
     Tensor Adiag(phi);
     A.diag(Adiag);
+    P.store(diagonal,1,Adiag,undefined);
+    }
+
+    Vector phivec, q, Vd;
+    bool phi_changed = false;
 
     int iter = 1;
     for(int ii = 1; ii <= actual_maxiter; ++ii)
         {
         //Diagonalize conj(V)*A*V
         //and compute the residual q
-        Tensor q;
         if(ii == 1)
             {
-            V[1] = phi;
-            A.product(V[1],AV[1]);
+            P.store(basis,1,phi);
+            {
+            Tensor AV;
+            A.product(phi,AV);
+            P.store(products,1,AV);
+            }
 
             //No need to diagonalize
-            lambda = Dot(conj(V[1]),AV[1]);
+            lambda = P.vec(basis,1) * P.vec(products,1);
             Mref = lambda;
 
             //Calculate residual q
-            q = V[1];
-            q *= -lambda;
-            q += AV[1]; 
+            q = P.vec(products,1);
+            q += (-lambda)*P.vec(basis,1);
             }
         else // ii != 1
             {
@@ -213,55 +445,29 @@ davidson(const LocalT& A, Tensor& phi) const
             //Compute corresponding eigenvector
             //phi of A from the min evec of M
             //(and start calculating residual q)
-            phi = U(1,1)*V[1];
-            q   = U(1,1)*AV[1];
-            for(int k = 2; k <= ii; ++k)
-                {
-                phi += U(k,1)*V[k];
-                q   += U(k,1)*AV[k];
-                }
+            const VectorRef u1 = U.Column(1);
+            phivec = P.cols(basis,1,ii) * u1;
+            q = P.cols(products,1,ii) * u1;
 
             //Calculate residual q
-            q += (-lambda)*phi;
+            q += (-lambda)*phivec;
 
             if(U(1,1) < 0)
                 {
-                phi *= -1;
+                phivec *= -1;
                 q *= -1;
                 }
+            phi_changed = true;
             }
 
         //Check convergence
-        qnorm = q.norm();
+        qnorm = Norm(q);
         if( (qnorm < errgoal_ && fabs(lambda-last_lambda) < errgoal_) 
             || qnorm < max(1E-12,errgoal_ * 1.0e-3) )
             {
             break; //Out of ii loop to return
             }
 
-        /*
-        if(debug_level_ >= 1 && qnorm > 3)
-            {
-            std::cerr << "Large qnorm = " << qnorm << "\n";
-            Print(Mref);
-            Vector D;
-            Matrix U;
-            EigenValues(Mref,D,U);
-            Print(D);
-
-            std::cerr << "ii = " << ii  << "\n";
-            Matrix Vorth(ii,ii);
-            for(int i = 1; i <= ii; ++i)
-            for(int j = i; j <= ii; ++j)
-                {
-                Vorth(i,j) = Dot(conj(V[i]),V[j]);
-                Vorth(j,i) = Vorth(i,j);
-                }
-            Print(Vorth);
-            exit(0);
-            }
-        */
-
         if(debug_level_ > 1 || (ii == 1 && debug_level_ > 0))
             {
             std::cout << boost::format("I %d q %.0E E %.10f")
@@ -274,28 +480,24 @@ davidson(const LocalT& A, Tensor& phi) const
         //Apply Davidson preconditioner
         {
         DavidsonPrecond dp(lambda);
-        Tensor cond(Adiag);
-        cond.mapElems(dp);
-        q /= cond;
+        const VectorRef diag = P.vec(diagonal,1);
+        for(int k = 1; k <= q.Length(); ++k)
+            {
+            const Real dk = diag(k);
+            q(k) *= (dk != dk ? 0 : dp(dk));
+            }
         }
 
         //Do Gram-Schmidt on d
         //to include it in the subbasis
-        Tensor& d = V[ii+1];
+        VectorRef d = P.row(basis,ii+1);
         d = q;
-        Vector Vd(ii);
         for(int pass = 1; pass <= 2; ++pass)
             {
-            for(int k = 1; k <= ii; ++k)
-                Vd(k) = Dot(conj(V[k]),d);
-
-            Tensor proj = Vd(1)*V[1];
-            for(int k = 2; k <= ii; ++k)
-                proj += Vd(k)*V[k];
-            proj *= -1;
-
-            d += proj;
-            d *= 1./(d.norm()+1E-33);
+            Vd = P.cols(basis,1,ii).t() * d;
+            q = P.cols(basis,1,ii) * Vd;
+            d -= q;
+            d *= 1./(Norm(d)+1E-33);
             }
 
         last_lambda = lambda;
@@ -304,15 +506,16 @@ davidson(const LocalT& A, Tensor& phi) const
         //for next step
         if(ii < actual_maxiter)
             {
-            A.product(d,AV[ii+1]);
+            {
+            Tensor AV;
+            A.product(P.tensor(d),AV);
+            //May repack P (invalidating d)
+            P.store(products,ii+1,AV);
+            }
 
             //Add new row and column to M
             Mref << M.SubMatrix(1,ii+1,1,ii+1);
-            Vector newCol(ii+1);
-            for(int k = 1; k <= ii+1; ++k)
-                {
-                newCol(k) = Dot(conj(V[k]),AV[ii+1]);
-                }
+            Vector newCol = P.cols(basis,1,ii+1).t() * P.vec(products,ii+1);
             Mref.Column(ii+1) = newCol;
             Mref.Row(ii+1) = newCol;
             }
@@ -321,6 +524,10 @@ davidson(const LocalT& A, Tensor& phi) const
 
         } //for(ii)
 
+    //P is only repacked after phivec 
+    //is computed if the loop continues
+    if(phi_changed) phi = P.tensor(phivec);
+
     if(debug_level_ > 0)
         {
         std::cout << boost::format("I %d q %.0E E %.10f")
@@ -20,6 +20,8 @@
 
 using namespace std::rel_ops;
 
+//Number of indices an ITensor stores without using the heap
+//(higher ranks are allowed, see SmallArray)
 static const int NMAX = 8;
 static const Real MIN_CUT = 1E-20;
 static const int MAX_M = 5000;
@@ -286,6 +288,23 @@ class Global
         static bool checkArrows_ = true;
         return checkArrows_;
         }
+    //IQTensor contractions with at least this many
+    //block products run on ThreadPool::global()
+    static int&
+    parallelBlockThreshold()
+        {
+        static int parallelBlockThreshold_ = 16;
+        return parallelBlockThreshold_;
+        }
+    //Block products of IQTensor contractions with at
+    //most this many multiply-adds are done by direct
+    //loops instead of a matrix multiplication (0 never)
+    static int&
+    smallProductSize()
+        {
+        static int smallProductSize_ = 512;
+        return smallProductSize_;
+        }
     static OptionSet&
     options()
         {
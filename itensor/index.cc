@@ -3,6 +3,7 @@
 //    (See accompanying LICENSE file.)
 //
 #include "index.h"
+#include "boost/thread/mutex.hpp"
 
 using namespace std;
 using boost::format;
@@ -101,20 +102,6 @@ operator<<(std::ostream& s, const UniqueID& uid)
     return s; 
     }
 
-int 
-prime_number(int n)
-    {
-    static const boost::array<int,54> plist = { { 
-    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 
-    37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 
-    79, 83, 89, 97, 101, 103, 107, 109, 113, 
-    127, 131, 137, 139, 149, 151, 157, 163, 
-    167, 173, 179, 181, 191, 193, 197, 199, 
-    211, 223, 227, 229, 233, 239, 241, 251 
-    } };
-    return plist.at(n);
-    }
-
 void 
 intrusive_ptr_add_ref(IndexDat* p) 
     { 
@@ -130,11 +117,15 @@ intrusive_ptr_release(IndexDat* p)
         } 
     }
 
-const UniqueID& IndexDat::
+UniqueID IndexDat::
 nextID()
     {
+    static boost::mutex mutex_;
     static UniqueID lastID_;
     static int count_ = 0;
+    //Indices may be created from several
+    //threads, so return a copy made under the lock
+    boost::mutex::scoped_lock lock(mutex_);
     //After making so many ID's sequentially,
     //call the random number generator again
     if(++count_ > 1000)
@@ -146,16 +137,18 @@ nextID()
     }
 
 void IndexDat::
-setUniqueReal()
+setUniqueId()
     {
-    //ur = sin(ind * sqrt(1.0/7.0) + ((int)_type - (int)Site) * sqrt(1.0 / 13.0));
-    Real arg = 0;
-    int pn = 1;
-    for(int i = int(ind.size())-1; i >= 0; --i)
-        { arg += ind.data[i]*sqrt(1.0/(prime_number(++pn))); }
-    arg *= sqrt(1.0/(prime_number(++pn)));
-    arg += ((int)_type - (int)Site) * sqrt(1.0/(prime_number(++pn)));
-    ur = sin(arg);
+    //Fold the two halves of the uuid together
+    //with the type (uuids are made sequentially
+    //so the mixing matters)
+    IndexKey hi = 0, lo = 0;
+    for(int i = 0; i < 8; ++i)
+        {
+        hi = (hi << 8) | ind.data[i];
+        lo = (lo << 8) | ind.data[8+i];
+        }
+    id = mixKey(mixKey(hi + IndexKey((int)_type - (int)Site)) ^ lo);
     }
 
 IndexDat::
@@ -169,7 +162,7 @@ IndexDat(const std::string& name, int mm,IndexType it)
     { 
     if(it == ReIm) Error("Not allowed to create Index with type ReIm");
     if(it == Any) Error("Not allowed to create Index with type Any");
-    setUniqueReal();
+    setUniqueId();
     }
 
 IndexDat::
@@ -183,7 +176,7 @@ IndexDat(const std::string& ss, int mm, IndexType it, const boost::uuids::uuid&
     { 
     if(it == ReIm) Error("Not allowed to create Index with type ReIm");
     if(it == Any) Error("Not allowed to create Index with type Any");
-    setUniqueReal();
+    setUniqueId();
     }
 
 IndexDat::
@@ -205,13 +198,13 @@ IndexDat(Index::Imaker im)
         {
         sname = "Null";
         _type = Site;
-        ur = 0.0;
+        id = 0;
         return;
         }
     else if(im == Index::makeReIm) sname = "ReIm";
     else if(im == Index::makeReImP) sname = "ReImP";
     else if(im == Index::makeReImPP) sname = "ReImPP";
-    setUniqueReal(); 
+    setUniqueId(); 
     }
 
 IndexDat* IndexDat::
@@ -302,8 +295,12 @@ setname(const std::string& newname) { p->sname = newname; }
 std::string Index::
 showm() const { return (boost::format("m=%d")%(p->m_)).str(); }
 
-Real Index::
-uniqueReal() const { return p->ur*(1+0.00398406*primelevel_); }
+IndexKey Index::
+uniqueId() const 
+    { 
+    if(primelevel_ == 0) return p->id;
+    return mixKey(p->id + primelevel_*0x9e3779b97f4a7c15ULL); 
+    }
 
 bool Index::
 isNull() const { return (p == IndexDat::Null()); }
@@ -323,18 +320,18 @@ primeLevel(int plev) { primelevel_ = plev; }
 bool Index::
 operator==(const Index& other) const 
     { 
-    return (p->ur == other.p->ur && primelevel_ == other.primelevel_); 
+    return (p->id == other.p->id && primelevel_ == other.primelevel_); 
     }
 
 bool Index::
 noprime_equals(const Index& other) const
     { 
-    return (p->ur == other.p->ur); 
+    return (p->id == other.p->id); 
     }
 
 bool Index::
 operator<(const Index& other) const 
-    { return (uniqueReal() < other.uniqueReal()); }
+    { return (uniqueId() < other.uniqueId()); }
 
 IndexVal Index::
 operator()(int i) const 
@@ -7,9 +7,11 @@
 #include <string>
 #include "global.h"
 #include "boost/intrusive_ptr.hpp"
+#include "boost/smart_ptr/detail/atomic_count.hpp"
 #include "boost/uuid/uuid.hpp"
 #include "boost/uuid/random_generator.hpp"
 #include "boost/uuid/string_generator.hpp"
+#include "boost/cstdint.hpp"
 
 #define Cout std::cout
 #define Endl std::endl
@@ -23,6 +25,25 @@ struct UniqueID;
 class IndexDat;
 struct IndexVal;
 
+//
+// 64-bit integer identifying an Index at a given
+// prime level. The key of a set of indices is the
+// sum (modulo 2^64) of their keys, so it does not
+// depend on the order of the indices.
+//
+typedef boost::uint64_t
+IndexKey;
+
+//Scrambles the bits of x (the splitmix64 finalizer)
+inline IndexKey
+mixKey(IndexKey x)
+    {
+    x ^= (x >> 30); x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= (x >> 27); x *= 0x94d049bb133111ebULL;
+    x ^= (x >> 31);
+    return x;
+    }
+
 
 //
 // Index
@@ -90,10 +111,11 @@ class Index
     std::string 
     showm() const;
 
-    // Returns a unique Real number identifying this Index.
-    // Useful for rapidly checking that two Index instances match.
-    Real 
-    uniqueReal() const;
+    // Returns a unique integer key identifying this Index
+    // and its prime level. Useful for rapidly checking 
+    // that two Index instances match.
+    IndexKey 
+    uniqueId() const;
 
     // Returns true if Index was default initialized.
     bool 
@@ -292,14 +314,14 @@ class IndexDat
     IndexType _type;
     boost::uuids::uuid ind;
     int m_;
-    Real ur;
+    IndexKey id;
     std::string sname;
 
     //
     //////////////
 
     void 
-    setUniqueReal();
+    setUniqueId();
 
     IndexDat(const std::string& name="", int mm = 1,IndexType it=Link);
 
@@ -334,7 +356,7 @@ class IndexDat
     //
     // (Private) Data Members
     
-    mutable unsigned int numref;
+    mutable boost::detail::atomic_count numref;
 
     const bool is_static_;
 
@@ -344,7 +366,7 @@ class IndexDat
     explicit
     IndexDat(Index::Imaker im);
 
-    static const UniqueID& 
+    static UniqueID 
     nextID();
 
     //These constructors are not implemented
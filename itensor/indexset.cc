@@ -12,7 +12,7 @@ IndexSet()
     :
     rn_(0),
     r_(0),
-    ur_(0)
+    key_(0)
     { }
 
 IndexSet::
@@ -20,7 +20,7 @@ IndexSet(const Index& i1)
     :
     rn_((i1.m() == 1 ? 0 : 1)),
     r_(1),
-    ur_(i1.uniqueReal())
+    key_(i1.uniqueId())
     { 
 #ifdef DEBUG
     if(i1 == Index::Null())
@@ -33,7 +33,7 @@ IndexSet::
 IndexSet(const Index& i1, const Index& i2)
     :
     r_(2),
-    ur_(i1.uniqueReal() + i2.uniqueReal())
+    key_(i1.uniqueId() + i2.uniqueId())
     { 
 #ifdef DEBUG
     if(i1 == Index::Null())
@@ -74,14 +74,16 @@ IndexSet(Index i1, Index i2, Index i3,
 	while(ii[r_] != Index::Null()) ++r_;
     int alloc_size;
     sortIndices(ii,r_,rn_,alloc_size,index_,0);
+    setUniqueId();
     }
 
 IndexSet::
 IndexSet(const IndexSet& other, const Permutation& P)
     :
+    index_(other.index_.size()),
     rn_(other.rn_),
     r_(other.r_),
-    ur_(other.ur_)
+    key_(other.key_)
     {
     for(int j = 1; j <= r_; ++j)
         index_[P.dest(j)] = other.index_[j];
@@ -168,6 +170,14 @@ hasindex1(const Index& I) const
 
 bool IndexSet::
 hasAllIndex(const array<Index,NMAX+1>& I, int nind) const
+    {
+    IndexArray inds(I.size());
+    std::copy(I.begin(),I.end(),inds.begin());
+    return hasAllIndex(inds,nind);
+    }
+
+bool IndexSet::
+hasAllIndex(const IndexArray& I, int nind) const
     {
     for(int n = 1; n <= nind; ++n)
         {
@@ -201,6 +211,7 @@ hasAllIndex(const array<Index,NMAX+1>& I, int nind) const
 void IndexSet::
 getperm(const boost::array<Index,NMAX+1>& ind, Permutation& P) const
 	{
+    if(r_ > NMAX) Error("IndexSet::getperm: use the IndexSet version for rank > NMAX");
 	for(int j = 1; j <= r_; ++j)
 	    {
 	    bool got_one = false;
@@ -223,7 +234,19 @@ getperm(const boost::array<Index,NMAX+1>& ind, Permutation& P) const
 void IndexSet::
 getperm(const IndexSet& other, Permutation& P) const
     {
-    getperm(other.index_,P);
+	for(int j = 1; j <= r_; ++j)
+	    {
+	    bool got_one = false;
+	    for(int k = 1; k <= r_; ++k)
+            if(other.index_[j] == index_[k])
+                { P.from_to(j,k); got_one = true; break; }
+	    if(!got_one)
+            {
+            Print(*this); 
+            Print(other);
+            Error("IndexSet::getperm: no matching index");
+            }
+	    }
     }
 
 
@@ -254,45 +277,45 @@ maxM() const
 void IndexSet::
 noprime(PrimeType p)
     {
-    ur_ = 0;
+    key_ = 0;
     for(int j = 1; j <= r_; ++j) 
         {
         Index& J = index_[j];
         J.noprime(p);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 #ifdef SET_UR
-        setUniqueReal();
+        setUniqueId();
 #endif
 	}
 
 void IndexSet::
 doprime(PrimeType pt, int inc)
 	{
-    ur_ = 0;
+    key_ = 0;
     for(int j = 1; j <= r_; ++j) 
         {
         Index& J = index_[j];
         J.doprime(pt,inc);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 #ifdef SET_UR
-        setUniqueReal();
+        setUniqueId();
 #endif
 	}
 
 void IndexSet::
 mapprime(int plevold, int plevnew, PrimeType pt)
 	{
-    ur_ = 0;
+    key_ = 0;
     for(int j = 1; j <= r_; ++j) 
         {
         Index& J = index_[j];
         J.mapprime(plevold,plevnew,pt);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 #ifdef SET_UR
-        setUniqueReal();
+        setUniqueId();
 #endif
 	}
 
@@ -303,10 +326,10 @@ mapprimeind(const Index& I, int plevold, int plevnew, PrimeType pt)
         if(index_[j] == I)
         {
         index_[j].mapprime(plevold,plevnew,pt);
-        ur_ -= I.uniqueReal();
-        ur_ += index_[j].uniqueReal();
+        key_ -= I.uniqueId();
+        key_ += index_[j].uniqueId();
 #ifdef SET_UR
-        setUniqueReal();
+        setUniqueId();
 #endif
         return;
         }
@@ -350,8 +373,8 @@ mapindex(const Index& i1, const Index& i2)
 	    if(index_[j] == i1) 
 		{
 		index_[j] = i2;
-        ur_ -= i1.uniqueReal();
-        ur_ += i2.uniqueReal();
+        key_ -= i1.uniqueId();
+        key_ += i2.uniqueId();
 		return;
 		}
 	Print(i1);
@@ -365,6 +388,7 @@ addindex(const Index& I)
     if(I == Index::Null())
         Error("Index is null");
 #endif
+    index_.grow(r_+2);
     if(I.m() == 1)
         {
         index_[++r_] = I;
@@ -378,7 +402,7 @@ addindex(const Index& I)
         index_[++rn_] = I;
         ++r_;
         }
-    ur_ += I.uniqueReal();
+    key_ += I.uniqueId();
     }
 
 void IndexSet::
@@ -388,11 +412,12 @@ addindexn(const array<Index,NMAX+1>& indices, int n)
     if(r_ != rn_)
         Error("Adding m != 1 Index will overwrite m == 1 Index.");
 #endif
+    index_.grow(rn_+n+1);
     for(int j = 1; j <= n; ++j)
         {
         const Index& J = indices[j];
         index_[++rn_] = J;
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
     r_ += n;
     }
@@ -404,40 +429,35 @@ addindexn(const Index& I)
     if(r_ != rn_)
         Error("Adding m != 1 Index will overwrite m == 1 Index.");
 #endif
+    index_.grow(rn_+2);
     index_[++rn_] = I;
-    ur_ += I.uniqueReal();
+    key_ += I.uniqueId();
     ++r_;
     }
 
 void IndexSet::
 addindex1(const array<Index,NMAX+1>& indices, int n) 
     {
+    index_.grow(r_+n+1);
     for(int j = 1; j <= n; ++j)
         {
         const Index& J = indices[j];
         index_[++r_] = J;
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
     }
 
 void IndexSet::
 addindex1(const std::vector<Index>& indices) 
     { 
-#ifdef DEBUG
-    if((r_+(int)indices.size()) > NMAX)
-        {
-        Print(*this);
-        Print(indices.size());
-        Error("Too many indices added");
-        }
-#endif
+    index_.grow(r_+indices.size()+1);
     for(size_t j = 0; j < indices.size(); ++j)
         { 
         assert(indices[j].m() == 1);
         assert(!hasindex1(indices[j]));
 
         index_[++r_] = indices[j]; 
-        ur_ += indices[j].uniqueReal();
+        key_ += indices[j].uniqueId();
         }
     }
 
@@ -456,10 +476,10 @@ addindex1(const Index& I)
         Print(I);
         Error("Adding Index twice");
         }
-    if(r_ == NMAX) Error("Maximum number of indices reached");
 #endif
+    index_.grow(r_+2);
     index_[++r_] = I;
-    ur_ += I.uniqueReal();
+    key_ += I.uniqueId();
     }
 
 void IndexSet::
@@ -467,18 +487,18 @@ removeindex1(int j)
     { 
     assert(j <= r_);
     assert(j > rn_);
-    ur_ -= index_[j].uniqueReal();
+    key_ -= index_[j].uniqueId();
     for(int k = j; k < r_; ++k) 
         index_[k] = index_[k+1];
     --r_;
     }
 
 void IndexSet::
-setUniqueReal()
+setUniqueId()
 	{
-    ur_ = 0;
+    key_ = 0;
     for(int j = 1; j <= r_; ++j)
-        ur_ += index_[j].uniqueReal();
+        key_ += index_[j].uniqueId();
 	}
 
 void IndexSet::
@@ -494,9 +514,9 @@ swap(IndexSet& other)
     rn_ = other.rn_;
     other.rn_ = si;
 
-    Real sr = ur_;
-    ur_ = other.ur_;
-    other.ur_ = sr;
+    IndexKey sk = key_;
+    key_ = other.key_;
+    other.key_ = sk;
     }
 
 void IndexSet::
@@ -504,7 +524,7 @@ clear()
     {
     rn_ = 0;
     r_ = 0;
-    ur_ = 0;
+    key_ = 0;
     }
 
 std::ostream&
@@ -522,11 +542,12 @@ read(std::istream& s)
     {
     s.read((char*) &r_,sizeof(r_));
     s.read((char*) &rn_,sizeof(rn_));
-    ur_ = 0;
+    index_.grow(r_+1);
+    key_ = 0;
     for(int j = 1; j <= r_; ++j) 
         {
         index_[j].read(s);
-        ur_ += index_[j].uniqueReal();
+        key_ += index_[j].uniqueId();
         }
     }
 
@@ -7,6 +7,11 @@
 #include "index.h"
 #include "permutation.h"
 
+//Storage for the Indices of an IndexSet, indexed from 1
+//(element 0 unused); only ranks above NMAX use the heap
+typedef SmallArray<Index,NMAX+1>
+IndexArray;
+
 //
 // IndexSet
 //
@@ -49,7 +54,7 @@ class IndexSet
     int
     m(int j) const { return GET(index_,j).m(); }
 
-    typedef boost::array<Index,NMAX+1>::const_iterator 
+    typedef IndexArray::const_iterator 
     index_it;
 
     //Can be used for iteration over Indices in a Foreach loop
@@ -58,8 +63,8 @@ class IndexSet
     index() const  
         { return std::make_pair(index_.begin()+1,index_.begin()+r_+1); }
 
-    Real
-    uniqueReal() const { return ur_; }
+    IndexKey
+    uniqueId() const { return key_; }
 
     //
     // Index Analysis
@@ -92,6 +97,9 @@ class IndexSet
     bool 
     hasindex1(const Index& I) const;
 
+    bool
+    hasAllIndex(const IndexArray& I, int nind) const;
+
     bool
     hasAllIndex(const boost::array<Index,NMAX+1>& I, int nind) const;
 
@@ -183,7 +191,7 @@ class IndexSet
         { removeindex1(findindex1(I)); }
 
     void
-    setUniqueReal();
+    setUniqueId();
 
     void
     swap(IndexSet& other);
@@ -209,12 +217,12 @@ class IndexSet
     // Data Members
     //
 
-    boost::array<Index,NMAX+1> index_;
+    IndexArray index_;
 
     int rn_,
         r_;
 
-    Real ur_;
+    IndexKey key_;
 
     //
     /////////
@@ -228,22 +236,22 @@ IndexSet(const Iterable& ii, int size, int& alloc_size, int offset)
     r_(size)
     { 
     sortIndices(ii,size,rn_,alloc_size,index_,offset);
-    setUniqueReal();
+    setUniqueId();
     }
 
 
 template<class Iterable>
 void
 sortIndices(const Iterable& I, int ninds, int& rn_, int& alloc_size, 
-            boost::array<Index,NMAX+1>& index_, int offset = 0)
+            IndexArray& index_, int offset = 0)
     {
-    assert(ninds <= NMAX);
+    index_.grow(ninds+1);
 
     rn_ = 0;
     alloc_size = 1;
 
     int r1_ = 0;
-    boost::array<const Index*,NMAX+1> index1_;
+    SmallArray<const Index*,NMAX+1> index1_(ninds+1);
 
     for(int n = offset; n < ninds+offset; ++n)
         {
@@ -111,15 +111,25 @@ class IQCombiner
     mutable IQIndex ucright_;
     bool do_condense;
 
+    //Keys of the Index's of the left IQIndex's, and
+    //the position in combs of the Combiner for each
+    //sum of left keys and for each right Index
+    mutable boost::unordered_set<IndexKey> leftinds_;
+    mutable boost::unordered_map<IndexKey,int> leftpos_, 
+                                               rightpos_;
+
     //
     /////////////
 
-    typedef std::map<ApproxReal, Combiner>::iterator
+    typedef boost::unordered_map<IndexKey, Combiner>::iterator
     setcomb_it;
 
     typedef std::map<Index, Combiner>::iterator
     rightcomb_it;
 
+    void
+    setPositions() const;
+
     };
 
 class QCounter
@@ -266,6 +276,7 @@ init(std::string rname, IndexType type,
         { rdir = dir; }
 
     //Construct individual Combiners
+    combs.clear();
     QCounter c(left_);
     std::vector<inqn> iq;
     for( ; c.notdone(); ++c)
@@ -293,9 +304,28 @@ init(std::string rname, IndexType type,
         {
         right_ = IQIndex(rname,iq,rdir,primelevel);
         }
+    setPositions();
     initted = true;
 	}
 
+inline
+void IQCombiner::
+setPositions() const
+    {
+    leftinds_.clear();
+    Foreach(const IQIndex& L, left_)
+        Foreach(const inqn& x, L.iq())
+            leftinds_.insert(x.index.uniqueId());
+
+    leftpos_.clear();
+    rightpos_.clear();
+    for(size_t n = 0; n < combs.size(); ++n)
+        {
+        leftpos_[combs[n].uniqueId()] = n;
+        rightpos_[combs[n].right().uniqueId()] = n;
+        }
+    }
+
 inline IQCombiner::
 operator IQTensor() const
     {
@@ -375,6 +405,7 @@ doprime(PrimeType pr, int inc)
             cond.doprime(pr,inc);
             ucright_.doprime(pr,inc);
             }
+        setPositions();
         }
     }
 
@@ -451,19 +482,15 @@ product(IQTensor T, IQTensor& res) const
 
         res = IQTensor(iqinds);
 
-        std::map<Index, const Combiner*> rightcomb;
-        Foreach(const Combiner& co, combs)
-            {
-            rightcomb[co.right()] = &co;
-            }
-
         Foreach(const ITensor& tt, T_.itensors())
             {
             for(int k = 1; k <= tt.r(); ++k)
                 {
-                if(r.hasindex(tt.index(k)))
+                boost::unordered_map<IndexKey,int>::const_iterator
+                it = rightpos_.find(tt.index(k).uniqueId());
+                if(it != rightpos_.end())
                     { 
-                    res += (*(rightcomb[tt.index(k)]) * tt); 
+                    res += (combs[it->second] * tt); 
                     break;
                     }
                 } //end for
@@ -516,26 +543,21 @@ product(IQTensor T, IQTensor& res) const
                 }
             }
 
-        //Create map of Combiners using uniqueReal as key
-        std::map<ApproxReal, const Combiner*> combmap;
-        Foreach(const Combiner& co, combs)
-            {
-            combmap[co.uniqueReal()] = &co;
-            }
-
         //Loop over each block in T and apply appropriate
-        //Combiner (determined by the uniqueReal of the 
+        //Combiner (determined by the uniqueId of the 
         //combined Indices)
         Foreach(const ITensor& t, T.blocks())
             {
-            Real block_ur = 0;
+            IndexKey block_key = 0;
             for(int k = 1; k <= t.r(); ++k)
                 {
-                if(this->hasindex(t.index(k))) 
-                    block_ur += t.index(k).uniqueReal();
+                const IndexKey key = t.index(k).uniqueId();
+                if(leftinds_.count(key)) block_key += key;
                 }
 
-            if(combmap.count(block_ur) == 0)
+            boost::unordered_map<IndexKey,int>::const_iterator
+            it = leftpos_.find(block_key);
+            if(it == leftpos_.end())
                 {
                 Print(t);
                 std::cerr << "\nleft indices \n";
@@ -543,18 +565,15 @@ product(IQTensor T, IQTensor& res) const
                     { std::cerr << j << " " << left_[j] << "\n"; }
                 std::cerr << "\n\n";
 
-                typedef std::map<ApproxReal, const Combiner*>::const_iterator
-                combmap_const_it;
-                for(combmap_const_it uu = combmap.begin();
-                    uu != combmap.end(); ++uu)
+                Foreach(const Combiner& co, combs)
                     {
                     std::cout << "Combiner: " << std::endl;
-                    std::cout << *(uu->second) << std::endl;
+                    std::cout << co << std::endl;
                     }
-                Error("no combmap entry for block_ur in IQCombiner prod");
+                Error("no combmap entry for block_key in IQCombiner prod");
                 }
 
-            res += (*combmap[block_ur] * t);
+            res += (combs[it->second] * t);
             }
 
         if(do_condense) 
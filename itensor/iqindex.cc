@@ -215,7 +215,6 @@ read(std::istream& s)
     iq_.resize(size);
     for(iq_it x = iq_.begin(); x != iq_.end(); ++x)
         { x->read(s); }
-    numref = 0;
     }
 
 IQIndexDat* IQIndexDat::
@@ -437,6 +436,22 @@ IQIndex(const Index& other,
     index_.primeLevel(i1.primeLevel());
     }
 
+IQIndex::
+IQIndex(const Index& other, 
+        std::vector<inqn>& ind_qn, 
+        Arrow dir) 
+    : 
+    index_(other),
+    _dir(dir), 
+    pd(new IQIndexDat(ind_qn))
+    {
+    int mm = 0;
+    for(const_iq_it x = pd->iq_.begin(); x != pd->iq_.end(); ++x)
+        { mm += x->index.m(); }
+    if(mm != index_.m())
+        Error("IQIndex: m of Index does not match its blocks");
+    }
+
 IQIndex::
 IQIndex(PrimeType pt, const IQIndex& other, int inc) 
     : 
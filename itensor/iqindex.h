@@ -45,8 +45,8 @@ class IQIndex
     const std::string&
     rawname() const { return index_.rawname(); }
 
-    Real 
-    uniqueReal() const { return index_.uniqueReal(); }
+    IndexKey 
+    uniqueId() const { return index_.uniqueId(); }
 
     int 
     primeLevel() const { return index_.primeLevel(); }
@@ -113,6 +113,12 @@ class IQIndex
             const Index& i1, const QN& q1, 
             Arrow dir = Out);
 
+    //Uses other as the combined Index (keeping its
+    //identity) with the given blocks; swaps out ind_qn
+    IQIndex(const Index& other, 
+            std::vector<inqn>& ind_qn, 
+            Arrow dir = Out);
+
     IQIndex(PrimeType pt, const IQIndex& other, int inc = 1);
 
     explicit 
@@ -387,7 +393,7 @@ class IQIndexDat
 
     std::vector<inqn> iq_;
 
-    mutable int numref;
+    mutable boost::detail::atomic_count numref;
 
     const bool is_static_;
 
@@ -25,7 +25,7 @@ intrusive_ptr_release(IQIndexSet* p)
 IQIndexSet::
 IQIndexSet()
     :
-    ur_(0),
+    key_(0),
     numref(0)
     { }
 
@@ -33,7 +33,7 @@ IQIndexSet::
 IQIndexSet(const IQIndex& i1)
     :
     index_(1),
-    ur_(i1.uniqueReal()),
+    key_(i1.uniqueId()),
     numref(0)
     { 
 #ifdef DEBUG
@@ -47,7 +47,7 @@ IQIndexSet::
 IQIndexSet(const IQIndex& i1, const IQIndex& i2)
     :
     index_(2),
-    ur_(i1.uniqueReal() + i2.uniqueReal()),
+    key_(i1.uniqueId() + i2.uniqueId()),
     numref(0)
     { 
 #ifdef DEBUG
@@ -65,7 +65,7 @@ IQIndexSet(const IQIndex& i1, const IQIndex& i2,
            const IQIndex& i3)
     :
     index_(3),
-    ur_(i1.uniqueReal() + i2.uniqueReal() + i3.uniqueReal()),
+    key_(i1.uniqueId() + i2.uniqueId() + i3.uniqueId()),
     numref(0)
     { 
 #ifdef DEBUG
@@ -113,7 +113,7 @@ IQIndexSet(IQIndex i1, IQIndex i2, IQIndex i3,
 	if(i8 != IQIndex::Null()) 
 	    index_.push_back(i8);
 
-    setUniqueReal();
+    setUniqueId();
     }
 
 IQIndexSet::
@@ -122,14 +122,14 @@ IQIndexSet(std::vector<IQIndex>& iqinds)
     numref(0)
     {
     index_.swap(iqinds);
-    setUniqueReal();
+    setUniqueId();
     }
 
 IQIndexSet::
 IQIndexSet(const IQIndexSet& other)
     :
     index_(other.index_),
-    ur_(other.ur_),
+    key_(other.key_),
     numref(0)
     {
     }
@@ -142,18 +142,18 @@ IQIndexSet(std::istream& s)
     int size;
     s.read((char*) &size,sizeof(size));
     index_.resize(size);
-    ur_ = 0;
+    key_ = 0;
     for(int j = 0; j < size; ++j) 
         {
         index_[j].read(s);
-        ur_ += index_[j].uniqueReal();
+        key_ += index_[j].uniqueId();
         }
     }
 
 IQIndexSet::
 IQIndexSet(int init_numref)
     :
-    ur_(0),
+    key_(0),
     numref(init_numref)
     { }
 
@@ -248,12 +248,12 @@ maxM() const
 void IQIndexSet::
 noprime(PrimeType p)
     {
-    ur_ = 0;
+    key_ = 0;
     for(size_t j = 0; j < index_.size(); ++j) 
         {
         IQIndex& J = index_[j];
         J.noprime(p);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 #ifdef DEBUG
     //Check if noprime resulted in any duplicate indices
@@ -264,24 +264,24 @@ noprime(PrimeType p)
 void IQIndexSet::
 doprime(PrimeType pt, int inc)
 	{
-    ur_ = 0;
+    key_ = 0;
     for(size_t j = 0; j < index_.size(); ++j) 
         {
         IQIndex& J = index_[j];
         J.doprime(pt,inc);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 	}
 
 void IQIndexSet::
 mapprime(int plevold, int plevnew, PrimeType pt)
 	{
-    ur_ = 0;
+    key_ = 0;
     for(size_t j = 0; j < index_.size(); ++j) 
         {
         IQIndex& J = index_[j];
         J.mapprime(plevold,plevnew,pt);
-        ur_ += J.uniqueReal();
+        key_ += J.uniqueId();
         }
 	}
 
@@ -292,8 +292,8 @@ mapprimeind(const IQIndex& I, int plevold, int plevnew, PrimeType pt)
         if(index_[j] == I)
         {
         index_[j].mapprime(plevold,plevnew,pt);
-        ur_ -= I.uniqueReal();
-        ur_ += index_[j].uniqueReal();
+        key_ -= I.uniqueId();
+        key_ += index_[j].uniqueId();
         return;
         }
     //Print(*this);
@@ -368,9 +368,9 @@ noprimeind(const IQIndex& I)
 	for(size_t j = 0; j < index_.size(); ++j) 
 	    if(index_[j] == I) 
 		{
-        ur_ -= index_[j].uniqueReal();
+        key_ -= index_[j].uniqueId();
 		index_[j].noprime();
-        ur_ += index_[j].uniqueReal();
+        key_ += index_[j].uniqueId();
 		return;
 		}
     Print(I);
@@ -394,8 +394,8 @@ mapindex(const IQIndex& i1, const IQIndex& i2)
 	    if(index_[j] == i1) 
 		{
 		index_[j] = i2;
-        ur_ -= i1.uniqueReal();
-        ur_ += i2.uniqueReal();
+        key_ -= i1.uniqueId();
+        key_ += i2.uniqueId();
 		return;
 		}
 	Print(i1);
@@ -414,22 +414,22 @@ addindex(const IQIndex& I)
         Error("IQIndex is null");
 #endif
     index_.push_back(I);
-    ur_ += I.uniqueReal();
+    key_ += I.uniqueId();
     }
 
 void IQIndexSet::
 removeindex(int j) 
     { 
-    ur_ -= index_[j].uniqueReal();
+    key_ -= index_[j].uniqueId();
     index_.erase(index_.begin() + (j-1));
     }
 
 void IQIndexSet::
-setUniqueReal()
+setUniqueId()
 	{
-    ur_ = 0;
+    key_ = 0;
     for(size_t j = 0; j < index_.size(); ++j)
-        ur_ += index_[j].uniqueReal();
+        key_ += index_[j].uniqueId();
 	}
 
 void IQIndexSet::
@@ -437,23 +437,23 @@ swap(IQIndexSet& other)
     {
     index_.swap(other.index_);
 
-    Real sr = ur_;
-    ur_ = other.ur_;
-    other.ur_ = sr;
+    IndexKey sk = key_;
+    key_ = other.key_;
+    other.key_ = sk;
     }
 
 void IQIndexSet::
 swapInds(vector<IQIndex>& newinds)
     {
     index_.swap(newinds);
-    setUniqueReal();
+    setUniqueId();
     }
 
 void IQIndexSet::
 clear()
     {
     index_.clear();
-    ur_ = 0;
+    key_ = 0;
     }
 
 std::ostream&
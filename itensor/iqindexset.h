@@ -6,6 +6,11 @@
 #define __ITENSOR_IQINDEXSET_H
 #include "iqindex.h"
 
+//IQIndex arguments indexed from 1 (element 0 
+//unused); only more than NMAX use the heap
+typedef SmallArray<IQIndex,NMAX+1>
+IQIndexArray;
+
 //
 // IQIndexSet
 //
@@ -65,8 +70,8 @@ class IQIndexSet
     end() const { return index_.end(); }
 
 
-    Real
-    uniqueReal() const { return ur_; }
+    IndexKey
+    uniqueId() const { return key_; }
 
     //
     // IQIndex Analysis
@@ -173,7 +178,7 @@ class IQIndexSet
     removeindex(int j);
 
     void
-    setUniqueReal();
+    setUniqueId();
 
     void
     swap(IQIndexSet& other);
@@ -235,9 +240,9 @@ class IQIndexSet
 
     std::vector<IQIndex> index_;
 
-    Real ur_;
+    IndexKey key_;
 
-    mutable unsigned int 
+    mutable boost::detail::atomic_count
     numref;
 
     //
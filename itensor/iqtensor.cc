@@ -3,6 +3,7 @@
 //    (See accompanying LICENSE file.)
 //
 #include "iqtensor.h"
+#include "threadpool.h"
 #include <set>
 using namespace std;
 using boost::format;
@@ -26,6 +27,7 @@ intrusive_ptr_release(IQTDat* p)
 IQTDat::
 IQTDat() 
     : 
+    front_(0),
     numref(0), 
     rmap_init(false)
     { }
@@ -34,13 +36,24 @@ IQTDat::
 IQTDat(const IQTDat& other) 
     : 
     itensor(other.itensor), 
+    front_(0),
     numref(0), 
     rmap_init(false)
-	{ }
+	{ 
+    //other may be shared with a thread building its rmap
+    boost::mutex::scoped_lock lock(other.rmap_mutex);
+    if(other.rmap_init)
+        {
+        rmap = other.rmap;
+        front_ = other.front_;
+        rmap_init = true;
+        }
+    }
 
 IQTDat::
 IQTDat(istream& s) 
     : 
+    front_(0),
     numref(0),
     rmap_init(false)
     { 
@@ -56,6 +69,7 @@ IQTDat(istream& s)
 IQTDat::
 IQTDat(int init_numref) 
     : 
+    front_(0),
     numref(init_numref), 
     rmap_init(false)
     { }
@@ -73,10 +87,13 @@ write(ostream& s) const
 void IQTDat::
 init_rmap() const
 	{
+    boost::mutex::scoped_lock lock(rmap_mutex);
 	if(rmap_init) return;
 
-    for(iterator it = itensor.begin(); it != itensor.end(); ++it)
-	    rmap[ApproxReal(it->uniqueReal())] = it;
+    front_ = 0;
+    rmap.rehash(itensor.size());
+    for(size_t n = 0; n < itensor.size(); ++n)
+	    rmap[itensor[n].uniqueId()] = int(n);
 
 	rmap_init = true;
 	}
@@ -95,8 +112,25 @@ uninit_rmap() const
 	rmap_init = false; 
 	}
 
+int IQTDat::
+position(IndexKey r) const
+    {
+    init_rmap();
+    boost::unordered_map<IndexKey,int>::const_iterator it = rmap.find(r);
+    if(it == rmap.end())
+        Error("No block with this key in IQTDat");
+    return it->second-front_;
+    }
+
+void IQTDat::
+push(IndexKey r, const ITensor& t)
+    {
+    itensor.push_front(t);
+    rmap[r] = --front_;
+    }
+
 bool IQTDat::
-has_itensor(const ApproxReal& r) const
+has_itensor(IndexKey r) const
 	{ 
 	init_rmap();
 	return rmap.count(r) == 1; 
@@ -117,7 +151,7 @@ clear()
     }
 
 void IQTDat::
-insert(const ApproxReal& r, const ITensor& t)
+insert(IndexKey r, const ITensor& t)
     {
     init_rmap();
 #ifdef DEBUG
@@ -129,26 +163,25 @@ insert(const ApproxReal& r, const ITensor& t)
 #endif
     if(rmap.count(r) == 1)
         {
-        Print((*rmap[r])); 
+        Print(itensor[rmap[r]-front_]); 
         Print(t);
         Error("Can't insert ITensor with identical structure twice, use operator+=.");
         }
     else
         {
-        itensor.push_front(t);
-        rmap[r] = itensor.begin();
+        push(r,t);
         }
     }
 
 void IQTDat::
 insert(const ITensor& t)
     {
-    ApproxReal r(t.uniqueReal());
+    IndexKey r = t.uniqueId();
     insert(r,t);
     }
 
 void IQTDat::
-insert_add(const ApproxReal& r, const ITensor& t)
+insert_add(IndexKey r, const ITensor& t)
     {
     init_rmap();
 #ifdef DEBUG
@@ -158,22 +191,22 @@ insert_add(const ApproxReal& r, const ITensor& t)
         Error("insert_add called on shared IQTDat");
         }
 #endif
-    if(rmap.count(r) == 1)
+    boost::unordered_map<IndexKey,int>::const_iterator it = rmap.find(r);
+    if(it != rmap.end())
         {
-        *rmap[r] += t;
+        itensor[it->second-front_] += t;
         return;
         }
     else
         {
-        itensor.push_front(t);
-        rmap[r] = itensor.begin();
+        push(r,t);
         }
     }
 
 void IQTDat::
 insert_add(const ITensor& t)
     {
-    ApproxReal r(t.uniqueReal());
+    IndexKey r = t.uniqueId();
     insert_add(r,t);
     }
 
@@ -188,16 +221,16 @@ insert_assign(const ITensor& t)
         Error("insert_assign called on shared IQTDat");
         }
 #endif
-    ApproxReal r(t.uniqueReal());
-    if(rmap.count(r) == 1)
+    IndexKey r = t.uniqueId();
+    boost::unordered_map<IndexKey,int>::const_iterator it = rmap.find(r);
+    if(it != rmap.end())
         {
-        rmap[r]->assignFrom(t);
+        itensor[it->second-front_].assignFrom(t);
         return;
         }
     else
         {
-        itensor.push_front(t);
-        rmap[r] = itensor.begin();
+        push(r,t);
         }
     }
 
@@ -211,7 +244,7 @@ clean(Real min_norm)
         Error("clean called on shared IQTDat");
         }
 #endif
-    list<ITensor> nitensor;
+    StorageT nitensor;
     Foreach(const ITensor& t, itensor)
         {
         if(t.norm() >= min_norm)
@@ -580,15 +613,14 @@ operator()(const IQIndexVal& iv1, const IQIndexVal& iv2,
     boost::array<IQIndexVal,NMAX+1> iv 
         = {{ IQIndexVal::Null(), iv1, iv2, iv3, iv4, iv5, iv6, iv7, iv8 }};
 
-    Real ur = 0; 
+    IndexKey key = 0; 
     int nn = 0; 
     while(GET(iv,nn+1).iqind != IQIndexVal::Null().iqind) 
-        ur += GET(iv,++nn).index().uniqueReal(); 
+        key += GET(iv,++nn).index().uniqueId(); 
     if(nn != r()) 
         Error("Wrong number of IQIndexVals provided");
-    ApproxReal r(ur);
 
-    if(!dat().has_itensor(r))
+    if(!dat().has_itensor(key))
         {
         std::vector<Index> indices; 
         indices.reserve(nn);
@@ -599,10 +631,10 @@ operator()(const IQIndexVal& iv1, const IQIndexVal& iv2,
             indices.push_back(iv[j].index());
             }
         ITensor t(indices);
-        ncdat().insert_add(r,t);
+        ncdat().insert_add(key,t);
         }
 
-    return (ncdat().get(r)).operator()(iv1.blockIndexVal(),
+    return (ncdat().get(key)).operator()(iv1.blockIndexVal(),
                                        iv2.blockIndexVal(),
                                        iv3.blockIndexVal(),
                                        iv4.blockIndexVal(),
@@ -622,21 +654,20 @@ operator()(const IQIndexVal& iv1, const IQIndexVal& iv2,
     boost::array<IQIndexVal,NMAX+1> iv 
         = {{ IQIndexVal::Null(), iv1, iv2, iv3, iv4, iv5, iv6, iv7, iv8 }};
 
-    Real ur = 0; 
+    IndexKey key = 0; 
     int nn = 0; 
     while(GET(iv,nn+1).iqind != IQIndexVal::Null().iqind) 
-        ur += GET(iv,++nn).index().uniqueReal(); 
+        key += GET(iv,++nn).index().uniqueId(); 
     if(nn != r()) 
         Error("Wrong number of IQIndexVals provided");
-    ApproxReal r(ur);
 
-    if(!dat().has_itensor(r))
+    if(!dat().has_itensor(key))
         {
         return 0.;
         }
     else
         {
-        return (dat().get(r)).operator()(iv1.blockIndexVal(),
+        return (dat().get(key)).operator()(iv1.blockIndexVal(),
                                          iv2.blockIndexVal(),
                                          iv3.blockIndexVal(),
                                          iv4.blockIndexVal(),
@@ -911,11 +942,11 @@ symmetricDiag11(const IQIndex& i1, IQTensor& D, IQTensor& U, IQIndex& mid, int&
         D.insert(d.at(j));
     }
 
-Real IQTensor::
-uniqueReal() const 
+IndexKey IQTensor::
+uniqueId() const 
     { 
     if(is_ == 0) Error("IQTensor is null");
-    return is_->uniqueReal(); 
+    return is_->uniqueId(); 
     }
 
 Real IQTensor::
@@ -981,6 +1012,15 @@ void IQTensor::
 tieIndices(const boost::array<IQIndex,NMAX+1>& indices, int niqind, 
            const IQIndex& tied)
     {
+    IQIndexArray inds(indices.size());
+    std::copy(indices.begin(),indices.end(),inds.begin());
+    tieIndices(inds,niqind,tied);
+    }
+
+void IQTensor::
+tieIndices(const IQIndexArray& indices, int niqind, 
+           const IQIndex& tied)
+    {
     if(niqind < 1) Error("No IQIndices to tie");
 
     const int nindex = indices[1].nindex();
@@ -1017,7 +1057,7 @@ tieIndices(const boost::array<IQIndex,NMAX+1>& indices, int niqind,
         Error("Couldn't find IQIndex to tie");
         }
 
-    boost::array<Index,NMAX+1> totie;
+    IndexArray totie(niqind+1);
     for(int i = 1; i <= nindex; ++i)
         {
         for(int n = 1; n <= niqind; ++n)
@@ -1038,17 +1078,23 @@ tieIndices(const boost::array<IQIndex,NMAX+1>& indices, int niqind,
 void IQTensor::
 tieIndices(const IQIndex& i1, const IQIndex& i2, const IQIndex& tied)
     {
-    boost::array<IQIndex,NMAX+1> inds =
-        {{ IQIndex::Null(), i1, i2, 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null() }};
+    IQIndexArray inds(3);
+    inds[1] = i1;
+    inds[2] = i2;
 
     tieIndices(inds,2,tied);
     }
 
 void IQTensor::
 trace(const boost::array<IQIndex,NMAX+1>& indices, int niqind)
+    {
+    IQIndexArray inds(indices.size());
+    std::copy(indices.begin(),indices.end(),inds.begin());
+    trace(inds,niqind);
+    }
+
+void IQTensor::
+trace(const IQIndexArray& indices, int niqind)
     {
     if(niqind < 1) Error("No IQIndices to trace");
 
@@ -1087,7 +1133,7 @@ trace(const boost::array<IQIndex,NMAX+1>& indices, int niqind)
         Error("Couldn't find IQIndex to trace");
         }
 
-    boost::array<Index,NMAX+1> totrace;
+    IndexArray totrace(niqind+1);
     for(int i = 1; i <= nindex; ++i)
         {
         for(int n = 1; n <= niqind; ++n)
@@ -1108,11 +1154,9 @@ trace(const boost::array<IQIndex,NMAX+1>& indices, int niqind)
 void IQTensor::
 trace(const IQIndex& i1, const IQIndex& i2)
     {
-    boost::array<IQIndex,NMAX+1> inds =
-        {{ IQIndex::Null(), i1, i2, 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null() }};
+    IQIndexArray inds(3);
+    inds[1] = i1;
+    inds[2] = i2;
 
     trace(inds,2);
     }
@@ -1120,11 +1164,8 @@ trace(const IQIndex& i1, const IQIndex& i2)
 void IQTensor::
 trace(const IQIndex& i1)
     {
-    boost::array<IQIndex,NMAX+1> inds =
-        {{ IQIndex::Null(), i1, IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null(), 
-           IQIndex::Null(), IQIndex::Null() }};
+    IQIndexArray inds(2);
+    inds[1] = i1;
 
     trace(inds,1);
     }
@@ -1132,10 +1173,10 @@ trace(const IQIndex& i1)
 Real
 trace(IQTensor T)
     {
-    boost::array<IQIndex,NMAX+1> inds;
+    IQIndexArray inds(T.r()+1);
     for(int k = 1; k <= T.r(); ++k)
         {
-        inds.at(k) = T.index(k);
+        inds[k] = T.index(k);
         }
     T.trace(inds,T.r());
     T *= IQTensor::Sing();
@@ -1225,7 +1266,7 @@ void IQTensor::
 assignFrom(const IQTensor& other)
 	{
     //TODO: account for fermion sign here
-    if(fabs(uniqueReal()-other.uniqueReal()) > 1E-10)
+    if(uniqueId() != other.uniqueId())
         {
         PrintIndices((*this));
         PrintIndices(other);
@@ -1250,16 +1291,13 @@ conj()
         }
     else
         {
+        soloIndex();
+        is_->conj();
         soloDat();
-
-        IQTensor r,i;
-        SplitReIm(r,i);
-
-        r.is_->conj();
-        i.is_->conj();
-
-        i *= -1.0;
-        *this = r * IQTensor::Complex_1() + IQTensor::Complex_i() * i;
+        Foreach(ITensor& t, ncdat())
+            {
+            t.conj();
+            }
         }
     }
 
@@ -1321,153 +1359,403 @@ SplitReIm(IQTensor& re, IQTensor& im) const
         }
     }
 
-IQTensor& IQTensor::
-operator*=(const IQTensor& other)
+void IQTensor::
+JoinReIm(const IQTensor& re, const IQTensor& im)
     {
-    //TODO: account for fermion sign here
-    if(this == &other)
+    vector<IQIndex> inds(re.is_->begin(),re.is_->end());
+    inds.push_back(IQIndex::IndReIm());
+    IQTensor res(inds);
+
+    //Pair up the blocks of re and im
+    //having the same indices
+    typedef boost::unordered_map<IndexKey,const ITensor*>
+    BlockMap;
+    BlockMap imblock;
+    Foreach(const ITensor& t, im.dat())
         {
-        IQTensor cp_oth(other);
-        return operator*=(cp_oth);
+        imblock[t.uniqueId()] = &t;
         }
 
-    if(this->isNull()) 
-        Error("'This' IQTensor null in product");
+    ITensor z;
+    Foreach(const ITensor& t, re.dat())
+        {
+        BlockMap::iterator it = imblock.find(t.uniqueId());
+        if(it == imblock.end())
+            {
+            z.JoinReIm(t,ITensor());
+            }
+        else
+            {
+            z.JoinReIm(t,*(it->second));
+            imblock.erase(it);
+            }
+        res.insert(z);
+        }
+    for(BlockMap::const_iterator it = imblock.begin(); 
+        it != imblock.end(); ++it)
+        {
+        z.JoinReIm(ITensor(),*(it->second));
+        res.insert(z);
+        }
 
-    if(other.isNull()) 
-        Error("Multiplying by null IQTensor");
+    swap(res);
+    }
 
-    if(hasindex(IQIndex::IndReIm()) && other.hasindex(IQIndex::IndReIm()) && !other.hasindex(IQIndex::IndReImP())
-	    && !other.hasindex(IQIndex::IndReImPP()) && !hasindex(IQIndex::IndReImP()) && !hasindex(IQIndex::IndReImPP()))
+//
+// All pairs of blocks whose products add
+// into a single block of a contracted IQTensor.
+// The pairs are summed in the order they were
+// added, so the result does not depend on
+// which thread computes it.
+//
+namespace {
+
+struct BlockProduct
+    {
+    vector<int> order;
+    vector<const ITensor*> left,
+                           right;
+
+    //Sum of the products
+    ITensor res;
+
+    //Position of the first non-zero product 
+    //among all pairs of the contraction (-1 if none)
+    int first;
+
+    //Bytes copied by the products (see ProdCopyCount)
+    long copied;
+
+    BlockProduct() : first(-1), copied(0) { }
+
+    void
+    add(int n, const ITensor* l, const ITensor* r)
         {
-        static ITensor primer(Index::IndReIm(),Index::IndReImP(),1.0);
-        static ITensor primerP(Index::IndReIm(),Index::IndReImPP(),1.0);
-        static ITensor prod(Index::IndReIm(),Index::IndReImP(),Index::IndReImPP());
-        static IQTensor iqprimer(IQIndex::IndReIm(),IQIndex::IndReImP());
-        static IQTensor iqprimerP(IQIndex::IndReIm(),IQIndex::IndReImPP());
-        static IQTensor iqprod(IQIndex::IndReIm(),IQIndex::IndReImP(),IQIndex::IndReImPP());
-        static int first = 1;
-        if(first)
+        order.push_back(n);
+        left.push_back(l);
+        right.push_back(r);
+        }
+
+    void
+    compute()
+        {
+        //Small blocks are summed directly into res
+        int nfirst = -1;
+        if(sumSmallProducts(left,right,res,nfirst))
+            {
+            first = (nfirst < 0 ? -1 : order[nfirst]);
+            return;
+            }
+
+        ITensor tt;
+        for(size_t j = 0; j < left.size(); ++j)
             {
-            IndexVal iv0(Index::IndReIm(),1), iv1(Index::IndReImP(),1), iv2(Index::IndReImPP(),1);
-            iv0.i = 1; iv1.i = 1; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
-            iv0.i = 1; iv1.i = 2; iv2.i = 2; prod(iv0,iv1,iv2) = -1.0;
-            iv0.i = 2; iv1.i = 2; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
-            iv0.i = 2; iv1.i = 1; iv2.i = 2; prod(iv0,iv1,iv2) = 1.0;
-            first = 0;
-            iqprimer += primer;
-            iqprimerP += primerP;
-            iqprod += prod;
+            tt = *(left[j]); tt *= *(right[j]);
+            if(tt.scale().sign() == 0) continue;
+            if(first < 0)
+                {
+                res = tt;
+                first = order[j];
+                }
+            else
+                {
+                res += tt;
+                }
             }
-        return *this = (*this * iqprimer) * iqprod * (other * iqprimerP);
         }
 
-    solo();
+    //Flops of the products: twice the multiply-adds,
+    //each pair costing the sizes of both blocks over
+    //the size of the indices they share
+    Real
+    cost() const
+        {
+        Real c = 0;
+        for(size_t j = 0; j < left.size(); ++j)
+            {
+            const ITensor &L = *(left[j]),
+                          &R = *(right[j]);
+            Real shared = 1;
+            for(int k = 1; k <= L.rn(); ++k)
+                {
+                if(R.hasindex(L.index(k))) shared *= L.index(k).m();
+                }
+            c += 2.*L.vecSize()*R.vecSize()/shared;
+            }
+        return c;
+        }
 
-    set<ApproxReal> common_inds;
-    
-    //Load iqindex_ with those IQIndex's *not* common to *this and other
-    static vector<IQIndex> riqind_holder;
-    riqind_holder.resize(0);
+    struct FirstCreated
+        {
+        bool
+        operator()(const BlockProduct* a, const BlockProduct* b) const
+            { return a->first < b->first; }
+        };
+    };
 
-    for(int i = 1; i <= is_->r(); ++i)
+//Runs the block products on the threads of a pool.
+//The bytes each copies are taken off the count of
+//the thread it ran on, to be given to the caller.
+struct BlockProductRunner
+    {
+    vector<BlockProduct>& plan;
+
+    BlockProductRunner(vector<BlockProduct>& plan_) : plan(plan_) { }
+
+    void
+    operator()(int n) const 
+        { 
+        const long start = ProdCopyCount::bytes();
+        plan[n].compute(); 
+        plan[n].copied = ProdCopyCount::bytes()-start;
+        ProdCopyCount::add(-plan[n].copied);
+        }
+    };
+
+} //namespace
+
+bool ProductPlan::
+matches(const IQTensor& L, const IQTensor& R) const
+    {
+    if(!made_) return false;
+    if(L.r() != int(lind_.size()) || R.r() != int(rind_.size()))
+        return false;
+    if(L.iten_size() != int(lblock_.size()) 
+       || R.iten_size() != int(rblock_.size()))
+        return false;
+
+    for(int j = 1; j <= L.r(); ++j)
         {
-        const IQIndex& I = is_->index(i);
-        const_iqind_it f = find(other.is_->begin(),other.is_->end(),I);
-        if(f != other.is_->end()) //I is an element of other.iqindex_
+        const IQIndex& I = L.index(j);
+        if(I.uniqueId() != lind_[j-1] || I.dir() != ldir_[j-1]) 
+            return false;
+        }
+    for(int j = 1; j <= R.r(); ++j)
+        {
+        const IQIndex& I = R.index(j);
+        if(I.uniqueId() != rind_[j-1] || I.dir() != rdir_[j-1]) 
+            return false;
+        }
+
+    int n = 0;
+    Foreach(const ITensor& t, L.blocks())
+        {
+        if(t.uniqueId() != lblock_[n++]) return false;
+        }
+    n = 0;
+    Foreach(const ITensor& t, R.blocks())
+        {
+        if(t.uniqueId() != rblock_[n++]) return false;
+        }
+    return true;
+    }
+
+void ProductPlan::
+make(const IQTensor& L, const IQTensor& R)
+    {
+    typedef IQTensor::const_iten_it
+    const_iten_it;
+
+    const int makes = makes_;
+    clear();
+    makes_ = makes+1;
+
+    boost::unordered_set<IndexKey> common_inds;
+    
+    //Load res_inds_ with those IQIndex's *not* common to L and R
+    for(int i = 1; i <= L.r(); ++i)
+        {
+        const IQIndex& I = L.index(i);
+        lind_.push_back(I.uniqueId());
+        ldir_.push_back(I.dir());
+
+        IQTensor::const_iqind_it f = find(R.const_iqind_begin(),R.const_iqind_end(),I);
+        if(f != R.const_iqind_end()) //I is an index of R
             {
             //Check that arrow directions are compatible
             if(Global::checkArrows())
                 if(f->dir() == I.dir() && f->type() != ReIm && I.type() != ReIm)
                     {
-                    this->printIndices("*this");
-                    other.printIndices("other");
+                    L.printIndices("*this");
+                    R.printIndices("other");
                     cout << "IQIndex from *this = " << I << endl;
                     cout << "IQIndex from other = " << *f << endl;
                     cout << "Incompatible arrow directions in IQTensor::operator*=" << endl;
                     throw ArrowError("Incompatible arrow directions in IQTensor::operator*=.");
                     }
             for(size_t n = 0; n < I.iq().size(); ++n) 
-                { common_inds.insert(ApproxReal(I.iq()[n].index.uniqueReal())); }
+                { common_inds.insert(I.iq()[n].index.uniqueId()); }
 
-            common_inds.insert(ApproxReal(I.uniqueReal()));
+            common_inds.insert(I.uniqueId());
             }
         else 
             { 
-            riqind_holder.push_back(I); 
+            res_inds_.push_back(I); 
             }
         }
 
-    for(int i = 1; i <= other.is_->r(); ++i)
+    for(int i = 1; i <= R.r(); ++i)
         {
-        const IQIndex& I = other.is_->index(i);
-        if(!common_inds.count(ApproxReal(I.uniqueReal())))
+        const IQIndex& I = R.index(i);
+        rind_.push_back(I.uniqueId());
+        rdir_.push_back(I.dir());
+        if(!common_inds.count(I.uniqueId()))
             { 
-            riqind_holder.push_back(I); 
+            res_inds_.push_back(I); 
             }
         }
 
-    is_->swapInds(riqind_holder);
-
-    set<ApproxReal> keys;
+    const const_iten_it lbegin = L.const_iten_begin(),
+                        rbegin = R.const_iten_begin();
 
-    list<ITensor> old_itensor; 
-    ncdat().swap(old_itensor);
+    //Group the ITensors of L and R having the same 
+    //set of Index's to be contracted over together
+    BlockGroups<const_iten_it,const_iten_it> groups(common_inds);
+    for(const_iten_it lt = lbegin; lt != L.const_iten_end(); ++lt)
+        {
+        lblock_.push_back(lt->uniqueId());
+        groups.addLeft(lt);
+        }
+    for(const_iten_it rt = rbegin; rt != R.const_iten_end(); ++rt)
+        {
+        rblock_.push_back(rt->uniqueId());
+        groups.addRight(rt);
+        }
 
-    //com_this maps the uniqueReal of a set of Index's to be contracted over together
-    //to those ITensors in *this.itensor having all Index's in that set
-    multimap<ApproxReal,const_iten_it> com_this;
-    for(const_iten_it tt = old_itensor.begin(); tt != old_itensor.end(); ++tt)
+    //Group the pairs that add into the same block of the result
+    boost::unordered_map<IndexKey,int> blockOf;
+    npair_ = 0;
+    for(int g = 0; g < groups.size(); ++g)
         {
-        Real r = 0.0;
-        for(int a = 1; a <= tt->r(); ++a)
+        const vector<const_iten_it> &GL = groups.left(g),
+                                    &GR = groups.right(g);
+        for(size_t l = 0; l < GL.size(); ++l)
+        for(size_t r = 0; r < GR.size(); ++r)
             {
-            if(common_inds.count(ApproxReal(tt->index(a).uniqueReal())))
-                { r += tt->index(a).uniqueReal(); }
+            //Contracted indices appear in both blocks
+            const IndexKey res_key = GL[l]->uniqueId() + GR[r]->uniqueId() - 2*groups.key(g);
+            boost::unordered_map<IndexKey,int>::iterator b = blockOf.find(res_key);
+            if(b == blockOf.end())
+                {
+                b = blockOf.insert(make_pair(res_key,int(blocks_.size()))).first;
+                blocks_.push_back(Pairs());
+                }
+            Pairs& P = blocks_[b->second];
+            P.order.push_back(npair_++);
+            P.left.push_back(int(GL[l]-lbegin));
+            P.right.push_back(int(GR[r]-rbegin));
             }
-        com_this.insert(make_pair(ApproxReal(r),tt));
-        keys.insert(ApproxReal(r));
         }
 
-    //com_other is the same as com_this but for other
-    multimap<ApproxReal,const_iten_it> com_other;
-    for(const_iten_it ot = other.const_iten_begin(); ot != other.const_iten_end(); ++ot)
+    made_ = true;
+    }
+
+IQTensor& IQTensor::
+operator*=(const IQTensor& other)
+    {
+    ProductPlan plan;
+    return multiply(other,plan);
+    }
+
+IQTensor& IQTensor::
+multiply(const IQTensor& other, ProductPlan& plan)
+    {
+    //Flops are counted by the block products
+    ProfileScope ps("IQTensor::operator*=",Profiler::Product);
+
+    //TODO: account for fermion sign here
+    if(this == &other)
         {
-        Real r = 0.0;
-        for(int b = 1; b <= ot->r(); ++b)
-            {
-            if(common_inds.count(ApproxReal(ot->index(b).uniqueReal())))
-                { r += ot->index(b).uniqueReal(); }
-            }
-        com_other.insert(make_pair(ApproxReal(r),ot));
-        keys.insert(ApproxReal(r));
+        IQTensor cp_oth(other);
+        return multiply(cp_oth,plan);
         }
 
-    typedef multimap<ApproxReal,const_iten_it>::iterator mit;
-    pair<mit,mit> lrange,rrange;
-    ITensor tt;
-    for(set<ApproxReal>::iterator k = keys.begin(); k != keys.end(); ++k)
+    ProdCopyCount::Call pc;
+
+    if(this->isNull()) 
+        Error("'This' IQTensor null in product");
+
+    if(other.isNull()) 
+        Error("Multiplying by null IQTensor");
+
+    if(hasindex(IQIndex::IndReIm()) && other.hasindex(IQIndex::IndReIm()) && !other.hasindex(IQIndex::IndReImP())
+	    && !other.hasindex(IQIndex::IndReImPP()) && !hasindex(IQIndex::IndReImP()) && !hasindex(IQIndex::IndReImPP()))
         {
-        //Equal range returns the begin and end iterators for the sequence
-        //corresponding to multimap[key] as a pair
-        lrange = com_this.equal_range(*k);
-        rrange = com_other.equal_range(*k);
+        //(a+ib)(c+id) using three real products,
+        //as in ITensor::operator*=
+        IQTensor a,b,c,d;
+        SplitReIm(a,b);
+        other.SplitReIm(c,d);
+        IQTensor ac(a);
+        ac *= c;
+        IQTensor bd(b);
+        bd *= d;
+        a += b;
+        c += d;
+        a *= c;
+        a -= ac;
+        a -= bd;
+        ac -= bd;
+        JoinReIm(ac,a);
+        return *this;
+        }
 
-        //Iterate over all ITensors in *this and other sharing
-        //the set of contracted Index's corresponding to k
-        for(mit ll = lrange.first; ll != lrange.second; ++ll)
-        for(mit rr = rrange.first; rr != rrange.second; ++rr)
-            {
-            //Multiply the ITensors and add into res
-            tt = *(ll->second); tt *= *(rr->second);
-            if(tt.scale().sign() != 0)
-                ncdat().insert_add(tt);
-            }
+    if(plan.matches(*this,other))
+        ++plan.uses_;
+    else
+        plan.make(*this,other);
+
+    solo();
+
+    vector<IQIndex> riqind_holder(plan.res_inds_);
+    is_->swapInds(riqind_holder);
+
+    IQTDat::StorageT old_itensor; 
+    ncdat().swap(old_itensor);
+
+    //The block products, one for each block of the result
+    vector<BlockProduct> bprod(plan.blocks_.size());
+    const_iten_it rbegin = other.const_iten_begin();
+    for(size_t b = 0; b < bprod.size(); ++b)
+        {
+        const ProductPlan::Pairs& P = plan.blocks_[b];
+        for(size_t k = 0; k < P.order.size(); ++k)
+            bprod[b].add(P.order[k],&old_itensor[P.left[k]],&(*(rbegin+P.right[k])));
+        }
+
+    ThreadPool& pool = ThreadPool::global();
+    if(pool.numThreads() > 1 && bprod.size() > 1
+       && plan.npair_ >= Global::parallelBlockThreshold())
+        {
+        vector<Real> cost(bprod.size());
+        for(size_t b = 0; b < bprod.size(); ++b)
+            cost[b] = bprod[b].cost();
+        pool.runByCost(cost,BlockProductRunner(bprod));
+        Foreach(const BlockProduct& bp, bprod) 
+            ProdCopyCount::add(bp.copied);
+        }
+    else
+        {
+        Foreach(BlockProduct& bp, bprod) bp.compute();
+        }
+
+    //Insert the result blocks in the order the
+    //serial loop would have created them
+    vector<const BlockProduct*> done;
+    done.reserve(bprod.size());
+    Foreach(const BlockProduct& bp, bprod)
+        {
+        if(bp.first >= 0) done.push_back(&bp);
+        }
+    sort(done.begin(),done.end(),BlockProduct::FirstCreated());
+    Foreach(const BlockProduct* bp, done)
+        {
+        ncdat().insert(bp->res);
         }
 
     return *this;
 
-    } //IQTensor& IQTensor::operator*=(const IQTensor& other)
+    } //IQTensor& IQTensor::multiply(const IQTensor& other, ProductPlan& plan)
 
 IQTensor& IQTensor::
 operator/=(const IQTensor& other)
@@ -1492,10 +1780,9 @@ operator/=(const IQTensor& other)
         }
 
 
-    set<ApproxReal> common_inds;
+    boost::unordered_set<IndexKey> common_inds;
     
-    static vector<IQIndex> riqind_holder;
-    riqind_holder.resize(0);
+    vector<IQIndex> riqind_holder;
 
     for(int i = 1; i <= is_->r(); ++i)
         {
@@ -1515,9 +1802,9 @@ operator/=(const IQTensor& other)
                     throw ArrowError("Incompatible arrow directions in IQTensor::operator/=.");
                     }
             for(size_t n = 0; n < I.iq().size(); ++n) 
-                { common_inds.insert(ApproxReal(I.iq()[n].index.uniqueReal())); }
+                { common_inds.insert(I.iq()[n].index.uniqueId()); }
 
-            common_inds.insert(ApproxReal(I.uniqueReal()));
+            common_inds.insert(I.uniqueId());
             }
         riqind_holder.push_back(I);
         }
@@ -1526,7 +1813,7 @@ operator/=(const IQTensor& other)
     for(int i = 1; i <= other.is_->r(); ++i)
         {
         const IQIndex& I = other.is_->index(i);
-        if(!common_inds.count(ApproxReal(I.uniqueReal())))
+        if(!common_inds.count(I.uniqueId()))
             { 
             riqind_holder.push_back(I);
             inds_from_other = true;
@@ -1544,59 +1831,27 @@ operator/=(const IQTensor& other)
 
     soloDat();
 
-    list<ITensor> old_itensor; 
+    IQTDat::StorageT old_itensor; 
     ncdat().swap(old_itensor);
 
-    set<ApproxReal> keys;
-
-    //com_this maps the uniqueReal of a set of Index's to be summed over together
-    //to those ITensors in *this.itensor having all Index's in that set
-    multimap<ApproxReal,const_iten_it> com_this;
+    //Group the ITensors of *this and other having the
+    //same set of Index's to be summed over together
+    BlockGroups<const_iten_it,const_iten_it> groups(common_inds);
     for(const_iten_it tt = old_itensor.begin(); tt != old_itensor.end(); ++tt)
-        {
-        Real r = 0.0;
-        for(int a = 1; a <= tt->r(); ++a)
-            {
-            Real ur = tt->index(a).uniqueReal();
-            if(common_inds.count(ApproxReal(ur)))
-                r += ur;
-            }
-        com_this.insert(make_pair(ApproxReal(r),tt));
-        keys.insert(ApproxReal(r));
-        }
-
-    //com_other is the same as com_this but for other
-    multimap<ApproxReal,const_iten_it> com_other;
+        groups.addLeft(tt);
     for(const_iten_it ot = other.const_iten_begin(); ot != other.const_iten_end(); ++ot)
-        {
-        Real r = 0.0;
-        for(int b = 1; b <= ot->r(); ++b)
-            {
-            Real ur = ot->index(b).uniqueReal();
-            if(common_inds.count(ApproxReal(ur)))
-                r += ur;
-            }
-        com_other.insert(make_pair(ApproxReal(r),ot));
-        keys.insert(ApproxReal(r));
-        }
+        groups.addRight(ot);
 
-    typedef multimap<ApproxReal,const_iten_it>::iterator mit;
-    pair<mit,mit> lrange,rrange;
     ITensor tt;
-    for(set<ApproxReal>::iterator k = keys.begin(); k != keys.end(); ++k)
+    for(int g = 0; g < groups.size(); ++g)
         {
-        //Equal range returns the begin and end iterators for the sequence
-        //corresponding to multimap[key] as a pair
-        lrange = com_this.equal_range(*k);
-        rrange = com_other.equal_range(*k);
-
-        //Iterate over all ITensors in *this and other sharing
-        //the set of contracted Index's corresponding to k
-        for(mit ll = lrange.first; ll != lrange.second; ++ll)
-        for(mit rr = rrange.first; rr != rrange.second; ++rr)
+        const vector<const_iten_it> &L = groups.left(g),
+                                    &R = groups.right(g);
+        for(size_t l = 0; l < L.size(); ++l)
+        for(size_t r = 0; r < R.size(); ++r)
             {
             //Multiply the ITensors and add into res
-            tt = *(ll->second); tt /= *(rr->second);
+            tt = *(L[l]); tt /= *(R[r]);
             if(tt.scale().sign() != 0)
                 ncdat().insert_add(tt);
             }
@@ -1695,11 +1950,11 @@ operator+=(const IQTensor& other)
         }
 
     IQTensor& This = *this;
-    if(fabs(This.uniqueReal()-other.uniqueReal()) > 1.0e-11) 
+    if(This.uniqueId() != other.uniqueId()) 
         {
         PrintIndices(This);
         PrintIndices(other);
-        Error("bad match unique real in IQTensor::operator+=");
+        Error("bad match unique id in IQTensor::operator+=");
         }
 
     if(is_->r() == 0)	// Automatic initializing a summed IQTensor in a loop
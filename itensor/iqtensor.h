@@ -6,11 +6,16 @@
 #define __IQ_H
 #include "iqindexset.h"
 #include <list>
+#include <deque>
 #include <map>
+#include "boost/unordered_map.hpp"
+#include "boost/unordered_set.hpp"
+#include "boost/thread/mutex.hpp"
 
 class IQTDat;
 class IQCombiner;
 class IQTSparse;
+class ProductPlan;
 
 
 //
@@ -21,10 +26,10 @@ class IQTensor
     {
     public:
 
-    typedef std::list<ITensor>::iterator 
+    typedef std::deque<ITensor>::iterator 
     iten_it;
 
-    typedef std::list<ITensor>::const_iterator 
+    typedef std::deque<ITensor>::const_iterator 
     const_iten_it;
 
     typedef std::vector<IQIndex>::iterator 
@@ -165,6 +170,12 @@ class IQTensor
     IQTensor& 
     operator*=(const IQTensor& other);
 
+    //Same as operator*=, reusing plan if it was made
+    //for the indices and blocks of *this and other
+    //(otherwise plan is made again for them)
+    IQTensor& 
+    multiply(const IQTensor& other, ProductPlan& plan);
+
     //
     // Non-Contracting product
     //
@@ -411,6 +422,8 @@ class IQTensor
     bool 
     hasindex(const IQIndex& I) const;
 
+    //True if this has the IQIndex IndReIm
+    //(complex IQTensors are stored as for ITensor)
     bool 
     isComplex() const 
         { return findindex(IQIndex::IndReIm()) != 0; }
@@ -418,6 +431,9 @@ class IQTensor
     void 
     addindex1(const IQIndex& I);
 
+    void
+    tieIndices(const IQIndexArray& indices, int nind, const IQIndex& tied);
+
     void
     tieIndices(const boost::array<IQIndex,NMAX+1>& indices, int nind, const IQIndex& tied);
 
@@ -429,6 +445,9 @@ class IQTensor
                const IQIndex& tied, IQTensor T)
         { T.tieIndices(i1,i2,tied); return T; }
 
+    void
+    trace(const IQIndexArray& indices, int nind);
+
     void
     trace(const boost::array<IQIndex,NMAX+1>& indices, int nind);
 
@@ -457,8 +476,8 @@ class IQTensor
     void
     symmetricDiag11(const IQIndex& i1, IQTensor& D, IQTensor& U, IQIndex& mid, int& mink, int& maxk) const;
 
-    Real 
-    uniqueReal() const;
+    IndexKey 
+    uniqueId() const;
 
     Real 
     norm() const;
@@ -514,6 +533,10 @@ class IQTensor
     void 
     SplitReIm(IQTensor& re, IQTensor& im) const;
 
+    //Inverse of SplitReIm: set this to re + i*im
+    void
+    JoinReIm(const IQTensor& re, const IQTensor& im);
+
     void 
     conj();
 
@@ -581,11 +604,26 @@ class IQTensor
 
     }; //class IQTensor
 
+//
+// Block storage of an IQTensor: the ITensor blocks are
+// held in a deque, new blocks going in front, with a
+// table giving the position of each block from the key
+// of its Index's (so that lookups take constant time).
+// Inserting a block leaves references to the others
+// valid, but not iterators.
+// The table is updated as blocks are inserted; only
+// non-const iteration, which may change the Index's
+// of the blocks, causes it to be rebuilt. The rebuild
+// happens at the next lookup, under a lock since
+// threads may look up blocks of a shared IQTDat.
+// (For one contiguous buffer of all the block data,
+// see IQTFlat.)
+//
 class IQTDat : public boost::noncopyable
     {
     public:
 
-    typedef std::list<ITensor>
+    typedef std::deque<ITensor>
     StorageT;
 
     typedef StorageT::const_iterator
@@ -623,10 +661,10 @@ class IQTDat : public boost::noncopyable
     end() { uninit_rmap(); return itensor.end(); }
 
     const ITensor&
-    get(const ApproxReal& r) const { return *rmap[r]; }
+    get(IndexKey r) const { return itensor[position(r)]; }
 
     ITensor&
-    get(const ApproxReal& r) { return *rmap[r]; }
+    get(IndexKey r) { return itensor[position(r)]; }
 
     int
     size() const { return itensor.size(); }
@@ -638,13 +676,13 @@ class IQTDat : public boost::noncopyable
     clear();
 
     void 
-    insert(const ApproxReal& r, const ITensor& t);
+    insert(IndexKey r, const ITensor& t);
 
     void 
     insert(const ITensor& t);
 
     void 
-    insert_add(const ApproxReal& r, const ITensor& t);
+    insert_add(IndexKey r, const ITensor& t);
 
     void 
     insert_add(const ITensor& t);
@@ -656,7 +694,7 @@ class IQTDat : public boost::noncopyable
     clean(Real min_norm);
 
     bool 
-    has_itensor(const ApproxReal& r) const;
+    has_itensor(IndexKey r) const;
 
     void
     swap(StorageT& new_itensor);
@@ -709,18 +747,29 @@ class IQTDat : public boost::noncopyable
     // Data Members
     //
 
-    mutable std::list<ITensor> 
+    mutable StorageT
     itensor;
 
-    mutable std::map<ApproxReal,iterator>
-    rmap; //mutable so that const IQTensor methods can use rmap
+    mutable boost::unordered_map<IndexKey,int>
+    rmap; //position of each block in itensor plus front_,
+          //mutable so that const IQTensor methods can use rmap
+
+    //Decremented as blocks are put in front, so that
+    //the entries of rmap stay valid
+    mutable int
+    front_;
 
-    mutable unsigned int 
+    mutable boost::detail::atomic_count
     numref;
 
     mutable bool 
     rmap_init;
 
+    //Guards the lazy build of rmap by const methods,
+    //which threads sharing an IQTDat may call at once
+    mutable boost::mutex
+    rmap_mutex;
+
     //
     //////////////
 
@@ -730,6 +779,12 @@ class IQTDat : public boost::noncopyable
     void 
     uninit_rmap() const;
 
+    int
+    position(IndexKey r) const;
+
+    void
+    push(IndexKey r, const ITensor& t);
+
     explicit
     IQTDat(int init_numref);
 
@@ -745,6 +800,162 @@ class IQTDat : public boost::noncopyable
 
     }; //class IQTDat
 
+//
+// The block structure of a product of two IQTensors:
+// the IQIndex's of the result and, for each block of
+// the result, the pairs of blocks (by their positions
+// in the storage of the two factors) which add into it.
+//
+// Making a plan groups the blocks of both factors,
+// which for tensors with many small blocks takes
+// longer than multiplying them. A plan kept across
+// repeated products of the same structure (such as the
+// matrix-vector products of Davidson) is made once and
+// then only checked against the indices and blocks of
+// each new pair of factors. Usage:
+//
+//    ProductPlan plan;
+//    for(...)
+//        {
+//        IQTensor res(A);
+//        res.multiply(B,plan); //same as res *= B
+//        }
+//
+class ProductPlan
+    {
+    public:
+
+    ProductPlan() : made_(false), uses_(0), makes_(0), npair_(0) { }
+
+    bool
+    isNull() const { return !made_; }
+
+    //Products done with this plan since it was last made
+    int
+    uses() const { return uses_; }
+
+    //Number of times the plan was made
+    int
+    makes() const { return makes_; }
+
+    //Forgets the planned structure
+    void
+    clear() { *this = ProductPlan(); }
+
+    private:
+
+    //Pairs of blocks adding into one result block, numbered
+    //in the order their products were planned
+    struct Pairs
+        {
+        std::vector<int> order, 
+                         left, 
+                         right;
+        };
+
+    /////////////////
+    //
+    // Data Members
+
+    bool made_;
+    int uses_,
+        makes_;
+
+    //Keys of the IQIndex's, their arrows and 
+    //the keys of the blocks of the factors
+    std::vector<IndexKey> lind_, rind_;
+    std::vector<Arrow> ldir_, rdir_;
+    std::vector<IndexKey> lblock_, rblock_;
+
+    std::vector<IQIndex> res_inds_;
+    std::vector<Pairs> blocks_;
+    int npair_;
+
+    //
+    /////////////////
+
+    bool
+    matches(const IQTensor& L, const IQTensor& R) const;
+
+    void
+    make(const IQTensor& L, const IQTensor& R);
+
+    friend class IQTensor;
+
+    }; //class ProductPlan
+
+//
+// Groups the blocks of two tensors being contracted
+// by the key of their contracted indices: only blocks
+// in the same group have a non-zero product.
+// Groups are numbered in the order they are found.
+//
+// Used by the IQTensor and IQTSparse products.
+//
+template <class LIter, class RIter>
+class BlockGroups
+    {
+    public:
+
+    typedef boost::unordered_set<IndexKey>
+    KeySet;
+
+    //common holds the keys of the contracted IQIndex's
+    //and of the Index's making them up
+    explicit
+    BlockGroups(const KeySet& common) : common_(common) { }
+
+    void
+    addLeft(LIter it) { left_.at(group(*it)).push_back(it); }
+
+    void
+    addRight(RIter it) { right_.at(group(*it)).push_back(it); }
+
+    int
+    size() const { return key_.size(); }
+
+    //Sum of the keys of the contracted indices of group g
+    IndexKey
+    key(int g) const { return key_.at(g); }
+
+    const std::vector<LIter>&
+    left(int g) const { return left_.at(g); }
+
+    const std::vector<RIter>&
+    right(int g) const { return right_.at(g); }
+
+    private:
+
+    template <class Block>
+    int
+    group(const Block& b)
+        {
+        IndexKey key = 0;
+        for(int a = 1; a <= b.r(); ++a)
+            {
+            const IndexKey k = b.index(a).uniqueId();
+            if(common_.count(k)) key += k;
+            }
+        boost::unordered_map<IndexKey,int>::const_iterator
+        it = groupOf_.find(key);
+        if(it != groupOf_.end()) return it->second;
+
+        const int g = key_.size();
+        groupOf_[key] = g;
+        key_.push_back(key);
+        left_.push_back(std::vector<LIter>());
+        right_.push_back(std::vector<RIter>());
+        return g;
+        }
+
+    const KeySet& common_;
+    boost::unordered_map<IndexKey,int> groupOf_;
+    std::vector<IndexKey> key_;
+    std::vector<std::vector<LIter> > left_;
+    std::vector<std::vector<RIter> > right_;
+
+    }; //class BlockGroups
+
 template <typename Callable> 
 void IQTensor::
 mapElems(const Callable& f)
@@ -0,0 +1,163 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "iqtflat.h"
+
+using namespace std;
+
+namespace {
+
+struct KeyOrder
+    {
+    bool
+    operator()(const ITensor* a, const ITensor* b) const
+        { return a->uniqueId() < b->uniqueId(); }
+    };
+
+} //namespace
+
+IQTFlat::
+IQTFlat()
+    { }
+
+IQTFlat::
+IQTFlat(const IQTensor& T)
+    {
+    if(T.isNull()) Error("IQTFlat: IQTensor is null");
+
+    vector<const ITensor*> blocks;
+    blocks.reserve(T.iten_size());
+    for(IQTensor::const_iten_it it = T.const_iten_begin(); it != T.const_iten_end(); ++it)
+        blocks.push_back(&(*it));
+    sort(blocks.begin(),blocks.end(),KeyOrder());
+
+    Layout* L = new Layout;
+    layout_.reset(L);
+
+    L->iqindex.assign(T.const_iqind_begin(),T.const_iqind_end());
+    L->block.resize(blocks.size());
+    L->pos.rehash(blocks.size());
+    int offset = 0;
+    for(size_t n = 0; n < blocks.size(); ++n)
+        {
+        const ITensor& t = *(blocks[n]);
+        Block& b = L->block[n];
+        b.key = t.uniqueId();
+        b.offset = offset;
+        b.size = t.vecSize();
+        b.index.reserve(t.r());
+        for(int j = 1; j <= t.r(); ++j)
+            b.index.push_back(t.index(j));
+        L->pos[b.key] = int(n);
+        offset += b.size;
+        }
+
+    data_.ReDimension(offset);
+    for(size_t n = 0; n < blocks.size(); ++n)
+        blocks[n]->assignToVec(blockData(n));
+    }
+
+IQTensor IQTFlat::
+toIQTensor() const
+    {
+    if(isNull()) Error("IQTFlat is null");
+    vector<IQIndex> iqinds(layout_->iqindex);
+    IQTensor res(iqinds);
+    for(int n = 0; n < nblock(); ++n)
+        res += block(n);
+    return res;
+    }
+
+int IQTFlat::
+nblock() const
+    {
+    return (isNull() ? 0 : int(layout_->block.size()));
+    }
+
+IndexKey IQTFlat::
+key(int n) const
+    {
+    return GET(layout_->block,n).key;
+    }
+
+int IQTFlat::
+find(IndexKey r) const
+    {
+    if(isNull()) return -1;
+    boost::unordered_map<IndexKey,int>::const_iterator it = layout_->pos.find(r);
+    return (it == layout_->pos.end() ? -1 : it->second);
+    }
+
+VectorRef IQTFlat::
+blockData(int n) const
+    {
+    const Block& b = GET(layout_->block,n);
+    return data_.SubVector(b.offset+1,b.offset+b.size);
+    }
+
+ITensor IQTFlat::
+block(int n) const
+    {
+    return ITensor(GET(layout_->block,n).index,blockData(n));
+    }
+
+bool IQTFlat::
+sameBlocks(const IQTFlat& other) const
+    {
+    if(layout_ == other.layout_) return true;
+    if(isNull() || other.isNull()) return false;
+    const vector<Block> &b = layout_->block,
+                        &ob = other.layout_->block;
+    if(b.size() != ob.size()) return false;
+    for(size_t n = 0; n < b.size(); ++n)
+        {
+        if(b[n].key != ob[n].key || b[n].size != ob[n].size)
+            return false;
+        }
+    return true;
+    }
+
+void IQTFlat::
+checkSame(const IQTFlat& other) const
+    {
+    if(!sameBlocks(other))
+        Error("IQTFlat: blocks of the two tensors differ");
+    }
+
+IQTFlat& IQTFlat::
+operator+=(const IQTFlat& other)
+    {
+    checkSame(other);
+    data_ += other.data_;
+    return *this;
+    }
+
+IQTFlat& IQTFlat::
+operator-=(const IQTFlat& other)
+    {
+    checkSame(other);
+    data_ -= other.data_;
+    return *this;
+    }
+
+IQTFlat& IQTFlat::
+operator*=(Real fac)
+    {
+    data_ *= fac;
+    return *this;
+    }
+
+Real IQTFlat::
+norm() const
+    {
+    return Norm(data_);
+    }
+
+Real
+Dot(const IQTFlat& x, const IQTFlat& y)
+    {
+    if(!x.sameBlocks(y))
+        Error("Dot: blocks of the two IQTFlat's differ");
+    return x.data() * y.data();
+    }
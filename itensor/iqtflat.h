@@ -0,0 +1,135 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_IQTFLAT_H
+#define __ITENSOR_IQTFLAT_H
+#include "iqtensor.h"
+#include "boost/shared_ptr.hpp"
+
+//
+// IQTFlat holds the blocks of an IQTensor in one
+// Vector, one after another in order of their keys
+// (see ITensor::uniqueId), with a table giving the
+// offset of each block. Making one from an IQTensor
+// allocates all of the storage at once, and blocks
+// are found by key in constant time.
+//
+// It is an alternative to the storage of IQTensor
+// (IQTDat, a deque of ITensor blocks each with its own
+// storage) for tensors whose block structure stays
+// fixed while their elements change many times, like
+// the vectors of the Davidson algorithm: for two
+// IQTFlat's with the same blocks, +=, Dot and norm are
+// each a single loop over the data. Copies share the
+// table of blocks.
+//
+// Usage:
+//
+//    IQTFlat x(phi);
+//    x *= 2; x += IQTFlat(psi);
+//    phi = x.toIQTensor();
+//
+
+class IQTFlat
+    {
+    public:
+
+    IQTFlat();
+
+    explicit
+    IQTFlat(const IQTensor& T);
+
+    //Copies the blocks into a new IQTensor
+    IQTensor
+    toIQTensor() const;
+
+    bool
+    isNull() const { return layout_ == 0; }
+
+    int
+    nblock() const;
+
+    //Total number of elements
+    int
+    vecSize() const { return data_.Length(); }
+
+    //Key of block n = 0,1,...,nblock()-1
+    IndexKey
+    key(int n) const;
+
+    //Position of the block with key r, -1 if none
+    int
+    find(IndexKey r) const;
+
+    //Elements of block n, in the order of block(n)
+    VectorRef
+    blockData(int n) const;
+
+    //Block n as an ITensor (a copy)
+    ITensor
+    block(int n) const;
+
+    //All of the elements, block after block
+    const Vector&
+    data() const { return data_; }
+
+    //True if other has blocks with the
+    //same keys and sizes as this one
+    bool
+    sameBlocks(const IQTFlat& other) const;
+
+    //
+    // Operators (other must have the same blocks)
+    //
+
+    IQTFlat&
+    operator+=(const IQTFlat& other);
+
+    IQTFlat&
+    operator-=(const IQTFlat& other);
+
+    IQTFlat&
+    operator*=(Real fac);
+
+    Real
+    norm() const;
+
+    private:
+
+    struct Block
+        {
+        IndexKey key;
+        int offset,
+            size;
+        std::vector<Index> index;
+        };
+
+    //Shared by copies, never changed once made
+    struct Layout
+        {
+        std::vector<IQIndex> iqindex;
+        std::vector<Block> block;
+        boost::unordered_map<IndexKey,int> pos;
+        };
+
+    /////////////
+    //
+    // Data Members
+
+    boost::shared_ptr<const Layout> layout_;
+    Vector data_;
+
+    //
+    /////////////
+
+    void
+    checkSame(const IQTFlat& other) const;
+
+    }; //class IQTFlat
+
+//other must have the same blocks
+Real
+Dot(const IQTFlat& x, const IQTFlat& y);
+
+#endif
@@ -66,7 +66,7 @@ insert_add(const ITSparse& s)
     {
     init_rmap();
 
-    ApproxReal r(s.uniqueReal());
+    IndexKey r = s.uniqueId();
     if(rmap.count(r) == 1)
         {
         *rmap[r] += s;
@@ -99,7 +99,7 @@ init_rmap() const
     if(init) return;
 
     for(iterator it = its_.begin(); it != its_.end(); ++it)
-        rmap[ApproxReal(it->uniqueReal())] = it;
+        rmap[it->uniqueId()] = it;
 
     init = true;
     }
@@ -276,15 +276,14 @@ operator()(const IQIndexVal& iv1, const IQIndexVal& iv2,
     boost::array<IQIndexVal,NMAX+1> iv 
         = {{ IQIndexVal::Null(), iv1, iv2, iv3, iv4, iv5, iv6, iv7, iv8 }};
 
-    Real ur = 0; 
+    IndexKey key = 0; 
     int nn = 0; 
     while(GET(iv,nn+1).iqind != IQIndexVal::Null().iqind) 
-        ur += GET(iv,++nn).index().uniqueReal(); 
+        key += GET(iv,++nn).index().uniqueId(); 
     if(nn != r()) 
         Error("Wrong number of IQIndexVals provided");
-    ApproxReal r(ur);
 
-    if(!blocks().has_itensor(r))
+    if(!blocks().has_itensor(key))
         {
         std::vector<Index> indices; 
         indices.reserve(nn);
@@ -295,10 +294,10 @@ operator()(const IQIndexVal& iv1, const IQIndexVal& iv2,
             indices.push_back(iv[j].index());
             }
         ITensor t(indices);
-        ncdat().insert_add(r,t);
+        ncdat().insert_add(key,t);
         }
 
-    return (ncblocks().get(r)).operator()(iv1.blockIndexVal(),
+    return (ncblocks().get(key)).operator()(iv1.blockIndexVal(),
                                        iv2.blockIndexVal(),
                                        iv3.blockIndexVal(),
                                        iv4.blockIndexVal(),
@@ -582,11 +581,10 @@ product(const IQTSparse& S, const IQTensor& T, IQTensor& res)
         Error("Complex IQTSparse not yet implemented");
         }
 
-    set<ApproxReal> common_inds;
+    boost::unordered_set<IndexKey> common_inds;
     
     //Load iqindex_ with those IQIndex's *not* common to *this and other
-    static vector<IQIndex> riqind_holder;
-    riqind_holder.resize(0);
+    vector<IQIndex> riqind_holder;
 
     for(int i = 1; i <= S.is_->r(); ++i)
         {
@@ -606,9 +604,9 @@ product(const IQTSparse& S, const IQTensor& T, IQTensor& res)
                     throw ArrowError("Incompatible arrow directions in IQTensor::operator*=.");
                     }
             for(size_t n = 0; n < I.iq().size(); ++n) 
-                { common_inds.insert(ApproxReal(I.iq()[n].index.uniqueReal())); }
+                { common_inds.insert(I.iq()[n].index.uniqueId()); }
 
-            common_inds.insert(ApproxReal(I.uniqueReal()));
+            common_inds.insert(I.uniqueId());
             }
         else 
             { 
@@ -619,7 +617,7 @@ product(const IQTSparse& S, const IQTensor& T, IQTensor& res)
     for(int i = 1; i <= T.is_->r(); ++i)
         {
         const IQIndex& I = T.is_->index(i);
-        if(!common_inds.count(ApproxReal(I.uniqueReal())))
+        if(!common_inds.count(I.uniqueId()))
             { 
             riqind_holder.push_back(I); 
             }
@@ -627,60 +625,28 @@ product(const IQTSparse& S, const IQTensor& T, IQTensor& res)
 
     res = IQTensor(riqind_holder);
 
-    set<ApproxReal> keys;
-
-    list<ITensor> old_itensor; 
+    IQTDat::StorageT old_itensor; 
     res.p->swap(old_itensor);
 
-    multimap<ApproxReal,IQTSDat::const_iterator> com_S;
+    BlockGroups<IQTSDat::const_iterator,IQTensor::const_iten_it> groups(common_inds);
     for(IQTSDat::const_iterator tt = S.blocks().begin(); tt != S.blocks().end(); ++tt)
-        {
-        Real r = 0.0;
-        for(int a = 1; a <= tt->r(); ++a)
-            {
-            if(common_inds.count(ApproxReal(tt->index(a).uniqueReal())))
-                { r += tt->index(a).uniqueReal(); }
-            }
-        com_S.insert(make_pair(ApproxReal(r),tt));
-        keys.insert(ApproxReal(r));
-        }
-
-    multimap<ApproxReal,IQTensor::const_iten_it> com_T;
+        groups.addLeft(tt);
     for(IQTensor::const_iten_it ot = T.const_iten_begin(); ot != T.const_iten_end(); ++ot)
-        {
-        Real r = 0.0;
-        for(int b = 1; b <= ot->r(); ++b)
-            {
-            if(common_inds.count(ApproxReal(ot->index(b).uniqueReal())))
-                { r += ot->index(b).uniqueReal(); }
-            }
-        com_T.insert(make_pair(ApproxReal(r),ot));
-        keys.insert(ApproxReal(r));
-        }
-
-    typedef multimap<ApproxReal,IQTensor::const_iten_it>::iterator 
-    rit;
-    pair<rit,rit> rrange;
-
-    typedef multimap<ApproxReal,IQTSDat::const_iterator>::iterator 
-    lit;
-    pair<lit,lit> lrange;
+        groups.addRight(ot);
 
     ITensor tt;
-    for(set<ApproxReal>::iterator k = keys.begin(); k != keys.end(); ++k)
+    for(int g = 0; g < groups.size(); ++g)
         {
-        //Equal range returns the begin and end iterators for the sequence
-        //corresponding to multimap[key] as a pair
-        lrange = com_S.equal_range(*k);
-        rrange = com_T.equal_range(*k);
-
-        //Iterate over all ITensors in *this and other sharing
-        //the set of contracted Index's corresponding to k
-        for(lit ll = lrange.first; ll != lrange.second; ++ll)
-        for(rit rr = rrange.first; rr != rrange.second; ++rr)
+        const vector<IQTSDat::const_iterator>& L = groups.left(g);
+        const vector<IQTensor::const_iten_it>& R = groups.right(g);
+
+        //Iterate over all ITensors in S and T sharing
+        //the set of contracted Index's of this group
+        for(size_t l = 0; l < L.size(); ++l)
+        for(size_t r = 0; r < R.size(); ++r)
             {
             //Multiply the ITensors and add into res
-            tt = *(ll->second) * *(rr->second);
+            tt = *(L[l]) * *(R[r]);
             if(tt.scale().sign() != 0)
                 res.p->insert_add(tt);
             }
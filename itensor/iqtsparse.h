@@ -52,9 +52,9 @@ class IQTSparse
     int 
     m(int j) const { return is_->m(j); }
 
-    //uniqueReal depends on indices only, unordered:
-    Real 
-    uniqueReal() const { return is_->uniqueReal(); } 
+    //uniqueId depends on indices only, unordered:
+    IndexKey 
+    uniqueId() const { return is_->uniqueId(); } 
 
     bool
     isNull() const;
@@ -394,13 +394,13 @@ class IQTSDat
     // Data members
     //
 
-    mutable unsigned int numref;
+    mutable boost::detail::atomic_count numref;
 
     mutable bool init;
 
     mutable StorageT its_;
 
-    mutable std::map<ApproxReal,iterator>
+    mutable boost::unordered_map<IndexKey,iterator>
     rmap;
 
     //
@@ -3,6 +3,7 @@
 //    (See accompanying LICENSE file.)
 //
 #include "itensor.h"
+#include "permute.h"
 using namespace std;
 using boost::format;
 using boost::array;
@@ -40,6 +41,8 @@ init(const array<Index,NMAX+1>& ii, int rn, int r)
     {
     rn_ = rn;
     r_ = r;
+    n.resize(NMAX+1);
+    i.resize(NMAX+1);
     n[0] = 0;
     for(int j = 1; j <= rn_; ++j) 
         { n[j] = ii[j].m(); }
@@ -53,10 +56,13 @@ init(const IndexSet& is)
     {
     rn_ = is.rn();
     r_ = is.r();
+    const int size = max(r_,NMAX)+1;
+    n.resize(size);
+    i.resize(size);
     n[0] = 0;
     for(int j = 1; j <= rn_; ++j) 
         { n[j] = is.index(j).m(); }
-    for(int j = rn_+1; j <= NMAX; ++j) 
+    for(int j = rn_+1; j < size; ++j) 
         { n[j] = 1; }
     reset(1);
     }
@@ -81,7 +87,8 @@ operator++()
 bool Counter::
 operator!=(const Counter& other) const
     {
-    for(int j = 1; j <= NMAX; ++j)
+    if(i.size() != other.i.size()) return true;
+    for(int j = 1; j < i.size(); ++j)
         { if(i[j] != other.i[j]) return true; }
     return false;
     }
@@ -304,7 +311,7 @@ ITensor(const std::vector<Index>& I)
 	}
 
 ITensor::
-ITensor(const std::vector<Index>& I, const Vector& V) 
+ITensor(const std::vector<Index>& I, const VectorRef& V) 
     : 
     p(new ITDat(V))
 	{
@@ -372,6 +379,45 @@ ConjTensor()
     return ConjTensor_;
     }
 
+//
+// Helper tensors used to multiply complex ITensors.
+// Each is built completely before being stored
+// in a const static, so concurrent first calls are safe.
+//
+
+const ITensor& ITensor::
+ReImPrimer()
+    {
+    static const ITensor primer_(Index::IndReIm(),Index::IndReImP(),1.0);
+    return primer_;
+    }
+
+const ITensor& ITensor::
+ReImPrimerP()
+    {
+    static const ITensor primerP_(Index::IndReIm(),Index::IndReImPP(),1.0);
+    return primerP_;
+    }
+
+static ITensor
+makeReImProd()
+    {
+    ITensor prod(Index::IndReIm(),Index::IndReImP(),Index::IndReImPP());
+    IndexVal iv0(Index::IndReIm(),1), iv1(Index::IndReImP(),1), iv2(Index::IndReImPP(),1);
+    iv0.i = 1; iv1.i = 1; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
+    iv0.i = 1; iv1.i = 2; iv2.i = 2; prod(iv0,iv1,iv2) = -1.0;
+    iv0.i = 2; iv1.i = 2; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
+    iv0.i = 2; iv1.i = 1; iv2.i = 2; prod(iv0,iv1,iv2) = 1.0;
+    return prod;
+    }
+
+const ITensor& ITensor::
+ReImProd()
+    {
+    static const ITensor prod_(makeReImProd());
+    return prod_;
+    }
+
 void ITensor::
 read(std::istream& s)
     { 
@@ -552,7 +598,7 @@ void ITensor::
 assignFrom(const ITensor& other)
     {
     if(this == &other) return;
-    if(fabs(other.is_.uniqueReal() - is_.uniqueReal()) > 1E-12)
+    if(other.is_.uniqueId() != is_.uniqueId())
         {
         Print(*this); Print(other);
         Error("assignFrom: unique Real not the same"); 
@@ -570,17 +616,15 @@ assignFrom(const ITensor& other)
         p = new ITDat(); 
         }
     other.reshapeDat(P,p->v);
-    DO_IF_PS(++Prodstats::stats().c1;)
 #endif
     }
 
 
 void ITensor::
-groupIndices(const array<Index,NMAX+1>& indices, int nind, 
+groupIndices(const IndexArray& indices, int nind, 
              const Index& grouped, ITensor& res) const
     {
-    array<int,NMAX+1> isReplaced; 
-    isReplaced.assign(0);
+    SmallArray<int,NMAX+1> isReplaced(max(r(),NMAX)+1,0); 
 
     //Print(*this);
 
@@ -619,6 +663,31 @@ groupIndices(const array<Index,NMAX+1>& indices, int nind,
 
     vector<Index> nindices; 
     nindices.reserve(r()-nind+1);
+
+    //If the m != 1 indices are consecutive and in order,
+    //grouping them only relabels the data
+    int start = 1;
+    while(start <= rn() && isReplaced[start] <= 0) ++start;
+    bool inplace = (nn > 0);
+    for(int k = 0; k < nn && inplace; ++k)
+        inplace = (start+k <= rn() && isReplaced[start+k] == k+1);
+    if(inplace)
+        {
+        //Counts the bytes moved by the permutation which
+        //would have put grouped after the other indices
+        const Real saved = (start+nn <= rn() ? 2.*sizeof(Real)*vecSize() : 0);
+        ProfileScope ps("ITensor::groupIndices (shared)",Profiler::Permute,0,saved);
+        for(int j = 1; j < start; ++j) 
+            nindices.push_back(index(j));
+        nindices.push_back(grouped);
+        for(int j = start+nn; j <= rn(); ++j) 
+            nindices.push_back(index(j));
+        for(int j = rn()+1; j <= r(); ++j) 
+            if(isReplaced[j] == 0) nindices.push_back(index(j));
+        res = ITensor(nindices,*this);
+        return;
+        }
+
     Permutation P;
     int nkept = 0; 
     for(int j = 1; j <= rn(); ++j)
@@ -649,21 +718,20 @@ groupIndices(const array<Index,NMAX+1>& indices, int nind,
     }
 
 void ITensor::
-tieIndices(const array<Index,NMAX+1>& indices, int nind,
+tieIndices(const IndexArray& indices, int nind,
            const Index& tied)
     {
     if(nind == 0) Error("No indices given");
 
     const int tm = tied.m();
     
-    array<Index,NMAX+1> new_index_;
+    IndexArray new_index_(r()+2);
     new_index_[1] = tied;
     //will count these up below
     int new_r_ = 1;
     int alloc_size = tm;
 
-    array<bool,NMAX+1> is_tied;
-    is_tied.assign(false);
+    SmallArray<bool,NMAX+1> is_tied(r()+1,false);
 
     int nmatched = 0;
     for(int k = 1; k <= r(); ++k)
@@ -710,22 +778,19 @@ tieIndices(const array<Index,NMAX+1>& indices, int nind,
 
     Counter nc(new_is_);
 
-    //Set up ii pointers to link
-    //elements of res to appropriate
-    //elements of *this
-    array<int*,NMAX+1> ii;
-    int n = 2;
-    for(int j = 1; j <= r(); ++j)
+    //Stride in the data of *this of each
+    //m!=1 index of res; the tied index
+    //steps through all tied indices at once
+    SmallArray<int,NMAX+1> str(r()+2,0);
+    int n = 2, s = 1;
+    for(int j = 1; j <= rn(); ++j)
         {
         if(is_tied[j])
-            ii[j] = &(nc.i[1]);
+            str[1] += s;
         else
-            ii[j] = &(nc.i[n++]);
+            str[n++] = s;
+        s *= m(j);
         }
-
-    int one = 1;
-    for(int j = r()+1; j <= NMAX; ++j)
-        ii[j] = &one;
     
     //Create the new dat
     boost::intrusive_ptr<ITDat> np = new ITDat(alloc_size);
@@ -734,11 +799,10 @@ tieIndices(const array<Index,NMAX+1>& indices, int nind,
     const Vector& thisdat = p->v;
     for(; nc.notDone(); ++nc)
         {
-        resdat(nc.ind) =
-        thisdat(this->_ind(*ii[1],*ii[2],
-                           *ii[3],*ii[4],
-                           *ii[5],*ii[6],
-                           *ii[7],*ii[8]));
+        int off = 1;
+        for(int k = 1; k <= nc.rn_; ++k)
+            off += (nc.i[k]-1)*str[k];
+        resdat(nc.ind) = thisdat(off);
         }
 
     is_.swap(new_is_);
@@ -746,6 +810,15 @@ tieIndices(const array<Index,NMAX+1>& indices, int nind,
 
     } //ITensor::tieIndices
 
+void ITensor::
+tieIndices(const array<Index,NMAX+1>& indices, int nind,
+           const Index& tied)
+    {
+    IndexArray inds(indices.size());
+    std::copy(indices.begin(),indices.end(),inds.begin());
+    tieIndices(inds,nind,tied);
+    }
+
 void ITensor::
 tieIndices(const Index& i1, const Index& i2,
            const Index& tied)
@@ -787,19 +860,26 @@ tieIndices(const Index& i1, const Index& i2,
 
 void ITensor::
 trace(const array<Index,NMAX+1>& indices, int nind)
+    {
+    IndexArray inds(indices.size());
+    std::copy(indices.begin(),indices.end(),inds.begin());
+    trace(inds,nind);
+    }
+
+void ITensor::
+trace(const IndexArray& indices, int nind)
     {
     if(nind == 0) Error("No indices given");
 
     const int tm = indices[1].m();
     
-    array<Index,NMAX+1> new_index_;
+    IndexArray new_index_(r()+1);
 
     //will count these up below
     int new_r_ = 0;
     int alloc_size = 1;
 
-    array<bool,NMAX+1> traced;
-    traced.assign(false);
+    SmallArray<bool,NMAX+1> traced(r()+1,false);
 
     int nmatched = 0;
     for(int k = 1; k <= r(); ++k)
@@ -846,23 +926,19 @@ trace(const array<Index,NMAX+1>& indices, int nind)
 
     Counter nc(new_is_);
 
-    //Set up ii pointers to link
-    //elements of res to appropriate
-    //elements of *this
-    int trace_ind = 0;
-    array<int*,NMAX+1> ii;
-    int n = 1;
-    for(int j = 1; j <= r(); ++j)
+    //Stride in the data of *this of each m!=1
+    //index of res (str) and of the traced indices
+    //stepped together (tstr)
+    SmallArray<int,NMAX+1> str(r()+1,0);
+    int tstr = 0, n = 1, s = 1;
+    for(int j = 1; j <= rn(); ++j)
         {
         if(traced[j])
-            ii[j] = &(trace_ind);
+            tstr += s;
         else
-            ii[j] = &(nc.i[n++]);
+            str[n++] = s;
+        s *= m(j);
         }
-
-    int one = 1;
-    for(int j = r()+1; j <= NMAX; ++j)
-        ii[j] = &one;
     
     //Create the new dat
     boost::intrusive_ptr<ITDat> np = new ITDat(alloc_size);
@@ -871,15 +947,12 @@ trace(const array<Index,NMAX+1>& indices, int nind)
     const Vector& thisdat = p->v;
     for(; nc.notDone(); ++nc)
         {
+        int off = 1;
+        for(int k = 1; k <= nc.rn_; ++k)
+            off += (nc.i[k]-1)*str[k];
         Real newval = 0;
-        for(trace_ind = 1; trace_ind <= tm; ++trace_ind)
-            {
-            newval += 
-            thisdat(this->_ind(*ii[1],*ii[2],
-                               *ii[3],*ii[4],
-                               *ii[5],*ii[6],
-                               *ii[7],*ii[8]));
-            }
+        for(int t = 0; t < tm; ++t)
+            newval += thisdat(off+t*tstr);
         resdat(nc.ind) = newval;
         }
 
@@ -967,34 +1040,85 @@ expandIndex(const Index& small, const Index& big, int start)
     ITensor res(indices);
     res.scale_ = scale_;
 
-    //Big Index not guaranteed
-    //to remain at position w
-    //e.g. if some m==1 Indices
-    //get moved to the back
-    w = res.findindex(big);
+    //For each value of the indices stored after small, the
+    //elements are a block of inner*small.m() numbers, copied
+    //into the range of big starting at start
+    const int inner = innerSize(small),
+              sm = small.m(),
+              bm = big.m(),
+              outer = vecSize()/(inner*sm);
+    const Real* from = p->v.Store();
+    Real* to = res.p->v.Store() + start*inner;
+    for(int o = 0; o < outer; ++o)
+        {
+        std::copy(from,from+inner*sm,to);
+        from += inner*sm;
+        to += inner*bm;
+        }
 
-    array<int,NMAX+1> inc;
-    //Make sure all other inc's are zero
-    inc.assign(0);
-    inc.at(w) = start;
+    this->swap(res);
+    }
 
-    Counter c; 
-    initCounter(c);
+void ITensor::
+sliceIndex(const Index& big, const Index& small, int start)
+    {
+    if(small.m() > big.m() || start+small.m() > big.m())
+        Error("sliceIndex: small does not fit in big");
 
-    const Vector& thisdat = p->v;
-    Vector& resdat = res.p->v;
-    for(; c.notDone(); ++c)
+    vector<Index> indices; 
+    indices.reserve(r());
+    bool found = false;
+    for(int j = 1; j <= r(); ++j)
+        {
+        if(index(j) == big)
+            {
+            found = true;
+            indices.push_back(small);
+            }
+        else 
+            {
+            indices.push_back(index(j));
+            }
+        }
+
+    if(!found)
+        {
+        Print(*this);
+        Print(big);
+        Error("couldn't find index");
+        }
+
+    ITensor res(indices);
+    res.scale_ = scale_;
+
+    //The inverse of the copies of expandIndex
+    const int inner = innerSize(big),
+              sm = small.m(),
+              bm = big.m(),
+              outer = vecSize()/(inner*bm);
+    const Real* from = p->v.Store() + start*inner;
+    Real* to = res.p->v.Store();
+    for(int o = 0; o < outer; ++o)
         {
-        resdat(res._ind(c.i[1]+inc[1],c.i[2]+inc[2],
-                        c.i[3]+inc[3],c.i[4]+inc[4],
-                        c.i[5]+inc[5],c.i[6]+inc[6],
-                        c.i[7]+inc[7],c.i[8]+inc[8]))
-        = thisdat(c.ind);
+        std::copy(from,from+inner*sm,to);
+        from += inner*bm;
+        to += inner*sm;
         }
 
     this->swap(res);
     }
 
+//Number of elements for each value of I and of the
+//indices after it (the stride of I if m != 1)
+int ITensor::
+innerSize(const Index& I) const
+    {
+    int inner = 1;
+    for(int k = 1; k <= rn() && !(index(k) == I); ++k) 
+        inner *= m(k);
+    return inner;
+    }
+
 int ITensor::
 vecSize() const 
     { 
@@ -1025,6 +1149,42 @@ assignToVec(VectorRef v) const
     v *= scale_.real();
     }
 
+void ITensor::
+assignToVec(VectorRef v, const ITensor& order) const
+    {
+    if(order.is_.uniqueId() != is_.uniqueId())
+        {
+        Print(*this); Print(order);
+        Error("assignToVec: indices not the same"); 
+        }
+    if(p->v.Length() != v.Length()) 
+        Error("ITensor::assignToVec bad size");
+    if(scale_.isRealZero()) 
+        {
+        v *= 0;
+        return;
+        }
+    ITENSOR_CHECK_NULL
+
+    Permutation P; 
+    order.is_.getperm(is_,P);
+    if(P.is_trivial())
+        {
+        v = p->v;
+        }
+    else if(v.Stride() == 1 && v.Scale() == 1)
+        {
+        permuteDat(P,v.Store());
+        }
+    else
+        {
+        Vector pdat;
+        reshapeDat(P,pdat);
+        v = pdat;
+        }
+    v *= scale_.real();
+    }
+
 void ITensor::
 assignFromVec(const VectorRef& v)
     {
@@ -1054,164 +1214,24 @@ reshapeDat(const Permutation& P, Vector& rdat) const
         }
 
     rdat.ReDimension(thisdat.Length());
-    rdat = 0;
-
-    const Permutation::int9& ind = P.ind();
-
-    //Make a counter for thisdat
-    Counter c; 
-    initCounter(c);
-    array<int,NMAX+1> n;
-    for(int j = 1; j <= c.rn_; ++j) n[ind[j]] = c.n[j];
-
-    //Special case loops
-#define Loop6(q,z,w,k,y,s) {for(int i1 = 1; i1 <= n[1]; ++i1) for(int i2 = 1; i2 <= n[2]; ++i2)\
-	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4) for(int i5 = 1; i5 <= n[5]; ++i5)\
-    for(int i6 = 1; i6 <= n[6]; ++i6)\
-    rdat( (((((i6-1)*n[5]+i5-1)*n[4]+i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) =\
-    thisdat( (((((s-1)*c.n[5]+y-1)*c.n[4]+k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
+    permuteDat(P,rdat.Store());
 
-#define Loop5(q,z,w,k,y) {for(int i1 = 1; i1 <= n[1]; ++i1) for(int i2 = 1; i2 <= n[2]; ++i2)\
-	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4) for(int i5 = 1; i5 <= n[5]; ++i5)\
-    rdat( ((((i5-1)*n[4]+i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( ((((y-1)*c.n[4]+k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
-
-#define Loop4(q,z,w,k) {for(int i1 = 1; i1 <= n[1]; ++i1)  for(int i2 = 1; i2 <= n[2]; ++i2)\
-	for(int i3 = 1; i3 <= n[3]; ++i3) for(int i4 = 1; i4 <= n[4]; ++i4)\
-	rdat( (((i4-1)*n[3]+i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( (((k-1)*c.n[3]+w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
-
-#define Loop3(q,z,w) {for(int i1 = 1; i1 <= n[1]; ++i1)  for(int i2 = 1; i2 <= n[2]; ++i2)\
-	for(int i3 = 1; i3 <= n[3]; ++i3) rdat( ((i3-1)*n[2]+i2-1)*n[1]+i1 ) = thisdat( ((w-1)*c.n[2]+z-1)*c.n[1]+q ); return; }
-
-#define Bif3(a,b,c) if(ind[1] == a && ind[2] == b && ind[3] == c)
-
-#define Bif4(a,b,c,d) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4] == d)
-
-#define Bif5(a,b,c,d,e) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e)
+    } // ITensor::reshapeDat
 
-#define Bif6(a,b,c,d,e,g) if(ind[1] == a && ind[2] == b && ind[3] == c && ind[4]==d && ind[5] == e && ind[6] == g)
+void ITensor::
+permuteDat(const Permutation& P, Real* rdat) const
+    {
+    ProfileScope ps("ITensor::reshapeDat",Profiler::Permute,0,2.*sizeof(Real)*p->v.Length());
 
-    if(rn() == 2 && ind[1] == 2 && ind[2] == 1)
+    SmallArray<int,NMAX> dims(r()), dest(r());
+    for(int j = 1; j <= r(); ++j) 
         {
-        MatrixRef xref; 
-        thisdat.TreatAsMatrix(xref,c.n[2],c.n[1]);
-        rdat = Matrix(xref.t()).TreatAsVector();
-        return; 
+        dims[j-1] = m(j);
+        dest[j-1] = P.dest(j)-1;
         }
-    else if(rn() == 3)
-        {
-        DO_IF_PS(int idx = ((ind[1]-1)*3+ind[2]-1)*3+ind[3]; Prodstats::stats().perms_of_3[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif3(2,1,3) Loop3(i2,i1,i3)
-        Bif3(2,3,1) Loop3(i2,i3,i1) //cyclic
-        Bif3(3,1,2) Loop3(i3,i1,i2)
-        //Bif3(1,3,2) Loop3(i1,i3,i2)
-        //Bif3(3,2,1) Loop3(i3,i2,i1)
-        }
-    else if(rn() == 4)
-        {
-        DO_IF_PS(int idx = (((ind[1]-1)*4+ind[2]-1)*4+ind[3]-1)*4+ind[4]; Prodstats::stats().perms_of_4[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif4(1,2,4,3) Loop4(i1,i2,i4,i3)
-        Bif4(1,3,2,4) Loop4(i1,i3,i2,i4)
-        Bif4(2,3,1,4) Loop4(i2,i3,i1,i4)
-        Bif4(2,3,4,1) Loop4(i2,i3,i4,i1) //cyclic
-        Bif4(1,4,2,3) Loop4(i1,i4,i2,i3)
-        Bif4(2,1,3,4) Loop4(i2,i1,i3,i4)
-        Bif4(2,1,4,3) Loop4(i2,i1,i4,i3)
-        Bif4(3,4,1,2) Loop4(i3,i4,i1,i2)
-        }
-    else if(rn() == 5)
-        {
-        DO_IF_PS(int idx = ((((ind[1]-1)*5+ind[2]-1)*5+ind[3]-1)*5+ind[4]-1)*5+ind[5]; Prodstats::stats().perms_of_5[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif5(3,1,4,5,2) Loop5(i3,i1,i4,i5,i2)
-        Bif5(1,4,2,5,3) Loop5(i1,i4,i2,i5,i3)
-        Bif5(1,4,2,3,5) Loop5(i1,i4,i2,i3,i5)
-        Bif5(3,1,4,2,5) Loop5(i3,i1,i4,i2,i5)
-        Bif5(2,4,1,3,5) Loop5(i2,i4,i1,i3,i5)
-        Bif5(2,4,3,5,1) Loop5(i2,i4,i3,i5,i1)
-        Bif5(3,1,4,5,2) Loop5(i3,i1,i4,i5,i2)
-        Bif5(3,4,1,2,5) Loop5(i3,i4,i1,i2,i5)
-        Bif5(2,1,3,4,5) Loop5(i2,i1,i3,i4,i5)
-        Bif5(2,3,4,5,1) Loop5(i2,i3,i4,i5,i1)
-        Bif5(2,3,4,1,5) Loop5(i2,i3,i4,i1,i5)
-        Bif5(2,3,1,4,5) Loop5(i2,i3,i1,i4,i5)
-        Bif5(2,3,4,1,5) Loop5(i2,i3,i4,i1,i5)
-        Bif5(3,4,1,5,2) Loop5(i3,i4,i1,i5,i2)
-        Bif5(5,1,4,2,3) Loop5(i5,i1,i4,i2,i3)
-        }
-    else if(rn() == 6)
-        {
-        DO_IF_PS(int idx = (((((ind[1]-1)*6+ind[2]-1)*6+ind[3]-1)*6+ind[4]-1)*6+ind[5]-1)*6+ind[6]; Prodstats::stats().perms_of_6[idx] += 1; )
-        //Arranged loosely in order of frequency of occurrence
-        Bif6(2,4,1,3,5,6) Loop6(i2,i4,i1,i3,i5,i6)
-        Bif6(1,4,2,3,5,6) Loop6(i1,i4,i2,i3,i5,i6)
-        Bif6(2,4,1,5,3,6) Loop6(i2,i4,i1,i5,i3,i6)
-        Bif6(1,2,4,5,3,6) Loop6(i1,i2,i4,i5,i3,i6)
-        Bif6(3,4,1,5,6,2) Loop6(i3,i4,i1,i5,i6,i2)
-        }
-    DO_IF_PS(Prodstats::stats().c4 += 1;)
-
-    //The j's are pointers to the i's of xdat's Counter,
-    //but reordered in a way appropriate for rdat
-    array<int*,NMAX+1> j;
-    for(int k = 1; k <= NMAX; ++k) { j[ind[k]] = &(c.i[k]); }
-
-    //Catch-all loops that work for any tensor
-    switch(c.rn_)
-    {
-    case 2:
-        for(; c.notDone(); ++c)
-            {
-            rdat((*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    case 3:
-        for(; c.notDone(); ++c)
-            {
-            rdat(((*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    case 4:
-        for(; c.notDone(); ++c)
-            {
-            rdat((((*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    case 5:
-        for(; c.notDone(); ++c)
-            {
-            rdat(((((*j[5]-1)*n[4]+*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    case 6:
-        for(; c.notDone(); ++c)
-            {
-            rdat((((((*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    case 7:
-        for(; c.notDone(); ++c)
-            {
-            rdat(((((((*j[7]-1)*n[6]+*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    default:
-        for(; c.notDone(); ++c)
-            {
-            rdat((((((((*j[8]-1)*n[7]+*j[7]-1)*n[6]+*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]+*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-                = thisdat(c.ind);
-            }
-        return;
-    } //switch(c.rn_)
 
-    } // ITensor::reshapeDat
+    permuteCopy(r(),dims.begin(),dest.begin(),p->v.Store(),rdat);
+    }
 
 void ITensor::
 reshapeDat(const Permutation& P)
@@ -1263,19 +1283,150 @@ Randomize()
     p->v.Randomize(); 
     }
 
+//Position j of the ReIm Index among the m != 1
+//indices of t (0 if none), and the distance
+//between its two values in the data of t
+static int
+reImPosition(const ITensor& t, int& stride)
+    {
+    stride = 1;
+    for(int j = 1; j <= t.rn(); ++j)
+        {
+        if(t.index(j) == Index::IndReIm()) return j;
+        stride *= t.m(j);
+        }
+    return 0;
+    }
+
 void ITensor::
 SplitReIm(ITensor& re, ITensor& im) const
 	{
-	re = *this; im = *this;
-	if(!isComplex()) { im *= 0; return; }
-	//re *= Index::IndReIm()(1); im *= Index::IndReIm()(2);
-
-	re.mapindex(Index::IndReIm(),Index::IndReImP());
-	im.mapindex(Index::IndReIm(),Index::IndReImP());
-	re *= Index::IndReImP()(1);
-	im *= Index::IndReImP()(2);
+	if(!isComplex()) 
+        { 
+        re = *this; 
+        im = *this; 
+        im *= 0; 
+        return; 
+        }
+
+    //Copy out the two halves of each ReIm
+    //block, rather than contracting with
+    //ReIm(1) and ReIm(2)
+    int stride = 1;
+    const int k = reImPosition(*this,stride);
+
+    std::vector<Index> inds;
+    inds.reserve(r());
+    for(int j = 1; j <= r(); ++j)
+        if(j != k) inds.push_back(index(j));
+
+    const int n = vecSize()/2;
+    Vector rv(n), iv(n);
+    const Real* pv = p->v.Store();
+    Real* pr = rv.Store();
+    Real* pi = iv.Store();
+    for(int o = 0; o < n; o += stride)
+        {
+        std::copy(pv+2*o,pv+2*o+stride,pr+o);
+        std::copy(pv+2*o+stride,pv+2*o+2*stride,pi+o);
+        }
+
+    re = ITensor(inds,rv);
+    re.scale_ = scale_;
+    im = ITensor(inds,iv);
+    im.scale_ = scale_;
 	}
 
+void ITensor::
+JoinReIm(const ITensor& re, const ITensor& im)
+    {
+    if(re.isNull() && im.isNull())
+        Error("ITensor::JoinReIm: both parts null");
+    if(re.isComplex() || im.isComplex())
+        Error("ITensor::JoinReIm: parts must be real");
+
+    //The result has the index order of f, with ReIm
+    //as its last m != 1 Index, so that the real and
+    //imaginary parts are consecutive blocks of the data
+    const ITensor& f = (re.isNotNull() ? re : im);
+    if(re.isNotNull() && im.isNotNull()
+       && re.is_.uniqueId() != im.is_.uniqueId())
+        {
+        Error("ITensor::JoinReIm: parts have different indices");
+        }
+
+    LogNumber scale = f.scale_;
+    if(re.isNotNull() && im.isNotNull() && re.scale_.magnitudeLessThan(im.scale_))
+        scale = im.scale_;
+    if(scale.sign() == 0) scale = LogNumber(1);
+
+    const int n = f.vecSize();
+    Vector v(2*n);
+    v = 0;
+    const ITensor* part[] = { &re, &im };
+    for(int q = 0; q < 2; ++q)
+        {
+        const ITensor& t = *part[q];
+        if(t.isNull() || t.scale_.sign() == 0) continue;
+
+        Real* dest = v.Store() + q*n;
+        const Real* src = t.p->v.Store();
+
+        bool same_ind_order = true;
+        for(int j = 1; j <= f.rn(); ++j)
+            if(t.index(j) != f.index(j)) 
+                { 
+                same_ind_order = false; 
+                break; 
+                }
+
+        if(same_ind_order)
+            {
+            std::copy(src,src+n,dest);
+            }
+        else
+            {
+            Permutation P;
+            f.is_.getperm(t.is_,P);
+            SmallArray<int,NMAX> dims(f.rn()), pdest(f.rn());
+            for(int k = 1; k <= f.rn(); ++k)
+                {
+                dims[k-1] = t.m(k);
+                pdest[k-1] = P.dest(k)-1;
+                }
+            permuteCopy(f.rn(),dims.begin(),pdest.begin(),src,dest);
+            }
+
+        const Real fac = (t.scale_/scale).real0();
+        if(fac != 1)
+            for(int i = 0; i < n; ++i) dest[i] *= fac;
+        }
+
+    std::vector<Index> inds;
+    inds.reserve(f.r()+1);
+    for(int j = 1; j <= f.r(); ++j)
+        inds.push_back(f.index(j));
+    inds.push_back(Index::IndReIm());
+
+    *this = ITensor(inds,v);
+    scale_ = scale;
+    }
+
+void ITensor::
+conj()
+    {
+    if(!isComplex()) return;
+    solo();
+    //Negate the imaginary half of each ReIm block
+    int stride = 1;
+    reImPosition(*this,stride);
+    Real* pv = p->v.Store();
+    const int n = vecSize();
+    for(int o = 0; o < n; o += 2*stride)
+        for(int i = o+stride; i < o+2*stride; ++i) 
+            pv[i] = -pv[i];
+    }
+
 Real ITensor::
 sumels() const 
     { return p->v.sumels() * scale_.real0(); }
@@ -1440,10 +1591,10 @@ _ind8(const IndexVal& iv1, const IndexVal& iv2,
     {
     array<const IndexVal*,NMAX+1> iv = 
         {{ 0, &iv1, &iv2, &iv3, &iv4, &iv5, &iv6, &iv7, &iv8 }};
-    array<int,NMAX+1> ja; ja.assign(1);
+    SmallArray<int,NMAX+1> ja(max(r(),NMAX)+1,1);
     //Loop over the given IndexVals
     int j = 1, nn = 0;
-    while(iv[j]->ind != Index::Null())
+    while(j <= NMAX && iv[j]->ind != Index::Null())
         {
         //Loop over indices of this ITensor
         bool matched = false;
@@ -1486,7 +1637,7 @@ struct ProductProps
     ProductProps(const ITensor& L, const ITensor& R);
 
     //arrays specifying which indices match
-    array<bool,NMAX+1> contractedL, contractedR; 
+    SmallArray<bool,NMAX+1> contractedL, contractedR; 
 
     int nsamen, //number of m !=1 indices that match
         cdim,   //total dimension of contracted inds
@@ -1515,8 +1666,10 @@ ProductProps(const ITensor& L, const ITensor& R)
     lcstart(100), 
     rcstart(100)
     {
-    for(int j = 1; j <= NMAX; ++j) 
-        contractedL[j] = contractedR[j] = false;
+    contractedL.resize(max(L.rn(),NMAX)+1);
+    contractedR.resize(max(R.rn(),NMAX)+1);
+    contractedL.assign(false);
+    contractedR.assign(false);
 
     for(int j = 1; j <= L.rn(); ++j)
 	for(int k = 1; k <= R.rn(); ++k)
@@ -1617,6 +1770,7 @@ toMatrixProd(const ITensor& L, const ITensor& R, ProductProps& props,
 
         if(L_is_matrix) Error("Calling reshapeDat although L is matrix.");
         Vector lv; L.reshapeDat(props.pl,lv);
+        ProdCopyCount::add(long(sizeof(Real))*lv.Length());
         lv.TreatAsMatrix(lref,props.odimL,props.cdim); lref.ApplyTrans();
         }
 
@@ -1636,23 +1790,232 @@ toMatrixProd(const ITensor& L, const ITensor& R, ProductProps& props,
 
         if(R_is_matrix) Error("Calling reshape even though R is matrix.");
         Vector rv; R.reshapeDat(props.pr,rv);
+        ProdCopyCount::add(long(sizeof(Real))*rv.Length());
         rv.TreatAsMatrix(rref,props.odimR,props.cdim);
         }
 
-#ifdef COLLECT_PRODSTATS
-    if(L.rn() > R.rn()) 
+    }
+
+//Smallest leading dimension for which an operand whose
+//contracted indices sit between free indices is multiplied
+//as a batch of GEMMs, rather than being permuted first
+static const int
+minBatchedGemmDim = 8;
+
+//
+// Position of the contracted indices of one operand
+// of a product, relative to a chosen order of contraction.
+// pre and post are the total dimensions of the free
+// indices before and after the contracted ones.
+//
+namespace {
+
+struct OperandLayout
+    {
+    enum Kind { Front, Back, Middle, Scattered };
+
+    Kind kind;
+    int pre, post;
+
+    OperandLayout(const ITensor& T, const int* pos, int n);
+    };
+
+OperandLayout::
+OperandLayout(const ITensor& T, const int* pos, int n)
+    : kind(Scattered), pre(1), post(1)
+    {
+    if(n == 0)
         {
-        ++(Prodstats::stats().global[std::make_pair(L.rn(),R.rn())]);
+        kind = Back;
+        for(int j = 1; j <= T.rn(); ++j) pre *= T.m(j);
+        return;
         }
-    else 
+    for(int i = 1; i < n; ++i)
+        if(pos[i] != pos[0]+i) return;
+
+    for(int j = 1; j < pos[0]; ++j) pre *= T.m(j);
+    for(int j = pos[n-1]+1; j <= T.rn(); ++j) post *= T.m(j);
+
+    if(pre == 1)       kind = Front;
+    else if(post == 1) kind = Back;
+    else               kind = Middle;
+    }
+
+} //namespace
+
+//Decides which operands to permute before multiplying,
+//given their layouts; returns the number of bytes copied
+static long
+decidePermute(const OperandLayout& l, const OperandLayout& r,
+              int sizeL, int sizeR, bool& permL, bool& permR)
+    {
+    const bool batchL = (l.kind == OperandLayout::Middle && l.pre >= minBatchedGemmDim),
+               batchR = (r.kind == OperandLayout::Middle && r.pre >= minBatchedGemmDim);
+    permL = (l.kind == OperandLayout::Scattered || (l.kind == OperandLayout::Middle && !batchL));
+    permR = (r.kind == OperandLayout::Scattered || (r.kind == OperandLayout::Middle && !batchR));
+
+    //At most one operand can be batched
+    if(batchL && batchR)
         {
-        ++(Prodstats::stats().global[std::make_pair(R.rn(),L.rn())]);
+        if(sizeL <= sizeR) permL = true;
+        else               permR = true;
         }
-    ++Prodstats::stats().total;
-    if(L_is_matrix) ++Prodstats::stats().did_matrix;
-    if(R_is_matrix) ++Prodstats::stats().did_matrix;
-#endif
 
+    return long(sizeof(Real))*((permL ? sizeL : 0) + (permR ? sizeR : 0));
+    }
+
+//Copies the m!=1 data of T into res, with the indices
+//at positions pos[0],...,pos[n-1] moved to the front
+static void
+contractedToFront(const ITensor& T, const Vector& dat,
+                  const int* pos, int n, Vector& res)
+    {
+    ProfileScope ps("contractedToFront",Profiler::Permute,0,2.*sizeof(Real)*dat.Length());
+
+    SmallArray<int,NMAX> dims(T.rn()), dest(T.rn());
+    SmallArray<bool,NMAX+1> moved(T.rn()+1);
+    for(int j = 1; j <= T.rn(); ++j)
+        {
+        dims[j-1] = T.m(j);
+        moved[j] = false;
+        }
+    for(int i = 0; i < n; ++i)
+        {
+        dest[pos[i]-1] = i;
+        moved[pos[i]] = true;
+        }
+    int q = n;
+    for(int j = 1; j <= T.rn(); ++j)
+        if(!moved[j]) dest[j-1] = q++;
+
+    res.ReDimension(dat.Length());
+    permuteCopy(T.rn(),dims.begin(),dest.begin(),dat.Store(),res.Store());
+    ProdCopyCount::add(long(sizeof(Real))*dat.Length());
+    }
+
+void ITensor::
+matrixMultiply(const ITensor& other, const ProductProps& props,
+               Vector& res) const
+    {
+    const int n = props.nsamen;
+    const Vector &Ldat = p->v, &Rdat = other.p->v;
+
+    ProfileScope ps("ITensor::matrixMultiply",Profiler::Product,
+                    2.*props.cdim*props.odimL*props.odimR,
+                    sizeof(Real)*(Ldat.Length()+Rdat.Length()+Real(props.odimL)*props.odimR));
+
+    //Positions of the contracted indices in
+    //*this (lpos) and other (rpos), first in
+    //the order they appear in *this...
+    SmallArray<int,NMAX> lpos(n), rpos(n);
+    for(int j = 1; j <= rn(); ++j)
+        if(props.contractedL[j]) lpos[props.pl.dest(j)-1] = j;
+    for(int k = 1; k <= other.rn(); ++k)
+        if(props.contractedR[k]) rpos[props.pr.dest(k)-1] = k;
+    OperandLayout l(*this,lpos.begin(),n),
+                  r(other,rpos.begin(),n);
+
+    //...then in the order they appear in other
+    SmallArray<int,NMAX> lposR(n), rposR(n);
+    int q = 0;
+    for(int k = 1; k <= other.rn(); ++k)
+        {
+        if(!props.contractedR[k]) continue;
+        rposR[q] = k;
+        lposR[q] = lpos[props.pr.dest(k)-1];
+        ++q;
+        }
+    OperandLayout lR(*this,lposR.begin(),n),
+                  rR(other,rposR.begin(),n);
+
+    //Decide which operands get permuted
+    //for a given order of contraction
+    bool permL = false, permR = false,
+         permLR = false, permRR = false;
+    const long costL = decidePermute(l,r,Ldat.Length(),Rdat.Length(),permL,permR),
+               costR = decidePermute(lR,rR,Ldat.Length(),Rdat.Length(),permLR,permRR);
+    if(costR < costL)
+        {
+        l = lR; r = rR;
+        permL = permLR; permR = permRR;
+        lpos.swap(lposR);
+        rpos.swap(rposR);
+        }
+
+    Vector lperm, rperm;
+    if(permL)
+        {
+        contractedToFront(*this,Ldat,lpos.begin(),n,lperm);
+        l.kind = OperandLayout::Front;
+        }
+    if(permR)
+        {
+        contractedToFront(other,Rdat,rpos.begin(),n,rperm);
+        r.kind = OperandLayout::Front;
+        }
+    const Vector &lv = (permL ? lperm : Ldat),
+                 &rv = (permR ? rperm : Rdat);
+
+    const int cdim = props.cdim,
+              odimL = props.odimL,
+              odimR = props.odimR;
+
+    //Result is an odimR x odimL matrix (row major),
+    //computed as rref*lref: rref is odimR x cdim
+    //and lref is cdim x odimL
+    res.ReDimension(odimL*odimR);
+    MatrixRef nref;
+    res.TreatAsMatrix(nref,odimR,odimL);
+
+    if(l.kind == OperandLayout::Middle)
+        {
+        //Batch over the free indices following the contracted ones
+        MatrixRefNoLink rref;
+        if(r.kind == OperandLayout::Front)
+            { rv.TreatAsMatrix(rref,odimR,cdim); }
+        else
+            { rv.TreatAsMatrix(rref,cdim,odimR); rref.ApplyTrans(); }
+
+        const int a = l.pre,
+                  slice = a*cdim;
+        for(int b = 0; b < l.post; ++b)
+            {
+            MatrixRefNoLink lref;
+            lv.SubVector(b*slice+1,(b+1)*slice).TreatAsMatrix(lref,cdim,a);
+            MatrixRef nsub = nref.Columns(b*a+1,(b+1)*a);
+            nsub = rref*lref;
+            }
+        return;
+        }
+
+    MatrixRefNoLink lref;
+    if(l.kind == OperandLayout::Front)
+        { lv.TreatAsMatrix(lref,odimL,cdim); lref.ApplyTrans(); }
+    else
+        { lv.TreatAsMatrix(lref,cdim,odimL); }
+
+    if(r.kind == OperandLayout::Middle)
+        {
+        const int x = r.pre,
+                  slice = x*cdim;
+        for(int y = 0; y < r.post; ++y)
+            {
+            MatrixRefNoLink rref;
+            rv.SubVector(y*slice+1,(y+1)*slice).TreatAsMatrix(rref,cdim,x);
+            rref.ApplyTrans();
+            MatrixRef nsub = nref.Rows(y*x+1,(y+1)*x);
+            nsub = rref*lref;
+            }
+        return;
+        }
+
+    MatrixRefNoLink rref;
+    if(r.kind == OperandLayout::Front)
+        { rv.TreatAsMatrix(rref,odimR,cdim); }
+    else
+        { rv.TreatAsMatrix(rref,cdim,odimR); rref.ApplyTrans(); }
+
+    nref = rref*lref;
     }
 
 
@@ -1669,7 +2032,7 @@ operator/=(const ITensor& other)
     //These hold the indices from other 
     //that will be added to this->index_
     int nr1_ = 0;
-    static array<const Index*,NMAX+1> extra_index1_;
+    SmallArray<const Index*,NMAX+1> extra_index1_(other.r()+1);
 
     //------------------------------------------------------------------
     //Handle m==1 Indices: set union
@@ -1688,18 +2051,19 @@ operator/=(const ITensor& other)
         if(!this_has_index) extra_index1_[++nr1_] = &J;
         }
 
-    static array<Index,NMAX+1> new_index_;
+    IndexArray new_index_(max(r()+other.r(),NMAX)+1);
 
     if(other.rn() == 0)
         {
         scale_ *= other.scale_;
         scale_ *= other.p->v(1);
+        is_.index_.grow(is_.r_+nr1_+1);
         for(int j = 1; j <= nr1_; ++j) 
             { 
             is_.index_[is_.r_+j] = *(extra_index1_[j]); 
             }
         is_.r_ += nr1_;
-        is_.setUniqueReal();
+        is_.setUniqueId();
         return *this;
         }
     else if(rn() == 0)
@@ -1729,7 +2093,7 @@ operator/=(const ITensor& other)
             }
         is_.r_ += nr1_;
         is_.index_.swap(new_index_);
-        is_.setUniqueReal();
+        is_.setUniqueId();
         return *this;
         }
 
@@ -1753,9 +2117,6 @@ operator/=(const ITensor& other)
     for(int i = 1; i <= ni; ++i)
         { thisdat(((j-1)*nk+k-1)*ni+i) =  R(k,j) * L(j,i); }
 
-    if((is_.r() + other.is_.rn() - props.nsamen + nr1_) > NMAX) 
-        Error("ITensor::operator/=: too many indices in product.");
-
     //Handle m!=1 indices
     int nrn_ = 0;
     for(int j = 1; j <= is_.rn(); ++j)
@@ -1773,7 +2134,7 @@ operator/=(const ITensor& other)
     is_.rn_ = nrn_;
 
     is_.index_.swap(new_index_);
-    is_.setUniqueReal();
+    is_.setUniqueId();
     
     scale_ *= other.scale_;
 
@@ -1795,7 +2156,7 @@ ind4(int i4, int m3, int i3, int m2, int i2, int m1, int i1)
 
 void ITensor::
 directMultiply(const ITensor& other, ProductProps& props, 
-               int& new_rn_, array<Index,NMAX+1>& new_index_)
+               int& new_rn_, IndexArray& new_index_)
     {
     int am[NMAX+1], bm[NMAX+1], mcon[NMAX+1], mnew[NMAX+1];
     int *pa[NMAX+1], *pb[NMAX+1];
@@ -1844,7 +2205,7 @@ directMultiply(const ITensor& other, ProductProps& props,
         }
     if(props.nsamen > 4) Error("nsamen too big for this part!");
 
-    static Vector newdat;
+    Vector newdat;
     newdat.ReduceDimension(props.odimL*props.odimR);
 
     icon[1] = icon[2] = icon[3] = icon[4] = 1;
@@ -1918,7 +2279,7 @@ directMultiply(const ITensor& other, ProductProps& props,
 
 void ITensor::
 directMultiply(const ITensor& other, ProductProps& props, 
-               int& new_rn_, array<Index,NMAX+1>& new_index_)
+               int& new_rn_, IndexArray& new_index_)
     {
     //will count these up below
     int new_r_ = 0;
@@ -2026,36 +2387,39 @@ operator*=(const ITensor& other)
         return operator*=(cp_oth);
         }
 
+    ProdCopyCount::Call pc;
+
     if(this->isNull() || other.isNull())
         Error("Null ITensor in product");
 
     //Complex types are treated as just another index, of type ReIm
-    //Multiplication is handled automatically with these simple tensor helpers
+    //Products of two complex tensors are split into real products
     if(findindexn(Index::IndReIm()) && other.findindexn(Index::IndReIm()) && 
 	    !other.findindexn(Index::IndReImP()) && !other.hasindex(Index::IndReImPP()) 
 	    && !hasindex(Index::IndReImP()) && !hasindex(Index::IndReImPP()))
         {
-        static ITensor primer(Index::IndReIm(),Index::IndReImP(),1.0);
-        static ITensor primerP(Index::IndReIm(),Index::IndReImPP(),1.0);
-        static ITensor prod(Index::IndReIm(),Index::IndReImP(),Index::IndReImPP());
-        static bool first = true;
-        if(first)
-	    {
-            IndexVal iv0(Index::IndReIm(),1), iv1(Index::IndReImP(),1), iv2(Index::IndReImPP(),1);
-            iv0.i = 1; iv1.i = 1; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
-            iv0.i = 1; iv1.i = 2; iv2.i = 2; prod(iv0,iv1,iv2) = -1.0;
-            iv0.i = 2; iv1.i = 2; iv2.i = 1; prod(iv0,iv1,iv2) = 1.0;
-            iv0.i = 2; iv1.i = 1; iv2.i = 2; prod(iv0,iv1,iv2) = 1.0;
-            first = false;
-	    }
-        operator*=(primer);
-        operator*=(prod * (other * primerP));
+        //(a+ib)(c+id) using three real products:
+        //ac-bd and (a+b)(c+d)-ac-bd
+        ITensor a,b,c,d;
+        SplitReIm(a,b);
+        other.SplitReIm(c,d);
+        ITensor ac(a);
+        ac *= c;
+        ITensor bd(b);
+        bd *= d;
+        a += b;
+        c += d;
+        a *= c;
+        a -= ac;
+        a -= bd;
+        ac -= bd;
+        JoinReIm(ac,a);
         return *this;
         }
 
     //These hold  regular new indices and the m==1 indices that appear in the result
-    static array<Index,NMAX+1> new_index_;
-    static array<const Index*,NMAX+1> new_index1_;
+    IndexArray new_index_(max(r()+other.r(),NMAX)+1);
+    SmallArray<const Index*,NMAX+1> new_index1_(r()+other.r()+1);
     int nr1_ = 0;
 
     //
@@ -2089,16 +2453,11 @@ operator*=(const ITensor& other)
         scale_ *= other.scale_;
         scale_ *= other.p->v(1);
         is_.r_ = is_.rn_ + nr1_;
-        if(is_.r() > NMAX) 
-            {
-            std::cout << "new r_ would be = " << is_.r() << "\n";
-            std::cerr << "new r_ would be = " << is_.r() << "\n";
-            Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-            }
+        is_.index_.grow(is_.r_+1);
         //Keep current m!=1 indices, overwrite m==1 indices
         for(int j = 1; j <= nr1_; ++j) 
             is_.index_[is_.rn_+j] = *(new_index1_[j]);
-        is_.setUniqueReal();
+        is_.setUniqueId();
         return *this;
         }
     else if(rn() == 0)
@@ -2108,18 +2467,12 @@ operator*=(const ITensor& other)
         p = other.p;
         is_.rn_ = other.is_.rn_;
         is_.r_ = is_.rn_ + nr1_;
-        if(is_.r() > NMAX) 
-            {
-            std::cout << "new r_ would be = " << is_.r() << "\n";
-            std::cerr << "new r_ would be = " << is_.r() << "\n";
-            Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-            }
         for(int j = 1; j <= is_.rn(); ++j) 
             new_index_[j] = other.is_.index(j);
         for(int j = 1; j <= nr1_; ++j) 
             new_index_[is_.rn_+j] = *(new_index1_[j]);
         is_.index_.swap(new_index_);
-        is_.setUniqueReal();
+        is_.setUniqueId();
         return *this;
         }
 
@@ -2136,40 +2489,17 @@ operator*=(const ITensor& other)
     if(do_matrix_multiply)
     */
 
-    DO_IF_PS(++Prodstats::stats().c2;)
-    MatrixRefNoLink lref, rref;
-    bool L_is_matrix,R_is_matrix;
-    toMatrixProd(*this,other,props,lref,rref,L_is_matrix,R_is_matrix);
-
-    /*
-    if(!R_is_matrix && L_is_matrix) 
-        {
-        this->print("this");
-        other.print("other");
-        }
-        */
-
     //Do the matrix multiplication
+    Vector newdat;
+    matrixMultiply(other,props,newdat);
     if(p->count() != 1) 
         { 
         p = new ITDat(); 
         } 
-    p->v.ReDimension(rref.Nrows()*lref.Ncols());
-    MatrixRef nref; p->v.TreatAsMatrix(nref,rref.Nrows(),lref.Ncols());
-    nref = rref*lref;
+    p->v.CopyDestroy(newdat);
 
     //Fill in new_index_
 
-    if((rn() + other.rn() - 2*props.nsamen + nr1_) > NMAX) 
-        {
-        Print(*this);
-        Print(other);
-        Print(props.nsamen);
-        cerr << "new m==1 indices\n";
-        for(int j = 1; j <= nr1_; ++j) cerr << *(new_index1_.at(j)) << "\n";
-        Error("ITensor::operator*=: too many uncontracted indices in product (max is 8)");
-        }
-
     //Handle m!=1 indices
     for(int j = 1; j <= this->rn(); ++j)
         { if(!props.contractedL[j]) new_index_[++new_rn_] = index(j); }
@@ -2191,7 +2521,7 @@ operator*=(const ITensor& other)
         new_index_[++(is_.r_)] = *(new_index1_.at(j));
 
     is_.index_.swap(new_index_);
-    is_.setUniqueReal();
+    is_.setUniqueId();
 
     scale_ *= other.scale_;
 
@@ -2203,7 +2533,6 @@ operator*=(const ITensor& other)
         //Print(props.matchL);
         //other.reshape(props.matchL);
         //if(do_print) other.print("after",ShowData);
-        DO_IF_PS(++Prodstats::stats().c3;)
         }
         */
 
@@ -2212,6 +2541,267 @@ operator*=(const ITensor& other)
 
 
 
+namespace {
+
+//
+// A multi-index over some of the indices of a product of
+// small blocks, with the strides of each index in the two
+// arrays it runs over (first index fastest).
+//
+struct SmallWalk
+    {
+    int n,
+        size,
+        dim[NMAX],
+        s1[NMAX],
+        s2[NMAX];
+
+    SmallWalk() : n(0), size(1) { }
+
+    void
+    add(int m, int t1, int t2)
+        {
+        dim[n] = m;
+        s1[n] = t1;
+        s2[n] = t2;
+        size *= m;
+        ++n;
+        }
+
+    //Whether the elements are consecutive in both arrays
+    bool
+    contiguous() const
+        {
+        int s = 1;
+        for(int j = 0; j < n; ++j)
+            {
+            if(s1[j] != s || s2[j] != s) return false;
+            s *= dim[j];
+            }
+        return true;
+        }
+
+    //Moves the offsets o1, o2 to the next value of
+    //the multi-index i
+    void
+    step(int* i, int& o1, int& o2) const
+        {
+        for(int j = 0; j < n; ++j)
+            {
+            o1 += s1[j];
+            o2 += s2[j];
+            if(++i[j] < dim[j]) return;
+            o1 -= dim[j]*s1[j];
+            o2 -= dim[j]*s2[j];
+            i[j] = 0;
+            }
+        }
+    };
+
+//Elements of a tensor are stored with the first m != 1 index fastest
+int
+stride(const ITensor& T, int j)
+    {
+    int s = 1;
+    for(int k = 1; k < j; ++k) s *= T.m(k);
+    return s;
+    }
+
+//c[0..N) += r*l[0..N), with N fixed for the smallest sizes
+template <int N>
+inline void
+axpyFixed(Real* c, const Real* l, Real r)
+    {
+    for(int a = 0; a < N; ++a) c[a] += l[a]*r;
+    }
+
+inline void
+axpyN(int n, Real* c, const Real* l, Real r)
+    {
+    switch(n)
+        {
+        case 1: c[0] += l[0]*r; return;
+        case 2: axpyFixed<2>(c,l,r); return;
+        case 3: axpyFixed<3>(c,l,r); return;
+        case 4: axpyFixed<4>(c,l,r); return;
+        default: for(int a = 0; a < n; ++a) c[a] += l[a]*r;
+        }
+    }
+
+//
+// res += f * L*R, where A runs over the free indices of L
+// (into L and res), C over the contracted indices (into L
+// and R) and B over the free indices of R (into R and res).
+// When A is contiguous the innermost loop is an axpy.
+//
+void
+smallProduct(const SmallWalk& A, const SmallWalk& C, const SmallWalk& B,
+             Real f, const Real* L, const Real* R, Real* res)
+    {
+    const bool contiguous = A.contiguous();
+    int ib[NMAX] = { 0 }, ic[NMAX] = { 0 }, ia[NMAX] = { 0 };
+    int rb = 0, cb = 0;
+    for(int b = 0; b < B.size; ++b, B.step(ib,rb,cb))
+        {
+        int lc = 0, rc = 0;
+        for(int c = 0; c < C.size; ++c, C.step(ic,lc,rc))
+            {
+            const Real r = f*R[rb+rc];
+            if(r == 0) continue;
+            const Real* Lc = L + lc;
+            Real* Cb = res + cb;
+            if(contiguous)
+                {
+                axpyN(A.size,Cb,Lc,r);
+                continue;
+                }
+            int la = 0, ca = 0;
+            for(int a = 0; a < A.size; ++a, A.step(ia,la,ca))
+                Cb[ca] += Lc[la]*r;
+            }
+        }
+    }
+
+bool
+isComplexIndex(const Index& I)
+    {
+    return I.type() == ReIm;
+    }
+
+//Position of I among the m != 1 indices of T, or 0
+int
+findn(const ITensor& T, const Index& I)
+    {
+    for(int j = 1; j <= T.rn(); ++j)
+        if(T.index(j) == I) return j;
+    return 0;
+    }
+
+} //namespace
+
+bool
+sumSmallProducts(const std::vector<const ITensor*>& L,
+                 const std::vector<const ITensor*>& R,
+                 ITensor& res, int& nfirst)
+    {
+    const int maxsize = Global::smallProductSize();
+    const size_t np = L.size();
+    if(maxsize <= 0 || np == 0 || R.size() != np) return false;
+
+    //Check every product is small, and find the
+    //reference scale of the sum
+    int first = -1;
+    LogNumber ref;
+    for(size_t n = 0; n < np; ++n)
+        {
+        const ITensor &l = *L[n], &r = *R[n];
+        if(l.isNull() || r.isNull()) return false;
+        if(l.r() > NMAX || r.r() > NMAX) return false;
+        Real size = 1;
+        for(int j = 1; j <= l.r(); ++j)
+            {
+            if(isComplexIndex(l.index(j))) return false;
+            size *= l.m(j);
+            }
+        for(int k = 1; k <= r.r(); ++k)
+            {
+            if(isComplexIndex(r.index(k))) return false;
+            if(findn(l,r.index(k)) == 0) size *= r.m(k);
+            }
+        if(size > maxsize) return false;
+
+        if(l.scale().sign() == 0 || r.scale().sign() == 0) continue;
+        const LogNumber f = l.scale()*r.scale();
+        if(first < 0)
+            {
+            first = int(n);
+            ref = f;
+            }
+        //Relative factors must be well within the range of Real
+        else if(fabs(f.logNum()-ref.logNum()) > 200)
+            {
+            return false;
+            }
+        }
+
+    //Flops are counted below
+    ProfileScope ps("sumSmallProducts",Profiler::Product);
+
+    nfirst = first;
+    if(first < 0) return true;
+
+    //Indices of the result as in ITensor::operator*=: the
+    //uncontracted m != 1 indices of L then of R, then the
+    //m == 1 indices appearing in only one of them
+    const ITensor &l0 = *L[first], &r0 = *R[first];
+    ITensor C;
+    IndexArray& ci = C.is_.index_;
+    ci.grow(l0.r()+r0.r()+1);
+    int cr = 0, alloc_size = 1;
+    for(int j = 1; j <= l0.rn(); ++j)
+        if(findn(r0,l0.index(j)) == 0) 
+            {
+            ci[++cr] = l0.index(j);
+            alloc_size *= l0.m(j);
+            }
+    for(int k = 1; k <= r0.rn(); ++k)
+        if(findn(l0,r0.index(k)) == 0) 
+            {
+            ci[++cr] = r0.index(k);
+            alloc_size *= r0.m(k);
+            }
+    C.is_.rn_ = cr;
+    for(int j = l0.rn()+1; j <= l0.r(); ++j)
+        if(!r0.hasindex1(l0.index(j))) ci[++cr] = l0.index(j);
+    for(int k = r0.rn()+1; k <= r0.r(); ++k)
+        if(!l0.hasindex1(r0.index(k))) ci[++cr] = r0.index(k);
+    C.is_.r_ = cr;
+    C.is_.setUniqueId();
+    C.allocate(alloc_size);
+    Real* Cd = C.p->v.Store();
+
+    Real flops = 0;
+    for(size_t n = first; n < np; ++n)
+        {
+        const ITensor &l = *L[n], &r = *R[n];
+        if(l.scale().sign() == 0 || r.scale().sign() == 0) continue;
+        const Real f = (l.scale()*r.scale()/ref).real();
+
+        SmallWalk A, Cn, B;
+        for(int j = 1; j <= l.rn(); ++j)
+            {
+            const Index& I = l.index(j);
+            const int k = findn(r,I);
+            if(k != 0) 
+                {
+                Cn.add(I.m(),stride(l,j),stride(r,k));
+                continue;
+                }
+            const int q = findn(C,I);
+            if(q == 0) Error("sumSmallProducts: result indices differ");
+            A.add(I.m(),stride(l,j),stride(C,q));
+            }
+        for(int k = 1; k <= r.rn(); ++k)
+            {
+            const Index& I = r.index(k);
+            if(findn(l,I) != 0) continue;
+            const int q = findn(C,I);
+            if(q == 0) Error("sumSmallProducts: result indices differ");
+            B.add(I.m(),stride(r,k),stride(C,q));
+            }
+
+        smallProduct(A,Cn,B,f,l.p->v.Store(),r.p->v.Store(),Cd);
+        flops += 2.*A.size*Cn.size*B.size;
+        }
+    ps.addFlops(flops);
+
+    C.scale_ = ref;
+    C.scaleOutNorm();
+    res.swap(C);
+    return true;
+    }
+
+
 ITensor& ITensor::
 operator+=(const ITensor& other)
     {
@@ -2229,9 +2819,9 @@ operator+=(const ITensor& other)
         }
     if(complex_this && !complex_other) return operator+=(other * ITensor::Complex_1());
 
-    if(fabs(is_.uniqueReal() - other.is_.uniqueReal()) > 1E-12)
+    if(is_.uniqueId() != other.is_.uniqueId())
         {
-        cerr << format("this ur = %.10f, other.ur = %.10f\n")%is_.uniqueReal()%other.is_.uniqueReal();
+        cerr << format("this key = %d, other key = %d\n")%is_.uniqueId()%other.is_.uniqueId();
         Print(*this);
         Print(other);
         Error("ITensor::operator+=: unique Reals don't match (different Index structure).");
@@ -2288,43 +2878,19 @@ operator+=(const ITensor& other)
         return *this; 
         }
 
-    Permutation P; 
+    //Add other's data permuted into our order
+    //in one pass, scaled by scalefac
+    ProfileScope ps("ITensor::operator+= permuted",Profiler::Permute,
+                    2.*othrdat.Length(),3.*sizeof(Real)*othrdat.Length());
+    Permutation P;
     is_.getperm(other.is_,P);
-    Counter c; other.initCounter(c);
-    int *j[NMAX+1];
-    for(int k = 1; k <= NMAX; ++k) j[P.dest(k)] = &(c.i[k]);
-    static int n[NMAX+1];
-    for(int k = 1; k <= NMAX; ++k) 
-        {
-        n[P.dest(k)] = c.n[k];
-        //n[k] = index_[k].m();
-        }
-
-#ifdef STRONG_DEBUG
-    //Real tot_this = thisdat.sumels();
-    //Real tot_othr = othrdat.sumels();
-#endif
-
-    if(scalefac == 1)
-        {
-        for(; c.notDone(); ++c)
-            {
-            thisdat((((((((*j[8]-1)*n[7]+*j[7]-1)*n[6]
-            +*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]
-            +*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-            += othrdat(c.ind);
-            }
-        }
-    else
+    SmallArray<int,NMAX> dims(rn()), dest(rn());
+    for(int k = 1; k <= rn(); ++k)
         {
-        for(; c.notDone(); ++c)
-            {
-            thisdat((((((((*j[8]-1)*n[7]+*j[7]-1)*n[6]
-            +*j[6]-1)*n[5]+*j[5]-1)*n[4]+*j[4]-1)*n[3]
-            +*j[3]-1)*n[2]+*j[2]-1)*n[1]+*j[1])
-            += scalefac * othrdat(c.ind);
-            }
+        dims[k-1] = other.m(k);
+        dest[k-1] = P.dest(k)-1;
         }
+    permuteAdd(rn(),dims.begin(),dest.begin(),scalefac,othrdat.Store(),thisdat.Store());
 
     /*
 #ifdef STRONG_DEBUG
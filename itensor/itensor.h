@@ -7,6 +7,7 @@
 #include "real.h"
 #include "index.h"
 #include "prodstats.h"
+#include "profiler.h"
 #include "indexset.h"
 
 #define ITENSOR_USE_ALLOCATOR
@@ -31,10 +32,10 @@ class ITensor
 
     //Accessor Methods ----------------------------------------------
 
-    //Returns a Real number that uniquely identifies this
+    //Returns an integer key that uniquely identifies this
     //ITensor's set of Index's (independent of their order).
-    Real 
-    uniqueReal() const { return is_.ur_; } 
+    IndexKey 
+    uniqueId() const { return is_.key_; } 
 
     //Get the jth index, j = 1,2,..,r()
     const Index& 
@@ -60,6 +61,11 @@ class ITensor
     bool 
     isNotNull() const { return (p != 0); }
 
+    //There is no complex element type: a complex ITensor
+    //is a real one with the extra Index IndReIm (m = 2),
+    //holding the real part at ReIm=1 and the imaginary
+    //part at ReIm=2. A product of two complex ITensors
+    //costs three real products (see operator*=).
     bool 
     isComplex() const { return hasindexn(Index::IndReIm()); }
 
@@ -116,7 +122,7 @@ class ITensor
     explicit 
     ITensor(const std::vector<Index>& I);
 
-    ITensor(const std::vector<Index>& I, const Vector& V);
+    ITensor(const std::vector<Index>& I, const VectorRef& V);
 
     ITensor(const std::vector<Index>& I, const ITensor& other);
 
@@ -132,6 +138,16 @@ class ITensor
 
     static const ITensor& 
     ConjTensor();
+
+    //Helpers for products of complex ITensors
+    static const ITensor& 
+    ReImPrimer();
+
+    static const ITensor& 
+    ReImPrimerP();
+
+    static const ITensor& 
+    ReImProd();
         
     void 
     read(std::istream& s);
@@ -264,6 +280,10 @@ class ITensor
     bool 
     hasindex1(const Index& I) const { return is_.hasindex1(I); }
 
+    bool
+    hasAllIndex(const IndexArray& I, int nind) const
+        { return is_.hasAllIndex(I,nind); }
+
     bool
     hasAllIndex(const boost::array<Index,NMAX+1>& I, int nind) const
         { return is_.hasAllIndex(I,nind); }
@@ -404,8 +424,13 @@ class ITensor
     // RiJ = Ai(jk) <-- Here J represents the grouped pair of indices (jk)
     //                  If j.m() == 5 and k.m() == 7, J.m() == 5*7.
     //
+    // When the indices are already next to each other in memory, in
+    // the order given, res shares the data of *this (J takes their
+    // place among the indices of res); otherwise the data is permuted
+    // once, with J after the other indices.
+    //
     void 
-    groupIndices(const boost::array<Index,NMAX+1>& indices, int nind, 
+    groupIndices(const IndexArray& indices, int nind, 
                       const Index& grouped, ITensor& res) const;
 
     //
@@ -414,6 +439,10 @@ class ITensor
     //
     // Rijl = Aijil <-- here we have tied the 1st and 3rd index of A
     //
+    void
+    tieIndices(const IndexArray& indices, int nind,
+               const Index& tied);
+
     void
     tieIndices(const boost::array<Index,NMAX+1>& indices, int nind,
                const Index& tied);
@@ -455,6 +484,9 @@ class ITensor
     // Rik = trace(j,l,m,Aijkml) = \sum_j Aijkjj
     //
 
+    void
+    trace(const IndexArray& indices, int nind);
+
     void
     trace(const boost::array<Index,NMAX+1>& indices, int nind);
 
@@ -507,6 +539,14 @@ class ITensor
     void 
     expandIndex(const Index& small, const Index& big, int start);
 
+    //
+    // sliceIndex is the inverse of expandIndex: it replaces big
+    // with small, keeping the elements with big = start+1...start+m
+    // (where m = small.m()).
+    //
+    void 
+    sliceIndex(const Index& big, const Index& small, int start);
+
     void 
     fromMatrix11(const Index& i1, const Index& i2, const Matrix& res);
 
@@ -556,6 +596,12 @@ class ITensor
     void 
     assignToVec(VectorRef v) const;
 
+    //Writes the elements into v in the order they have in
+    //order (which must have the same indices), permuting
+    //them directly into v rather than into a new ITensor
+    void 
+    assignToVec(VectorRef v, const ITensor& order) const;
+
     void 
     assignFromVec(const VectorRef& v);
 
@@ -594,12 +640,13 @@ class ITensor
     void 
     SplitReIm(ITensor& re, ITensor& im) const;
 
+    //Inverse of SplitReIm: set this to re + i*im.
+    //A null re or im is taken to be zero.
+    void
+    JoinReIm(const ITensor& re, const ITensor& im);
+
     void 
-    conj() 
-        { 
-        if(!isComplex()) return; 
-        operator/=(ITensor::ConjTensor()); 
-        }
+    conj();
 
     void 
     conj(const Index& I) { }
@@ -640,6 +687,7 @@ class ITensor
     operator<<(std::ostream & s, const ITensor & t);
 
     friend class commaInit;
+    friend class CheckpointWriter;
 
     typedef Index 
     IndexT;
@@ -679,6 +727,14 @@ class ITensor
     void 
     initCounter(Counter& C) const;
 
+    int
+    innerSize(const Index& I) const;
+
+    //Writes the data permuted by P to rdat,
+    //which must have room for vecSize() elements
+    void
+    permuteDat(const Permutation& P, Real* rdat) const;
+
     void 
     allocate(int dim);
 
@@ -698,9 +754,16 @@ class ITensor
                              MatrixRefNoLink& lref, MatrixRefNoLink& rref,
                              bool& L_is_matrix, bool& R_is_matrix);
 
+    //Contracts the data of *this with that of other, using
+    //GEMM calls on the data in place where possible.
+    //Result has the free indices of *this first.
+    void
+    matrixMultiply(const ITensor& other, const ProductProps& pp,
+                   Vector& res) const;
+
     void
     directMultiply(const ITensor& other, ProductProps& pp, 
-                   int& new_rn_, boost::array<Index,NMAX+1>& new_index_);
+                   int& new_rn_, IndexArray& new_index_);
 
     int _ind(int i1, int i2, int i3, int i4, 
              int i5, int i6, int i7, int i8) const;
@@ -718,6 +781,11 @@ class ITensor
     friend void 
     product(const ITSparse& S, const ITensor& T, ITensor& res);
 
+    friend bool
+    sumSmallProducts(const std::vector<const ITensor*>& L,
+                     const std::vector<const ITensor*>& R,
+                     ITensor& res, int& nfirst);
+
     public:
 
     // The ITmaker constructor is for making constant, global
@@ -735,7 +803,9 @@ class ITensor
 class Counter
     {
 public:
-    boost::array<int,NMAX+1> n, i;
+    //Sized to hold at least NMAX indices,
+    //more if the IndexSet has higher rank
+    SmallArray<int,NMAX+1> n, i;
     int ind;
     int rn_,r_;
 
@@ -834,7 +904,7 @@ public:
 
 private:
 
-    mutable unsigned int 
+    mutable boost::detail::atomic_count
     numref;
 
     //Must be dynamically allocated:
@@ -908,6 +978,25 @@ Dot(const ITensor& x, const ITensor& y);
 void 
 BraKet(const ITensor& x, const ITensor& y, Real& re, Real& im);
 
+//
+// Sets res to the sum of the products L[n]*R[n], which
+// must all have the same indices in the result, for
+// products of small blocks (as made by IQTensor contractions).
+// Instead of a matrix multiplication per product, each
+// product is added straight into res by loops specialized
+// for the smallest shapes.
+//
+// Returns false, leaving res unchanged, if some product has
+// more than Global::smallProductSize() multiply-adds, has a
+// complex index, or if the scale factors are too far apart
+// to be summed in one array. Otherwise nfirst is the first
+// n with a product not zero by its scale factors (-1 if none).
+//
+bool
+sumSmallProducts(const std::vector<const ITensor*>& L,
+                 const std::vector<const ITensor*>& R,
+                 ITensor& res, int& nfirst);
+
 inline ITensor 
 operator*(const IndexVal& iv1, const IndexVal& iv2) 
     { ITensor t(iv1); return (t *= iv2); }
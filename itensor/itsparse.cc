@@ -146,9 +146,9 @@ operator+=(const ITSparse& other)
         return *this;
         }
 
-    if(fabs(is_.uniqueReal() - other.is_.uniqueReal()) > 1E-12)
+    if(is_.uniqueId() != other.is_.uniqueId())
         {
-        cerr << format("this ur = %.10f, other.ur = %.10f\n")%is_.uniqueReal()%other.is_.uniqueReal();
+        cerr << format("this key = %d, other key = %d\n")%is_.uniqueId()%other.is_.uniqueId();
         Print(*this);
         Print(other);
         Error("ITSparse::operator+=: unique Reals don't match (different Index structure).");
@@ -294,6 +294,17 @@ write(std::ostream& s) const
     scale_.write(s);
     }
 
+//Position in the data of T of the element whose
+//index values are *ip[1],*ip[2],...,*ip[T.rn()]
+static int
+dataPos(const ITensor& T, const SmallArray<int*,NMAX+1>& ip)
+    {
+    int pos = 0;
+    for(int j = T.rn(); j >= 1; --j)
+        pos = pos*T.m(j) + *ip[j]-1;
+    return pos+1;
+    }
+
 void
 product(const ITSparse& S, const ITensor& T, ITensor& res)
     {
@@ -314,10 +325,8 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
     //The ri pointer does the same
     //but for res
     int one = 1;
-    array<int*,NMAX+1> ti,
-                       ri; 
-    ti.assign(&one);
-    ri.assign(&one);
+    SmallArray<int*,NMAX+1> ti(max(T.r(),NMAX)+1,&one),
+                            ri(max(S.r()+T.r(),NMAX)+1,&one); 
 
     //Index that will loop over 
     //the diagonal elems of S
@@ -326,7 +335,10 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
 
     //Create a Counter that only loops
     //over the free Indices of T
+    //(sized up front since ti and ri point into it)
     Counter tc;
+    tc.n.resize(ti.size());
+    tc.i.resize(ti.size());
     tc.n[0] = 0;
 
     res.is_.clear();
@@ -341,10 +353,8 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
     //
     // (scon is similar but for S)
     //
-    array<int,NMAX+1> tcon,
-                      scon;
-    tcon.assign(0);
-    scon.assign(0);
+    SmallArray<int,NMAX+1> tcon(T.r()+1,0),
+                           scon(S.r()+1,0);
     int ncon = 0; //number contracted
 
     //Analyze contracted Indices
@@ -450,7 +460,7 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
         }
 
     //Finish initting Counter tc
-    for(int k = tc.rn_+1; k <= NMAX; ++k)
+    for(int k = tc.rn_+1; k < tc.n.size(); ++k)
         {
         tc.n[k] = 1;
         }
@@ -470,14 +480,8 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
             for(; tc.notDone(); ++tc)
             for(diag_ind = 1; diag_ind <= dsize; ++diag_ind)
                 {
-                resdat(res._ind(*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8]))
-                 =  Tdat(T._ind(*ti[1],*ti[2],
-                                *ti[3],*ti[4],
-                                *ti[5],*ti[6],
-                                *ti[7],*ti[8]));
+                resdat(dataPos(res,ri))
+                 =  Tdat(dataPos(T,ti));
                 }
             }
         else
@@ -490,15 +494,9 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
                 for(diag_ind = 1; diag_ind <= dsize; ++diag_ind)
                     {
                     val +=
-                    Tdat(T._ind(*ti[1],*ti[2],
-                                *ti[3],*ti[4],
-                                *ti[5],*ti[6],
-                                *ti[7],*ti[8]));
+                    Tdat(dataPos(T,ti));
                     }
-                resdat(res._ind(*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8]))
+                resdat(dataPos(res,ri))
                 = val;
                 }
             }
@@ -512,15 +510,9 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
             for(; tc.notDone(); ++tc)
             for(diag_ind = 1; diag_ind <= dsize; ++diag_ind)
                 {
-                resdat(res._ind(*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8]))
+                resdat(dataPos(res,ri))
                  = S.diag_(diag_ind) 
-                   * Tdat(T._ind(*ti[1],*ti[2],
-                                 *ti[3],*ti[4],
-                                 *ti[5],*ti[6],
-                                 *ti[7],*ti[8]));
+                   * Tdat(dataPos(T,ti));
                 }
             }
         else
@@ -533,15 +525,9 @@ product(const ITSparse& S, const ITensor& T, ITensor& res)
                     {
                     val +=
                     S.diag_(diag_ind) 
-                    * Tdat(T._ind(*ti[1],*ti[2],
-                                  *ti[3],*ti[4],
-                                  *ti[5],*ti[6],
-                                  *ti[7],*ti[8]));
+                    * Tdat(dataPos(T,ti));
                     }
-                resdat(res._ind(*ri[1],*ri[2],
-                                *ri[3],*ri[4],
-                                *ri[5],*ri[6],
-                                *ri[7],*ri[8]))
+                resdat(dataPos(res,ri))
                 = val;
                 }
             }
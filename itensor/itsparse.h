@@ -59,9 +59,9 @@ class ITSparse
     int 
     m(int j) const { return is_.m(j); }
 
-    //uniqueReal depends on indices only, unordered:
-    Real 
-    uniqueReal() const { return is_.ur_; } 
+    //uniqueId depends on indices only, unordered:
+    IndexKey 
+    uniqueId() const { return is_.key_; } 
 
     bool 
     isComplex() const { return hasindexn(Index::IndReIm()); }
@@ -6,6 +6,7 @@
 #define __ITENSOR_LOCALMPO
 #include "mpo.h"
 #include "localop.h"
+#include "asyncio.h"
 
 //
 // The LocalMPO class projects an MPO 
@@ -56,6 +57,10 @@ class LocalMPO
     void
     product(const Tensor& phi, Tensor& phip) const;
 
+    //Estimated flops of product(phi,phip)
+    Real
+    productFlops(const Tensor& phi) const;
+
     Real
     expect(const Tensor& phi) const { return lop_.expect(phi); }
 
@@ -172,8 +177,14 @@ class LocalMPO
         do_write_ = val; 
         }
 
+    //Pending writes are finished first
     const std::string&
-    writeDir() const { return writedir_; }
+    writeDir() const { if(io_) io_->flush(); return writedir_; }
+
+    //Seconds spent waiting on disk I/O
+    //when doWrite() is true
+    Real
+    ioStallTime() const { return (io_ ? io_->stallTime() : 0); }
 
     static LocalMPO& Null()
         {
@@ -183,6 +194,9 @@ class LocalMPO
 
     private:
 
+    friend class CheckpointWriter;
+    friend class CheckpointReader;
+
     /////////////////
     //
     // Data Members
@@ -197,6 +211,7 @@ class LocalMPO
 
     bool do_write_;
     std::string writedir_;
+    boost::shared_ptr<AsyncIO> io_;
 
     const MPSt<Tensor>* Psi_;
 
@@ -313,6 +328,20 @@ product(const Tensor& phi, Tensor& phip) const
         }
     }
 
+template <class Tensor> inline
+Real LocalMPO<Tensor>::
+productFlops(const Tensor& phi) const
+    {
+    if(Op_ != 0) return lop_.productFlops(phi);
+    if(Psi_ == 0) Error("LocalMPO is null");
+
+    //Making the projector, then its overlap with phi
+    int b = position();
+    Contraction<Tensor> C;
+    C.add(L()).add(primelink(Psi_->AA(b))).add(primelink(Psi_->AA(b+1))).add(R());
+    return C.flops() + 2.*phi.vecSize();
+    }
+
 template <class Tensor>
 inline
 const Tensor& LocalMPO<Tensor>::
@@ -521,10 +550,10 @@ setLHlim(int val)
 
     if(LHlim_ != val && PH_.at(LHlim_).isNotNull())
         {
-        //std::cerr << boost::format("Writing PH(%d) to %s\n")%LHlim_%writedir_;
-        writeToFile(PHFName(LHlim_),PH_.at(LHlim_));
+        io_->put(PHFName(LHlim_),PH_.at(LHlim_));
         PH_.at(LHlim_) = Tensor();
         }
+    const bool forward = (val < LHlim_);
     LHlim_ = val;
     if(LHlim_ < 1) 
         {
@@ -534,18 +563,13 @@ setLHlim(int val)
         }
     if(PH_.at(LHlim_).isNull())
         {
-        std::string fname = PHFName(LHlim_);
-        std::ifstream s(fname.c_str());
-        if(s.good())
-            {
-            PH_.at(LHlim_).read(s);
-            s.close();
-            }
-        else
-            {
-            std::cerr << boost::format("Tried to read file %s\n")%fname;
-            Error("Missing file");
-            }
+        io_->get(PHFName(LHlim_),PH_.at(LHlim_));
+        }
+    //Read ahead the one needed next
+    const int nl = LHlim_-1;
+    if(forward && nl >= 1 && PH_.at(nl).isNull())
+        {
+        io_->prefetch(PHFName(nl));
         }
     }
 
@@ -561,10 +585,10 @@ setRHlim(int val)
 
     if(RHlim_ != val && PH_.at(RHlim_).isNotNull())
         {
-        //std::cerr << boost::format("Writing PH(%d) to %s\n")%RHlim_%writedir_;
-        writeToFile(PHFName(RHlim_),PH_.at(RHlim_));
+        io_->put(PHFName(RHlim_),PH_.at(RHlim_));
         PH_.at(RHlim_) = Tensor();
         }
+    const bool forward = (val > RHlim_);
     RHlim_ = val;
     if(RHlim_ > Op_->NN()) 
         {
@@ -574,18 +598,13 @@ setRHlim(int val)
         }
     if(PH_.at(RHlim_).isNull())
         {
-        std::string fname = PHFName(RHlim_);
-        std::ifstream s(fname.c_str());
-        if(s.good())
-            {
-            PH_.at(RHlim_).read(s);
-            s.close();
-            }
-        else
-            {
-            std::cerr << boost::format("Tried to read file %s\n")%fname;
-            Error("Missing file");
-            }
+        io_->get(PHFName(RHlim_),PH_.at(RHlim_));
+        }
+    //Read ahead the one needed next
+    const int nl = RHlim_+1;
+    if(forward && nl <= Op_->NN() && PH_.at(nl).isNull())
+        {
+        io_->prefetch(PHFName(nl));
         }
     }
 
@@ -595,6 +614,7 @@ initWrite()
     {
     std::string global_write_dir = Global::options().stringOrDefault("WriteDir","./");
     writedir_ = mkTempDir("PH",global_write_dir);
+    io_.reset(new AsyncIO(Global::options().intOrDefault("IOWindow",4)));
     //std::cout << "Successfully created directory " + writedir_ << std::endl;
     }
 
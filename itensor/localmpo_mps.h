@@ -75,6 +75,9 @@ class LocalMPO_MPS
     void
     doWrite(bool val);
 
+    Real
+    ioStallTime() const { return lmpo_.ioStallTime(); }
+
     static LocalMPO_MPS& Null()
         {
         static LocalMPO_MPS Null_;
@@ -6,6 +6,7 @@
 #define __ITENSOR_LOCALMPOSET
 #include "mpo.h"
 #include "localmpo.h"
+#include "threadpool.h"
 
 template <class Tensor>
 class LocalMPOSet
@@ -101,17 +102,41 @@ LocalMPOSet(const std::vector<MPOt<Tensor> >& Op)
         }
     }
 
+template <class Tensor>
+struct LocalMPOProduct
+    {
+    const std::vector<LocalMPO<Tensor> >& lmpo;
+    const Tensor& phi;
+    std::vector<Tensor>& phip;
+
+    LocalMPOProduct(const std::vector<LocalMPO<Tensor> >& lmpo_,
+                    const Tensor& phi_,
+                    std::vector<Tensor>& phip_)
+        : lmpo(lmpo_), phi(phi_), phip(phip_) { }
+
+    void
+    operator()(int n) const { lmpo.at(n+1).product(phi,phip.at(n)); }
+    };
+
 template <class Tensor>
 void inline LocalMPOSet<Tensor>::
 product(const Tensor& phi, Tensor& phip) const
     {
-    lmpo_.at(1).product(phi,phip);
+    //The products by each MPO run on the global ThreadPool
+    //if there are enough of them to keep it busy
+    const int nop = int(lmpo_.size())-1;
+    std::vector<Real> cost(nop);
+    for(int n = 0; n < nop; ++n)
+        {
+        cost[n] = lmpo_.at(n+1).productFlops(phi);
+        }
+    std::vector<Tensor> phi_n(nop);
+    ThreadPool::global().runByCost(cost,LocalMPOProduct<Tensor>(lmpo_,phi,phi_n));
 
-    Tensor phi_n;
-    for(size_t n = 2; n < lmpo_.size(); ++n)
+    phip = phi_n.at(0);
+    for(int n = 1; n < nop; ++n)
         {
-        lmpo_.at(n).product(phi,phi_n);
-        phip += phi_n;
+        phip += phi_n[n];
         }
     }
 
@@ -4,7 +4,7 @@
 //
 #ifndef __ITENSOR_LOCAL_OP
 #define __ITENSOR_LOCAL_OP
-#include "iqtensor.h"
+#include "contract.h"
 
 //
 // The LocalOp class represents
@@ -54,6 +54,10 @@ class LocalOp
     void
     product(const Tensor& phi, Tensor& phip) const;
 
+    //Estimated flops of product(phi,phip)
+    Real
+    productFlops(const Tensor& phi) const;
+
     Real
     expect(const Tensor& phi) const;
 
@@ -124,6 +128,7 @@ class LocalOp
         R_ = other.R_;
         combine_mpo_ = other.combine_mpo_;
         bond_ = other.bond_;
+        plans_ = other.plans_;
         }
 
     private:
@@ -139,12 +144,20 @@ class LocalOp
     mutable int size_;
     mutable Tensor bond_;
 
+    //Block structure of the products of product(),
+    //kept until update() is called
+    mutable std::vector<ProductPlan> plans_;
+
     //
     /////////////////
 
     void
     makeBond() const;
 
+    //The tensors multiplied by product()
+    void
+    addOperands(Contraction<Tensor>& C, const Tensor& phi) const;
+
     };
 
 template <class Tensor>
@@ -186,6 +199,7 @@ update(const Tensor& Op1, const Tensor& Op2,
     R_ = &R;
     size_ = -1;
     bond_ = Tensor();
+    plans_.clear();
     }
 
 template <class Tensor>
@@ -194,45 +208,43 @@ product(const Tensor& phi, Tensor& phip) const
     {
     if(this->isNull()) Error("LocalOp is null");
 
-    const Tensor& Op1 = *Op1_;
-    const Tensor& Op2 = *Op2_;
+    //Davidson's matrix-vector product
+    ProfileScope ps("LocalOp::product",Profiler::Matvec);
 
-    if(L().isNull())
-        {
-        phip = phi;
+    //The order of contraction is chosen
+    //from the current index dimensions, and the
+    //products are planned once for each update()
+    Contraction<Tensor> C;
+    addOperands(C,phi);
+    C.contract(phip,plans_);
 
-        if(R().isNotNull()) 
-            phip *= R(); //m^3 k d
+    phip.mapprime(1,0);
+    }
 
-        if(combine_mpo_)
-            {
-            phip *= bondTensor();
-            }
-        else
-            {
-            phip *= Op2; //m^2 k^2
-            phip *= Op1; //m^2 k^2
-            }
+template <class Tensor>
+inline Real LocalOp<Tensor>::
+productFlops(const Tensor& phi) const
+    {
+    if(this->isNull()) Error("LocalOp is null");
+    Contraction<Tensor> C;
+    addOperands(C,phi);
+    return C.flops();
+    }
+
+template <class Tensor>
+inline void LocalOp<Tensor>::
+addOperands(Contraction<Tensor>& C, const Tensor& phi) const
+    {
+    C.add(phi,"phi").add(L(),"L");
+    if(combine_mpo_)
+        {
+        C.add(bondTensor(),"Op12");
         }
     else
         {
-        phip = phi * L(); //m^3 k d
-
-        if(combine_mpo_)
-            {
-            phip *= bondTensor();
-            }
-        else
-            {
-            phip *= Op1; //m^2 k^2
-            phip *= Op2; //m^2 k^2
-            }
-
-        if(R().isNotNull()) 
-            phip *= R();
+        C.add(*Op1_,"Op1").add(*Op2_,"Op2");
         }
-
-    phip.mapprime(1,0);
+    C.add(R(),"R");
     }
 
 template <class Tensor>
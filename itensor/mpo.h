@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_MPO_H
 #define __ITENSOR_MPO_H
 #include "mps.h"
+#include "contract.h"
 
 //
 // class MPOt
@@ -349,14 +350,12 @@ psiHphi(const MPSType& psi, const MPOType& H, const MPSType& phi, Real& re, Real
     const int N = H.NN();
     if(phi.NN() != N || psi.NN() != N) Error("psiHphi: mismatched N");
 
-    Tensor L = phi.AA(1); 
-    L *= H.AA(1); 
-    L *= conj(primed(psi.AA(1)));
-    for(int i = 2; i < N; ++i) 
+    Tensor L;
+    for(int i = 1; i < N; ++i) 
         { 
-        L *= phi.AA(i); 
-        L *= H.AA(i); 
-        L *= conj(primed(psi.AA(i))); 
+        Contraction<Tensor> C;
+        C.add(L,"L").add(phi.AA(i),"phi").add(H.AA(i),"H").add(conj(primed(psi.AA(i))),"psi*");
+        C.contract(L);
         }
     L *= phi.AA(N); L *= H.AA(N);
 
@@ -381,10 +380,13 @@ psiHphi(const MPS& psi, const MPO& H, const ITensor& LB, const ITensor& RB, cons
     MPS psiconj(psi);
     for(int i = 1; i <= N; ++i) 
         psiconj.AAnc(i) = conj(primed(psi.AA(i)));
-    ITensor L = (LB.isNull() ? phi.AA(1) : LB * phi.AA(1));
-    L *= H.AA(1); L *= psiconj.AA(1);
-    for(int i = 2; i <= N; ++i)
-        { L *= phi.AA(i); L *= H.AA(i); L *= psiconj.AA(i); }
+    ITensor L = LB;
+    for(int i = 1; i <= N; ++i)
+        { 
+        Contraction<ITensor> C;
+        C.add(L,"L").add(phi.AA(i),"phi").add(H.AA(i),"H").add(psiconj.AA(i),"psi*");
+        C.contract(L);
+        }
     if(!RB.isNull()) L *= RB;
     if(L.isComplex())
         {
@@ -226,6 +226,8 @@ setBond(int b) const
         atb_ = b;
         return;
         }
+    const bool moving_right = (b > atb_);
+    const bool moved = (std::abs(b-atb_) == 1);
     //
     //Shift atb_ (location of bond that is loaded into RAM)
     //to requested value b, writing any non-Null tensors to
@@ -235,14 +237,12 @@ setBond(int b) const
         {
         if(A.at(atb_).isNotNull())
             {
-            //std::cerr << boost::format("Writing A(%d) to %s\n")%atb_%writedir_;
-            writeToFile(AFName(atb_),A.at(atb_));
+            io_->put(AFName(atb_),A.at(atb_));
             A.at(atb_) = Tensor();
             }
         if(A.at(atb_+1).isNotNull())
             {
-            //std::cerr << boost::format("Writing A(%d) to %s\n")%(atb_+1)%writedir_;
-            writeToFile(AFName(atb_+1),A.at(atb_+1));
+            io_->put(AFName(atb_+1),A.at(atb_+1));
             if(atb_+1 != b) A.at(atb_+1) = Tensor();
             }
         ++atb_;
@@ -251,14 +251,12 @@ setBond(int b) const
         {
         if(A.at(atb_).isNotNull())
             {
-            //std::cerr << boost::format("Writing A(%d) to %s\n")%atb_%writedir_;
-            writeToFile(AFName(atb_),A.at(atb_));
+            io_->put(AFName(atb_),A.at(atb_));
             if(atb_ != b+1) A.at(atb_) = Tensor();
             }
         if(A.at(atb_+1).isNotNull())
             {
-            //std::cerr << boost::format("Writing A(%d) to %s\n")%(atb_+1)%writedir_;
-            writeToFile(AFName(atb_+1),A.at(atb_+1));
+            io_->put(AFName(atb_+1),A.at(atb_+1));
             A.at(atb_+1) = Tensor();
             }
         --atb_;
@@ -270,33 +268,20 @@ setBond(int b) const
     //
     if(A.at(b).isNull())
         {
-        std::string fname = AFName(b);
-        std::ifstream s(fname.c_str());
-        if(s.good())
-            {
-            A.at(b).read(s);
-            s.close();
-            }
-        else
-            {
-            std::cerr << boost::format("Tried to read file %s\n")%fname;
-            Error("Missing file");
-            }
+        io_->get(AFName(b),A.at(b));
         }
     if(A.at(b+1).isNull())
         {
-        std::string fname = AFName(b+1);
-        std::ifstream s(fname.c_str());
-        if(s.good())
-            {
-            A.at(b+1).read(s);
-            s.close();
-            }
-        else
-            {
-            std::cerr << boost::format("Tried read A[%d]\n")%(b+1);
-            Error("Missing file");
-            }
+        io_->get(AFName(b+1),A.at(b+1));
+        }
+    //
+    //Read ahead the tensor needed
+    //if the next move is in the same direction
+    //
+    const int next = (moving_right ? b+2 : b-1);
+    if(moved && next >= 1 && next <= N && A.at(next).isNull())
+        {
+        io_->prefetch(AFName(next));
         }
     if(b == 1)
         {
@@ -842,9 +827,9 @@ projectOp(int j, Direction dir,
         std::cerr << boost::format("projectOp: from left j < r_orth_lim_ (j=%d,r_orth_lim_=%d)\n")%j%r_orth_lim_; 
         Error("Projecting operator at j < r_orth_lim_"); 
         }
-    nE = (E.isNull() ? AA(j) : E * AA(j));
-    nE *= X; 
-    nE *= conj(primed(AA(j)));
+    Contraction<Tensor> C;
+    C.add(E,"E").add(AA(j),"A").add(X,"X").add(conj(primed(AA(j))),"A*");
+    C.contract(nE);
     }
 template
 void MPSt<ITensor>::projectOp(int j, Direction dir, 
@@ -876,6 +861,7 @@ initWrite()
     std::string global_write_dir = Global::options().stringOrDefault("WriteDir","./");
     writedir_ = mkTempDir("psi",global_write_dir);
     std::cout << "Successfully created directory " + writedir_ << std::endl;
+    io_.reset(new AsyncIO(Global::options().intOrDefault("IOWindow",4)));
 
     //std::string mod_name = writedir_ + "/model";
     //writeToFile(mod_name,(*model));
@@ -7,6 +7,7 @@
 #include "svdworker.h"
 #include "model.h"
 #include "option.h"
+#include "asyncio.h"
 
 #define Cout std::cout
 #define Endl std::endl
@@ -225,8 +226,14 @@ class MPSt
         do_write_ = val;
         }
 
+    //Pending writes are finished first
     const std::string&
-    writeDir() const { return writedir_; }
+    writeDir() const { if(io_) io_->flush(); return writedir_; }
+
+    //Seconds spent waiting on disk I/O
+    //when doWrite() is true
+    Real
+    ioStallTime() const { return (io_ ? io_->stallTime() : 0); }
 
     bool 
     isOrtho() const { return is_ortho_; }
@@ -455,6 +462,8 @@ protected:
 
     bool do_write_;
 
+    boost::shared_ptr<AsyncIO> io_;
+
     //
     //////////////////////////
 
@@ -560,7 +569,13 @@ svdBond(int b, const Tensor& AA, Direction dir,
 #ifdef USE_SVD_ONLY
     {
     SparseT D;
-    svd_.svd(b,AA,A[b],D,A[b+1]);
+        {
+        //RandomSVD(bool) turns the random SVD
+        //mode on or off for this bond only
+        RandomSVDScope random(svd_,(opt == RandomSVD() ? opt.boolVal() 
+                                                       : svd_.useRandomSVD()));
+        svd_.svd(b,AA,A[b],D,A[b+1]);
+        }
 
     //Normalize the orthogonality center
     //if(opt.boolEquals(DoNormalize(true)))
@@ -516,12 +516,30 @@ DoNormalize(bool val = true)
     return Option("DoNormalize",val);
     }
 
+Option inline
+DryRun(bool val = true)
+    {
+    return Option("DryRun",val);
+    }
+
+Option inline
+IOWindow(int n = 4)
+    {
+    return Option("IOWindow",n);
+    }
+
 Option inline
 Pinning(Real val = 1)
     {
     return Option("Pinning",val);
     }
 
+Option inline
+MaxMemory(Real bytes)
+    {
+    return Option("MaxMemory",bytes);
+    }
+
 Option inline
 NumCenter(int nc = 2)
     {
@@ -546,6 +564,18 @@ Quiet(bool val = true)
     return Option("Quiet",val);
     }
 
+Option inline
+RandomSVD(bool val = true)
+    {
+    return Option("RandomSVD",val);
+    }
+
+Option inline
+UseArena(bool val = true)
+    {
+    return Option("UseArena",val);
+    }
+
 Option inline
 UseWF()
     {
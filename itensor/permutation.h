@@ -5,19 +5,28 @@
 #ifndef __PERMUTATION_H
 #define __PERMUTATION_H
 #include "global.h"
+#include "smallarray.h"
 
 //
 // Tell where each index will go, 
 // if(p.dest(2) == 1) then 2 -> 1, etc.
+// Indices not mentioned stay where they are.
 //
 class Permutation
 {
 public:
-    typedef boost::array<int,NMAX+1> int9;
+    typedef SmallArray<int,NMAX+1> IntArray;
     
-    inline const int9& 
+    //Has size at least NMAX+1; ind()[j] is defined
+    //for every j up to the largest index moved
+    inline const IntArray& 
     ind() const { return ind_; }
 
+    //Number of indices the permutation acts on
+    //(at least NMAX)
+    int
+    size() const { return ind_.size()-1; }
+
     inline bool 
     is_trivial() const { return trivial; }
 
@@ -30,7 +39,7 @@ public:
     from_to(int j, int k);
 
     inline int 
-    dest(int j) const { return GET(ind_,j); }
+    dest(int j) const { return (j < ind_.size() ? ind_[j] : j); }
 
     bool 
     check(int d);
@@ -39,9 +48,9 @@ public:
     operator<<(std::ostream& s, const Permutation& p);
 
 private:
-    void set8(int9 *n, int i1, int i2, int i3, int i4, int i5, int i6, int i7, int i8);
+    void set8(IntArray *n, int i1, int i2, int i3, int i4, int i5, int i6, int i7, int i8);
 
-    int9 ind_;
+    IntArray ind_;
 
     bool trivial;
 };
@@ -49,7 +58,7 @@ private:
 inline Permutation inverse(const Permutation& P)
     {
     Permutation inv;
-    for(int n = 1; n <= NMAX; ++n) 
+    for(int n = 1; n <= P.size(); ++n) 
         inv.from_to(P.dest(n),n);
     return inv;
     }
@@ -68,7 +77,14 @@ inline void Permutation::
 from_to(int j, int k) 
     { 
     if(j!=k) { trivial = false; } 
-    GET(ind_,j) = k; 
+    if(j >= ind_.size())
+        {
+        //Extend as the identity
+        const int n0 = ind_.size();
+        ind_.resize(j+1);
+        for(int i = n0; i <= j; ++i) ind_[i] = i;
+        }
+    ind_[j] = k; 
     }
 
 inline bool Permutation::
@@ -95,7 +111,7 @@ check(int d)
 	}
 
 inline void Permutation::
-set8(int9 *n, int i1, int i2, int i3, int i4, int i5, int i6, int i7, int i8)
+set8(IntArray *n, int i1, int i2, int i3, int i4, int i5, int i6, int i7, int i8)
     {
     (*n)[1] = i1; (*n)[2] = i2; (*n)[3] = i3; (*n)[4] = i4;
     (*n)[5] = i5; (*n)[6] = i6; (*n)[7] = i7; (*n)[8] = i8;
@@ -104,7 +120,7 @@ set8(int9 *n, int i1, int i2, int i3, int i4, int i5, int i6, int i7, int i8)
 inline std::ostream& 
 operator<<(std::ostream& s, const Permutation& p)
     {
-    for(int i = 1; i <= NMAX; i++) s << "(" << i << "," << p.ind_[i] << ")";
+    for(int i = 1; i <= p.size(); i++) s << "(" << i << "," << p.ind_[i] << ")";
     return s;
     }
 
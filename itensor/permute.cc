@@ -0,0 +1,218 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "permute.h"
+#include "smallarray.h"
+
+using namespace std;
+
+//Edge length of the square tiles used for
+//transposes (a 32x32 tile of Reals is 8KB)
+static const int
+permuteTile = 32;
+
+//
+// A permutation simplified to its fused dimensions.
+// n[k] is the extent of fused index k, ss[k] its stride
+// in the source and rs[k] its stride in the result.
+// Index 0 always has source stride 1 (if r > 0).
+//
+namespace {
+
+struct PermutePlan
+    {
+    int r;
+    SmallArray<int,NMAX> n, ss, rs;
+
+    PermutePlan(int r_, const int* dims, const int* dest);
+    };
+
+PermutePlan::
+PermutePlan(int r_, const int* dims, const int* dest)
+    : r(0), n(r_), ss(r_), rs(r_)
+    {
+    //Strides of each index of the result
+    SmallArray<int,NMAX> rdim(r_), rstride(r_);
+    for(int k = 0; k < r_; ++k) rdim[dest[k]] = dims[k];
+    int str = 1;
+    for(int k = 0; k < r_; ++k)
+        {
+        rstride[k] = str;
+        str *= rdim[k];
+        }
+
+    str = 1;
+    for(int k = 0; k < r_; ++k)
+        {
+        const int nk = dims[k],
+                  sk = str,
+                  rk = rstride[dest[k]];
+        str *= nk;
+        if(nk == 1) continue;
+
+        //Fuse with the previous index if the
+        //two are adjacent in the result as well
+        if(r > 0 && ss[r-1]*n[r-1] == sk && rs[r-1]*n[r-1] == rk)
+            {
+            n[r-1] *= nk;
+            continue;
+            }
+
+        n[r] = nk;
+        ss[r] = sk;
+        rs[r] = rk;
+        ++r;
+        }
+    }
+
+} //namespace
+
+//
+// Element operations: res = src for copies,
+// res += fac*src for permuteAdd
+//
+namespace {
+
+struct CopyOp
+    {
+    void
+    operator()(Real& r, Real s) const { r = s; }
+    };
+
+struct AxpyOp
+    {
+    const Real fac;
+    AxpyOp(Real fac_) : fac(fac_) { }
+    void
+    operator()(Real& r, Real s) const { r += fac*s; }
+    };
+
+struct AddOp
+    {
+    void
+    operator()(Real& r, Real s) const { r += s; }
+    };
+
+} //namespace
+
+//Loop along fused index 0, which has
+//stride 1 in both the source and result
+template <class Op>
+static void
+permuteContiguous(const PermutePlan& P, const Op& op, const Real* src, Real* res)
+    {
+    const int len = P.n[0];
+
+    SmallArray<int,NMAX> i(P.r,0);
+    int so = 0,
+        ro = 0;
+    while(true)
+        {
+        const Real* s = src + so;
+        Real* d = res + ro;
+        for(int j = 0; j < len; ++j) op(d[j],s[j]);
+
+        //Advance the outer indices
+        int k = 1;
+        for(; k < P.r; ++k)
+            {
+            so += P.ss[k];
+            ro += P.rs[k];
+            if(++i[k] < P.n[k]) break;
+            so -= P.ss[k]*P.n[k];
+            ro -= P.rs[k]*P.n[k];
+            i[k] = 0;
+            }
+        if(k == P.r) return;
+        }
+    }
+
+//Tiled transpose between fused index 0 (stride 1
+//in the source) and index b (stride 1 in the result)
+template <class Op>
+static void
+permuteTiled(const PermutePlan& P, int b, const Op& op, const Real* src, Real* res)
+    {
+    const int na = P.n[0],
+              nb = P.n[b],
+              rsa = P.rs[0],
+              ssb = P.ss[b];
+
+    SmallArray<int,NMAX> i(P.r,0);
+    int so = 0,
+        ro = 0;
+    while(true)
+        {
+        const Real* s = src + so;
+        Real* d = res + ro;
+        for(int b0 = 0; b0 < nb; b0 += permuteTile)
+            {
+            const int b1 = min(b0+permuteTile,nb);
+            for(int a0 = 0; a0 < na; a0 += permuteTile)
+                {
+                const int a1 = min(a0+permuteTile,na);
+                for(int ia = a0; ia < a1; ++ia)
+                    {
+                    const Real* sa = s + ia;
+                    Real* da = d + ia*rsa;
+                    for(int ib = b0; ib < b1; ++ib)
+                        op(da[ib],sa[ib*ssb]);
+                    }
+                }
+            }
+
+        //Advance the indices other than 0 and b
+        int k = 1;
+        for(; k < P.r; ++k)
+            {
+            if(k == b) continue;
+            so += P.ss[k];
+            ro += P.rs[k];
+            if(++i[k] < P.n[k]) break;
+            so -= P.ss[k]*P.n[k];
+            ro -= P.rs[k]*P.n[k];
+            i[k] = 0;
+            }
+        if(k == P.r) return;
+        }
+    }
+
+template <class Op>
+static void
+permuteApply(int r, const int* dims, const int* dest, const Op& op,
+             const Real* src, Real* res)
+    {
+    const PermutePlan P(r,dims,dest);
+
+    if(P.r == 0)
+        {
+        op(res[0],src[0]);
+        return;
+        }
+
+    int b = 0;
+    while(P.rs[b] != 1) ++b;
+
+    if(b == 0)
+        permuteContiguous(P,op,src,res);
+    else
+        permuteTiled(P,b,op,src,res);
+    }
+
+void
+permuteCopy(int r, const int* dims, const int* dest,
+            const Real* src, Real* res)
+    {
+    permuteApply(r,dims,dest,CopyOp(),src,res);
+    }
+
+void
+permuteAdd(int r, const int* dims, const int* dest, Real fac,
+           const Real* src, Real* res)
+    {
+    if(fac == 1)
+        permuteApply(r,dims,dest,AddOp(),src,res);
+    else
+        permuteApply(r,dims,dest,AxpyOp(fac),src,res);
+    }
@@ -0,0 +1,37 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_PERMUTE_H
+#define __ITENSOR_PERMUTE_H
+#include "real.h"
+
+//
+// Kernel for permuting the elements of dense
+// tensor storage, used by ITensor::reshapeDat
+// and ITensor::operator+=.
+//
+// Data is stored first-index-fastest; the source
+// has dimensions dims[0],...,dims[r-1] and its index k
+// becomes index dest[k] of the result (both 0-based).
+//
+// Indices that are adjacent in both layouts are fused
+// and dimensions of size 1 are dropped. What remains is
+// done as a copy along the common stride-1 index, or as
+// tiled two-dimensional transposes between the stride-1
+// indices of the source and of the result.
+//
+void
+permuteCopy(int r, const int* dims, const int* dest,
+            const Real* src, Real* res);
+
+//
+// Adds fac times the permuted elements of src to res
+// (laid out as for permuteCopy) in the same single pass,
+// without a temporary copy.
+//
+void
+permuteAdd(int r, const int* dims, const int* dest, Real fac,
+           const Real* src, Real* res);
+
+#endif
@@ -0,0 +1,318 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "profiler.h"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/tss.hpp"
+#include "boost/unordered_map.hpp"
+#include <sys/time.h>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+using boost::format;
+
+volatile bool Profiler::
+enabled_ = false;
+
+namespace {
+
+Real
+wallTime()
+    {
+    timeval tv;
+    gettimeofday(&tv,0);
+    return tv.tv_sec + 1E-6*tv.tv_usec;
+    }
+
+struct Totals
+    {
+    Profiler::Kind kind;
+    long count;
+    Real time, flops, bytes;
+    Totals() : kind(Profiler::Product), count(0), time(0), flops(0), bytes(0) { }
+    };
+
+struct Event
+    {
+    const char* name;
+    Profiler::Kind kind;
+    Real start, dur, flops, bytes;
+    };
+
+//
+// What one thread has recorded. Only its thread
+// writes to it; the lock is held against a merge.
+//
+struct ThreadBuf
+    {
+    boost::mutex mutex;
+    int tid;
+    boost::unordered_map<const char*,Totals> totals;
+    std::vector<Event> events;
+    long dropped;
+
+    explicit
+    ThreadBuf(int tid_) : tid(tid_), dropped(0) { }
+    };
+
+//
+// Buffers of all threads that have recorded. They are
+// kept (not deleted at thread exit) until the program ends,
+// so what finished threads recorded is still reported.
+//
+struct Registry
+    {
+    boost::mutex mutex;
+    std::vector<ThreadBuf*> bufs;
+    volatile long maxevents;
+    Real t0;
+
+    Registry() : maxevents(100000), t0(wallTime()) { }
+
+    ~Registry()
+        {
+        Foreach(ThreadBuf* b, bufs) delete b;
+        }
+    };
+
+Registry&
+registry()
+    {
+    static Registry reg_;
+    return reg_;
+    }
+
+void
+keepBuf(ThreadBuf*) { }
+
+ThreadBuf&
+threadBuf()
+    {
+    static boost::thread_specific_ptr<ThreadBuf> buf_(&keepBuf);
+    if(buf_.get() == 0)
+        {
+        Registry& R = registry();
+        boost::mutex::scoped_lock lock(R.mutex);
+        R.bufs.push_back(new ThreadBuf(int(R.bufs.size())));
+        buf_.reset(R.bufs.back());
+        }
+    return *buf_;
+    }
+
+bool
+slowerFirst(const Profiler::Site& a, const Profiler::Site& b)
+    {
+    return a.time > b.time;
+    }
+
+//Name with the characters JSON strings need escaped removed
+string
+jsonName(const string& s)
+    {
+    string res;
+    Foreach(char c, s)
+        if(c != '"' && c != '\\' && c >= ' ') res += c;
+    return res;
+    }
+
+//
+// Turns the profiler on when ITENSOR_PROFILE is set, and
+// reports (and writes the trace) at exit
+//
+struct EnvProfile
+    {
+    string trace;
+    bool on;
+
+    EnvProfile()
+        : on(false)
+        {
+        const char* v = getenv("ITENSOR_PROFILE");
+        if(v == 0 || *v == 0 || string(v) == "0") return;
+        on = true;
+        if(string(v) != "1") trace = v;
+        registry();
+        Profiler::enable();
+        }
+
+    ~EnvProfile()
+        {
+        if(!on) return;
+        Profiler::report(cerr);
+        if(trace.empty()) return;
+        ofstream s(trace.c_str());
+        if(!s)
+            {
+            cerr << "Profiler: couldn't open \"" << trace << "\" for writing" << endl;
+            return;
+            }
+        Profiler::writeTrace(s);
+        cerr << "Profiler: wrote trace to " << trace << endl;
+        }
+    };
+
+EnvProfile envProfile_;
+
+} //namespace
+
+const char* Profiler::
+kindName(Kind k)
+    {
+    static const char* names[] =
+        { "product", "permute", "svd", "eigen", "matvec", "diskio" };
+    return (k >= 0 && k < NumKinds ? names[k] : "unknown");
+    }
+
+void Profiler::
+enable(bool val)
+    {
+    registry();
+    enabled_ = val;
+    }
+
+void Profiler::
+reset()
+    {
+    Registry& R = registry();
+    boost::mutex::scoped_lock lock(R.mutex);
+    Foreach(ThreadBuf* b, R.bufs)
+        {
+        boost::mutex::scoped_lock block(b->mutex);
+        b->totals.clear();
+        b->events.clear();
+        b->dropped = 0;
+        }
+    }
+
+void Profiler::
+maxEvents(long n)
+    {
+    Registry& R = registry();
+    boost::mutex::scoped_lock lock(R.mutex);
+    R.maxevents = max(n,0L);
+    }
+
+Real Profiler::
+now()
+    {
+    return wallTime()-registry().t0;
+    }
+
+void Profiler::
+record(const char* name, Kind kind, Real start, Real end,
+       Real flops, Real bytes)
+    {
+    ThreadBuf& b = threadBuf();
+    const long maxevents = registry().maxevents;
+    boost::mutex::scoped_lock lock(b.mutex);
+
+    Totals& t = b.totals[name];
+    t.kind = kind;
+    ++t.count;
+    t.time += end-start;
+    t.flops += flops;
+    t.bytes += bytes;
+
+    if(long(b.events.size()) < maxevents)
+        {
+        Event e = { name, kind, start, end-start, flops, bytes };
+        b.events.push_back(e);
+        }
+    else
+        {
+        ++b.dropped;
+        }
+    }
+
+std::vector<Profiler::Site> Profiler::
+sites()
+    {
+    //Call sites are merged by name, since the same
+    //literal may have several addresses
+    map<string,Site> merged;
+    Registry& R = registry();
+    boost::mutex::scoped_lock lock(R.mutex);
+    Foreach(ThreadBuf* b, R.bufs)
+        {
+        boost::mutex::scoped_lock block(b->mutex);
+        typedef boost::unordered_map<const char*,Totals>::value_type
+        TotalsPair;
+        Foreach(const TotalsPair& p, b->totals)
+            {
+            Site& s = merged[p.first];
+            if(s.name.empty())
+                {
+                s.name = p.first;
+                s.kind = p.second.kind;
+                s.count = 0;
+                s.time = s.flops = s.bytes = 0;
+                }
+            s.count += p.second.count;
+            s.time += p.second.time;
+            s.flops += p.second.flops;
+            s.bytes += p.second.bytes;
+            }
+        }
+    std::vector<Site> res;
+    for(map<string,Site>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+        res.push_back(it->second);
+    sort(res.begin(),res.end(),slowerFirst);
+    return res;
+    }
+
+void Profiler::
+report(std::ostream& s)
+    {
+    const std::vector<Site> S = sites();
+    long ndropped = 0;
+    int nthread = 0;
+        {
+        Registry& R = registry();
+        boost::mutex::scoped_lock lock(R.mutex);
+        nthread = int(R.bufs.size());
+        Foreach(ThreadBuf* b, R.bufs) ndropped += b->dropped;
+        }
+
+    s << format("\n-------- Profile (%d thread%s) --------\n") % nthread % (nthread == 1 ? "" : "s");
+    s << format("%-36s %-8s %10s %10s %10s %9s %9s\n")
+         % "call site" % "kind" % "calls" % "total s" % "mean us" % "GFlop/s" % "GB/s";
+    Foreach(const Site& x, S)
+        {
+        s << format("%-36s %-8s %10d %10.4f %10.1f %9.2f %9.2f\n")
+             % x.name % kindName(x.kind) % x.count % x.time
+             % (1E6*x.time/max(x.count,1L))
+             % (x.time > 0 ? 1E-9*x.flops/x.time : 0.)
+             % (x.time > 0 ? 1E-9*x.bytes/x.time : 0.);
+        }
+    if(ndropped > 0)
+        s << format("(%d events not kept for the trace)\n") % ndropped;
+    }
+
+void Profiler::
+writeTrace(std::ostream& s)
+    {
+    Registry& R = registry();
+    boost::mutex::scoped_lock lock(R.mutex);
+    s << "{\"traceEvents\": [\n";
+    bool first = true;
+    Foreach(ThreadBuf* b, R.bufs)
+        {
+        boost::mutex::scoped_lock block(b->mutex);
+        s << (first ? "" : ",\n");
+        first = false;
+        s << format("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                    "\"args\": {\"name\": \"%s\"}}")
+             % b->tid % (b->tid == 0 ? "first thread" : "worker");
+        Foreach(const Event& e, b->events)
+            {
+            s << format(",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                        "\"ts\": %.1f, \"dur\": %.1f, \"args\": {\"flops\": %.0f, \"bytes\": %.0f}}")
+                 % jsonName(e.name) % kindName(e.kind) % b->tid
+                 % (1E6*e.start) % (1E6*e.dur) % e.flops % e.bytes;
+            }
+        }
+    s << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+    }
@@ -0,0 +1,137 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_PROFILER_H
+#define __ITENSOR_PROFILER_H
+#include "global.h"
+
+//
+// Profiler records the calls made to the library's hot
+// paths (tensor products, permutations of tensor data,
+// SVDs and diagonalizations, the matrix-vector products
+// of Davidson, and disk I/O): for each call site the number
+// of calls, wall time, floating point operations and bytes
+// moved, and optionally every call as a timed event.
+//
+// It is off by default and costs one test of a flag per
+// call site when off. Turn it on with Profiler::enable(),
+// or without rebuilding by setting the environment variable
+// ITENSOR_PROFILE: to 1 for a report on std::cerr at exit,
+// or to a file name to also write the trace to that file.
+//
+// Each thread records into its own buffer; the buffers
+// are only merged by report, sites and writeTrace.
+// Times of nested call sites (e.g. the products inside
+// a LocalOp::product) are counted in both.
+//
+// Usage:
+//
+//    void f(...)
+//        {
+//        ProfileScope ps("f",Profiler::Product,flops,bytes);
+//        ...
+//        }
+//
+
+class Profiler
+    {
+    public:
+
+    enum Kind { Product, Permute, SVD, Eigen, Matvec, DiskIO, NumKinds };
+
+    static const char*
+    kindName(Kind k);
+
+    static bool
+    enabled() { return enabled_; }
+
+    static void
+    enable(bool val = true);
+
+    //Forgets everything recorded so far
+    static void
+    reset();
+
+    //Events kept per thread for the trace (default 100000);
+    //0 records totals only
+    static void
+    maxEvents(long n);
+
+    //Totals of one call site, merged over threads
+    struct Site
+        {
+        std::string name;
+        Kind kind;
+        long count;
+        Real time,  //seconds
+             flops,
+             bytes;
+        };
+
+    //Sorted by total time, largest first
+    static std::vector<Site>
+    sites();
+
+    //Table of sites() with rates
+    static void
+    report(std::ostream& s);
+
+    //Chrome trace-event JSON, for chrome://tracing or Perfetto
+    static void
+    writeTrace(std::ostream& s);
+
+    //Seconds since the profiler was first enabled
+    static Real
+    now();
+
+    //name must outlive the Profiler (e.g. a string literal)
+    static void
+    record(const char* name, Kind kind, Real start, Real end,
+           Real flops, Real bytes);
+
+    private:
+
+    static volatile bool enabled_;
+    };
+
+class ProfileScope
+    {
+    public:
+
+    ProfileScope(const char* name, Profiler::Kind kind,
+                 Real flops = 0, Real bytes = 0)
+        :
+        name_(name),
+        kind_(kind),
+        flops_(flops),
+        bytes_(bytes),
+        start_(Profiler::enabled() ? Profiler::now() : -1)
+        { }
+
+    ~ProfileScope()
+        {
+        if(start_ >= 0)
+            Profiler::record(name_,kind_,start_,Profiler::now(),flops_,bytes_);
+        }
+
+    void
+    addFlops(Real f) { flops_ += f; }
+
+    void
+    addBytes(Real b) { bytes_ += b; }
+
+    private:
+
+    const char* name_;
+    Profiler::Kind kind_;
+    Real flops_,
+         bytes_,
+         start_;
+
+    //Not copyable
+    ProfileScope(const ProfileScope&);
+    void operator=(const ProfileScope&);
+    };
+
+#endif
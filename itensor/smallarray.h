@@ -0,0 +1,176 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SMALLARRAY_H
+#define __ITENSOR_SMALLARRAY_H
+#include <algorithm>
+#include "error.h"
+
+//
+// SmallArray
+//
+// Fixed-capacity array in the spirit of boost::array,
+// except that it can be resized: up to N elements are
+// stored inline (no heap allocation), larger sizes
+// spill over to the heap. Default size is N.
+//
+template<typename T, int N>
+class SmallArray
+    {
+    public:
+
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallArray() : size_(N), p_(inline_), heap_(0) { }
+
+    explicit
+    SmallArray(int size, const T& val = T());
+
+    SmallArray(const SmallArray& other);
+
+    ~SmallArray() { delete[] heap_; }
+
+    SmallArray&
+    operator=(const SmallArray& other);
+
+    int
+    size() const { return size_; }
+
+    //True if the elements are stored on the heap
+    bool
+    onHeap() const { return p_ != inline_; }
+
+    T&
+    operator[](int j) { return p_[j]; }
+
+    const T&
+    operator[](int j) const { return p_[j]; }
+
+    T&
+    at(int j) { checkRange(j); return p_[j]; }
+
+    const T&
+    at(int j) const { checkRange(j); return p_[j]; }
+
+    iterator
+    begin() { return p_; }
+
+    iterator
+    end() { return p_+size_; }
+
+    const_iterator
+    begin() const { return p_; }
+
+    const_iterator
+    end() const { return p_+size_; }
+
+    //Keeps the first min(n,size()) elements
+    void
+    resize(int n);
+
+    //Resizes only if n is larger than size()
+    void
+    grow(int n) { if(n > size_) resize(n); }
+
+    //Sets every element to val
+    void
+    assign(const T& val) { std::fill(p_,p_+size_,val); }
+
+    void
+    swap(SmallArray& other);
+
+    private:
+
+    void
+    checkRange(int j) const
+        {
+        if(j < 0 || j >= size_) Error("SmallArray: index out of range");
+        }
+
+    void
+    setPointer() { p_ = (heap_ == 0 ? inline_ : heap_); }
+
+    /////////////
+    //
+    // Data Members
+    //
+
+    int size_;
+    T* p_;
+    T inline_[N];
+    T* heap_; //null unless size_ > N
+
+    //
+    /////////////
+
+    };
+
+template<typename T, int N>
+SmallArray<T,N>::
+SmallArray(int size, const T& val)
+    : size_(size),
+      heap_(size > N ? new T[size] : 0)
+    {
+    setPointer();
+    std::fill(p_,p_+(size_ > N ? size_ : N),val);
+    }
+
+template<typename T, int N>
+SmallArray<T,N>::
+SmallArray(const SmallArray& other)
+    : size_(other.size_),
+      heap_(other.heap_ == 0 ? 0 : new T[other.size_])
+    {
+    setPointer();
+    if(heap_ == 0) std::copy(other.inline_,other.inline_+N,inline_);
+    else           std::copy(other.heap_,other.heap_+size_,heap_);
+    }
+
+template<typename T, int N>
+SmallArray<T,N>& SmallArray<T,N>::
+operator=(const SmallArray& other)
+    {
+    if(this == &other) return *this;
+    SmallArray cp(other);
+    swap(cp);
+    return *this;
+    }
+
+template<typename T, int N>
+void SmallArray<T,N>::
+resize(int n)
+    {
+    if(n <= N)
+        {
+        if(onHeap())
+            {
+            std::copy(heap_,heap_+std::min(n,size_),inline_);
+            delete[] heap_;
+            heap_ = 0;
+            }
+        }
+    else
+        {
+        T* nh = new T[n];
+        std::copy(p_,p_+std::min(n,size_),nh);
+        delete[] heap_;
+        heap_ = nh;
+        }
+    size_ = n;
+    setPointer();
+    }
+
+template<typename T, int N>
+void SmallArray<T,N>::
+swap(SmallArray& other)
+    {
+    std::swap_ranges(inline_,inline_+N,other.inline_);
+    std::swap(heap_,other.heap_);
+    std::swap(size_,other.size_);
+    setPointer();
+    other.setPointer();
+    }
+
+#endif
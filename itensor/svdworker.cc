@@ -4,6 +4,7 @@
 //
 #include "svdworker.h"
 #include "localop.h"
+#include "threadpool.h"
 
 using namespace std;
 using boost::format;
@@ -16,6 +17,124 @@ sqrt(Vector V)
     return V;
     }
 
+//
+// Helpers for decomposing the blocks of an IQTensor
+// concurrently. The blocks must already be scaled
+// (scaleTo) since that modifies them.
+//
+namespace {
+
+//Operation counts for the profiler (Golub and Van Loan):
+//SVD of an m x n matrix with U and V, and symmetric
+//eigendecomposition of an n x n matrix with eigenvectors
+Real
+svdFlops(int m, int n)
+    {
+    const Real a = max(m,n), b = min(m,n);
+    return 4*a*a*b + 8*a*b*b + 9*b*b*b;
+    }
+
+Real
+eigFlops(int n)
+    {
+    return 9.*n*n*n;
+    }
+
+//SVD of M keeping at most maxm singular values.
+//If maxm (plus a safety margin) is well below the size of M,
+//only the leading singular values are computed, with RandomSVD.
+//This falls back to the full SVD if the weight RandomSVD misses
+//exceeds the weight of the margin, i.e. if the spectrum
+//has not decayed enough for the truncation to be reliable.
+//Returns the weight missed, 0 for the full SVD.
+//Pass maxm = 0 to always do the full SVD.
+Real
+truncatedSVD(const Matrix& M, Matrix& U, Vector& d, Matrix& V, int maxm)
+    {
+    ProfileScope ps("truncatedSVD",Profiler::SVD,0,sizeof(Real)*M.Nrows()*Real(M.Ncols()));
+    const int k = maxm + max(10,maxm/10);
+    if(maxm <= 0 || 3*k > min(M.Nrows(),M.Ncols()))
+        {
+        ps.addFlops(svdFlops(M.Nrows(),M.Ncols()));
+        SVD(M,U,d,V);
+        return 0;
+        }
+
+    //Range finding with two power iterations, Q.t()*M,
+    //then the SVD of a k x n matrix
+    const Real resid = RandomSVD(M,U,d,V,k);
+    ps.addFlops(12.*M.Nrows()*M.Ncols()*k + svdFlops(k,M.Ncols()));
+
+    Real margin = 0;
+    for(int j = maxm+1; j <= k; ++j) 
+        margin += sqr(d(j));
+    if(resid <= margin) return resid;
+
+    ps.addFlops(svdFlops(M.Nrows(),M.Ncols()));
+    SVD(M,U,d,V);
+    return 0;
+    }
+
+//SVD of block n, with rows given by the Index in uI
+struct SVDBlock
+    {
+    const vector<const ITensor*>& blocks;
+    const IQIndex& uI;
+    vector<Matrix> &U, &V;
+    vector<Vector>& d;
+    vector<Real>& resid;
+    const int maxm;
+
+    SVDBlock(const vector<const ITensor*>& blocks_, const IQIndex& uI_,
+             vector<Matrix>& U_, vector<Vector>& d_, vector<Matrix>& V_,
+             vector<Real>& resid_, int maxm_)
+        : blocks(blocks_), uI(uI_), U(U_), V(V_), d(d_), 
+          resid(resid_), maxm(maxm_) { }
+
+    void
+    operator()(int n) const
+        {
+        const ITensor& t = *blocks[n];
+        const 
+        Index &ui = t.index(uI.hasindex(t.index(1)) ? 1 : 2),
+              &vi = t.index(uI.hasindex(t.index(1)) ? 2 : 1);
+
+        Matrix M(ui.m(),vi.m());
+        t.toMatrix11NoScale(ui,vi,M);
+
+        resid.at(n) = truncatedSVD(M,U.at(n),d.at(n),V.at(n),maxm);
+        }
+    };
+
+//Eigenvectors of (symmetric) block n,
+//ordered from largest eigenvalue down
+struct EigBlock
+    {
+    const vector<const ITensor*>& blocks;
+    vector<Matrix>& U;
+    vector<Vector>& d;
+
+    EigBlock(const vector<const ITensor*>& blocks_,
+             vector<Matrix>& U_, vector<Vector>& d_)
+        : blocks(blocks_), U(U_), d(d_) { }
+
+    void
+    operator()(int n) const
+        {
+        const ITensor& t = *blocks[n];
+        const int m = t.index(1).m();
+        Matrix M(m,m);
+        t.toMatrix11NoScale(t.index(1),t.index(2),M);
+
+        M *= -1;
+        ProfileScope ps("EigBlock",Profiler::Eigen,eigFlops(m),sizeof(Real)*m*m);
+        EigenValues(M,d.at(n),U.at(n));
+        d.at(n) *= -1;
+        }
+    };
+
+} //namespace
+
 SVDWorker::
 SVDWorker() 
     : N(1), 
@@ -24,6 +143,7 @@ SVDWorker()
       minm_(1),
       maxm_(MAX_M),
       use_orig_m_(false), 
+      use_random_svd_(false), 
       showeigs_(false), 
       doRelCutoff_(false),
       absoluteCutoff_(false), 
@@ -40,6 +160,7 @@ SVDWorker(int N_)
       minm_(1), 
       maxm_(MAX_M),
       use_orig_m_(false), 
+      use_random_svd_(false), 
       showeigs_(false), 
       doRelCutoff_(false),
       absoluteCutoff_(false), 
@@ -57,6 +178,7 @@ SVDWorker(int N_, Real cutoff, int minm, int maxm,
       minm_(minm), 
       maxm_(maxm),
       use_orig_m_(false), 
+      use_random_svd_(false), 
       showeigs_(false), 
       doRelCutoff_(doRelCutoff),
       absoluteCutoff_(false), 
@@ -127,12 +249,14 @@ svdRank2(const ITensor& A, const Index& ui, const Index& vi,
 
     Matrix UU,VV;
     Vector& DD = eigsKept_.at(b);
-    SVD(M,UU,DD,VV);
+    //Weight not captured if only the leading
+    //singular values were computed
+    const Real resid = truncatedSVD(M,UU,DD,VV,(use_random_svd_ ? maxm_ : 0));
 
     //Truncate
     int m = DD.Length();
     Real& svdtruncerr = truncerr_.at(b);
-    svdtruncerr = 0;
+    svdtruncerr = resid;
 
     //Zero out any negative weight
     for(int zerom = m; zerom > 0; --zerom)
@@ -259,30 +383,29 @@ svdRank2(const IQTensor& A, const IQIndex& uI, const IQIndex& vI,
 
     //1. SVD each ITensor within A.
     //   Store results in mmatrix and mvector.
-    int itenind = 0;
+    vector<const ITensor*> blockptr;
+    vector<Real> cost;
+    blockptr.reserve(Nblock);
+    cost.reserve(Nblock);
     Foreach(const ITensor& t, A.blocks())
         {
         t.scaleTo(refNorm_);
+        blockptr.push_back(&t);
+        cost.push_back(svdFlops(t.index(1).m(),t.index(2).m()));
+        }
 
-        Matrix &UU = Umatrix.at(itenind);
-        Matrix &VV = Vmatrix.at(itenind);
-        Vector &d =  dvector.at(itenind);
-
-        const 
-        Index &ui = t.index(uI.hasindex(t.index(1)) ? 1 : 2),
-              &vi = t.index(uI.hasindex(t.index(1)) ? 2 : 1);
-
-        Matrix M(ui.m(),vi.m());
-        t.toMatrix11NoScale(ui,vi,M);
-
-        SVD(M,UU,d,VV);
+    vector<Real> resid(Nblock,0);
+    //Blocks run on the threads of the global ThreadPool
+    //if they can keep them busy, else BLAS threads are used
+    ThreadPool::global().runByCost(cost,SVDBlock(blockptr,uI,Umatrix,dvector,Vmatrix,
+                                                 resid,(use_random_svd_ ? maxm_ : 0)));
 
-        //Store the squared singular values
-        //(denmat eigenvalues) in alleig
+    //Store the squared singular values
+    //(denmat eigenvalues) in alleig
+    Foreach(const Vector& d, dvector)
+        {
         for(int j = 1; j <= d.Length(); ++j) 
             alleig.push_back(sqr(d(j)));
-
-        ++itenind;
         }
 
     //2. Truncate eigenvalues
@@ -294,6 +417,7 @@ svdRank2(const IQTensor& A, const IQIndex& uI, const IQIndex& vI,
     //Determine number of states to keep m
     int m = (int)alleig.size();
     Real svdtruncerr = 0;
+    Foreach(Real r, resid) svdtruncerr += r;
     Real docut = -1;
     int mdisc = 0; 
 
@@ -400,7 +524,7 @@ svdRank2(const IQTensor& A, const IQIndex& uI, const IQIndex& vI,
     vector<ITSparse> Dblock;
     Dblock.reserve(Nblock);
 
-    itenind = 0;
+    int itenind = 0;
     int total_m = 0;
     Foreach(const ITensor& t, A.blocks())
         {
@@ -503,7 +627,11 @@ diag_denmat(const ITensor& rho, Vector& D, Index& newmid, ITensor& U)
     Matrix R,UU; 
     rho.toMatrix11NoScale(ri,primed(ri),R);
     R *= -1.0; 
-    EigenValues(R,D,UU); 
+        {
+        ProfileScope ps("SVDWorker::diag_denmat",Profiler::Eigen,
+                        eigFlops(R.Nrows()),sizeof(Real)*R.Nrows()*R.Nrows());
+        EigenValues(R,D,UU); 
+        }
     D *= -1.0;
 
     //Include rho's scale to get the actual eigenvalues kept
@@ -630,7 +758,10 @@ diag_denmat(const IQTensor& rho, Vector& D, IQIndex& newmid, IQTensor& U)
 
     //1. Diagonalize each ITensor within rho.
     //   Store results in mmatrix and mvector.
-    int itenind = 0;
+    vector<const ITensor*> blockptr;
+    vector<Real> cost;
+    blockptr.reserve(rho.iten_size());
+    cost.reserve(rho.iten_size());
     Foreach(const ITensor& t, rho.blocks())
         {
         if(!t.index(1).noprime_equals(t.index(2)))
@@ -641,18 +772,17 @@ diag_denmat(const IQTensor& rho, Vector& D, IQIndex& newmid, IQTensor& U)
             }
 
         t.scaleTo(refNorm_);
+        blockptr.push_back(&t);
+        cost.push_back(eigFlops(t.index(1).m()));
+        }
 
-        Matrix &UU = mmatrix.at(itenind);
-        Vector &d =  mvector.at(itenind);
+    ThreadPool::global().runByCost(cost,EigBlock(blockptr,mmatrix,mvector));
 
-        //Diag ITensors within rho
-        int n = t.index(1).m();
-        Matrix M(n,n);
-        t.toMatrix11NoScale(t.index(1),t.index(2),M);
-
-        M *= -1;
-        EigenValues(M,d,UU);
-        d *= -1;
+    int itenind = 0;
+    Foreach(const ITensor& t, rho.blocks())
+        {
+        const Vector &d =  mvector.at(itenind);
+        const int n = t.index(1).m();
 
         for(int j = 1; j <= n; ++j) 
             alleig.push_back(d(j));
@@ -660,6 +790,10 @@ diag_denmat(const IQTensor& rho, Vector& D, IQIndex& newmid, IQTensor& U)
         ++itenind;
 
 #ifdef STRONG_DEBUG
+        const Matrix &UU = mmatrix.at(itenind-1);
+        Matrix M(n,n);
+        t.toMatrix11NoScale(t.index(1),t.index(2),M);
+        M *= -1;
 	Real maxM = 1.0;
         for(int r = 1; r <= n; ++r)
 	    for(int c = r+1; c <= n; ++c)
@@ -916,7 +1050,10 @@ diag_and_truncate(const IQTensor& rho, vector<Matrix>& mmatrix,
         t.toMatrix11NoScale(t.index(1),t.index(2),M);
 
         M *= -1;
-        EigenValues(M,d,UU);
+            {
+            ProfileScope ps("SVDWorker::diag_and_truncate",Profiler::Eigen,eigFlops(n),sizeof(Real)*n*n);
+            EigenValues(M,d,UU);
+            }
         d *= -1;
 
         d *= refNorm_.real();
@@ -159,6 +159,16 @@ class SVDWorker
     void 
     useOrigM(bool val) { use_orig_m_ = val; }
 
+    //When maxm is well below the size of the
+    //matrices being decomposed, compute only the
+    //leading singular values (see RandomSVD in svd.h).
+    //Falls back to the full SVD if the spectrum
+    //doesn't decay enough for this to be accurate.
+    bool 
+    useRandomSVD() const { return use_random_svd_; }
+    void 
+    useRandomSVD(bool val) { use_random_svd_ = val; }
+
     //Print detailed information about the
     //eigenvalues computed during the SVD
     bool 
@@ -285,6 +295,7 @@ private:
     int minm_;
     int maxm_;
     bool use_orig_m_; 
+    bool use_random_svd_;
     bool showeigs_;
     bool doRelCutoff_;
     bool absoluteCutoff_;
@@ -319,6 +330,32 @@ private:
 
     }; //class SVDWorker
 
+//
+// Sets the random SVD mode of an SVDWorker,
+// restoring its previous mode when destroyed
+// (even if the decomposition throws)
+//
+class RandomSVDScope
+    {
+    public:
+
+    RandomSVDScope(SVDWorker& svd, bool val)
+        : svd_(svd), saved_(svd.useRandomSVD())
+        { svd_.useRandomSVD(val); }
+
+    ~RandomSVDScope() { svd_.useRandomSVD(saved_); }
+
+    private:
+
+    SVDWorker& svd_;
+    const bool saved_;
+
+    //Not copyable
+    RandomSVDScope(const RandomSVDScope&);
+    void operator=(const RandomSVDScope&);
+
+    }; //class RandomSVDScope
+
 template<class Tensor, class SparseT, class LocalOpT>
 void SVDWorker::
 csvd(int b, const Tensor& AA, Tensor& L, SparseT& V, Tensor& R, 
@@ -71,11 +71,13 @@ derivMPS(const std::vector<Tensor>& psi, const MPOt<Tensor>& H,
 
     for(--j; j > 1; --j)
         {
-        RH.at(j-1) = RH.at(j) * psi.at(j);
-        RH[j-1] *= H.AA(pj--);
+        Contraction<Tensor> C;
+        C.add(RH.at(j),"RH").add(psi.at(j),"psi");
+        C.add(H.AA(pj--),"H");
         if(nsite[j] == 2)
-            RH[j-1] *= H.AA(pj--);
-        RH[j-1] *= conj(primed(psi.at(j)));
+            C.add(H.AA(pj--),"H");
+        C.add(conj(primed(psi.at(j))),"psi*");
+        C.contract(RH.at(j-1));
         }
 
     pj = 1;
@@ -104,9 +106,11 @@ derivMPS(const std::vector<Tensor>& psi, const MPOt<Tensor>& H,
         Tensor& Bd = dpsi.at(j);
 
         //Begin applying H to psi
-        Bd = LH[j] * B * H.AA(pj++);
+        Contraction<Tensor> C;
+        C.add(LH[j],"LH").add(B,"psi").add(H.AA(pj++),"H");
         if(nsite[j] == 2)
-            Bd *= H.AA(pj++);
+            C.add(H.AA(pj++),"H");
+        C.contract(Bd);
 
         //Use partial result to build LH
         if(j < N)
@@ -0,0 +1,436 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "threadpool.h"
+#include "boost/bind.hpp"
+#include <dlfcn.h>
+
+using namespace std;
+
+namespace {
+
+typedef void (*SetThreadsFunc)(int);
+typedef int (*GetThreadsFunc)();
+
+//
+// Thread controls of MKL or OpenBLAS, looked up among
+// the loaded libraries so that no particular BLAS has
+// to be linked in
+//
+struct BlasControl
+    {
+    SetThreadsFunc set;
+    GetThreadsFunc get;
+
+    BlasControl()
+        : set(0), get(0)
+        {
+        find("MKL_Set_Num_Threads","MKL_Get_Max_Threads");
+        if(!set) find("openblas_set_num_threads","openblas_get_num_threads");
+        }
+
+    void
+    find(const char* setname, const char* getname)
+        {
+        set = reinterpret_cast<SetThreadsFunc>(dlsym(RTLD_DEFAULT,setname));
+        get = reinterpret_cast<GetThreadsFunc>(dlsym(RTLD_DEFAULT,getname));
+        if(!set || !get) { set = 0; get = 0; }
+        }
+    };
+
+const BlasControl&
+blasControl()
+    {
+    static BlasControl c_;
+    return c_;
+    }
+
+//Flops a BLAS call needs for each thread it 
+//uses to be worth splitting up
+const Real blasGrain = 1E6;
+
+//True if the tasks should run in parallel on nthread
+//threads, false if one after another with BLAS using
+//the threads: compares the time of the longest task
+//(or the work per thread) to the time with BLAS 
+//threads, assuming they speed up calls costing
+//at least blasGrain per thread perfectly
+bool
+preferTasks(const vector<Real>& cost, int nthread)
+    {
+    if(!BlasThreads::available()) return true;
+    Real total = 0, 
+         maxcost = 0,
+         serial = 0;
+    Foreach(Real c, cost)
+        {
+        total += c;
+        maxcost = max(maxcost,c);
+        serial += c/max(1.,min(Real(nthread),c/blasGrain));
+        }
+    return max(maxcost,total/nthread) <= serial;
+    }
+
+struct LargestFirst
+    {
+    const vector<int>& order;
+    const ThreadPool::Task& f;
+
+    LargestFirst(const vector<int>& order_, const ThreadPool::Task& f_)
+        : order(order_), f(f_) { }
+
+    void
+    operator()(int n) const { f(order[n]); }
+    };
+
+} //namespace
+
+ThreadPool::
+ThreadPool(int nthread)
+    :
+    task_(0),
+    ntask_(0),
+    chunk_(1),
+    nactive_(0),
+    next_(0),
+    ndone_(0),
+    generation_(0),
+    busy_(false),
+    quit_(false),
+    failed_(false)
+    {
+    startWorkers(nthread);
+    }
+
+ThreadPool::
+~ThreadPool()
+    {
+    stopWorkers();
+    }
+
+void ThreadPool::
+resize(int nthread)
+    {
+    if(!tryResize(nthread))
+        Error("ThreadPool::resize called while pool is busy");
+    }
+
+bool ThreadPool::
+tryResize(int nthread)
+    {
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        if(busy_) return false;
+        //Calls to run made meanwhile are done serially
+        busy_ = true;
+        }
+    restart(nthread);
+    release();
+    return true;
+    }
+
+void ThreadPool::
+restart(int nthread)
+    {
+    if(nthread == numThreads()) return;
+    stopWorkers();
+    startWorkers(nthread);
+    }
+
+void ThreadPool::
+release()
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    busy_ = false;
+    }
+
+void ThreadPool::
+startWorkers(int nthread)
+    {
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        quit_ = false;
+        }
+    vector<boost::thread*> workers;
+    for(int j = 1; j < nthread; ++j)
+        {
+        workers.push_back(new boost::thread(boost::bind(&ThreadPool::workLoop,this)));
+        }
+    boost::mutex::scoped_lock lock(mutex_);
+    workers_.swap(workers);
+    }
+
+void ThreadPool::
+stopWorkers()
+    {
+    vector<boost::thread*> workers;
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        quit_ = true;
+        workers.swap(workers_);
+        }
+    start_.notify_all();
+    Foreach(boost::thread* w, workers)
+        {
+        w->join();
+        delete w;
+        }
+    }
+
+int ThreadPool::
+numThreads() const
+    {
+    boost::mutex::scoped_lock lock(mutex_);
+    return int(workers_.size())+1;
+    }
+
+void ThreadPool::
+run(int ntask, const Task& f)
+    {
+    //Chunks of tasks small enough to even out 
+    //the work of the threads
+    runTasks(ntask,f,max(1,ntask/(4*numThreads())));
+    }
+
+void ThreadPool::
+runTasks(int ntask, const Task& f, int chunk)
+    {
+    if(ntask <= 0) return;
+
+    bool serial = true;
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        if(!busy_ && !workers_.empty() && ntask > 1)
+            {
+            serial = false;
+            busy_ = true;
+            task_ = &f;
+            ntask_ = ntask;
+            chunk_ = chunk;
+            next_ = 0;
+            ndone_ = 0;
+            failed_ = false;
+            error_.clear();
+            ++generation_;
+            }
+        }
+
+    if(serial)
+        {
+        for(int n = 0; n < ntask; ++n) f(n);
+        return;
+        }
+
+        {
+        //The BLAS thread count is a setting of the whole
+        //process, so BLAS calls made meanwhile by threads
+        //outside the pool get one thread too; it is put
+        //back before the pool is marked idle again
+        BlasThreads blas(1);
+
+        start_.notify_all();
+
+        doTasks(f,ntask,chunk);
+
+        //Workers that joined this call must be done
+        //with it before the next can reset next_
+        boost::mutex::scoped_lock lock(mutex_);
+        while(ndone_ < ntask || nactive_ > 0) done_.wait(lock);
+        }
+
+    bool failed = false;
+    string error;
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        busy_ = false;
+        task_ = 0;
+        failed = failed_;
+        error.swap(error_);
+        }
+
+    if(failed) throw ITError(error);
+    }
+
+void ThreadPool::
+workLoop()
+    {
+    unsigned long seen = 0;
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        seen = generation_;
+        }
+    while(true)
+        {
+        const Task* f = 0;
+        int ntask = 0,
+            chunk = 1;
+            {
+            boost::mutex::scoped_lock lock(mutex_);
+            while(!quit_ && generation_ == seen) start_.wait(lock);
+            if(quit_) return;
+            seen = generation_;
+            if(task_ == 0) continue;
+            f = task_;
+            ntask = ntask_;
+            chunk = chunk_;
+            ++nactive_;
+            }
+
+        doTasks(*f,ntask,chunk);
+
+            {
+            boost::mutex::scoped_lock lock(mutex_);
+            if(--nactive_ == 0) done_.notify_all();
+            }
+        }
+    }
+
+void ThreadPool::
+doTasks(const Task& f, int ntask, int chunk)
+    {
+    while(true)
+        {
+        const int first = __sync_fetch_and_add(&next_,chunk);
+        if(first >= ntask) return;
+        const int last = min(first+chunk,ntask);
+
+        for(int n = first; n < last; ++n)
+            {
+            string error;
+            bool failed = false;
+            try
+                {
+                f(n);
+                }
+            catch(const ITError& e)
+                {
+                failed = true;
+                error = e.what();
+                }
+            catch(const std::exception& e)
+                {
+                failed = true;
+                error = e.what();
+                }
+            catch(...)
+                {
+                failed = true;
+                error = "Unknown exception in ThreadPool task";
+                }
+
+            if(failed)
+                {
+                boost::mutex::scoped_lock lock(mutex_);
+                if(!failed_)
+                    {
+                    failed_ = true;
+                    error_ = error;
+                    }
+                }
+            }
+
+        if(__sync_add_and_fetch(&ndone_,last-first) == ntask)
+            {
+            boost::mutex::scoped_lock lock(mutex_);
+            done_.notify_all();
+            }
+        }
+    }
+
+void ThreadPool::
+runByCost(const vector<Real>& cost, const Task& f)
+    {
+    const int ntask = int(cost.size());
+    if(numThreads() == 1 || ntask < 2 || !preferTasks(cost,numThreads()))
+        {
+        for(int n = 0; n < ntask; ++n) f(n);
+        return;
+        }
+
+    vector<pair<Real,int> > bycost(ntask);
+    for(int n = 0; n < ntask; ++n) 
+        bycost[n] = make_pair(-cost[n],n);
+    sort(bycost.begin(),bycost.end());
+
+    vector<int> order(ntask);
+    for(int n = 0; n < ntask; ++n) 
+        order[n] = bycost[n].second;
+
+    runTasks(ntask,LargestFirst(order,f),1);
+    }
+
+int ThreadPool::
+defaultNumThreads()
+    {
+    const char* v = getenv("ITENSOR_NUM_THREADS");
+    if(v != 0 && atoi(v) > 0) return atoi(v);
+    const int nhard = int(boost::thread::hardware_concurrency());
+    return (nhard > 1 ? nhard : 1);
+    }
+
+namespace {
+
+//Pool size from the "NumThreads" option,
+//setting the BLAS threads if it is given
+int
+optionNumThreads()
+    {
+    const int nthread = Global::options().intOrDefault("NumThreads",0);
+    if(nthread <= 0) return ThreadPool::defaultNumThreads();
+    BlasThreads::set(nthread);
+    return nthread;
+    }
+
+} //namespace
+
+ThreadPool& ThreadPool::
+global()
+    {
+    static ThreadPool pool_(optionNumThreads());
+    return pool_;
+    }
+
+void ThreadPool::
+setNumThreads(int nthread)
+    {
+    const bool given = (nthread > 0);
+    global().resize(given ? nthread : defaultNumThreads());
+
+    //Outside of parallel tasks, BLAS gets as many
+    //threads as the pool, but only if asked for
+    //explicitly: otherwise MKL_NUM_THREADS or
+    //OPENBLAS_NUM_THREADS are left to decide
+    if(given) BlasThreads::set(nthread);
+    }
+
+BlasThreads::
+BlasThreads(int nthread)
+    : prev_(get())
+    {
+    if(nthread != prev_) set(nthread);
+    }
+
+BlasThreads::
+~BlasThreads()
+    {
+    if(get() != prev_) set(prev_);
+    }
+
+bool BlasThreads::
+available()
+    {
+    return blasControl().set != 0;
+    }
+
+int BlasThreads::
+get()
+    {
+    return (available() ? blasControl().get() : 1);
+    }
+
+void BlasThreads::
+set(int nthread)
+    {
+    if(available()) blasControl().set(max(nthread,1));
+    }
@@ -0,0 +1,207 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_THREADPOOL_H
+#define __ITENSOR_THREADPOOL_H
+#include "global.h"
+#include "boost/function.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+//
+// ThreadPool keeps a fixed set of worker threads
+// waiting to run the tasks of a call to run(n,f).
+// The thread calling run also works on the tasks
+// and run returns only once all of them are done.
+// Threads take tasks by atomically advancing the
+// index of the next task, several at a time for run
+// and one at a time for runByCost; the mutex is only
+// used to start and finish a call.
+//
+// If the pool is already busy (say run was called
+// from two threads at once, or from inside a task)
+// the second caller just does all of its tasks itself,
+// so nested parallelism never starts more threads.
+//
+// While tasks run on several threads, MKL and OpenBLAS
+// are limited to one thread each (see BlasThreads).
+// This limit is process-wide: it also holds for BLAS
+// calls made at that time by threads outside the pool.
+//
+
+class ThreadPool
+    {
+    public:
+
+    typedef boost::function<void (int)>
+    Task;
+
+    //nthread counts the calling thread,
+    //so nthread == 1 starts no workers
+    explicit
+    ThreadPool(int nthread = defaultNumThreads());
+
+    ~ThreadPool();
+
+    int
+    numThreads() const;
+
+    //Restarts the pool with nthread threads;
+    //must not be called while run is in progress
+    void
+    resize(int nthread);
+
+    //
+    // Calls f(n) for n = 0,1,...,ntask-1.
+    // The order in which tasks start is unspecified.
+    // If a task throws, the first error caught is
+    // rethrown as an ITError once all tasks are done.
+    //
+    void
+    run(int ntask, const Task& f);
+
+    //
+    // Like run, given an estimate cost[n] of the flops
+    // of each task. If the tasks can keep the pool's
+    // threads busy they run in parallel, the most costly
+    // first. If instead one or a few tasks hold most of
+    // the work, they all run on the calling thread where
+    // BLAS can use every thread of the pool.
+    //
+    void
+    runByCost(const std::vector<Real>& cost, const Task& f);
+
+    //
+    // Pool shared by the whole library. Its size is
+    // read once, on the first call, from the
+    // "NumThreads" option of Global::options() if
+    // set and positive, else defaultNumThreads().
+    // A positive "NumThreads" also sets the number of
+    // BLAS threads; if unset, BLAS keeps its own
+    // setting (e.g. from OPENBLAS_NUM_THREADS).
+    //
+    static ThreadPool&
+    global();
+
+    //
+    // Resizes the global pool, as "NumThreads" does:
+    // nthread > 0 also sets the number of BLAS threads,
+    // nthread <= 0 means defaultNumThreads().
+    // Must not be called while the pool is running tasks.
+    //
+    static void
+    setNumThreads(int nthread);
+
+    //The environment variable ITENSOR_NUM_THREADS
+    //if set, else the number of hardware threads
+    static int
+    defaultNumThreads();
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    std::vector<boost::thread*> workers_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable start_,
+                              done_;
+
+    //next_ and ndone_ are updated with atomic
+    //operations, the rest under mutex_
+    const Task* task_;
+    int ntask_,
+        chunk_,
+        nactive_;
+    volatile int next_,
+                 ndone_;
+    unsigned long generation_;
+    bool busy_,
+         quit_,
+         failed_;
+    std::string error_;
+
+    //
+    /////////////////
+
+    //Returns false, leaving the pool as it
+    //was, if run is in progress
+    bool
+    tryResize(int nthread);
+
+    //Called with busy_ set, so that no 
+    //task runs on the workers meanwhile
+    void
+    restart(int nthread);
+
+    //Clears busy_
+    void
+    release();
+
+    void
+    startWorkers(int nthread);
+
+    void
+    stopWorkers();
+
+    //Calls f(n) for n < ntask, the threads
+    //taking chunk tasks at a time
+    void
+    runTasks(int ntask, const Task& f, int chunk);
+
+    void
+    workLoop();
+
+    void
+    doTasks(const Task& f, int ntask, int chunk);
+
+    //Not copyable
+    ThreadPool(const ThreadPool&);
+    void operator=(const ThreadPool&);
+
+    }; //class ThreadPool
+
+//
+// Number of threads used inside MKL or OpenBLAS calls,
+// found at run time among the loaded libraries. With
+// any other BLAS, available() is false and the rest
+// does nothing.
+//
+// Constructing a BlasThreads sets the number of
+// threads until it is destroyed.
+//
+class BlasThreads
+    {
+    public:
+
+    explicit
+    BlasThreads(int nthread);
+
+    ~BlasThreads();
+
+    static bool
+    available();
+
+    //1 if not available()
+    static int
+    get();
+
+    static void
+    set(int nthread);
+
+    private:
+
+    int prev_;
+
+    //Not copyable
+    BlasThreads(const BlasThreads&);
+    void operator=(const BlasThreads&);
+
+    }; //class BlasThreads
+
+#endif
@@ -6,6 +6,7 @@
 #include <math.h>
 #define CHANGE      0
 #include <fstream>
+#include <vector>
 
 #include "acml.h"
 
@@ -1354,13 +1355,13 @@ void EigenValues(const MatrixRef& A, Vector& D, Matrix& Z)
     char jobz = 'V';
     char uplo = 'U';
     int lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    double work[lwork];
+    vector<double> work(lwork);
     int info;
     
     D.ReDimension(N);
     Z = A;
 
-    dsyev_(&jobz,&uplo,&N,Z.Store(),&N,D.Store(),work,&lwork,&info,1,1);
+    dsyev_(&jobz,&uplo,&N,Z.Store(),&N,D.Store(),&work[0],&lwork,&info,1,1);
 
     if(info != 0)
 	{
@@ -1394,14 +1395,14 @@ GeneralizedEV(const MatrixRef& A, const MatrixRef& B, Vector& D, Matrix& Z)
     char jobz = 'V';
     char uplo = 'U';
     int lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    double work[lwork];
+    vector<double> work(lwork);
     int info;
     
     D.ReDimension(N);
     Z = A;
     Matrix BB(B);//Need to copy since BB gets overwritten
 
-    dsygv_(&itype,&jobz,&uplo,&N,Z.Store(),&N,BB.Store(),&N,D.Store(),work,&lwork,&info,1,1);
+    dsygv_(&itype,&jobz,&uplo,&N,Z.Store(),&N,BB.Store(),&N,D.Store(),&work[0],&lwork,&info,1,1);
 
     if(info != 0)
         {
@@ -2924,13 +2925,13 @@ void HermitianEigenvalues(const Matrix& re, const Matrix& im, Vector& evals,
     char jobz = 'V';
     char uplo = 'U';
     int lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    doublecomplex work[lwork];
-    double rwork[lwork];
+    vector<doublecomplex> work(lwork);
+    vector<double> rwork(lwork);
     int info;
     
     evals.ReDimension(N);
 
-    zheev_(&jobz,&uplo,&N,(doublecomplex*)&(H.dat[0]),&N,evals.Store(),work,&lwork,rwork,&info,1,1);
+    zheev_(&jobz,&uplo,&N,(doublecomplex*)&(H.dat[0]),&N,evals.Store(),&work[0],&lwork,&rwork[0],&info,1,1);
     revecs = H.RealMat().t();
     ievecs = H.ImMat().t();
 
@@ -358,6 +358,35 @@ Real MatrixRef::zerofrac() const
     return (Real (nzeros)) /(nr * nc);
     }
 
+#if defined(i386) || defined(__x86_64)
+void 
+mult(const MatrixRef & M, const VectorRef & V, VectorRef & res,int noclear)
+    {
+// Use BLAS 2 routine unless the storage can't be described to it
+    int m = M.ncols;
+    int n = M.nrows;
+    int lda = M.rowstride;
+    int incx = V.Stride();
+    int incy = res.Stride();
+    if(m == 0 || n == 0 || lda < m || incx < 1 || incy < 1)
+	{
+	if(!noclear) res = 0.0;
+	int i=1;
+	ColumnIter mcol(M);
+	while(mcol.inc())
+	    res.addin(mcol,V(i++));
+	return;
+	}
+
+// Storage is seen by Fortran as the transpose of M
+    static char pt[] = {'T','N'};
+    char trans = pt[M.DoTranspose()];
+    Real alpha = M.Scale() * V.Scale();
+    Real beta = noclear ? 1.0 : 0.0;
+    dgemv_(&trans,&m,&n,&alpha,M.Store(),&lda,V.Store(),&incx,
+	   &beta,res.Store(),&incy);
+    }
+#else
 void 
 mult(const MatrixRef & M, const VectorRef & V, VectorRef & res,int noclear)
     {
@@ -367,6 +396,7 @@ mult(const MatrixRef & M, const VectorRef & V, VectorRef & res,int noclear)
     while(mcol.inc())
 	res.addin(mcol,V(i++));
     }
+#endif
 
 void 
 AddOuter(const VectorRef & V1, const VectorRef & V2, MatrixRef & M)
@@ -6,6 +6,7 @@
 #include <math.h>
 #define CHANGE      0
 #include <fstream>
+#include <vector>
 #include "mkl_types.h"
 #include "error.h"
 #include <cstdlib>
@@ -1481,10 +1482,10 @@ void EigenValues(const MatrixRef& A, Vector& D, Matrix& Z)
     //Call routine
     MKL_INT lwork = (MKL_INT) QWORK[0];
     MKL_INT liwork = QIWORK[0];
-    double WORK[lwork];
-    MKL_INT IWORK[liwork];
+    vector<double> WORK(lwork);
+    vector<MKL_INT> IWORK(liwork);
     info = 0;
-    dsyevd_(&jobz,&uplo,&n,Z.Store(),&n,D.Store(),WORK,&lwork,IWORK,&liwork,&info);
+    dsyevd_(&jobz,&uplo,&n,Z.Store(),&n,D.Store(),&WORK[0],&lwork,&IWORK[0],&liwork,&info);
 	if(info != 0)
         {
         cerr << "info is " << info << endl;
@@ -1509,14 +1510,14 @@ GeneralizedEV(const MatrixRef& A, const MatrixRef& B, Vector& D, Matrix& Z)
     char jobz = 'V';
     char uplo = 'U';
     MKL_INT lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    double work[lwork];
+    vector<double> work(lwork);
     MKL_INT info;
     
     D.ReDimension(N);
     Z = A;
     Matrix BB(B);//Need to copy since BB gets overwritten
 
-    dsygv_(&itype,&jobz,&uplo,&N,Z.Store(),&N,BB.Store(),&N,D.Store(),work,&lwork,&info);
+    dsygv_(&itype,&jobz,&uplo,&N,Z.Store(),&N,BB.Store(),&N,D.Store(),&work[0],&lwork,&info);
 
     if(info != 0)
         {
@@ -1567,9 +1568,9 @@ GenEigenValues(const MatrixRef& A, Vector& Re, Vector& Im)
 
     //Call routine
     MKL_INT lwork = (MKL_INT) QWORK[0];
-    double WORK[lwork];
+    vector<double> WORK(lwork);
     info = 0;
-    dgeev_(&jobvl,&jobvr,&n,Z.Store(),&n,Re.Store(),Im.Store(),noevecs,&num_evecs,noevecs,&num_evecs,WORK,&lwork,&info);
+    dgeev_(&jobvl,&jobvr,&n,Z.Store(),&n,Re.Store(),Im.Store(),noevecs,&num_evecs,noevecs,&num_evecs,&WORK[0],&lwork,&info);
 	if(info != 0)
         {
         cerr << "info is " << info << endl;
@@ -3079,14 +3080,14 @@ void HermitianEigenvalues(const Matrix& re, const Matrix& im, Vector& evals,
     char jobz = 'V';
     char uplo = 'U';
     MKL_INT lwork = max(1,3*N-1);//max(1, 1+6*N+2*N*N);
-    MKL_Complex16 work[lwork];
-    double rwork[lwork];
+    vector<MKL_Complex16> work(lwork);
+    vector<double> rwork(lwork);
     MKL_INT info;
     
     evals.ReDimension(N);
 
     zheev_(&jobz,&uplo,&N,(MKL_Complex16*)&(H.dat[0]),&N,evals.Store(),
-           work,&lwork,rwork,&info);
+           &work[0],&lwork,&rwork[0],&info);
     revecs = H.RealMat().t();
     ievecs = H.ImMat().t();
 
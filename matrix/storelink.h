@@ -4,6 +4,7 @@
 #define _storelink_h
 
 #include <iostream>
+#include "storepool.h"
 
 typedef double Real;
 
@@ -11,7 +12,10 @@ typedef double Real;
 // storage on which they are based from being deleted prematurely. 
 // StoreLink utilizes reference counting. The ref classes never 
 // allocate storage. The actual storage classes utilize makestorage, 
-// etc. for allocation.
+// etc. for allocation, which come from StorePool.
+// The counts are updated atomically (gcc __sync builtins) so that
+// links to the same storage, including the shared null storage, 
+// may be made and destroyed from several threads.
 
 class StoreReport;
 
@@ -81,6 +85,10 @@ private:
         }
 
     enum { offset = (sizeof(storerep)-1) / sizeof(Real) + 1 };
+    static inline void addref(storerep* r)
+        { __sync_add_and_fetch(&(r->numref),1); }
+    static inline int release(storerep* r)
+        { return __sync_sub_and_fetch(&(r->numref),1); }
     inline void donew(int s);
     inline void dodelete();
 // " =" is private, not allowed.  Put in to replace default shallow copy.
@@ -115,29 +123,31 @@ inline void StoreLink::donew(int s)
     {
     if (s > 0)
 	{
-	p = (storerep *) new Real[s + offset];
-	p->numref = 1; p->storage = s; StoreLink::storageinuse() += s;
-    StoreLink::numberofobjects()++;
+	p = (storerep *) StorePool::alloc(sizeof(Real)*(s + offset));
+	p->numref = 1; p->storage = s; 
+    __sync_add_and_fetch(&StoreLink::storageinuse(),s);
+    __sync_add_and_fetch(&StoreLink::numberofobjects(),1);
 	// cout << "Making storage address " << (long)(p) << endl;
 	}
     else  
-	{ p = StoreLink::pnullrep(); p->numref++; }
+	{ p = StoreLink::pnullrep(); addref(p); }
     }
 
 inline void StoreLink::dodelete()
     { 
-    if(--p->numref == 0) 
+    if(release(p) == 0) 
 	{
 	// cout << "Deleting storage address " << (long)(p) << endl;
-    StoreLink::storageinuse() -= p->storage; StoreLink::numberofobjects()--;
-	delete [] ((Real *) p);
+    __sync_sub_and_fetch(&StoreLink::storageinuse(),p->storage);
+    __sync_sub_and_fetch(&StoreLink::numberofobjects(),1);
+	StorePool::dealloc(p, sizeof(Real)*(p->storage + offset));
 //	if(StoreLink::storageinuse() <= 0)
 //	    cout << "Storage in use is now " << StoreLink::storageinuse() << endl;
 	}
     }
 
 inline StoreLink::StoreLink() : p(StoreLink::pnullrep())
-    { p->numref++; }
+    { addref(p); }
 
 inline Real * StoreLink::Store() const
     { return ((Real *)p)+offset; }
@@ -149,11 +159,11 @@ inline int StoreLink::Storage() const { return p->storage; }
 inline StoreLink::~StoreLink() { dodelete(); }
 
 inline StoreLink::StoreLink(const StoreLink & S) : p(S.p)
-    { p->numref++; }
+    { addref(p); }
 
 inline StoreLink & StoreLink::operator<<(const StoreLink & S)		
     { 			
-    if(this != &S) { dodelete(); p = S.p; p->numref++; }
+    if(this != &S) { addref(S.p); dodelete(); p = S.p; }
     return *this; 
     }
 
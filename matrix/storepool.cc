@@ -0,0 +1,341 @@
+// storepool.cc -- Code for StorePool class
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <new>
+#include <vector>
+#include "storepool.h"
+
+namespace {
+
+// Size classes: minblock bytes, then four classes per doubling
+// up to maxblock bytes.  Larger blocks are not pooled.
+const size_t minblock = 128;
+const int minlog = 7;			// log2(minblock)
+const int maxlog = 26;			// log2(maxblock) = 64MB
+const int nclass = 4*(maxlog-minlog) + 1;
+
+inline int
+floorlog2(size_t n)
+    { return 8*sizeof(unsigned long) - 1 - __builtin_clzl((unsigned long)n); }
+
+inline int
+classindex(size_t n)			// nclass if too large to pool
+    {
+    if(n <= minblock) return 0;
+    const int o = floorlog2(n-1);
+    if(o >= maxlog) return nclass;
+    const size_t quarter = (size_t(1) << o) >> 2;
+    const size_t sub = (n - (size_t(1) << o) + quarter - 1) / quarter;
+    return 4*(o-minlog) + int(sub);
+    }
+
+inline size_t
+classsize(int i)
+    {
+    if(i == 0) return minblock;
+    const int o = minlog + (i-1)/4;
+    return (size_t(1) << o) + ((i-1)%4 + 1)*((size_t(1) << o) >> 2);
+    }
+
+struct Cache
+    {
+    std::vector<void*> free[nclass];
+    size_t bytes;
+    int arena;				// Depth of nested Arenas
+    // Statistics of the owning thread: inuse counts the blocks it
+    // allocated less those it freed, so it can go negative
+    long allocs, mallocs, inuse, peak;
+    int gen;				// Value of statsgen for these counts
+    Cache() : bytes(0), arena(0), allocs(0), mallocs(0), inuse(0),
+	      peak(0), gen(0) {}
+    };
+
+// Incremented by resetStats; a Cache whose counts are from an
+// earlier generation has made no allocations since the reset
+volatile int statsgen = 0;
+
+inline void
+renew(Cache& c)
+    {
+    if(c.gen == statsgen) return;
+    c.gen = statsgen;
+    c.allocs = 0;
+    c.mallocs = 0;
+    c.peak = c.inuse;
+    }
+
+inline void
+addinuse(Cache& c, long n)
+    {
+    c.inuse += n;
+    if(c.inuse > c.peak) c.peak = c.inuse;
+    }
+
+pthread_mutex_t sharedlock = PTHREAD_MUTEX_INITIALIZER;
+
+Cache&
+shared()
+    {
+    static Cache* shared_ = new Cache;	// Never deleted, may outlive statics
+    return *shared_;
+    }
+
+// Hand a block freed by a thread to the shared cache, or to the system
+void
+toshared(void* p, int i)
+    {
+    const size_t sz = classsize(i);
+    pthread_mutex_lock(&sharedlock);
+    Cache& sc = shared();
+    const bool keep = (sc.bytes + sz <= StorePool::sharedCacheLimit());
+    if(keep)
+	{
+	sc.free[i].push_back(p);
+	sc.bytes += sz;
+	}
+    pthread_mutex_unlock(&sharedlock);
+    if(!keep) free(p);
+    }
+
+// Move blocks out of c, largest first, until it holds at most limit bytes
+void
+trim(Cache& c, size_t limit)
+    {
+    for(int i = nclass-1; i >= 0 && c.bytes > limit; --i)
+	{
+	const size_t sz = classsize(i);
+	while(!c.free[i].empty() && c.bytes > limit)
+	    {
+	    void* p = c.free[i].back();
+	    c.free[i].pop_back();
+	    c.bytes -= sz;
+	    toshared(p,i);
+	    }
+	}
+    }
+
+// The caches of running threads, and the counts of exited ones
+pthread_mutex_t registrylock = PTHREAD_MUTEX_INITIALIZER;
+
+std::vector<Cache*>&
+registry()
+    {
+    static std::vector<Cache*>* reg_ = new std::vector<Cache*>;
+    return *reg_;
+    }
+
+Cache&
+retired()
+    {
+    static Cache* ret_ = new Cache;
+    return *ret_;
+    }
+
+void
+threadexit(void* v)
+    {
+    Cache* c = (Cache*) v;
+    trim(*c,0);
+    pthread_mutex_lock(&registrylock);
+    std::vector<Cache*>& reg = registry();
+    for(size_t j = 0; j < reg.size(); ++j)
+	if(reg[j] == c) { reg[j] = reg.back(); reg.pop_back(); break; }
+    renew(*c);
+    Cache& r = retired();
+    renew(r);
+    r.allocs += c->allocs;
+    r.mallocs += c->mallocs;
+    r.inuse += c->inuse;
+    r.peak += c->peak;
+    pthread_mutex_unlock(&registrylock);
+    delete c;
+    }
+
+pthread_key_t cachekey;
+pthread_once_t cacheonce = PTHREAD_ONCE_INIT;
+
+void
+makekey()
+    { pthread_key_create(&cachekey,threadexit); }
+
+Cache&
+threadcache()
+    {
+    pthread_once(&cacheonce,makekey);
+    Cache* c = (Cache*) pthread_getspecific(cachekey);
+    if(c == 0)
+	{
+	c = new Cache;
+	c->gen = statsgen;
+	pthread_setspecific(cachekey,c);
+	pthread_mutex_lock(&registrylock);
+	registry().push_back(c);
+	pthread_mutex_unlock(&registrylock);
+	}
+    return *c;
+    }
+
+// Add the counts of c, as of the current generation, to s
+void
+addcounts(StorePool::Stats& s, const Cache& c)
+    {
+    const bool current = (c.gen == statsgen);
+    s.allocs += (current ? c.allocs : 0);
+    s.mallocs += (current ? c.mallocs : 0);
+    s.inuse += c.inuse;
+    s.peak += (current ? c.peak : c.inuse);
+    s.cached += long(c.bytes);
+    }
+
+} //namespace
+
+size_t StorePool::blockSize(size_t n)
+    {
+    const int i = classindex(n);
+    return (i == nclass ? n : classsize(i));
+    }
+
+size_t& StorePool::threadCacheLimit()
+    {
+    static size_t limit_ = size_t(64) << 20;
+    return limit_;
+    }
+
+size_t& StorePool::sharedCacheLimit()
+    {
+    static size_t limit_ = size_t(256) << 20;
+    return limit_;
+    }
+
+void* StorePool::alloc(size_t n)
+    {
+    Cache& tc = threadcache();
+    renew(tc);
+    ++tc.allocs;
+    const int i = classindex(n);
+    if(i == nclass)
+	{
+	void* p = malloc(n);
+	if(p == 0) throw std::bad_alloc();
+	++tc.mallocs;
+	addinuse(tc,long(n));
+	return p;
+	}
+
+    const size_t sz = classsize(i);
+    void* p = 0;
+    if(!tc.free[i].empty())
+	{
+	p = tc.free[i].back();
+	tc.free[i].pop_back();
+	tc.bytes -= sz;
+	}
+    else
+	{
+	pthread_mutex_lock(&sharedlock);
+	Cache& sc = shared();
+	if(!sc.free[i].empty())
+	    {
+	    p = sc.free[i].back();
+	    sc.free[i].pop_back();
+	    sc.bytes -= sz;
+	    }
+	pthread_mutex_unlock(&sharedlock);
+	}
+
+    if(p == 0)
+	{
+	p = malloc(sz);
+	if(p == 0) throw std::bad_alloc();
+	++tc.mallocs;
+	}
+    addinuse(tc,long(sz));
+    return p;
+    }
+
+void StorePool::dealloc(void* p, size_t n)
+    {
+    if(p == 0) return;
+    Cache& tc = threadcache();
+    const int i = classindex(n);
+    if(i == nclass)
+	{
+	tc.inuse -= long(n);
+	free(p);
+	return;
+	}
+
+    const size_t sz = classsize(i);
+    tc.inuse -= long(sz);
+    if(tc.arena > 0 || tc.bytes + sz <= threadCacheLimit())
+	{
+	tc.free[i].push_back(p);
+	tc.bytes += sz;
+	}
+    else
+	toshared(p,i);
+    }
+
+void StorePool::releaseShared()
+    {
+    pthread_mutex_lock(&sharedlock);
+    Cache& sc = shared();
+    for(int i = 0; i < nclass; ++i)
+	{
+	for(size_t j = 0; j < sc.free[i].size(); ++j) free(sc.free[i][j]);
+	sc.free[i].clear();
+	}
+    sc.bytes = 0;
+    pthread_mutex_unlock(&sharedlock);
+    }
+
+void StorePool::releaseThread()
+    {
+    Cache& tc = threadcache();
+    for(int i = 0; i < nclass; ++i)
+	{
+	for(size_t j = 0; j < tc.free[i].size(); ++j) free(tc.free[i][j]);
+	tc.free[i].clear();
+	}
+    tc.bytes = 0;
+    }
+
+// The counts of other running threads are read without a lock,
+// so they may be slightly behind
+StorePool::Stats StorePool::stats()
+    {
+    Stats s;
+    pthread_mutex_lock(&registrylock);
+    const std::vector<Cache*>& reg = registry();
+    for(size_t j = 0; j < reg.size(); ++j) addcounts(s,*reg[j]);
+    addcounts(s,retired());
+    pthread_mutex_unlock(&registrylock);
+    pthread_mutex_lock(&sharedlock);
+    s.cached += long(shared().bytes);
+    pthread_mutex_unlock(&sharedlock);
+    return s;
+    }
+
+void StorePool::resetStats()
+    { __sync_add_and_fetch(&statsgen,1); }
+
+StorePool::Arena::Arena(bool active)
+    : active_(active)
+    { if(active_) ++threadcache().arena; }
+
+StorePool::Arena::~Arena()
+    {
+    if(!active_) return;
+    Cache& tc = threadcache();
+    if(--tc.arena == 0) trim(tc,threadCacheLimit());
+    }
+
+std::ostream& operator<<(std::ostream& s, const StorePool::Stats& st)
+    {
+    const double mb = 1024*1024;
+    s << st.allocs << " allocs (" << st.mallocs << " from system), "
+      << st.inuse/mb << "MB in use, peak " << st.peak/mb << "MB, "
+      << st.cached/mb << "MB cached";
+    return s;
+    }
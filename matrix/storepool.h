@@ -0,0 +1,71 @@
+// storepool.h -- Size-class pool for the storage of Matrix/Vector objects
+
+#ifndef _storepool_h
+#define _storepool_h
+
+#include <iostream>
+
+// StoreLink gets its storage from StorePool rather than directly from new.
+// Requests are rounded up to one of a set of size classes (four per
+// doubling, so at most 25% is wasted) and freed blocks are kept for reuse:
+// first in a cache private to the freeing thread, then in a shared cache
+// guarded by a lock. Each cache holds at most a fixed number of bytes;
+// beyond that, and for blocks larger than the biggest class, memory goes
+// back to the system.
+//
+// An Arena lifts the limit on the calling thread's cache for its lifetime,
+// so that everything freed during a unit of work (e.g. one DMRG bond
+// update) is available for reuse within it. When the Arena is destroyed
+// the cache is trimmed back to its limit in one pass. Arena(false) does
+// nothing, so that using one can be made optional.
+
+class StorePool
+    {
+public:
+// Allocation, in bytes. dealloc must be passed the same size as alloc.
+    static void* alloc(size_t);
+    static void dealloc(void*, size_t);
+
+// Size actually reserved for a request of the given number of bytes.
+    static size_t blockSize(size_t);
+
+// Largest number of bytes kept in each thread's cache, and in
+// the shared cache. Default 64MB and 256MB.
+    static size_t& threadCacheLimit();
+    static size_t& sharedCacheLimit();
+
+// Return the blocks held in the shared cache, or in the
+// calling thread's cache, to the system.
+    static void releaseShared();
+    static void releaseThread();
+
+// Counts are kept by each thread without any shared counter and summed
+// by stats(). The peak is the sum of each thread's peak, so it is exact
+// when a single thread allocates and otherwise an upper bound.
+    struct Stats
+	{
+	long allocs;		// Number of calls to alloc
+	long mallocs;		// Number of these that went to the system
+	long inuse;		// Bytes currently handed out
+	long peak;		// Largest value of inuse since last reset
+	long cached;		// Bytes held in the caches
+	Stats() : allocs(0), mallocs(0), inuse(0), peak(0), cached(0) {}
+	};
+    static Stats stats();
+    static void resetStats();	// Zeros the counts, sets peak to inuse
+
+    class Arena
+	{
+    public:
+	explicit Arena(bool active = true);
+	~Arena();
+    private:
+	bool active_;
+	Arena(const Arena&);
+	void operator=(const Arena&);
+	};
+    };
+
+std::ostream& operator<<(std::ostream&, const StorePool::Stats&);
+
+#endif
@@ -1,6 +1,8 @@
 #include "svd.h"
 
 #include <fstream>
+#include "boost/random/mersenne_twister.hpp"
+#include "boost/random/normal_distribution.hpp"
 
 using namespace std;
 
@@ -133,3 +135,63 @@ SVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
 
     return;
     }
+
+//Fills M with Gaussian random numbers using its own
+//generator, so that results are reproducible and
+//concurrent calls do not share any state
+static void
+randomFill(Matrix& M, int seed)
+    {
+    boost::random::mt19937 gen(seed);
+    boost::random::normal_distribution<Real> normal;
+    for(int j = 1; j <= M.Ncols(); ++j)
+    for(int i = 1; i <= M.Nrows(); ++i)
+        {
+        M(i,j) = normal(gen);
+        }
+    }
+
+Real
+RandomSVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+          int k, int npower)
+    {
+    const int n = A.Nrows(), 
+              m = A.Ncols();
+
+    if(k >= min(n,m))
+        {
+        SVD(A,U,D,V);
+        return 0;
+        }
+
+    Matrix Omega(m,k);
+    randomFill(Omega,n+7*m+31*k);
+
+    //Q spans (approximately) the range
+    //of the leading k singular vectors of A
+    Matrix Q = A * Omega;
+    Orthog(Q,k,2);
+    for(int p = 1; p <= npower; ++p)
+        {
+        Omega = A.t() * Q;
+        Orthog(Omega,k,2);
+        Q = A * Omega;
+        Orthog(Q,k,2);
+        }
+
+    Matrix B = Q.t() * A, 
+           u;
+    SVD(B,u,D,V);
+    U = Q * u;
+
+    Real resid = 0;
+    for(int j = 1; j <= m; ++j)
+        {
+        const Real nj = Norm(A.Column(j));
+        resid += nj*nj;
+        }
+    for(int j = 1; j <= k; ++j)
+        resid -= D(j)*D(j);
+
+    return max(resid,0.);
+    }
@@ -27,4 +27,24 @@ void
 SVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
     Real newThresh = 1E-4);
 
+//
+// Computes only the leading k singular triplets of A
+// (U is n x k, D has length k, V is k x m) using a
+// randomized range finder: the columns of A * Omega, for a
+// random m x k Matrix Omega, are orthonormalized and refined
+// by npower passes of power iteration, giving Q with
+// A ~= Q * Q.t() * A. The small Matrix Q.t() * A is then
+// decomposed with SVD above.
+//
+// Returns the weight of A missed by the approximation,
+// |A|^2 - sum_j D(j)^2, which is an upper bound on
+// the error in the k'th singular value squared.
+//
+// If k >= min(n,m) this just calls SVD and returns 0.
+//
+
+Real
+RandomSVD(const MatrixRef& A, Matrix& U, Vector& D, Matrix& V,
+          int k, int npower = 2);
+
 #endif
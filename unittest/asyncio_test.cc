@@ -0,0 +1,154 @@
+#include "test.h"
+#include "itensor.h"
+#include "asyncio.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+using namespace boost;
+
+struct AsyncIODefaults
+    {
+    const Index s1,s2,s3;
+    ITensor A,B,C;
+    string dir;
+    vector<string> files;
+
+    AsyncIODefaults()
+        :
+        s1("s1",2,Site),
+        s2("s2",3,Site),
+        s3("s3",4,Site),
+        A(s1,s2),
+        B(s2,s3),
+        C(s1,s2,s3),
+        dir(mkTempDir("asyncio","/tmp/"))
+        {
+        A.Randomize();
+        B.Randomize();
+        C.Randomize();
+        }
+
+    string
+    file(const string& name)
+        {
+        files.push_back(dir + "/" + name);
+        return files.back();
+        }
+
+    ~AsyncIODefaults()
+        {
+        Foreach(const string& f, files)
+            std::remove(f.c_str());
+        rmdir(dir.c_str());
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(AsyncIOTest,AsyncIODefaults)
+
+TEST(RoundTrip)
+    {
+    const string fA = file("A"), fB = file("B");
+        {
+        AsyncIO io;
+        io.put(fA,A);
+        io.put(fB,B);
+        io.flush();
+        CHECK(io.stallTime() >= 0);
+        }
+
+    //Written to disk in the usual format
+    ITensor rA;
+    readFromFile(fA,rA);
+    CHECK_CLOSE((rA-A).norm(),0,1E-10);
+
+    AsyncIO io;
+    ITensor rB;
+    io.get(fB,rB);
+    CHECK_CLOSE((rB-B).norm(),0,1E-10);
+    }
+
+TEST(GetPending)
+    {
+    const string fA = file("A");
+    AsyncIO io;
+    io.put(fA,A);
+    //May or may not be written yet
+    ITensor rA;
+    io.get(fA,rA);
+    CHECK_CLOSE((rA-A).norm(),0,1E-10);
+
+    //The latest version wins
+    io.put(fA,B);
+    io.get(fA,rA);
+    CHECK_CLOSE((rA-B).norm(),0,1E-10);
+    io.flush();
+
+    ITensor dA;
+    readFromFile(fA,dA);
+    CHECK_CLOSE((dA-B).norm(),0,1E-10);
+    }
+
+TEST(Prefetch)
+    {
+    const string fA = file("A"), fB = file("B"), fC = file("C");
+    writeToFile(fA,A);
+    writeToFile(fB,B);
+    writeToFile(fC,C);
+
+    AsyncIO io(2);
+    io.prefetch(fA);
+    io.prefetch(fB);
+    //Window is full, ignored
+    io.prefetch(fC);
+
+    ITensor rA, rB, rC;
+    io.get(fB,rB);
+    io.get(fA,rA);
+    io.get(fC,rC);
+    CHECK_CLOSE((rA-A).norm(),0,1E-10);
+    CHECK_CLOSE((rB-B).norm(),0,1E-10);
+    CHECK_CLOSE((rC-C).norm(),0,1E-10);
+
+    //Prefetching a file which doesn't exist
+    //only fails when it is asked for
+    const string fD = file("D");
+    io.prefetch(fD);
+    ITensor rD;
+    BOOST_CHECK_THROW(io.get(fD,rD),ITError);
+    }
+
+TEST(SmallWindow)
+    {
+    AsyncIO io(1);
+    CHECK_EQUAL(io.window(),1);
+
+    vector<ITensor> T(6);
+    for(size_t j = 0; j < T.size(); ++j)
+        {
+        T[j] = C;
+        T[j] *= (j+1.);
+        io.put(file(str(format("T%d")%j)),T[j]);
+        }
+
+    for(size_t j = 0; j < T.size(); ++j)
+        {
+        ITensor r;
+        io.get(files.at(j),r);
+        CHECK_CLOSE((r-T[j]).norm(),0,1E-10);
+        }
+    }
+
+TEST(MissingFile)
+    {
+    AsyncIO io;
+    ITensor r;
+    BOOST_CHECK_THROW(io.get(dir+"/none",r),ITError);
+
+    //Write errors are reported by a later call
+    io.put(dir+"/nodir/A",A);
+    BOOST_CHECK_THROW(io.flush(),ITError);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
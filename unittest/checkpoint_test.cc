@@ -0,0 +1,194 @@
+#include "test.h"
+#include "checkpoint.h"
+#include "hams/heisenberg.h"
+#include "model/spinhalf.h"
+#include "core.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+using namespace boost;
+
+struct CheckpointDefaults
+    {
+    const int N;
+    SpinHalf model;
+    IQMPO H;
+    IQMPS psi;
+    string dir, fname;
+
+    CheckpointDefaults()
+        :
+        N(8),
+        model(N),
+        H(Heisenberg(model)),
+        dir(mkTempDir("checkpoint","/tmp/")),
+        fname(dir + "/ckpt")
+        {
+        InitState initState(N);
+        for(int i = 1; i <= N; ++i)
+            initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+        psi = IQMPS(model,initState);
+        Sweeps sweeps(2);
+        sweeps.maxm() = 20;
+        sweeps.cutoff() = 1E-10;
+        dmrg(psi,H,sweeps,Quiet());
+        }
+
+    ~CheckpointDefaults()
+        {
+        std::remove(fname.c_str());
+        rmdir(dir.c_str());
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(CheckpointTest,CheckpointDefaults)
+
+TEST(ITensorRoundTrip)
+    {
+    Index s1("s1",2,Site), s2("s2",3,Site), l("l",1);
+    ITensor A(s1,primed(s2),l), B(s2,s1), N0;
+    A.Randomize();
+    B.Randomize();
+    B *= -3.5;
+        {
+        CheckpointWriter w(fname);
+        w.write("A",A);
+        w.write("B",B);
+        w.write("null",N0);
+        w.writeInt("n",-42);
+        w.writeReal("x",0.25);
+        }
+
+    CheckpointReader r(fname);
+    CHECK_EQUAL(r.version(),1);
+    CHECK_EQUAL(r.names().size(),5);
+    CHECK(r.has("A"));
+    CHECK(!r.has("C"));
+
+    ITensor rA, rB, rN(s1);
+    r.read("A",rA);
+    r.read("B",rB);
+    r.read("null",rN);
+    CHECK(rA.hasindex(primed(s2)));
+    CHECK(rA.hasindex(l));
+    CHECK_CLOSE((rA-A).norm(),0,1E-12);
+    CHECK_CLOSE((rB-B).norm(),0,1E-12);
+    CHECK(rN.isNull());
+    //Index's are shared by the tensors read
+    CHECK_CLOSE((rA*rB - A*B).norm(),0,1E-12);
+
+    CHECK_EQUAL(r.intVal("n"),-42);
+    CHECK_CLOSE(r.realVal("x"),0.25,1E-16);
+    }
+
+TEST(IQTensorRoundTrip)
+    {
+    IQTensor A = psi.AA(4),
+             Ac = conj(psi.AA(5)),
+             Z = psi.AA(3)*IQTensor::Complex_1() + psi.AA(3)*IQTensor::Complex_i();
+        {
+        CheckpointWriter w(fname);
+        w.write("A",A);
+        w.write("Ac",Ac);
+        w.write("Z",Z);
+        }
+
+    CheckpointReader r(fname);
+    IQTensor rA, rAc, rZ;
+    r.read("A",rA);
+    r.read("Ac",rAc);
+    r.read("Z",rZ);
+    CHECK_EQUAL(rA.iten_size(),A.iten_size());
+    CHECK_CLOSE((rA-A).norm(),0,1E-12);
+    CHECK_CLOSE((rAc-Ac).norm(),0,1E-12);
+    for(int j = 1; j <= Ac.r(); ++j)
+        CHECK_EQUAL(rAc.findtype(Ac.index(j).type()).dir(),Ac.findtype(Ac.index(j).type()).dir());
+    CHECK(rZ.isComplex());
+    CHECK_CLOSE((rZ-Z).norm(),0,1E-12);
+    }
+
+TEST(MPSRoundTrip)
+    {
+    const Real E = psiHphi(psi,H,psi);
+        {
+        CheckpointWriter w(fname);
+        w.write("psi",psi);
+        w.write("H",H);
+        }
+
+    CheckpointReader r(fname);
+    IQMPS rpsi(model);
+    IQMPO rH(model);
+    r.read("psi",rpsi);
+    r.read("H",rH);
+    CHECK_EQUAL(rpsi.leftLim(),psi.leftLim());
+    CHECK_EQUAL(rpsi.rightLim(),psi.rightLim());
+    CHECK_EQUAL(rpsi.maxm(),psi.maxm());
+    CHECK_CLOSE(psiHphi(rpsi,rH,rpsi),E,1E-10);
+    CHECK_CLOSE(psiHphi(rpsi,H,psi),E,1E-10);
+
+    SpinHalf model6(6);
+    IQMPS psi6(model6);
+    BOOST_CHECK_THROW(r.read("psi",psi6),ITError);
+    }
+
+TEST(Environments)
+    {
+    psi.position(3);
+    LocalMPO<IQTensor> PH(H);
+    PH.position(3,psi);
+        {
+        CheckpointWriter w(fname);
+        w.write("PH",PH);
+        }
+
+    CheckpointReader r(fname);
+    LocalMPO<IQTensor> rPH(H);
+    r.read("PH",rPH);
+    CHECK_EQUAL(rPH.position(),3);
+
+    const IQTensor phi = psi.AA(3)*psi.AA(4);
+    IQTensor Hphi, rHphi;
+    PH.product(phi,Hphi);
+    rPH.product(phi,rHphi);
+    CHECK_CLOSE((rHphi-Hphi).norm(),0,1E-12);
+
+    //Environments to the left were saved too
+    psi.position(1);
+    PH.position(1,psi);
+    rPH.position(1,psi);
+    const IQTensor phi1 = psi.AA(1)*psi.AA(2);
+    PH.product(phi1,Hphi);
+    rPH.product(phi1,rHphi);
+    CHECK((rHphi-Hphi).norm() < 1E-12);
+    }
+
+TEST(Errors)
+    {
+    ITensor A(Index("s",2,Site));
+        {
+        CheckpointWriter w(fname);
+        w.write("A",A);
+        BOOST_CHECK_THROW(w.write("A",A),ITError);
+        w.close();
+        BOOST_CHECK_THROW(w.writeInt("n",1),ITError);
+        }
+
+    CheckpointReader r(fname);
+    IQTensor T;
+    BOOST_CHECK_THROW(r.read("A",T),ITError);
+    BOOST_CHECK_THROW(r.intVal("B"),ITError);
+
+    const string other = dir + "/other";
+        {
+        std::ofstream f(other.c_str());
+        f << "not a checkpoint file, but long enough to have a header..........\n";
+        }
+    BOOST_CHECK_THROW(CheckpointReader bad(other),ITError);
+    std::remove(other.c_str());
+    BOOST_CHECK_THROW(CheckpointReader missing(other),ITError);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
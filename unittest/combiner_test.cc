@@ -156,4 +156,55 @@ TEST(Product)
 
 }
 
+TEST(SharedData)
+{
+    ITensor A(b3,l2,b4,l3);
+    A.Randomize();
+
+    Profiler::reset();
+    Profiler::maxEvents(0);
+    Profiler::enable();
+
+    //l2 and b4 are next to each other and in order:
+    //only the indices change
+    Combiner c(l2,b4);
+    c.init();
+    const Index r = c.right();
+    ITensor cA = c * A;
+
+    //b4 before l2 needs a permutation
+    Combiner d(b4,l2);
+    d.init();
+    const Index q = d.right();
+    ITensor dA = d * A;
+
+    Profiler::enable(false);
+    int shared = 0;
+    Foreach(const Profiler::Site& s, Profiler::sites())
+    {
+        if(s.name == "ITensor::groupIndices (shared)") shared = s.count;
+    }
+    Profiler::reset();
+    CHECK_EQUAL(shared,1);
+
+    CHECK_EQUAL(cA.r(),3);
+    CHECK(cA.hasindex(r) && !cA.hasindex(l2) && !cA.hasindex(b4));
+    CHECK(dA.hasindex(q) && !dA.hasindex(l2) && !dA.hasindex(b4));
+    for(int j = 1; j <= 3; ++j)
+    for(int k2 = 1; k2 <= 2; ++k2)
+    for(int k4 = 1; k4 <= 4; ++k4)
+    for(int k3 = 1; k3 <= 2; ++k3)
+    {
+        const Real a = A(b3(j),l2(k2),b4(k4),l3(k3));
+        CHECK_CLOSE(cA(b3(j),r(k2+2*(k4-1)),l3(k3)),a,1E-10);
+        CHECK_CLOSE(dA(b3(j),q(k4+4*(k2-1)),l3(k3)),a,1E-10);
+    }
+
+    //Uncombining gives A back
+    ITensor ucA = c * cA;
+    CHECK((ucA-A).norm() < 1E-12*A.norm());
+    ITensor udA = d * dA;
+    CHECK((udA-A).norm() < 1E-12*A.norm());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+#include "test.h"
+#include "contract.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace boost;
+
+struct ContractionDefaults
+    {
+    const Index a,b,c,d;
+
+    ContractionDefaults()
+        :
+        a("a",10),
+        b("b",100),
+        c("c",5),
+        d("d",50)
+        { }
+    };
+
+//Random IQTensor with a block for each pair
+//of Index's of i and j with the same position
+IQTensor
+randomDiag(const IQIndex& i, const IQIndex& j)
+    {
+    IQTensor T(i,j);
+    for(int n = 1; n <= i.nindex(); ++n)
+        {
+        ITensor t(i.index(n),j.index(n));
+        t.Randomize();
+        T += t;
+        }
+    return T;
+    }
+
+BOOST_FIXTURE_TEST_SUITE(ContractionTest,ContractionDefaults)
+
+TEST(MatrixChain)
+    {
+    ITensor A(a,b), B(b,c), C(c,d);
+    A.Randomize(); B.Randomize(); C.Randomize();
+
+    //(A*B)*C costs 10*100*5 + 10*5*50
+    Contraction<ITensor> AC;
+    AC.add(A,"A").add(B,"B").add(C,"C");
+    CHECK_EQUAL(AC.order(),"(A*B)*C");
+    CHECK_CLOSE(AC.flops(),7500,1E-10);
+
+    ITensor R = AC.result();
+    ITensor F = A*(B*C);
+    CHECK((R-F).norm() < 1E-12*F.norm());
+
+    //B*C first is cheaper when it
+    //is much smaller than A*B
+    Index e("e",1000), f("f",2);
+    ITensor BB(b,e), CC(e,f);
+    BB.Randomize(); CC.Randomize();
+    Contraction<ITensor> BC;
+    BC.add(A,"A").add(BB,"B").add(CC,"C");
+    CHECK_EQUAL(BC.order(),"A*(B*C)");
+    CHECK_CLOSE(BC.flops(),100*1000*2+10*100*2,1E-10);
+    R = BC.result();
+    F = (A*BB)*CC;
+    CHECK((R-F).norm() < 1E-12*F.norm());
+
+    //Null operands are skipped
+    Contraction<ITensor> N;
+    N.add(ITensor(),"L").add(A,"A").add(B,"B");
+    CHECK_EQUAL(N.size(),2);
+    CHECK_EQUAL(N.order(),"A*B");
+    }
+
+TEST(Greedy)
+    {
+    //Ring of tensors, more than are searched exhaustively
+    const int n = Contraction<ITensor>::maxExhaustive()+2;
+    vector<Index> l(n);
+    for(int j = 0; j < n; ++j)
+        l[j] = Index(str(format("l%d")%j),2+j%3);
+
+    Contraction<ITensor> C;
+    ITensor F;
+    for(int j = 0; j < n; ++j)
+        {
+        ITensor T(l[j],l[(j+1)%n]);
+        T.Randomize();
+        C.add(T);
+        if(j == 0) F = T;
+        else       F *= T;
+        }
+    CHECK_EQUAL(C.size(),n);
+    CHECK(C.flops() > 0);
+
+    ITensor R = C.result();
+    CHECK_EQUAL(R.r(),0);
+    CHECK_CLOSE(R.val0(),F.val0(),1E-10);
+    }
+
+TEST(LocalOpOrder)
+    {
+    //Two-site DMRG: phi is m x d x d x m,
+    //the MPO tensors have bond dimension k
+    Index l("l",40), r("r",40),
+          s1("s1",2,Site), s2("s2",2,Site),
+          hl("hl",5), hm("hm",5), hr("hr",5);
+
+    ITensor phi(l,s1,s2,r),
+            L(l,hl,primed(l)),
+            Op1(hl,s1,primed(s1),hm),
+            Op2(hm,s2,primed(s2),hr),
+            R(r,hr,primed(r));
+    phi.Randomize(); L.Randomize(); R.Randomize();
+    Op1.Randomize(); Op2.Randomize();
+
+    Contraction<ITensor> C;
+    C.add(phi,"phi").add(L,"L").add(Op1,"Op1").add(Op2,"Op2").add(R,"R");
+    CHECK_EQUAL(C.order(),"(((phi*L)*Op1)*Op2)*R");
+
+    ITensor res = C.result(),
+            fixed = phi * L;
+    fixed *= Op1;
+    fixed *= Op2;
+    fixed *= R;
+    CHECK((res-fixed).norm() < 1E-12*fixed.norm());
+    }
+
+TEST(PlannedProducts)
+    {
+    Index u("u",2), z("z",3), n("n",2);
+    IQIndex I("I",u,QN(+1),z,QN(0),n,QN(-1),Out);
+
+    IQTensor A = randomDiag(conj(I),primed(I)),
+             B = randomDiag(conj(primed(I)),primed(I,2)),
+             C = randomDiag(conj(primed(I,2)),primed(I,3));
+
+    std::vector<ProductPlan> plans;
+    Contraction<IQTensor> C1;
+    C1.add(A,"A").add(B,"B").add(C,"C");
+    IQTensor r1;
+    C1.contract(r1,plans);
+    CHECK_EQUAL(plans.size(),2);
+    CHECK_EQUAL(plans[0].makes(),1);
+    CHECK_EQUAL(plans[1].makes(),1);
+    IQTensor f1 = A*B;
+    f1 *= C;
+    CHECK((r1-f1).norm() < 1E-12*f1.norm());
+
+    //The same products on new data reuse the plans
+    IQTensor A2(A);
+    A2.Randomize();
+    Contraction<IQTensor> C2;
+    C2.add(A2,"A").add(B,"B").add(C,"C");
+    IQTensor r2;
+    C2.contract(r2,plans);
+    CHECK_EQUAL(plans[0].makes(),1);
+    CHECK_EQUAL(plans[0].uses(),1);
+    CHECK_EQUAL(plans[1].uses(),1);
+    IQTensor f2 = A2*B;
+    f2 *= C;
+    CHECK((r2-f2).norm() < 1E-12*f2.norm());
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#include "test.h"
+#include "core.h"
+#include "hams/heisenberg.h"
+#include "model/spinhalf.h"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using namespace std;
+
+struct CostModelDefaults
+    {
+    const int N;
+    SpinHalf model;
+    IQMPO H;
+    InitState initState;
+    IQMPS psi;
+    //Fixed rates, so the tests don't time anything
+    const MachineRates rates;
+
+    CostModelDefaults()
+        :
+        N(8),
+        model(N),
+        H(Heisenberg(model)),
+        initState(N),
+        rates(1E9,1E9,1E-6)
+        {
+        for(int i = 1; i <= N; ++i)
+            initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+        psi = IQMPS(model,initState);
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(CostModelTest,CostModelDefaults)
+
+TEST(ExactDims)
+    {
+    //With maxm large enough nothing is truncated, so
+    //the bond dimensions are those of the Sz = 0 sector
+    Sweeps sweeps(3);
+    sweeps.maxm() = 1000;
+    DMRGCost c(psi,H,sweeps,rates);
+    CHECK_EQUAL(c.sweeps().size(),3);
+    CHECK_EQUAL(c.m(1),2);
+    CHECK_EQUAL(c.m(2),4);
+    CHECK_EQUAL(c.m(3),8);
+    CHECK_EQUAL(c.m(4),16);
+    CHECK_EQUAL(c.m(5),8);
+    CHECK_EQUAL(c.m(7),2);
+    CHECK_EQUAL(c.sweep(3).m,16);
+
+    //Same as a real run
+    dmrg(psi,H,sweeps,Quiet());
+    for(int b = 1; b < N; ++b)
+        CHECK_EQUAL(psi.LinkInd(b).m(),c.m(b));
+    }
+
+TEST(GrowsWithMaxm)
+    {
+    SpinHalf model20(20);
+    IQMPO H20 = Heisenberg(model20);
+    InitState init20(20);
+    for(int i = 1; i <= 20; ++i)
+        init20(i) = (i%2==1 ? model20.Up(i) : model20.Dn(i));
+    IQMPS psi20(model20,init20);
+
+    Sweeps sweeps(4);
+    sweeps.maxm() = 10,20,40,80;
+    DMRGCost c(psi20,H20,sweeps,rates);
+
+    for(int sw = 1; sw <= 4; ++sw)
+        CHECK(c.sweep(sw).m <= sweeps.maxm(sw));
+    CHECK_EQUAL(c.sweep(4).m,80);
+    for(int sw = 2; sw <= 4; ++sw)
+        {
+        CHECK(c.sweep(sw).flops() > c.sweep(sw-1).flops());
+        CHECK(c.sweep(sw).mem > c.sweep(sw-1).mem);
+        }
+    CHECK(c.sweep(4).time > c.sweep(3).time);
+    CHECK(c.sweep(4).disk_mem < c.sweep(4).mem);
+    CHECK_CLOSE(c.time(),c.sweep(1).time+c.sweep(2).time+c.sweep(3).time+c.sweep(4).time,1E-10);
+
+    //Without quantum numbers every product is dense
+    MPS dpsi(model20,init20);
+    MPO dH = Heisenberg(model20);
+    DMRGCost d(dpsi,dH,sweeps,rates);
+    CHECK_EQUAL(d.sweep(4).m,80);
+    CHECK(d.flops() > c.flops());
+    CHECK(d.sweep(4).block_pairs < c.sweep(4).block_pairs);
+    }
+
+TEST(NeedsWriteM)
+    {
+    Sweeps sweeps(3);
+    sweeps.maxm() = 4,8,16;
+
+    DMRGCost fits(psi,H,sweeps,rates,MaxMemory(1E12));
+    CHECK_EQUAL(fits.writeM(),0);
+    CHECK(!fits.exceedsMemory());
+
+    //The second sweep needs more memory than the first
+    const Real limit = 0.5*(fits.sweep(1).mem+fits.sweep(2).mem);
+    DMRGCost tight(psi,H,sweeps,rates,MaxMemory(limit));
+    CHECK_EQUAL(tight.writeM(),8);
+
+    DMRGCost none(psi,H,sweeps,rates,MaxMemory(1));
+    CHECK_EQUAL(none.writeM(),4);
+    CHECK(none.exceedsMemory());
+    }
+
+TEST(DryRunDMRG)
+    {
+    Sweeps sweeps(2);
+    sweeps.maxm() = 20;
+
+    ostringstream out;
+    streambuf* orig = cout.rdbuf(out.rdbuf());
+    const Real E = dmrg(psi,H,sweeps,DryRun());
+    cout.rdbuf(orig);
+
+    CHECK_EQUAL(E,0);
+    CHECK(out.str().find("DMRG cost estimate") != string::npos);
+    //psi is not changed
+    for(int b = 1; b < N; ++b)
+        CHECK_EQUAL(psi.LinkInd(b).m(),1);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
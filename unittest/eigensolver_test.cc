@@ -30,7 +30,7 @@ TEST(FourSite)
 
     MPS psi(model,initState);
 
-    LocalMPO<ITensor> PH(H,2);
+    LocalMPO<ITensor> PH(H,NumCenter(2));
 
     ITensor phip;
     psi.position(2);
@@ -40,7 +40,8 @@ TEST(FourSite)
 
     Eigensolver d(9);
     Real En1 = d.davidson(PH,phi1);
-    CHECK_CLOSE(En1,-1.1896926208,1E-4);
+    //Lowest state given the Neel product state environment
+    CHECK_CLOSE(En1,-0.9571067812,1E-4);
 
     cout << endl << endl;
     /*
@@ -130,7 +131,7 @@ TEST(IQFourSite)
 
     IQMPS psi(model,initState);
 
-    LocalMPO<IQTensor> PH(H,2);
+    LocalMPO<IQTensor> PH(H,NumCenter(2));
 
     IQTensor phip;
     psi.position(2);
@@ -141,9 +142,104 @@ TEST(IQFourSite)
     Eigensolver d(9);
     Real En1 = d.davidson(PH,phi1);
     //cout << format("Energy from tensor Davidson (b=2) = %.20f")%En1 << endl;
-    CHECK_CLOSE(En1,-1.1896926208,1E-4);
+    //Lowest state given the Neel product state environment
+    CHECK_CLOSE(En1,-0.9571067812,1E-4);
 
 
     }
 
+TEST(PackedTensorsGrow)
+    {
+    Index a1("a1",2), a2("a2",3), 
+          b1("b1",2), b2("b2",2);
+    IQIndex A("A",a1,QN(+1),a2,QN(-1),Out),
+            B("B",b1,QN(-1),b2,QN(+1),Out);
+
+    ITensor r11(a1,b1), t22(a2,b2);
+    r11.Randomize();
+    t22.Randomize();
+    IQTensor R(A,B), T(A,B);
+    R += r11;
+    T += -2*r11;
+    T += t22;
+
+    PackedTensors<IQTensor> P(R,2,3);
+    P.store(0,1,R);
+    P.store(1,1,R,-1);
+    CHECK_EQUAL(P.vecSize(),4);
+
+    //The new block of T widens every row used
+    P.store(0,2,T);
+    CHECK_EQUAL(P.vecSize(),10);
+    CHECK((P.tensor(P.vec(0,1))-R).norm() < 1E-12);
+    CHECK((P.tensor(P.vec(0,2))-T).norm() < 1E-12);
+    CHECK((P.tensor(P.vec(1,1))-R).norm() > 1);
+    //The new block is filled in the rows stored before
+    const ITensor &n01 = P.tensor(P.vec(0,1)).blocks().get(t22.uniqueId());
+    CHECK_CLOSE(n01.norm(),0,1E-12);
+    const ITensor &n11 = P.tensor(P.vec(1,1)).blocks().get(t22.uniqueId());
+    CHECK_CLOSE(n11.sumels(),-6,1E-12);
+    CHECK_CLOSE(n11.norm(),sqrt(6.),1E-12);
+
+    //Rows are used in order, up to maxrows
+    bool caught = false;
+    try { P.row(1,3); }
+    catch(const ITError& e) { caught = true; }
+    CHECK(caught);
+
+    P.store(0,3,R);
+    caught = false;
+    try { P.row(0,4); }
+    catch(const ITError& e) { caught = true; }
+    CHECK(caught);
+    }
+
+TEST(ExactLowest)
+    {
+    const int N = 6;
+    SpinHalf model(N);
+    MPO H = Heisenberg(model);
+
+    InitState initState(N);
+    for(int i = 1; i <= N; ++i)
+        initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+
+    MPS psi(model,initState);
+    psi.position(3);
+
+    LocalMPO<ITensor> PH(H,NumCenter(2));
+    PH.position(3,psi);
+
+    ITensor phi = psi.AA(3) * psi.AA(4);
+
+    //Build the matrix of PH column by column
+    const int n = phi.vecSize();
+    Matrix Hm(n,n);
+    Vector e(n);
+    for(int j = 1; j <= n; ++j)
+        {
+        e = 0;
+        e(j) = 1;
+        ITensor x(phi), Hx;
+        x.assignFromVec(e);
+        PH.product(x,Hx);
+        ITensor y(phi);
+        y.assignFrom(Hx);
+        y.assignToVec(Hm.Column(j));
+        }
+    Vector D;
+    Matrix U;
+    EigenValues(Hm,D,U);
+
+    Eigensolver d(n,1E-10);
+    Real En = d.davidson(PH,phi);
+    CHECK_CLOSE(En,D(1),1E-8);
+    CHECK_CLOSE(phi.norm(),1,1E-10);
+
+    //phi is the eigenvector
+    ITensor Hphi;
+    PH.product(phi,Hphi);
+    CHECK((Hphi-En*phi).norm() < 1E-4);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
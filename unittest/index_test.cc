@@ -1,5 +1,6 @@
 #include "test.h"
-#include "index.h"
+#include "indexset.h"
+#include <set>
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(IndexTest)
@@ -32,5 +33,32 @@ BOOST_AUTO_TEST_CASE(Primes)
 
 }
 
+BOOST_AUTO_TEST_CASE(UniqueId)
+{
+    //Indices are created with consecutive uuids
+    std::set<IndexKey> keys;
+    for(int j = 0; j < 1000; ++j)
+        {
+        Index I("I");
+        keys.insert(I.uniqueId());
+        keys.insert(I.primed().uniqueId());
+        keys.insert(I.primed(2).uniqueId());
+        }
+    CHECK_EQUAL(keys.size(),3000);
+
+    Index J("J",2), K("K",3);
+    Index Jc(J);
+    CHECK_EQUAL(Jc.uniqueId(),J.uniqueId());
+    CHECK(Jc.primed().uniqueId() != J.uniqueId());
+    CHECK_EQUAL(Jc.primed().primed(-1).uniqueId(),J.uniqueId());
+
+    //Keys of index sets don't depend on the order
+    IndexSet is1(J,K,primed(J)), 
+                    is2(primed(J),J,K);
+    CHECK_EQUAL(is1.uniqueId(),is2.uniqueId());
+    IndexSet is3(J,primed(K),primed(J));
+    CHECK(is1.uniqueId() != is3.uniqueId());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
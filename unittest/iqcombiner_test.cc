@@ -214,4 +214,47 @@ TEST(CondenseProduct)
     CHECK(diff.norm() < 1E-12);
     }
 
+TEST(CondenseManySectors)
+    {
+    IQTensor psi(L1,S1,S2,L2);
+    Foreach(const inqn& a, L1.iq())
+    Foreach(const inqn& s1, S1.iq())
+    Foreach(const inqn& s2, S2.iq())
+    Foreach(const inqn& b, L2.iq())
+        {
+        if(a.qn + s1.qn + s2.qn + b.qn != QN()) continue;
+        ITensor t(a.index,s1.index,s2.index,b.index);
+        t.Randomize();
+        psi += t;
+        }
+    checkDiv(psi);
+
+    IQCombiner c;
+    c.doCondense(true);
+    c.addleft(L1);
+    c.addleft(S1);
+    c.init();
+
+    IQTensor cpsi = c * psi;
+    CHECK(cpsi.hasindex(c.right()));
+    CHECK(cpsi.hasindex(S2));
+    CHECK_CLOSE(cpsi.norm(),psi.norm(),1E-12);
+
+    IQTensor diff = psi - conj(c) * cpsi;
+    CHECK(diff.norm() < 1E-12*psi.norm());
+
+    //Calling init again rebuilds the Combiners
+    //rather than adding to them
+    c.init("cmb");
+    diff = psi - conj(c) * (c * psi);
+    CHECK(diff.norm() < 1E-12*psi.norm());
+
+    //Priming keeps the cached lookups in step
+    IQCombiner pc(c);
+    pc.doprime(primeBoth);
+    IQTensor ppsi = primed(psi);
+    diff = primed(c * psi) - pc * ppsi;
+    CHECK(diff.norm() < 1E-12*psi.norm());
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
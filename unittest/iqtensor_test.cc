@@ -1,5 +1,6 @@
 #include "test.h"
 #include "iqtensor.h"
+#include "iqtflat.h"
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -197,6 +198,29 @@ TEST(TieIndices)
         }
     }
 
+TEST(HighRankTrace)
+    {
+    IQTensor E(conj(S1),primed(S1));
+    ITensor eu(S1.index(1),primed(S1).index(1)),
+            ed(S1.index(2),primed(S1).index(2));
+    eu.Randomize(); ed.Randomize();
+    E += eu; E += ed;
+
+    //Rank 10, more than NMAX indices
+    IQTensor X = E * primed(E,2) * primed(E,4) * primed(E,6) * primed(E,8);
+    CHECK_EQUAL(X.r(),10);
+
+    IQTensor Xt = trace(conj(S1),primed(S1,4),X);
+    CHECK_EQUAL(Xt.r(),8);
+    ITensor Xi = trace(Index(S1),Index(primed(S1,4)),X.toITensor());
+    CHECK((Xt.toITensor()-Xi).norm() < 1E-10*Xi.norm());
+
+    IQTensor Xd = tieIndices(S1,primed(S1,6),S1,X);
+    CHECK_EQUAL(Xd.r(),9);
+    ITensor Xdi = tieIndices(Index(S1),Index(primed(S1,6)),Index(S1),X.toITensor());
+    CHECK((Xd.toITensor()-Xdi).norm() < 1E-10*Xdi.norm());
+    }
+
 TEST(ToReal)
     {
     Real f = ran1();
@@ -244,4 +268,184 @@ TEST(MapElems)
         }
     }
 
+TEST(ComplexProduct)
+    {
+    IQTensor a(phi), b(phi), c(B), d(B);
+    b.Randomize();
+    c.conj();
+    d.conj();
+    d.Randomize();
+
+    IQTensor x = a*IQTensor::Complex_1() + b*IQTensor::Complex_i();
+    IQTensor y = c*IQTensor::Complex_1() + d*IQTensor::Complex_i();
+
+    IQTensor z = x*y;
+    CHECK(z.isComplex());
+
+    IQTensor zr,zi;
+    z.SplitReIm(zr,zi);
+    IQTensor re = a*c + (-1)*(b*d), 
+             im = a*d + b*c;
+    CHECK((zr-re).norm() < 1E-12*re.norm());
+    CHECK((zi-im).norm() < 1E-12*im.norm());
+
+    IQTensor xc(x);
+    xc.conj();
+    IQTensor xr,xi;
+    xc.SplitReIm(xr,xi);
+    xr.conj();
+    xi.conj();
+    CHECK((xr-a).norm() < 1E-14);
+    CHECK((xi+b).norm() < 1E-14);
+    }
+
+TEST(BlockLookup)
+    {
+    //Element access finds blocks by key, also after
+    //blocks are added and after their Index's are primed
+    IQTensor a(L1,L2);
+    for(int j1 = 1; j1 <= L1.m(); ++j1)
+    for(int j2 = 1; j2 <= L2.m(); ++j2)
+        {
+        a(L1(j1),L2(j2)) = B(L1(j1),L2(j2));
+        }
+    CHECK_EQUAL(a.iten_size(),B.iten_size());
+    CHECK((a-B).norm() < 1E-12);
+
+    a.doprime(primeBoth);
+    for(int j1 = 1; j1 <= L1.m(); ++j1)
+    for(int j2 = 1; j2 <= L2.m(); ++j2)
+        {
+        CHECK_CLOSE(a(primed(L1)(j1),primed(L2)(j2)),B(L1(j1),L2(j2)),1E-10);
+        }
+
+    IQTensor b(B);
+    b += B;
+    int nblock = 0;
+    for(IQTensor::const_iten_it it = b.const_iten_begin(); it != b.const_iten_end(); ++it, ++nblock)
+        {
+        CHECK(it->norm() > 0);
+        }
+    CHECK_EQUAL(nblock,B.iten_size());
+    CHECK(((1./2)*b-B).norm() < 1E-12);
+    }
+
+TEST(SmallBlockProducts)
+    {
+    //Same results whether the small blocks are
+    //multiplied by direct loops or matrix multiplication
+    IQTensor Ap = conj(A);
+    Ap.primeind(L1);
+
+    const int orig = Global::smallProductSize();
+    Global::smallProductSize() = 0;
+    const IQTensor AA = Ap*A,
+                   CA = C*A;
+    Global::smallProductSize() = 1000;
+    const IQTensor sAA = Ap*A,
+                   sCA = C*A;
+    Global::smallProductSize() = orig;
+
+    CHECK_EQUAL(sAA.iten_size(),AA.iten_size());
+    CHECK((sAA-AA).norm() < 1E-12*AA.norm());
+    CHECK_EQUAL(sCA.iten_size(),CA.iten_size());
+    CHECK((sCA-CA).norm() < 1E-12*CA.norm());
+    }
+
+TEST(ProductPlanReuse)
+    {
+    IQTensor Ap = conj(A);
+    Ap.primeind(L1);
+
+    ProductPlan plan;
+    CHECK(plan.isNull());
+    IQTensor r1(Ap);
+    r1.multiply(A,plan);
+    CHECK(!plan.isNull());
+    CHECK_EQUAL(plan.makes(),1);
+    CHECK_EQUAL(plan.uses(),0);
+    CHECK((r1-Ap*A).norm() < 1E-12*r1.norm());
+
+    //New data with the same blocks reuses the plan
+    IQTensor A2(A);
+    A2.Randomize();
+    IQTensor r2(Ap);
+    r2.multiply(A2,plan);
+    CHECK_EQUAL(plan.makes(),1);
+    CHECK_EQUAL(plan.uses(),1);
+    const IQTensor f2 = Ap*A2;
+    CHECK_EQUAL(r2.iten_size(),f2.iten_size());
+    CHECK((r2-f2).norm() < 1E-12*f2.norm());
+
+    //Different blocks make it again
+    IQTensor A3(L1,S1,L2,S2);
+    ITensor T(L1.index(1),L2.index(2),S1.index(1),S2.index(2));
+    T.Randomize();
+    A3 += T;
+    IQTensor r3(Ap);
+    r3.multiply(A3,plan);
+    CHECK_EQUAL(plan.makes(),2);
+    CHECK_EQUAL(plan.uses(),0);
+    CHECK((r3-Ap*A3).norm() < 1E-12*r3.norm());
+    }
+
+TEST(BlockOrder)
+    {
+    //New blocks go in front, and references to
+    //the blocks already there stay valid
+    IQTensor a(L1,L2);
+    ITensor first(l1u,l2d);
+    first.Randomize();
+    a += first;
+    const ITensor& ref = *(a.const_iten_begin());
+    ITensor second(l1d,l2u);
+    second.Randomize();
+    a += second;
+    CHECK_EQUAL(a.const_iten_begin()->uniqueId(),second.uniqueId());
+    CHECK_EQUAL(ref.uniqueId(),first.uniqueId());
+    CHECK((ref-first).norm() < 1E-12);
+    }
+
+TEST(FlatStorage)
+    {
+    IQTFlat fa(A);
+    CHECK_EQUAL(fa.nblock(),A.iten_size());
+    CHECK_EQUAL(fa.vecSize(),A.vecSize());
+
+    //Blocks are in key order, and found by key
+    for(int n = 1; n < fa.nblock(); ++n)
+        CHECK(fa.key(n-1) < fa.key(n));
+    for(IQTensor::const_iten_it it = A.const_iten_begin(); it != A.const_iten_end(); ++it)
+        {
+        const int n = fa.find(it->uniqueId());
+        CHECK(n >= 0);
+        CHECK((fa.block(n)-*it).norm() < 1E-12);
+        }
+    CHECK_EQUAL(fa.find(phi.const_iten_begin()->uniqueId()),-1);
+
+    CHECK((fa.toIQTensor()-A).norm() < 1E-12);
+    CHECK_CLOSE(fa.norm(),A.norm(),1E-10);
+
+    //Vector operations over all the blocks at once
+    IQTensor A2(A);
+    A2.Randomize();
+    IQTFlat fa2(A2);
+    CHECK(fa.sameBlocks(fa2));
+    CHECK_CLOSE(Dot(fa,fa2),Dot(A,A2),1E-10);
+
+    IQTFlat fs(fa);
+    fs *= 2;
+    fs -= fa2;
+    CHECK(((2*A-A2)-fs.toIQTensor()).norm() < 1E-12);
+    fs += fa2;
+    CHECK(((2*A)-fs.toIQTensor()).norm() < 1E-12);
+
+    //Tensors with other blocks can't be added
+    CHECK(!fa.sameBlocks(IQTFlat(phi)));
+    bool caught = false;
+    try { fs += IQTFlat(phi); }
+    catch(const ITError& e) { caught = true; }
+    CHECK(caught);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,6 @@
 #include "test.h"
 #include "itensor.h"
+#include "itsparse.h"
 #include <boost/test/unit_test.hpp>
 
 struct ITensorDefaults
@@ -498,6 +499,40 @@ TEST(assignToVec)
 
 }
 
+TEST(assignToVecOrdered)
+    {
+    ITensor T(l1,l2,l3);
+    T.Randomize();
+    T *= -2;
+
+    //Elements in the order of O, as
+    //assignFrom would arrange them
+    const ITensor O(l3,l1,l2);
+    ITensor x(O);
+    x.assignFrom(T);
+    Vector ref(x.vecSize()); 
+    x.assignToVec(ref);
+
+    Vector v(T.vecSize());
+    T.assignToVec(v,O);
+    CHECK(Norm(v-ref) < 1E-12);
+
+    //Rows are written directly, columns 
+    //(which have a stride) through a copy
+    Matrix M(2,T.vecSize());
+    T.assignToVec(M.Row(2),O);
+    CHECK(Norm(M.Row(2)-ref) < 1E-12);
+    Matrix C(T.vecSize(),2);
+    T.assignToVec(C.Column(1),O);
+    CHECK(Norm(C.Column(1)-ref) < 1E-12);
+
+    //Same order: a plain copy
+    T.assignToVec(v,T);
+    Vector tv(T.vecSize());
+    T.assignToVec(tv);
+    CHECK(Norm(v-tv) < 1E-12);
+    }
+
 TEST(MapElems)
     {
     // class Functor and the function Func
@@ -540,6 +575,113 @@ TEST(reshape)
 
 }
 
+TEST(AllPermutations)
+{
+    std::vector<Index> all;
+    all.push_back(b3);
+    all.push_back(b2);
+    all.push_back(b5);
+    all.push_back(b4);
+    all.push_back(l1);
+    all.push_back(a1);
+    all.push_back(s2);
+
+    //Ranks 3 through 6 plus an m==1 Index
+    for(int r = 3; r <= 7; ++r)
+        {
+        std::vector<Index> inds(all.begin(),all.begin()+r);
+        ITensor T(inds);
+        T.Randomize();
+        Vector tv(T.vecSize());
+        T.assignToVec(tv);
+
+        std::vector<int> order(r);
+        for(int j = 0; j < r; ++j) order[j] = j;
+
+        int nwrong = 0;
+        do  {
+            std::vector<Index> pinds(r);
+            for(int j = 0; j < r; ++j) pinds[j] = inds[order[j]];
+            ITensor P(pinds);
+            P.assignFrom(T);
+            Vector pv(P.vecSize());
+            P.assignToVec(pv);
+
+            //Element at position i (0-based, first index fastest)
+            //of T should be at the position of the permuted
+            //multi-index in P
+            for(int i = 0; i < tv.Length(); ++i)
+                {
+                std::vector<int> ti(r);
+                int rem = i;
+                for(int j = 0; j < r; ++j)
+                    {
+                    ti[j] = rem % inds[j].m();
+                    rem /= inds[j].m();
+                    }
+                int pi = 0;
+                for(int j = r-1; j >= 0; --j)
+                    pi = pi*pinds[j].m() + ti[order[j]];
+                if(pv(pi+1) != tv(i+1)) ++nwrong;
+                }
+            }
+        while(std::next_permutation(order.begin(),order.end()));
+
+        CHECK_EQUAL(nwrong,0);
+        }
+}
+
+TEST(PermutedSum)
+{
+    std::vector<Index> all;
+    all.push_back(b3);
+    all.push_back(b2);
+    all.push_back(l1);
+    all.push_back(b5);
+    all.push_back(a1);
+    all.push_back(b4);
+
+    for(int r = 2; r <= 6; ++r)
+        {
+        std::vector<Index> inds(all.begin(),all.begin()+r);
+        ITensor T(inds);
+        T.Randomize();
+        T *= 0.5;
+
+        std::vector<int> order(r);
+        for(int j = 0; j < r; ++j) order[j] = j;
+
+        int nwrong = 0;
+        do  {
+            std::vector<Index> pinds(r);
+            for(int j = 0; j < r; ++j) pinds[j] = inds[order[j]];
+            ITensor P(pinds);
+            P.Randomize();
+            P *= -3;
+
+            //Scale factor of P smaller, equal and larger than T's
+            const Real f[] = { 0.1, 2, 1000 };
+            for(int n = 0; n < 3; ++n)
+                {
+                ITensor S(T);
+                S += f[n]*P;
+
+                ITensor Q(inds);
+                Q.assignFrom(P);
+                Vector tv(T.vecSize()), qv(Q.vecSize()), sv(S.vecSize());
+                T.assignToVec(tv);
+                Q.assignToVec(qv);
+                S.assignToVec(sv);
+                for(int i = 1; i <= tv.Length(); ++i)
+                    if(fabs(sv(i) - (tv(i)+f[n]*qv(i))) > 1E-10*f[n]) ++nwrong;
+                }
+            }
+        while(std::next_permutation(order.begin(),order.end()));
+
+        CHECK_EQUAL(nwrong,0);
+        }
+}
+
 TEST(findindex)
 {
     ITensor T(mixed_inds);
@@ -728,6 +870,62 @@ TEST(ContractingProduct)
     CHECK(!Hpsi.hasindex(a2));
     }
 
+TEST(ProductCopies)
+    {
+    Index i("i",9), j("j",10), k("k",3), x("x",7),
+          c1("c1",4), c2("c2",5);
+
+    //Reference products have both operands
+    //ordered as matrices, contracted indices first
+    ITensor T(i,c1,c2,j), U(c1,c2,k);
+    T.Randomize(); U.Randomize();
+    ITensor Tm(c1,c2,i,j);
+    Tm.assignFrom(T);
+
+    //Contracted indices between free ones: batched GEMM
+    ProdCopyCount::reset();
+    ITensor TU = T*U;
+    CHECK_EQUAL(ProdCopyCount::bytes(),0);
+    ITensor UT = U*T;
+    CHECK_EQUAL(ProdCopyCount::bytes(),0);
+    ITensor ref = Tm*U;
+    CHECK((TU-ref).norm() < 1E-12*ref.norm());
+    CHECK((UT-ref).norm() < 1E-12*ref.norm());
+
+    //Contracted indices in reversed order: only
+    //the smaller operand gets permuted
+    ITensor V(c2,c1,k);
+    V.Randomize();
+    ITensor Vm(c1,c2,k);
+    Vm.assignFrom(V);
+
+    ProdCopyCount::reset();
+    ITensor VT = V*T;
+    CHECK_EQUAL(ProdCopyCount::bytes(),long(sizeof(Real)*V.vecSize()));
+    CHECK_EQUAL(ProdCopyCount::last(),long(sizeof(Real)*V.vecSize()));
+    //last() is the count of the latest product alone
+    TU = T*U;
+    CHECK_EQUAL(ProdCopyCount::last(),0);
+    ProdCopyCount::reset();
+    ITensor TV = Tm*V;
+    CHECK_EQUAL(ProdCopyCount::bytes(),long(sizeof(Real)*V.vecSize()));
+    ref = Tm*Vm;
+    CHECK((VT-ref).norm() < 1E-12*ref.norm());
+    CHECK((TV-ref).norm() < 1E-12*ref.norm());
+
+    //Leading dimension too small to batch
+    ITensor W(k,c1,c2,x);
+    W.Randomize();
+    ITensor Wm(c1,c2,k,x);
+    Wm.assignFrom(W);
+
+    ProdCopyCount::reset();
+    ITensor WT = W*Tm;
+    CHECK_EQUAL(ProdCopyCount::bytes(),long(sizeof(Real)*W.vecSize()));
+    ref = Wm*Tm;
+    CHECK((WT-ref).norm() < 1E-12*ref.norm());
+    }
+
 TEST(NonContractingProduct)
 {
     ITensor L(b2,a1,b3,b4), R(a1,b3,a2,b5,b4);
@@ -928,6 +1126,89 @@ TEST(Trace)
 
     }
 
+TEST(HighRankSparseProduct)
+    {
+    //More than NMAX indices
+    std::vector<Index> hi;
+    for(int j = 1; j <= 10; ++j)
+        hi.push_back(Index(nameint("h",j),2));
+    ITensor T(hi);
+    T.Randomize();
+
+    Index x("x",2);
+    Vector diag(2);
+    diag.Randomize();
+    Matrix M(2,2);
+    M = 0; M(1,1) = diag(1); M(2,2) = diag(2);
+
+    ITensor R = ITSparse(hi[3],x,diag) * T;
+    CHECK_EQUAL(R.r(),10);
+    CHECK(R.hasindex(x));
+    ITensor Rd = ITensor(hi[3],x,M) * T;
+    CHECK((R-Rd).norm() < 1E-10*Rd.norm());
+
+    //Both indices contracted
+    ITensor Q = ITSparse(hi[0],hi[9],diag) * T;
+    CHECK_EQUAL(Q.r(),8);
+    ITensor Qd = ITensor(hi[0],hi[9],M) * T;
+    CHECK((Q-Qd).norm() < 1E-10*Qd.norm());
+    }
+
+TEST(HighRank)
+    {
+    //Tensors with more than NMAX indices
+    Index k("k",3);
+    std::vector<Index> ai(1,k), bi(1,k);
+    for(int j = 1; j <= 5; ++j)
+        {
+        ai.push_back(Index(nameint("a",j),2));
+        bi.push_back(Index(nameint("b",j),2));
+        }
+    const Index &a1 = ai[1], &a2 = ai[2], &b1 = bi[1], &b4 = bi[4];
+
+    ITensor A(ai), B(bi);
+    A.Randomize();
+    B.Randomize();
+
+    ITensor C = A*B;
+    CHECK_EQUAL(C.r(),10);
+
+    //Different index order, so operator+= must permute
+    ITensor D = B*A;
+    CHECK((C-D).norm() < 1E-10);
+
+    //Contracting a rank 10 tensor
+    ITensor E(a2,b1,b4);
+    E.Randomize();
+    CHECK(((C*E)-(A*(B*E))).norm() < 1E-10);
+
+    //Trace of a rank 12 tensor
+    ITensor Ap = primed(A);
+    Ap.noprimeind(primed(a1));
+    ITensor tA = trace(a1,primed(a1),A*primed(A));
+    CHECK_EQUAL(tA.r(),10);
+    CHECK((tA-A*Ap).norm() < 1E-10);
+
+    //Trace over all indices
+    ITensor F(k,primed(k,1),primed(k,2),primed(k,3),primed(k,4));
+    F.Randomize();
+    ITensor FF = F*primed(F,5);
+    CHECK_EQUAL(FF.r(),10);
+    Vector v(FF.vecSize());
+    FF.assignToVec(v);
+    CHECK_CLOSE(trace(FF),v(1)+v(v.Length()/2+1)+v(v.Length()),1E-10);
+
+    //Tie two indices of a rank 10 tensor
+    Index t("t",2);
+    ITensor delta(a1,b1,t);
+    delta(a1(1),b1(1),t(1)) = 1;
+    delta(a1(2),b1(2),t(2)) = 1;
+    ITensor TC(C);
+    TC.tieIndices(a1,b1,t);
+    CHECK_EQUAL(TC.r(),9);
+    CHECK((TC-C*delta).norm() < 1E-10);
+    }
+
 TEST(fromMatrix11)
     {
     Matrix M22(s1.m(),s2.m());
@@ -1114,4 +1395,124 @@ TEST(CommaAssignment)
     CHECK_EQUAL(AA(s1(2),s2(2)),22);
     }
 
+TEST(ComplexProduct)
+    {
+    ITensor a(b3,b4,b2), b(b3,b4,b2),
+            c(b5,b2,b4), d(b5,b2,b4);
+    a.Randomize(); b.Randomize();
+    c.Randomize(); d.Randomize();
+
+    ITensor x = a*ITensor::Complex_1() + b*ITensor::Complex_i();
+    ITensor y = c*ITensor::Complex_1() + d*ITensor::Complex_i();
+
+    ITensor xr,xi;
+    x.SplitReIm(xr,xi);
+    CHECK((xr-a).norm() < 1E-14);
+    CHECK((xi-b).norm() < 1E-14);
+
+    ITensor z = x*y;
+    CHECK(z.isComplex());
+    CHECK_EQUAL(z.r(),3);
+
+    ITensor zr,zi;
+    z.SplitReIm(zr,zi);
+    ITensor re = a*c - b*d, 
+            im = a*d + b*c;
+    CHECK((zr-re).norm() < 1E-12*re.norm());
+    CHECK((zi-im).norm() < 1E-12*im.norm());
+
+    //Same as contracting through the ReIm helper tensors
+    ITensor h = (x*ITensor::ReImPrimer()) * (ITensor::ReImProd()*(y*ITensor::ReImPrimerP()));
+    CHECK((h-z).norm() < 1E-12*z.norm());
+
+    //Real times complex
+    ITensor w = c*x;
+    ITensor wr,wi;
+    w.SplitReIm(wr,wi);
+    CHECK((wr-a*c).norm() < 1E-12*wr.norm());
+    CHECK((wi-b*c).norm() < 1E-12*wi.norm());
+
+    ITensor xc(x);
+    xc.conj();
+    xc.SplitReIm(xr,xi);
+    CHECK((xr-a).norm() < 1E-14);
+    CHECK((xi+b).norm() < 1E-14);
+
+    ITensor j;
+    j.JoinReIm(ITensor(),b);
+    j.SplitReIm(xr,xi);
+    CHECK(xr.norm() < 1E-14);
+    CHECK((xi-b).norm() < 1E-14);
+    }
+
+TEST(SumSmallProducts)
+    {
+    Index i("i",2), j("j",3), k("k",2), l("l",4);
+    ITensor A1(i,j,k), B1(k,j,l),
+            A2(k,i,j), B2(l,j,k);
+    A1.Randomize(); B1.Randomize();
+    A2.Randomize(); B2.Randomize();
+    //Different scales and storage orders
+    A2 *= 1E5;
+    B1 *= -0.5;
+
+    std::vector<const ITensor*> L, R;
+    L.push_back(&A1); R.push_back(&B1);
+    L.push_back(&A2); R.push_back(&B2);
+
+    const ITensor C = A1*B1 + A2*B2;
+
+    ITensor S;
+    int first = -1;
+    CHECK(sumSmallProducts(L,R,S,first));
+    CHECK_EQUAL(first,0);
+    CHECK(S.hasindex(i) && S.hasindex(l));
+    CHECK_EQUAL(S.r(),2);
+    CHECK((S-C).norm() < 1E-12*C.norm());
+
+    //Products with more multiply-adds than
+    //Global::smallProductSize() are left to operator*=
+    const int orig = Global::smallProductSize();
+    Global::smallProductSize() = 2*3*2*4-1;
+    CHECK(!sumSmallProducts(L,R,S,first));
+    Global::smallProductSize() = 0;
+    CHECK(!sumSmallProducts(L,R,S,first));
+    Global::smallProductSize() = orig;
+    }
+
+TEST(ExpandSliceIndex)
+    {
+    Index i("i",2), s("s",3), b("b",7), j("j",4);
+    ITensor T(i,s,j);
+    T.Randomize();
+
+    ITensor E(T);
+    E.expandIndex(s,b,2);
+    CHECK(E.hasindex(b) && !E.hasindex(s));
+    CHECK_CLOSE(E.norm(),T.norm(),1E-12);
+    for(int ii = 1; ii <= i.m(); ++ii)
+    for(int jj = 1; jj <= j.m(); ++jj)
+        {
+        CHECK_CLOSE(E(i(ii),b(1),j(jj)),0,1E-12);
+        CHECK_CLOSE(E(i(ii),b(2),j(jj)),0,1E-12);
+        for(int ss = 1; ss <= s.m(); ++ss)
+            {
+            CHECK_CLOSE(E(i(ii),b(2+ss),j(jj)),T(i(ii),s(ss),j(jj)),1E-12);
+            }
+        CHECK_CLOSE(E(i(ii),b(6),j(jj)),0,1E-12);
+        }
+
+    ITensor S(E);
+    S.sliceIndex(b,s,2);
+    CHECK(S.hasindex(s) && !S.hasindex(b));
+    CHECK((S-T).norm() < 1E-12);
+
+    //Slicing at another offset picks out
+    //the zeros padded by expandIndex
+    S = E;
+    S.sliceIndex(b,s,4);
+    CHECK_CLOSE(S(i(1),s(1),j(1)),T(i(1),s(3),j(1)),1E-12);
+    CHECK_CLOSE(S(i(2),s(2),j(3)),0,1E-12);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
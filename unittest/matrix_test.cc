@@ -75,6 +75,42 @@ TEST(GeneralizedEigenValues)
         }
     }
 
+TEST(MatrixVectorProduct)
+    {
+    Matrix A(N+3,N);
+    A.Randomize();
+    Vector x(N+3);
+    x.Randomize();
+
+    //Plain, transposed, sub-matrix and strided cases
+    Vector y = A.t() * x;
+    for(int j = 1; j <= N; ++j)
+        {
+        Real r = 0;
+        for(int i = 1; i <= N+3; ++i) r += A(i,j)*x(i);
+        CHECK_CLOSE(y(j),r,1E-10);
+        }
+
+    MatrixRef S = A.SubMatrix(2,N+1,3,N);
+    Vector z = 2*S * A.Column(1).SubVector(3,N);
+    for(int i = 1; i <= N; ++i)
+        {
+        Real r = 0;
+        for(int j = 1; j <= N-2; ++j) r += 2*S(i,j)*A(j+2,1);
+        CHECK_CLOSE(z(i),r,1E-10);
+        }
+
+    Vector w(N+3);
+    w = 1;
+    w += A * x.SubVector(1,N);
+    for(int i = 1; i <= N+3; ++i)
+        {
+        Real r = 1;
+        for(int j = 1; j <= N; ++j) r += A(i,j)*x(j);
+        CHECK_CLOSE(w(i),r,1E-10);
+        }
+    }
+
 TEST(TestSVD)
     {
     int n = 200, m = 400;
@@ -99,6 +135,62 @@ TEST(TestSVD)
     CHECK(sumerrsq < 1E-10);
     }
 
+TEST(TestRandomSVD)
+    {
+    int n = 150, m = 200, k = 20;
+    Matrix A(n,m);
+    Matrix dd(n,n); dd = 0.0;
+    for(int i = 1; i <= n; i++)
+        {
+        dd(i,i) = pow(0.7,i-1);
+        }
+    Matrix uu(n,n), vv(n,m);
+    uu.Randomize(); vv.Randomize();
+    Orthog(uu,n,2);
+    vv = vv.t(); Orthog(vv,n,2); vv = vv.t();
+    A = uu * dd * vv;
+
+    Matrix U,V;  Vector D;
+    Real resid = RandomSVD(A,U,D,V,k);
+    CHECK_EQUAL(U.Ncols(),k);
+    CHECK_EQUAL(D.Length(),k);
+    CHECK_EQUAL(V.Nrows(),k);
+
+    //Leading singular values are accurate and
+    //resid is the weight of the rest
+    for(int i = 1; i <= k/2; ++i)
+        {
+        CHECK_CLOSE(D(i),dd(i,i),1E-10);
+        }
+    Real tail = 0;
+    for(int i = k+1; i <= n; ++i) tail += dd(i,i)*dd(i,i);
+    CHECK(resid >= tail*(1-1E-6));
+    CHECK(resid < 2*tail);
+
+    Matrix DD(k,k); DD = 0.0; DD.Diagonal() = D;
+    Matrix err = A - U * DD * V;
+    CHECK(Trace(err * err.t()) < 2*tail);
+
+    //Nothing to gain for large k: full SVD
+    resid = RandomSVD(A,U,D,V,n);
+    CHECK_EQUAL(resid,0);
+    CHECK_EQUAL(D.Length(),n);
+    }
+
+TEST(RandomSVDLargeSketch)
+    {
+    //Omega has more elements than the period of a small
+    //linear congruential generator; it must still capture
+    //every direction of an exactly rank k matrix
+    const int n = 700, m = 600, k = 300;
+    Matrix X(n,k), Y(k,m);
+    X.Randomize(); Y.Randomize();
+    const Matrix A = X * Y;
+
+    Matrix U,V;  Vector D;
+    const Real resid = RandomSVD(A,U,D,V,k);
+    CHECK(resid < 1E-10*Trace(A * A.t()));
+    }
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,122 @@
+#include "test.h"
+#include "itensor.h"
+#include "threadpool.h"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using namespace std;
+
+struct ProfilerDefaults
+    {
+    Index i, j, k;
+    ITensor A, B;
+
+    ProfilerDefaults()
+        :
+        i("i",10), j("j",20), k("k",30),
+        A(i,j), B(j,k)
+        {
+        A.Randomize();
+        B.Randomize();
+        Profiler::reset();
+        }
+
+    ~ProfilerDefaults()
+        {
+        Profiler::enable(false);
+        Profiler::maxEvents(100000);
+        Profiler::reset();
+        }
+    };
+
+//Totals of the named call site, or a Site with count 0
+Profiler::Site
+findSite(const string& name)
+    {
+    Foreach(const Profiler::Site& s, Profiler::sites())
+        if(s.name == name) return s;
+    Profiler::Site none;
+    none.count = 0;
+    none.time = none.flops = none.bytes = 0;
+    return none;
+    }
+
+struct RecordTask
+    {
+    void
+    operator()(int) const
+        {
+        ProfileScope ps("RecordTask",Profiler::Matvec,10,100);
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(ProfilerTest,ProfilerDefaults)
+
+TEST(Disabled)
+    {
+    Profiler::enable(false);
+    ITensor C = A*B;
+    CHECK(!Profiler::enabled());
+    CHECK_EQUAL(findSite("ITensor::matrixMultiply").count,0);
+    }
+
+TEST(Product)
+    {
+    Profiler::enable();
+    ITensor C = A*B;
+    C = A*B;
+    Profiler::enable(false);
+
+    const Profiler::Site s = findSite("ITensor::matrixMultiply");
+    CHECK_EQUAL(s.count,2);
+    CHECK_EQUAL(s.kind,Profiler::Product);
+    CHECK_CLOSE(s.flops,2*2.*10*20*30,1E-10);
+    CHECK_CLOSE(s.bytes,2*8.*(10*20+20*30+10*30),1E-10);
+    CHECK(s.time >= 0);
+
+    Profiler::reset();
+    CHECK_EQUAL(findSite("ITensor::matrixMultiply").count,0);
+    }
+
+TEST(Threads)
+    {
+    Profiler::enable();
+    ThreadPool pool(4);
+    pool.run(1000,RecordTask());
+    Profiler::enable(false);
+
+    const Profiler::Site s = findSite("RecordTask");
+    CHECK_EQUAL(s.count,1000);
+    CHECK_CLOSE(s.flops,1E4,1E-10);
+    CHECK_CLOSE(s.bytes,1E5,1E-10);
+    }
+
+TEST(Trace)
+    {
+    Profiler::enable();
+    ITensor C = A*B;
+    Profiler::enable(false);
+
+    ostringstream s;
+    Profiler::writeTrace(s);
+    const string t = s.str();
+    CHECK(t.find("\"traceEvents\"") != string::npos);
+    CHECK(t.find("\"name\": \"ITensor::matrixMultiply\", \"cat\": \"product\", \"ph\": \"X\"") != string::npos);
+
+    ostringstream r;
+    Profiler::report(r);
+    CHECK(r.str().find("ITensor::matrixMultiply") != string::npos);
+
+    //Totals only
+    Profiler::reset();
+    Profiler::maxEvents(0);
+    Profiler::enable();
+    C = A*B;
+    Profiler::enable(false);
+    ostringstream s0;
+    Profiler::writeTrace(s0);
+    CHECK(s0.str().find("matrixMultiply") == string::npos);
+    CHECK_EQUAL(findSite("ITensor::matrixMultiply").count,1);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
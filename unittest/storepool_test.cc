@@ -0,0 +1,145 @@
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include "matrix.h"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+using namespace std;
+using namespace boost;
+
+//Allocates and frees n blocks
+void
+allocFree(int n)
+    {
+    for(int j = 0; j < n; ++j)
+        {
+        void* p = StorePool::alloc(1000);
+        StorePool::dealloc(p,1000);
+        }
+    }
+
+struct StorePoolDefaults
+    {
+    const size_t tlimit_;
+
+    StorePoolDefaults()
+        : tlimit_(StorePool::threadCacheLimit())
+        { }
+
+    ~StorePoolDefaults()
+        {
+        StorePool::threadCacheLimit() = tlimit_;
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(StorePoolTest,StorePoolDefaults)
+
+TEST(BlockSize)
+    {
+    CHECK_EQUAL(StorePool::blockSize(1),128);
+    CHECK_EQUAL(StorePool::blockSize(128),128);
+    CHECK_EQUAL(StorePool::blockSize(129),160);
+    CHECK_EQUAL(StorePool::blockSize(256),256);
+    CHECK_EQUAL(StorePool::blockSize(257),320);
+
+    for(size_t n = 100; n < (size_t(1) << 26); n = 3*n/2+7)
+        {
+        const size_t b = StorePool::blockSize(n);
+        CHECK(b >= n);
+        CHECK(4*b <= 5*n+4*128);
+        CHECK_EQUAL(StorePool::blockSize(b),b);
+        }
+
+    //Not pooled
+    const size_t big = (size_t(1) << 26) + 1;
+    CHECK_EQUAL(StorePool::blockSize(big),big);
+    }
+
+TEST(Reuse)
+    {
+    void* p = StorePool::alloc(1000);
+    StorePool::dealloc(p,1000);
+
+    const StorePool::Stats s0 = StorePool::stats();
+    void* q = StorePool::alloc(1001);
+    const StorePool::Stats s1 = StorePool::stats();
+    CHECK(q == p);
+    CHECK_EQUAL(s1.allocs,s0.allocs+1);
+    CHECK_EQUAL(s1.mallocs,s0.mallocs);
+    CHECK(s1.peak >= s1.inuse);
+    StorePool::dealloc(q,1001);
+
+    //Vector storage comes from the pool too
+    for(int j = 0; j < 10; ++j)
+        {
+        Vector v(5000);
+        v = 1;
+        }
+    const StorePool::Stats s2 = StorePool::stats();
+    for(int j = 0; j < 10; ++j)
+        {
+        Vector v(5000);
+        v = 1;
+        }
+    const StorePool::Stats s3 = StorePool::stats();
+    CHECK_EQUAL(s3.allocs,s2.allocs+10);
+    CHECK_EQUAL(s3.mallocs,s2.mallocs);
+    }
+
+TEST(Arena)
+    {
+    StorePool::releaseThread();
+    StorePool::threadCacheLimit() = 0;
+
+    const size_t n = 8000,
+                 b = StorePool::blockSize(n);
+    const long cached0 = StorePool::stats().cached;
+        {
+        StorePool::Arena arena;
+        void* p = StorePool::alloc(n);
+        StorePool::dealloc(p,n);
+        //Kept by this thread despite the zero limit
+        CHECK_EQUAL(StorePool::stats().cached,cached0+long(b));
+        void* q = StorePool::alloc(n);
+        CHECK(q == p);
+        StorePool::dealloc(q,n);
+        }
+
+    //Leaving the arena moved the block out of the thread cache,
+    //so releasing it changes nothing
+    const long cached1 = StorePool::stats().cached;
+    StorePool::releaseThread();
+    CHECK_EQUAL(StorePool::stats().cached,cached1);
+
+        {
+        StorePool::Arena inactive(false);
+        void* p = StorePool::alloc(n);
+        StorePool::dealloc(p,n);
+        const long cached2 = StorePool::stats().cached;
+        StorePool::releaseThread();
+        CHECK_EQUAL(StorePool::stats().cached,cached2);
+        }
+    }
+
+TEST(ThreadStats)
+    {
+    //Counts of running and of exited threads are both included
+    StorePool::resetStats();
+    const StorePool::Stats s0 = StorePool::stats();
+    boost::thread t1(boost::bind(allocFree,100)),
+                  t2(boost::bind(allocFree,50));
+    t1.join();
+    allocFree(10);
+    t2.join();
+    const StorePool::Stats s1 = StorePool::stats();
+    CHECK_EQUAL(s1.allocs,s0.allocs+160);
+    CHECK_EQUAL(s1.inuse,s0.inuse);
+    CHECK(s1.peak >= s1.inuse);
+
+    StorePool::resetStats();
+    const StorePool::Stats s2 = StorePool::stats();
+    CHECK_EQUAL(s2.allocs,0);
+    CHECK_EQUAL(s2.peak,s2.inuse);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -344,6 +344,82 @@ TEST(AbsoluteCutoff)
     CHECK(svd.eigsKept()(svd.numEigsKept()) > cutoff);
     }
 
+TEST(RandomSVD)
+    {
+    const int n = 120, m = 100;
+    Index ui("ui",n), vi("vi",m);
+
+    Matrix dd(m,m); dd = 0.0;
+    for(int i = 1; i <= m; ++i) 
+        dd(i,i) = pow(0.8,i-1);
+    Matrix uu(n,m), vv(m,m);
+    uu.Randomize(); vv.Randomize();
+    Orthog(uu,m,2);
+    Orthog(vv,m,2);
+
+    //Rapidly decaying spectrum
+    ITensor T(ui,vi,uu*dd*vv.t());
+
+    SVDWorker svd;
+    svd.cutoff(1E-14);
+    svd.maxm(10);
+
+    ITensor U,V;
+    ITSparse D;
+    svd.svdRank2(T,ui,vi,U,D,V);
+    const Vector eigs = svd.eigsKept();
+    const Real truncerr = svd.truncerr();
+    const ITensor nT = U*D*V;
+
+    svd.useRandomSVD(true);
+    svd.svdRank2(T,ui,vi,U,D,V);
+    CHECK_EQUAL(svd.numEigsKept(),10);
+    for(int j = 1; j <= 10; ++j)
+        CHECK_CLOSE(svd.eigsKept()(j),eigs(j),1E-5);
+    CHECK_CLOSE(svd.truncerr(),truncerr,1E-6);
+    CHECK((U*D*V-nT).norm() < 1E-5*nT.norm());
+
+    //IQTensor version
+    IQIndex uI("uI",ui,QN(0),Out), 
+            vI("vI",vi,QN(0),In);
+    IQTensor TT(uI,vI);
+    TT += T;
+    IQTensor UU,VV;
+    IQTSparse DD;
+    svd.svdRank2(TT,uI,vI,UU,DD,VV);
+    CHECK_EQUAL(svd.numEigsKept(),10);
+    for(int j = 1; j <= 10; ++j)
+        CHECK_CLOSE(svd.eigsKept()(j),eigs(j),1E-5);
+    CHECK_CLOSE((UU*DD*VV-TT).norm(),(nT-T).norm(),1E-4);
+
+    //Flat spectrum: falls back to the full SVD
+    Matrix R(n,m);
+    R.Randomize();
+    ITensor F(ui,vi,R);
+    svd.useRandomSVD(false);
+    svd.svdRank2(F,ui,vi,U,D,V);
+    const Vector feigs = svd.eigsKept();
+    svd.useRandomSVD(true);
+    svd.svdRank2(F,ui,vi,U,D,V);
+    CHECK_EQUAL(svd.numEigsKept(),10);
+    for(int j = 1; j <= 10; ++j)
+        CHECK_EQUAL(svd.eigsKept()(j),feigs(j));
+    }
+
+TEST(RandomSVDScopeRestores)
+    {
+    SVDWorker svd;
+    svd.useRandomSVD(false);
+    try
+        {
+        RandomSVDScope random(svd,true);
+        CHECK(svd.useRandomSVD());
+        Error("decomposition failed");
+        }
+    catch(const ITError& e) { }
+    CHECK(!svd.useRandomSVD());
+    }
+
 /*
 TEST(UseOrigM)
     {
@@ -0,0 +1,597 @@
+#include "test.h"
+#include "iqtensor.h"
+#include "threadpool.h"
+#include "svdworker.h"
+#include "localmposet.h"
+#include "model/spinhalf.h"
+#include "hams/heisenberg.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+using namespace std;
+
+//
+// Contracts the same tensors from several
+// threads at once and checks each result
+// against the serial one, element by element.
+//
+
+//Same elements, but the indices may differ
+template <class Tensor>
+bool
+sameElems(const Tensor& x, const Tensor& y)
+    {
+    if(x.vecSize() != y.vecSize()) return false;
+    Vector vx(x.vecSize()),
+           vy(y.vecSize());
+    x.assignToVec(vx);
+    y.assignToVec(vy);
+    for(int j = 1; j <= vx.Length(); ++j)
+        if(vx(j) != vy(j)) return false;
+    return true;
+    }
+
+template <class Tensor>
+bool
+sameDat(const Tensor& x, const Tensor& y)
+    {
+    if(x.r() != y.r()) return false;
+    for(int j = 1; j <= x.r(); ++j)
+        if(x.index(j) != y.index(j)) return false;
+    if(x.vecSize() != y.vecSize()) return false;
+    Vector vx(x.vecSize()),
+           vy(y.vecSize());
+    x.assignToVec(vx);
+    y.assignToVec(vy);
+    for(int j = 1; j <= vx.Length(); ++j)
+        if(vx(j) != vy(j)) return false;
+    return true;
+    }
+
+struct ThreadDefaults
+    {
+    Index s1,s2,l1,l2,l3;
+
+    ITensor A,B,C,Ac,Bc;
+
+    IQIndex S1,L1,L2;
+
+    IQTensor P,Q,Pc,Qc;
+
+    ThreadDefaults() :
+    s1(Index("s1",2,Site)),
+    s2(Index("s2",2,Site)),
+    l1(Index("l1",7)),
+    l2(Index("l2",5)),
+    l3(Index("l3",6))
+        {
+        A = ITensor(l1,s1,l2);
+        A.Randomize();
+        B = ITensor(s2,l2,l3,s1);
+        B.Randomize();
+        C = ITensor(l3,l1,s2);
+        C.Randomize();
+
+        Ac = A*ITensor::Complex_1() + B*C*ITensor::Complex_i();
+        Bc = ITensor::Complex_1()*B + ITensor::Complex_i()*(-2*B);
+
+        Index s1u("S1 Up",1,Site),
+              s1d("S1 Dn",1,Site),
+              l1u("L1 Up",3),
+              l1d("L1 Dn",4),
+              l2u("L2 Up",2),
+              l20("L2 Z0",3),
+              l2d("L2 Dn",2);
+
+        S1 = IQIndex("S1",s1u,QN(+1),s1d,QN(-1),Out);
+        L1 = IQIndex("L1",l1u,QN(+1),l1d,QN(-1),Out);
+        L2 = IQIndex("L2",l2u,QN(+1),l20,QN(0),l2d,QN(-1),Out);
+
+        P = IQTensor(L1,S1,L2);
+        for(int n1 = 1; n1 <= L1.nindex(); ++n1)
+        for(int n2 = 1; n2 <= S1.nindex(); ++n2)
+        for(int n3 = 1; n3 <= L2.nindex(); ++n3)
+            {
+            ITensor T(L1.index(n1),S1.index(n2),L2.index(n3));
+            T.Randomize();
+            P += T;
+            }
+
+        Q = IQTensor(L2,primed(L2));
+        for(int n1 = 1; n1 <= L2.nindex(); ++n1)
+        for(int n2 = 1; n2 <= L2.nindex(); ++n2)
+            {
+            ITensor T(L2.index(n1),primed(L2).index(n2));
+            T.Randomize();
+            Q += T;
+            }
+
+        Pc = P*IQTensor::Complex_1() + P*IQTensor::Complex_i();
+        Qc = conj(Q)*IQTensor::Complex_1() - conj(Q)*IQTensor::Complex_i();
+        }
+
+    };
+
+//Every operation exercised by the worker threads
+struct Results
+    {
+    ITensor AB, ABC, AdivB, sum, cprod;
+    IQTensor PQ, PdivQ, cPQ;
+
+    Results(const ThreadDefaults& d)
+        {
+        AB = d.A * d.B;
+        ABC = AB * d.C;
+        AdivB = d.A / d.B;
+
+        //C has the indices of AB in a different order
+        sum = AB;
+        sum += d.C;
+
+        cprod = d.Ac * d.Bc;
+
+        PQ = d.P * conj(d.Q);
+        PdivQ = d.P / d.Q;
+        cPQ = d.Pc * d.Qc;
+        }
+
+    int
+    countMismatches(const Results& o) const
+        {
+        int n = 0;
+        if(!sameDat(AB,o.AB)) ++n;
+        if(!sameDat(ABC,o.ABC)) ++n;
+        if(!sameDat(AdivB,o.AdivB)) ++n;
+        if(!sameDat(sum,o.sum)) ++n;
+        if(!sameDat(cprod,o.cprod)) ++n;
+        if(!sameDat(PQ,o.PQ)) ++n;
+        if(!sameDat(PdivQ,o.PdivQ)) ++n;
+        if(!sameDat(cPQ,o.cPQ)) ++n;
+        return n;
+        }
+    };
+
+//Makes IQTensor products use a pool of nthread
+//threads, restoring the defaults when destroyed
+struct ParallelProducts
+    {
+    const int nthread_, thresh_;
+
+    ParallelProducts(int nthread, int thresh)
+        : 
+        nthread_(ThreadPool::global().numThreads()),
+        thresh_(Global::parallelBlockThreshold())
+        {
+        ThreadPool::global().resize(nthread);
+        Global::parallelBlockThreshold() = thresh;
+        }
+
+    ~ParallelProducts()
+        {
+        ThreadPool::global().resize(nthread_);
+        Global::parallelBlockThreshold() = thresh_;
+        }
+    };
+
+struct CountTask
+    {
+    std::vector<int>& count;
+
+    CountTask(std::vector<int>& count_) : count(count_) { }
+
+    void
+    operator()(int n) const 
+        { 
+        ++count.at(n); 
+        if(n == 77 && count.size() == 100) Error("Task 77 failed");
+        }
+    };
+
+//Records the thread each task ran on and the
+//number of BLAS threads it had
+struct RecordThread
+    {
+    std::vector<boost::thread::id>& id;
+    std::vector<int>& nblas;
+
+    RecordThread(std::vector<boost::thread::id>& id_, std::vector<int>& nblas_) 
+        : id(id_), nblas(nblas_) { }
+
+    void
+    operator()(int n) const 
+        { 
+        id.at(n) = boost::this_thread::get_id(); 
+        nblas.at(n) = BlasThreads::get();
+        }
+    };
+
+void
+runWorker(const ThreadDefaults& d, const Results& serial,
+          int niter, int& mismatches)
+    {
+    for(int n = 1; n <= niter; ++n)
+        {
+        Results r(d);
+        mismatches += serial.countMismatches(r);
+        }
+    }
+
+//Weighted sum of the elements of T, found one at a time
+Real
+elemSum(const IQTensor& T, const IQIndex& I1, const IQIndex& I2, const IQIndex& I3)
+    {
+    Real sum = 0;
+    for(int i1 = 1; i1 <= I1.m(); ++i1)
+    for(int i2 = 1; i2 <= I2.m(); ++i2)
+    for(int i3 = 1; i3 <= I3.m(); ++i3)
+        sum += (i1+2*i2+3*i3)*T(I1(i1),I2(i2),I3(i3));
+    return sum;
+    }
+
+void
+sharedWorker(const ThreadDefaults& d, const IQTensor& shared, 
+             Real sum, const IQTensor& PQ, int& mismatches)
+    {
+    if(elemSum(shared,d.L1,d.S1,d.L2) != sum) ++mismatches;
+    if(!sameDat(shared * conj(d.Q),PQ)) ++mismatches;
+    }
+
+//IQTensor with every block of I1, I2, I3 filled in
+IQTensor
+randomIQ(const IQIndex& I1, const IQIndex& I2, const IQIndex& I3)
+    {
+    IQTensor T(I1,I2,I3);
+    for(int n1 = 1; n1 <= I1.nindex(); ++n1)
+    for(int n2 = 1; n2 <= I2.nindex(); ++n2)
+    for(int n3 = 1; n3 <= I3.nindex(); ++n3)
+        {
+        ITensor t(I1.index(n1),I2.index(n2),I3.index(n3));
+        t.Randomize();
+        T += t;
+        }
+    return T;
+    }
+
+//Counts each task of niter runs on the global pool
+void
+globalWorker(std::vector<int>& count, int niter)
+    {
+    for(int j = 1; j <= niter; ++j)
+        {
+        std::vector<int> once(count.size(),0);
+        ThreadPool::global().run(once.size(),CountTask(once));
+        for(size_t n = 0; n < count.size(); ++n) count[n] += once[n];
+        }
+    }
+
+//Largest residual |A u - d u| of the eigenvectors
+//of a random symmetric n x n matrix
+void
+eigenWorker(int n, Real& resid)
+    {
+    Matrix A(n,n);
+    A.Randomize();
+    A += A.t();
+    Matrix U;
+    Vector D;
+    EigenValues(A,D,U);
+    resid = 0;
+    for(int j = 1; j <= n; ++j)
+        {
+        Vector diff = D(j)*U.Column(j);
+        diff -= A*U.Column(j);
+        resid = std::max(resid,Norm(diff));
+        }
+    }
+
+BOOST_FIXTURE_TEST_SUITE(ThreadTest,ThreadDefaults)
+
+TEST(Pool)
+    {
+    ThreadPool pool(4);
+    CHECK_EQUAL(pool.numThreads(),4);
+
+    std::vector<int> count(1000,0);
+    pool.run(count.size(),CountTask(count));
+    for(size_t n = 0; n < count.size(); ++n)
+        CHECK_EQUAL(count[n],1);
+
+    //Errors in a task are passed back to the caller
+    std::vector<int> count2(100,0);
+    bool caught = false;
+    try { pool.run(count2.size(),CountTask(count2)); }
+    catch(const ITError& e) { caught = true; }
+    CHECK(caught);
+    for(size_t n = 0; n < count2.size(); ++n)
+        CHECK_EQUAL(count2[n],1);
+
+    pool.resize(1);
+    CHECK_EQUAL(pool.numThreads(),1);
+    }
+
+TEST(RunByCost)
+    {
+    ThreadPool pool(4);
+
+    std::vector<int> count(60,0);
+    std::vector<Real> cost(count.size(),1E3);
+    cost[7] = 1E5;
+    pool.runByCost(cost,CountTask(count));
+    for(size_t n = 0; n < count.size(); ++n)
+        CHECK_EQUAL(count[n],1);
+
+    const int nblas = BlasThreads::get();
+    std::vector<boost::thread::id> id(8);
+    std::vector<int> taskblas(8,0);
+    pool.runByCost(std::vector<Real>(8,1E3),RecordThread(id,taskblas));
+    for(size_t n = 0; n < id.size(); ++n)
+        CHECK_EQUAL(taskblas[n],1);
+    CHECK_EQUAL(BlasThreads::get(),nblas);
+
+    if(!BlasThreads::available()) return;
+
+    //One task with most of the work: all run on
+    //the calling thread, with BLAS threads instead
+        {
+        BlasThreads b(4);
+        std::vector<Real> cost2(8,1E3);
+        cost2[3] = 1E12;
+        pool.runByCost(cost2,RecordThread(id,taskblas));
+        for(size_t n = 0; n < id.size(); ++n)
+            {
+            CHECK(id[n] == boost::this_thread::get_id());
+            CHECK_EQUAL(taskblas[n],4);
+            }
+        }
+    CHECK_EQUAL(BlasThreads::get(),nblas);
+    }
+
+TEST(SetNumThreads)
+    {
+    const int orig = ThreadPool::global().numThreads(),
+              origblas = BlasThreads::get();
+
+    ThreadPool::setNumThreads(3);
+    CHECK_EQUAL(ThreadPool::global().numThreads(),3);
+    if(BlasThreads::available())
+        CHECK_EQUAL(BlasThreads::get(),3);
+
+    //"NumThreads" is only read by the first call to global()
+    Global::options().add(Option("NumThreads",2));
+    CHECK_EQUAL(ThreadPool::global().numThreads(),3);
+    Global::options().add(Option("NumThreads",0));
+
+    //Zero or less means the default, and
+    //leaves the BLAS threads alone
+    BlasThreads::set(2);
+    ThreadPool::setNumThreads(0);
+    CHECK_EQUAL(ThreadPool::global().numThreads(),ThreadPool::defaultNumThreads());
+    if(BlasThreads::available())
+        CHECK_EQUAL(BlasThreads::get(),2);
+
+    ThreadPool::global().resize(orig);
+    BlasThreads::set(origblas);
+    }
+
+TEST(ConcurrentGlobal)
+    {
+    const int orig = ThreadPool::global().numThreads(),
+              origblas = BlasThreads::get();
+
+    //Threads all starting to use the global pool
+    //just after it is resized
+    const int nthread = 4,
+              nround = 6,
+              niter = 5;
+    std::vector<std::vector<int> > count(nthread,std::vector<int>(50,0));
+    for(int r = 1; r <= nround; ++r)
+        {
+        ThreadPool::setNumThreads(1+r%4);
+        boost::thread_group threads;
+        for(int t = 0; t < nthread; ++t)
+            threads.create_thread(boost::bind(globalWorker,boost::ref(count[t]),niter));
+        threads.join_all();
+        CHECK_EQUAL(ThreadPool::global().numThreads(),1+r%4);
+        }
+
+    for(int t = 0; t < nthread; ++t)
+    for(size_t n = 0; n < count[t].size(); ++n)
+        CHECK_EQUAL(count[t][n],nround*niter);
+
+    ThreadPool::global().resize(orig);
+    BlasThreads::set(origblas);
+    }
+
+TEST(ParallelBlockProducts)
+    {
+    IQTensor PQ = P * conj(Q),
+             PP = P * conj(primeind(P,L2)),
+             cPQ = Pc * Qc;
+
+    ParallelProducts par(4,1);
+
+    CHECK(sameDat(PQ,P * conj(Q)));
+    CHECK(sameDat(PP,P * conj(primeind(P,L2))));
+    CHECK(sameDat(cPQ,Pc * Qc));
+    }
+
+TEST(ParallelCopyCount)
+    {
+    //Blocks too big to be summed directly, with the
+    //contracted indices in opposite orders so that
+    //every block product copies an operand
+    IQIndex I("I",Index("I Up",10),QN(+1),Index("I Dn",12),QN(-1),Out),
+            J("J",Index("J Up",8),QN(+1),Index("J Dn",9),QN(-1),Out);
+    IQTensor X = randomIQ(I,J,primed(J)),
+             Y = randomIQ(conj(primed(J)),conj(J),primed(I));
+    IQTensor R = X * Y;
+    const long serial = ProdCopyCount::last();
+    CHECK(serial > 0);
+
+    ParallelProducts par(4,1);
+    const long before = ProdCopyCount::bytes();
+    R = X * Y;
+    CHECK_EQUAL(ProdCopyCount::last(),serial);
+    CHECK_EQUAL(ProdCopyCount::bytes()-before,serial);
+    }
+
+TEST(ParallelBlockSVD)
+    {
+    //Blocks of different sizes, conserving QNs
+    IQTensor T(L1,L2);
+        {
+        ITensor ud(L1.index(1),L2.index(3)),
+                du(L1.index(2),L2.index(1));
+        ud.Randomize();
+        du.Randomize();
+        T += ud;
+        T += du;
+        }
+    IQTensor rho = T * conj(primeind(T,L1));
+
+    SVDWorker svd;
+    svd.cutoff(1E-4);
+    svd.maxm(5);
+
+    IQTensor U, V;
+    IQTSparse D;
+    svd.svdRank2(T,L1,L2,U,D,V);
+    Vector eigs;
+    IQIndex mid;
+    IQTensor Ur;
+    svd.diag_denmat(rho,eigs,mid,Ur);
+
+    ParallelProducts par(4,1);
+
+    IQTensor pU, pV;
+    IQTSparse pD;
+    svd.svdRank2(T,L1,L2,pU,pD,pV);
+    //Only the new link indices differ
+    CHECK(sameElems(U,pU));
+    CHECK(sameElems(V,pV));
+
+    Vector peigs;
+    IQIndex pmid;
+    IQTensor pUr;
+    svd.diag_denmat(rho,peigs,pmid,pUr);
+    CHECK(sameElems(Ur,pUr));
+    CHECK_EQUAL(eigs.Length(),peigs.Length());
+    for(int j = 1; j <= eigs.Length(); ++j)
+        CHECK_EQUAL(eigs(j),peigs(j));
+    }
+
+TEST(ParallelLocalMPOSet)
+    {
+    const int N = 8;
+    SpinHalf model(N);
+    InitState initState(N);
+    for(int i = 1; i <= N; ++i) 
+        initState(i) = (i%2==1 ? model.Up(i) : model.Dn(i));
+    IQMPS psi(model,initState);
+    psi.position(3);
+
+    //LocalMPOSet uses Op[1],Op[2],...
+    std::vector<IQMPO> Op(4);
+    Op[1] = Heisenberg(model);
+    Op[2] = Op[1];
+    Op[2] *= -0.5;
+    Op[3] = Heisenberg(model);
+
+    IQTensor phi = psi.AA(3) * psi.AA(4);
+
+    IQTensor sum;
+    for(int n = 1; n <= 3; ++n)
+        {
+        LocalMPO<IQTensor> lop(Op[n]);
+        lop.position(3,psi);
+        CHECK(lop.productFlops(phi) > 0);
+        IQTensor phin;
+        lop.product(phi,phin);
+        if(n == 1) sum = phin;
+        else       sum += phin;
+        }
+
+    ParallelProducts par(4,1);
+
+    LocalMPOSet<IQTensor> lset(Op);
+    lset.position(3,psi);
+    IQTensor phip;
+    lset.product(phi,phip);
+
+    CHECK((phip-sum).norm() < 1E-12*sum.norm());
+    }
+
+TEST(ConcurrentProducts)
+    {
+    const Results serial(*this);
+
+    //Each thread's block products also compete
+    //for the worker threads of the global pool
+    ParallelProducts par(3,1);
+
+    //The serial results must be reproducible
+    CHECK_EQUAL(serial.countMismatches(Results(*this)),0);
+
+    const int nthread = 8;
+    const int niter = 50;
+    std::vector<int> mismatches(nthread,0);
+
+    boost::thread_group workers;
+    for(int t = 0; t < nthread; ++t)
+        {
+        workers.create_thread(boost::bind(runWorker,boost::cref(*this),
+                                          boost::cref(serial),niter,
+                                          boost::ref(mismatches[t])));
+        }
+    workers.join_all();
+
+    for(int t = 0; t < nthread; ++t)
+        CHECK_EQUAL(mismatches[t],0);
+    }
+
+TEST(EigenValuesSmallStack)
+    {
+    //The LAPACK work space of a 400 x 400 block
+    //(about 2.5MB) does not fit on a 2MB stack
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(2*1024*1024);
+    Real resid = 1;
+    boost::thread t(attrs,boost::bind(eigenWorker,400,boost::ref(resid)));
+    t.join();
+    CHECK(resid < 1E-8);
+    }
+
+TEST(SharedConstOperand)
+    {
+    const Real sum = elemSum(P,L1,S1,L2);
+    const IQTensor PQ = P * conj(Q);
+
+    std::ostringstream os;
+    P.write(os);
+
+    const int nthread = 8;
+    std::vector<int> mismatches(nthread,0);
+    for(int round = 1; round <= 20; ++round)
+        {
+        //A copy read from disk looks blocks up only once
+        //its table is built, which every thread may try first
+        std::istringstream is(os.str());
+        const IQTensor shared(is);
+
+        boost::thread_group workers;
+        for(int t = 0; t < nthread; ++t)
+            {
+            workers.create_thread(boost::bind(sharedWorker,boost::cref(*this),
+                                              boost::cref(shared),sum,
+                                              boost::cref(PQ),
+                                              boost::ref(mismatches[t])));
+            }
+        workers.join_all();
+        }
+
+    for(int t = 0; t < nthread; ++t)
+        CHECK_EQUAL(mismatches[t],0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()